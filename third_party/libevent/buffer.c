@@ -49,8 +49,13 @@
 #include <sys/ioctl.h>
 #endif
 
+#ifndef WIN32
+#include <sys/uio.h>
+#endif
+
 #include <assert.h>
 #include <errno.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -65,77 +70,453 @@
 #include "config.h"
 #include "evutil.h"
 
+
+/*
+ * An evbuffer is a chain of segments.  Segments either own the memory
+ * that follows them, which can be appended to, or refer to read-only
+ * memory added with evbuffer_add_reference(), which is released once the
+ * last segment referring to it goes away.  Whole segments move between
+ * buffers without copying their data.
+ *
+ * The public fields of struct evbuffer describe the first segment, which
+ * is what EVBUFFER_DATA() reads.  A buffer only ever holds more than one
+ * segment, or a reference, once evbuffer_add_reference() or
+ * evbuffer_remove_buffer() put them there; until then its only segment
+ * grows in place, so that EVBUFFER_DATA() covers all of its data.
+ */
+
+/* New segments have room for at least this much data, */
+#define EVBUFFER_SEGMENT_MIN	256
+/* and grow by doubling up to this size */
+#define EVBUFFER_SEGMENT_MAX	(64 * 1024)
+/* Up to this much data is copied rather than moved between buffers */
+#define EVBUFFER_COPY_MAX	512
+/* Most segments written with one writev() */
+#define EVBUFFER_MAX_IOV	64
+#if defined(IOV_MAX) && IOV_MAX < EVBUFFER_MAX_IOV
+#undef EVBUFFER_MAX_IOV
+#define EVBUFFER_MAX_IOV	IOV_MAX
+#endif
+
+struct evbuffer_ref {
+	int refcnt;
+
+	const void *data;
+	size_t datlen;
+	void (*cleanupfn)(const void *, size_t, void *);
+	void *arg;
+};
+
+struct evbuffer_segment {
+	struct evbuffer_segment *next;
+
+	u_char *orig_buffer;
+	size_t misalign;
+	size_t off;
+	size_t totallen;
+
+	struct evbuffer_ref *ref;	/* NULL if the segment owns its memory */
+};
+
+/* The chain behind a struct evbuffer, allocated by evbuffer_new() */
+struct evbuffer_chain {
+	struct evbuffer buffer;
+
+	struct evbuffer_segment *first;
+	struct evbuffer_segment *last;
+};
+
+#define EVBUFFER_FIRST(x)	(((struct evbuffer_chain *)(x))->first)
+#define EVBUFFER_LAST(x)	(((struct evbuffer_chain *)(x))->last)
+
+#define SEGMENT_DATA(seg)	((seg)->orig_buffer + (seg)->misalign)
+#define SEGMENT_SPACE(seg)	((seg)->ref != NULL ? 0 : \
+	(seg)->totallen - (seg)->misalign - (seg)->off)
+
+static struct evbuffer_segment *
+evbuffer_segment_new(size_t datlen)
+{
+	struct evbuffer_segment *seg;
+	size_t length = EVBUFFER_SEGMENT_MIN;
+
+	while (length < datlen)
+		length <<= 1;
+
+	if ((seg = malloc(sizeof(struct evbuffer_segment) + length)) == NULL)
+		return (NULL);
+
+	seg->next = NULL;
+	seg->orig_buffer = (u_char *)(seg + 1);
+	seg->misalign = 0;
+	seg->off = 0;
+	seg->totallen = length;
+	seg->ref = NULL;
+
+	return (seg);
+}
+
+static void
+evbuffer_segment_free(struct evbuffer_segment *seg)
+{
+	struct evbuffer_ref *ref = seg->ref;
+
+	if (ref != NULL && --ref->refcnt == 0) {
+		if (ref->cleanupfn != NULL)
+			(*ref->cleanupfn)(ref->data, ref->datlen, ref->arg);
+		free(ref);
+	}
+	free(seg);
+}
+
+/* Points the public fields of the buffer at its first segment */
+static void
+evbuffer_sync(struct evbuffer *buf)
+{
+	struct evbuffer_segment *seg = EVBUFFER_FIRST(buf);
+
+	if (seg == NULL) {
+		buf->buffer = buf->orig_buffer = NULL;
+		buf->misalign = buf->totallen = 0;
+		return;
+	}
+	buf->orig_buffer = seg->orig_buffer;
+	buf->misalign = seg->misalign;
+	buf->totallen = seg->totallen;
+	buf->buffer = SEGMENT_DATA(seg);
+}
+
+/* Whether the data of the buffer is not all in one segment it owns */
+static int
+evbuffer_chained(struct evbuffer *buf)
+{
+	struct evbuffer_segment *seg = EVBUFFER_FIRST(buf);
+
+	return (seg != NULL && (seg != EVBUFFER_LAST(buf) || seg->ref != NULL));
+}
+
+static void
+evbuffer_append_segment(struct evbuffer *buf, struct evbuffer_segment *seg)
+{
+	struct evbuffer_segment *last = EVBUFFER_LAST(buf);
+
+	/* An empty segment left by evbuffer_drain() goes first */
+	if (last != NULL && last == EVBUFFER_FIRST(buf) && last->off == 0) {
+		evbuffer_segment_free(last);
+		EVBUFFER_FIRST(buf) = EVBUFFER_LAST(buf) = NULL;
+	}
+
+	seg->next = NULL;
+	if (EVBUFFER_LAST(buf) != NULL)
+		EVBUFFER_LAST(buf)->next = seg;
+	else
+		EVBUFFER_FIRST(buf) = seg;
+	EVBUFFER_LAST(buf) = seg;
+}
+
+/* Appends an empty segment with room for at least datlen bytes */
+static struct evbuffer_segment *
+evbuffer_grow(struct evbuffer *buf, size_t datlen)
+{
+	struct evbuffer_segment *seg, *last = EVBUFFER_LAST(buf);
+
+	if (last != NULL && last->ref == NULL &&
+	    last->totallen < EVBUFFER_SEGMENT_MAX &&
+	    datlen < last->totallen << 1)
+		datlen = last->totallen << 1;
+
+	if ((seg = evbuffer_segment_new(datlen)) == NULL)
+		return (NULL);
+	evbuffer_append_segment(buf, seg);
+
+	return (seg);
+}
+
+/*
+ * Makes room for datlen more bytes in the only segment of a buffer that
+ * is not chained, moving its data to the front or doubling its size.
+ */
+static int
+evbuffer_grow_inplace(struct evbuffer *buf, size_t datlen)
+{
+	struct evbuffer_segment *seg = EVBUFFER_FIRST(buf);
+	size_t need = seg->misalign + seg->off + datlen;
+	size_t length = seg->totallen;
+
+	if (length >= need)
+		return (0);
+
+	if (seg->misalign > 0) {
+		memmove(seg->orig_buffer, SEGMENT_DATA(seg), seg->off);
+		need -= seg->misalign;
+		seg->misalign = 0;
+		if (length >= need)
+			return (0);
+	}
+
+	while (length < need)
+		length <<= 1;
+	if ((seg = realloc(seg, sizeof(struct evbuffer_segment) + length))
+	    == NULL)
+		return (-1);
+	seg->orig_buffer = (u_char *)(seg + 1);
+	seg->totallen = length;
+	EVBUFFER_FIRST(buf) = EVBUFFER_LAST(buf) = seg;
+
+	return (0);
+}
+
+/* Moves all of the segments of inbuf to the end of outbuf */
+static void
+evbuffer_move_segments(struct evbuffer *outbuf, struct evbuffer *inbuf)
+{
+	struct evbuffer_segment *seg, *next;
+
+	for (seg = EVBUFFER_FIRST(inbuf); seg != NULL; seg = next) {
+		next = seg->next;
+		evbuffer_append_segment(outbuf, seg);
+	}
+	outbuf->off += inbuf->off;
+
+	EVBUFFER_FIRST(inbuf) = EVBUFFER_LAST(inbuf) = NULL;
+	inbuf->off = 0;
+	evbuffer_sync(inbuf);
+	evbuffer_sync(outbuf);
+}
+
+/* Copies the first datlen bytes of the buffer without draining them */
+static void
+evbuffer_copyout(struct evbuffer *buf, void *data, size_t datlen)
+{
+	struct evbuffer_segment *seg;
+	u_char *p = data;
+	size_t n;
+
+	for (seg = EVBUFFER_FIRST(buf); datlen > 0; seg = seg->next) {
+		n = seg->off < datlen ? seg->off : datlen;
+		memcpy(p, SEGMENT_DATA(seg), n);
+		p += n;
+		datlen -= n;
+	}
+}
+
 struct evbuffer *
 evbuffer_new(void)
 {
-	struct evbuffer *buffer;
+	struct evbuffer_chain *chain;
 	
-	buffer = calloc(1, sizeof(struct evbuffer));
+	chain = calloc(1, sizeof(struct evbuffer_chain));
 
-	return (buffer);
+	return (chain != NULL ? &chain->buffer : NULL);
 }
 
 void
 evbuffer_free(struct evbuffer *buffer)
 {
-	if (buffer->orig_buffer != NULL)
-		free(buffer->orig_buffer);
+	struct evbuffer_segment *seg, *next;
+
+	for (seg = EVBUFFER_FIRST(buffer); seg != NULL; seg = next) {
+		next = seg->next;
+		evbuffer_segment_free(seg);
+	}
 	free(buffer);
 }
 
 /* 
  * This is a destructive add.  The data from one buffer moves into
- * the other buffer.
+ * the other buffer.  Into an empty or chained output buffer, the segments
+ * are relinked unless there is little enough to copy into the free space
+ * of its last segment; into any other buffer, the data is copied so that
+ * it stays contiguous.
  */
 
-#define SWAP(x,y) do { \
-	(x)->buffer = (y)->buffer; \
-	(x)->orig_buffer = (y)->orig_buffer; \
-	(x)->misalign = (y)->misalign; \
-	(x)->totallen = (y)->totallen; \
-	(x)->off = (y)->off; \
-} while (0)
-
 int
 evbuffer_add_buffer(struct evbuffer *outbuf, struct evbuffer *inbuf)
 {
-	int res;
-
-	/* Short cut for better performance */
-	if (outbuf->off == 0) {
-		struct evbuffer tmp;
-		size_t oldoff = inbuf->off;
-
-		/* Swap them directly */
-		SWAP(&tmp, outbuf);
-		SWAP(outbuf, inbuf);
-		SWAP(inbuf, &tmp);
-
-		/* 
-		 * Optimization comes with a price; we need to notify the
-		 * buffer if necessary of the changes. oldoff is the amount
-		 * of data that we transfered from inbuf to outbuf
-		 */
-		if (inbuf->off != oldoff && inbuf->cb != NULL)
-			(*inbuf->cb)(inbuf, oldoff, inbuf->off, inbuf->cbarg);
-		if (oldoff && outbuf->cb != NULL)
-			(*outbuf->cb)(outbuf, 0, oldoff, outbuf->cbarg);
-		
+	struct evbuffer_segment *last = EVBUFFER_LAST(outbuf);
+	size_t outoff = outbuf->off;
+	size_t inoff = inbuf->off;
+
+	if (inoff == 0)
 		return (0);
+
+	if ((outoff > 0 && !evbuffer_chained(outbuf)) ||
+	    (inoff <= EVBUFFER_COPY_MAX && last != NULL &&
+	     SEGMENT_SPACE(last) >= inoff)) {
+		if (evbuffer_expand(outbuf, inoff) == -1)
+			return (-1);
+		last = EVBUFFER_LAST(outbuf);
+		evbuffer_copyout(inbuf, SEGMENT_DATA(last) + last->off, inoff);
+		last->off += inoff;
+		outbuf->off += inoff;
+		evbuffer_drain(inbuf, inoff);
+	} else {
+		evbuffer_move_segments(outbuf, inbuf);
+		if (inbuf->cb != NULL)
+			(*inbuf->cb)(inbuf, inoff, 0, inbuf->cbarg);
 	}
 
-	res = evbuffer_add(outbuf, inbuf->buffer, inbuf->off);
-	if (res == 0) {
-		/* We drain the input buffer on success */
-		evbuffer_drain(inbuf, inbuf->off);
+	if (outbuf->cb != NULL)
+		(*outbuf->cb)(outbuf, outoff, outbuf->off, outbuf->cbarg);
+
+	return (0);
+}
+
+int
+evbuffer_remove_buffer(struct evbuffer *src, struct evbuffer *dst,
+    size_t datlen)
+{
+	struct evbuffer_segment *seg, *part;
+	size_t srcoff = src->off;
+	size_t dstoff = dst->off;
+	size_t left;
+
+	if (datlen == 0 || srcoff == 0)
+		return (0);
+	if (datlen >= srcoff) {
+		evbuffer_move_segments(dst, src);
+		if (src->cb != NULL)
+			(*src->cb)(src, srcoff, 0, src->cbarg);
+		if (dst->cb != NULL)
+			(*dst->cb)(dst, dstoff, dst->off, dst->cbarg);
+		return (srcoff);
 	}
 
-	return (res);
+	/* Move the segments that go entirely */
+	for (left = datlen; left > 0 && (seg = EVBUFFER_FIRST(src))->off <= left;
+	    left -= seg->off) {
+		EVBUFFER_FIRST(src) = seg->next;
+		evbuffer_append_segment(dst, seg);
+	}
+
+	/* and share or copy the part of the one that is split */
+	if (left > 0) {
+		seg = EVBUFFER_FIRST(src);
+		if (seg->ref != NULL) {
+			if ((part = malloc(sizeof(struct evbuffer_segment)))
+			    == NULL)
+				goto out;
+			*part = *seg;
+			part->off = left;
+			part->ref->refcnt++;
+			evbuffer_append_segment(dst, part);
+		} else {
+			part = EVBUFFER_LAST(dst);
+			if (part == NULL || SEGMENT_SPACE(part) < left) {
+				if ((part = evbuffer_grow(dst, left)) == NULL)
+					goto out;
+			}
+			memcpy(SEGMENT_DATA(part) + part->off,
+			    SEGMENT_DATA(seg), left);
+			part->off += left;
+		}
+		seg->misalign += left;
+		seg->off -= left;
+		left = 0;
+	}
+
+ out:
+	datlen -= left;
+	src->off -= datlen;
+	dst->off += datlen;
+	evbuffer_sync(src);
+	evbuffer_sync(dst);
+
+	if (datlen && src->cb != NULL)
+		(*src->cb)(src, srcoff, src->off, src->cbarg);
+	if (datlen && dst->cb != NULL)
+		(*dst->cb)(dst, dstoff, dst->off, dst->cbarg);
+
+	return (datlen);
+}
+
+int
+evbuffer_add_reference(struct evbuffer *buf, const void *data, size_t datlen,
+    void (*cleanupfn)(const void *, size_t, void *), void *arg)
+{
+	struct evbuffer_segment *seg;
+	struct evbuffer_ref *ref;
+	size_t oldoff = buf->off;
+
+	if (datlen == 0) {
+		if (cleanupfn != NULL)
+			(*cleanupfn)(data, datlen, arg);
+		return (0);
+	}
+
+	if ((ref = malloc(sizeof(struct evbuffer_ref))) == NULL)
+		return (-1);
+	if ((seg = malloc(sizeof(struct evbuffer_segment))) == NULL) {
+		free(ref);
+		return (-1);
+	}
+
+	ref->refcnt = 1;
+	ref->data = data;
+	ref->datlen = datlen;
+	ref->cleanupfn = cleanupfn;
+	ref->arg = arg;
+
+	seg->orig_buffer = (u_char *)data;
+	seg->misalign = 0;
+	seg->off = datlen;
+	seg->totallen = datlen;
+	seg->ref = ref;
+	evbuffer_append_segment(buf, seg);
+	buf->off += datlen;
+	evbuffer_sync(buf);
+
+	if (buf->cb != NULL)
+		(*buf->cb)(buf, oldoff, buf->off, buf->cbarg);
+
+	return (0);
+}
+
+u_char *
+evbuffer_pullup(struct evbuffer *buf, size_t size)
+{
+	struct evbuffer_segment *seg, *next, *tmp;
+	size_t copied, n;
+
+	if (size > buf->off)
+		size = buf->off;
+
+	if ((seg = EVBUFFER_FIRST(buf)) == NULL)
+		return (NULL);
+	if (seg->off >= size)
+		return (SEGMENT_DATA(seg));
+
+	if ((tmp = evbuffer_segment_new(size)) == NULL)
+		return (NULL);
+
+	for (copied = 0; copied < size; seg = next) {
+		next = seg->next;
+		n = size - copied;
+		if (n < seg->off) {
+			memcpy(tmp->orig_buffer + copied, SEGMENT_DATA(seg), n);
+			seg->misalign += n;
+			seg->off -= n;
+			copied += n;
+			break;
+		}
+		memcpy(tmp->orig_buffer + copied, SEGMENT_DATA(seg), seg->off);
+		copied += seg->off;
+		evbuffer_segment_free(seg);
+	}
+
+	tmp->off = size;
+	tmp->next = seg;
+	EVBUFFER_FIRST(buf) = tmp;
+	if (seg == NULL)
+		EVBUFFER_LAST(buf) = tmp;
+	evbuffer_sync(buf);
+
+	return (tmp->orig_buffer);
 }
 
 int
 evbuffer_add_vprintf(struct evbuffer *buf, const char *fmt, va_list ap)
 {
+	struct evbuffer_segment *last;
 	char *buffer;
 	size_t space;
 	size_t oldoff = buf->off;
@@ -143,12 +524,12 @@ evbuffer_add_vprintf(struct evbuffer *buf, const char *fmt, va_list ap)
 	va_list aq;
 
 	/* make sure that at least some space is available */
-	evbuffer_expand(buf, 64);
+	if (evbuffer_expand(buf, 64) == -1)
+		return (-1);
 	for (;;) {
-		size_t used = buf->misalign + buf->off;
-		buffer = (char *)buf->buffer + buf->off;
-		assert(buf->totallen >= used);
-		space = buf->totallen - used;
+		last = EVBUFFER_LAST(buf);
+		buffer = (char *)SEGMENT_DATA(last) + last->off;
+		space = SEGMENT_SPACE(last);
 
 #ifndef va_copy
 #define	va_copy(dst, src)	memcpy(&(dst), &(src), sizeof(va_list))
@@ -162,7 +543,9 @@ evbuffer_add_vprintf(struct evbuffer *buf, const char *fmt, va_list ap)
 		if (sz < 0)
 			return (-1);
 		if ((size_t)sz < space) {
+			last->off += sz;
 			buf->off += sz;
+			evbuffer_sync(buf);
 			if (buf->cb != NULL)
 				(*buf->cb)(buf, oldoff, buf->off, buf->cbarg);
 			return (sz);
@@ -196,7 +579,7 @@ evbuffer_remove(struct evbuffer *buf, void *data, size_t datlen)
 	if (nread >= buf->off)
 		nread = buf->off;
 
-	memcpy(data, buf->buffer, nread);
+	evbuffer_copyout(buf, data, nread);
 	evbuffer_drain(buf, nread);
 	
 	return (nread);
@@ -210,39 +593,53 @@ evbuffer_remove(struct evbuffer *buf, void *data, size_t datlen)
 char *
 evbuffer_readline(struct evbuffer *buffer)
 {
-	u_char *data = EVBUFFER_DATA(buffer);
-	size_t len = EVBUFFER_LENGTH(buffer);
+	struct evbuffer_segment *seg;
+	u_char *data;
 	char *line;
-	unsigned int i;
-
-	for (i = 0; i < len; i++) {
-		if (data[i] == '\r' || data[i] == '\n')
+	size_t i = 0, j = 0;
+	int fch, sch = -1;
+
+	for (seg = EVBUFFER_FIRST(buffer); seg != NULL; seg = seg->next) {
+		data = SEGMENT_DATA(seg);
+		for (j = 0; j < seg->off; j++) {
+			if (data[j] == '\r' || data[j] == '\n')
+				break;
+		}
+		if (j < seg->off)
 			break;
+		i += seg->off;
 	}
 
-	if (i == len)
+	if (seg == NULL)
 		return (NULL);
 
-	if ((line = malloc(i + 1)) == NULL) {
+	if ((line = malloc(i + j + 1)) == NULL) {
 		fprintf(stderr, "%s: out of memory\n", __func__);
 		return (NULL);
 	}
 
-	memcpy(line, data, i);
-	line[i] = '\0';
-
 	/*
 	 * Some protocols terminate a line with '\r\n', so check for
 	 * that, too.
 	 */
-	if ( i < len - 1 ) {
-		char fch = data[i], sch = data[i+1];
-
-		/* Drain one more character if needed */
-		if ( (sch == '\r' || sch == '\n') && sch != fch )
-			i += 1;
+	fch = data[j];
+	if (j + 1 < seg->off) {
+		sch = data[j + 1];
+	} else {
+		while ((seg = seg->next) != NULL && seg->off == 0)
+			;
+		if (seg != NULL)
+			sch = *SEGMENT_DATA(seg);
 	}
 
+	i += j;
+	evbuffer_copyout(buffer, line, i);
+	line[i] = '\0';
+
+	/* Drain one more character if needed */
+	if ((sch == '\r' || sch == '\n') && sch != fch)
+		i += 1;
+
 	evbuffer_drain(buffer, i + 1);
 
 	return (line);
@@ -250,65 +647,69 @@ evbuffer_readline(struct evbuffer *buffer)
 
 /* Adds data to an event buffer */
 
-static void
-evbuffer_align(struct evbuffer *buf)
-{
-	memmove(buf->orig_buffer, buf->buffer, buf->off);
-	buf->buffer = buf->orig_buffer;
-	buf->misalign = 0;
-}
-
-/* Expands the available space in the event buffer to at least datlen */
+/*
+ * Makes room for at least datlen contiguous bytes at the end of the
+ * event buffer, in a new segment if the last one is too small.
+ */
 
 int
 evbuffer_expand(struct evbuffer *buf, size_t datlen)
 {
-	size_t need = buf->misalign + buf->off + datlen;
-
-	/* If we can fit all the data, then we don't have to do anything */
-	if (buf->totallen >= need)
+	struct evbuffer_segment *last = EVBUFFER_LAST(buf);
+	int res = 0;
+
+	if (last != NULL && !evbuffer_chained(buf)) {
+		res = evbuffer_grow_inplace(buf, datlen);
+	} else if (last != NULL && last->ref == NULL &&
+	    SEGMENT_SPACE(last) >= datlen) {
+		/* If we can fit all the data, then we don't have to do anything */
 		return (0);
-
-	/*
-	 * If the misalignment fulfills our data needs, we just force an
-	 * alignment to happen.  Afterwards, we have enough space.
-	 */
-	if (buf->misalign >= datlen) {
-		evbuffer_align(buf);
-	} else {
-		void *newbuf;
-		size_t length = buf->totallen;
-
-		if (length < 256)
-			length = 256;
-		while (length < need)
-			length <<= 1;
-
-		if (buf->orig_buffer != buf->buffer)
-			evbuffer_align(buf);
-		if ((newbuf = realloc(buf->buffer, length)) == NULL)
-			return (-1);
-
-		buf->orig_buffer = buf->buffer = newbuf;
-		buf->totallen = length;
+	} else if (last != NULL && last->ref == NULL && last->off == 0 &&
+	    last->totallen >= datlen) {
+		/* An empty segment can start over at its beginning */
+		last->misalign = 0;
+	} else if (evbuffer_grow(buf, datlen) == NULL) {
+		res = -1;
 	}
+	evbuffer_sync(buf);
 
-	return (0);
+	return (res);
 }
 
 int
 evbuffer_add(struct evbuffer *buf, const void *data, size_t datlen)
 {
-	size_t need = buf->misalign + buf->off + datlen;
+	struct evbuffer_segment *last = EVBUFFER_LAST(buf);
+	const u_char *p = data;
 	size_t oldoff = buf->off;
+	size_t n = 0;
 
-	if (buf->totallen < need) {
+	/* Keep a buffer that is not chained in one segment */
+	if (!evbuffer_chained(buf)) {
 		if (evbuffer_expand(buf, datlen) == -1)
 			return (-1);
+		last = EVBUFFER_LAST(buf);
 	}
 
-	memcpy(buf->buffer + buf->off, data, datlen);
+	/* Fill up the last segment, and put the rest into a new one */
+	if (last != NULL) {
+		n = SEGMENT_SPACE(last);
+		if (n > datlen)
+			n = datlen;
+		memcpy(SEGMENT_DATA(last) + last->off, p, n);
+		last->off += n;
+	}
+	if (n < datlen) {
+		if ((last = evbuffer_grow(buf, datlen - n)) == NULL) {
+			if (n > 0)
+				EVBUFFER_LAST(buf)->off -= n;
+			return (-1);
+		}
+		memcpy(SEGMENT_DATA(last), p + n, datlen - n);
+		last->off = datlen - n;
+	}
 	buf->off += datlen;
+	evbuffer_sync(buf);
 
 	if (datlen && buf->cb != NULL)
 		(*buf->cb)(buf, oldoff, buf->off, buf->cbarg);
@@ -319,21 +720,35 @@ evbuffer_add(struct evbuffer *buf, const void *data, size_t datlen)
 void
 evbuffer_drain(struct evbuffer *buf, size_t len)
 {
+	struct evbuffer_segment *seg;
 	size_t oldoff = buf->off;
 
-	if (len >= buf->off) {
-		buf->off = 0;
-		buf->buffer = buf->orig_buffer;
-		buf->misalign = 0;
-		goto done;
-	}
+	if (len > buf->off)
+		len = buf->off;
+	buf->off -= len;
 
-	buf->buffer += len;
-	buf->misalign += len;
+	while ((seg = EVBUFFER_FIRST(buf)) != NULL && seg->off <= len) {
+		/* Keep the last segment around to be filled again */
+		if (seg == EVBUFFER_LAST(buf) && seg->ref == NULL &&
+		    seg->totallen <= EVBUFFER_SEGMENT_MAX) {
+			seg->misalign = 0;
+			seg->off = 0;
+			len = 0;
+			break;
+		}
+		len -= seg->off;
+		EVBUFFER_FIRST(buf) = seg->next;
+		evbuffer_segment_free(seg);
+	}
 
-	buf->off -= len;
+	if (EVBUFFER_FIRST(buf) == NULL) {
+		EVBUFFER_LAST(buf) = NULL;
+	} else {
+		seg->misalign += len;
+		seg->off -= len;
+	}
+	evbuffer_sync(buf);
 
- done:
 	/* Tell someone about changes in this buffer */
 	if (buf->off != oldoff && buf->cb != NULL)
 		(*buf->cb)(buf, oldoff, buf->off, buf->cbarg);
@@ -349,9 +764,17 @@ evbuffer_drain(struct evbuffer *buf, size_t len)
 int
 evbuffer_read(struct evbuffer *buf, int fd, int howmuch)
 {
-	u_char *p;
+	struct evbuffer_segment *last, *seg = NULL;
 	size_t oldoff = buf->off;
+	size_t space = 0, capacity = 0;
 	int n = EVBUFFER_MAX_READ;
+#ifndef WIN32
+	struct iovec iov[2];
+	int niov = 0, serrno;
+#endif
+
+	if (EVBUFFER_LAST(buf) != NULL)
+		capacity = EVBUFFER_LAST(buf)->totallen;
 
 #if defined(FIONREAD)
 #ifdef WIN32
@@ -369,8 +792,8 @@ evbuffer_read(struct evbuffer *buf, int fd, int howmuch)
 		 * about it.  If the reader does not tell us how much
 		 * data we should read, we artifically limit it.
 		 */
-		if ((size_t)n > buf->totallen << 2)
-			n = buf->totallen << 2;
+		if ((size_t)n > capacity << 2)
+			n = capacity << 2;
 		if (n < EVBUFFER_MAX_READ)
 			n = EVBUFFER_MAX_READ;
 	}
@@ -378,24 +801,66 @@ evbuffer_read(struct evbuffer *buf, int fd, int howmuch)
 	if (howmuch < 0 || howmuch > n)
 		howmuch = n;
 
+#ifndef WIN32
+	/*
+	 * Read into the space left in the last segment, and into a new
+	 * segment if that is not enough and the buffer is chained.
+	 */
+	if (!evbuffer_chained(buf) && evbuffer_expand(buf, howmuch) == -1)
+		return (-1);
+	last = EVBUFFER_LAST(buf);
+	if (last != NULL && last->ref == NULL && last->off == 0)
+		last->misalign = 0;
+	if (last != NULL && (space = SEGMENT_SPACE(last)) > 0) {
+		if (space > (size_t)howmuch)
+			space = howmuch;
+		iov[niov].iov_base = (void *)(SEGMENT_DATA(last) + last->off);
+		iov[niov].iov_len = space;
+		niov++;
+	}
+	if (space < (size_t)howmuch) {
+		if ((seg = evbuffer_segment_new(howmuch - space)) == NULL)
+			return (-1);
+		iov[niov].iov_base = (void *)seg->orig_buffer;
+		iov[niov].iov_len = howmuch - space;
+		niov++;
+	}
+
+	n = readv(fd, iov, niov);
+	if (n <= 0) {
+		serrno = errno;
+		if (seg != NULL)
+			free(seg);
+		errno = serrno;
+		return (n == -1 ? -1 : 0);
+	}
+
+	if (space > 0) {
+		last->off += (size_t)n < space ? (size_t)n : space;
+	}
+	if ((size_t)n > space) {
+		seg->off = n - space;
+		evbuffer_append_segment(buf, seg);
+	} else if (seg != NULL) {
+		free(seg);
+	}
+#else
 	/* If we don't have FIONREAD, we might waste some space here */
 	if (evbuffer_expand(buf, howmuch) == -1)
 		return (-1);
 
 	/* We can append new data at this point */
-	p = buf->buffer + buf->off;
-
-#ifndef WIN32
-	n = read(fd, p, howmuch);
-#else
-	n = recv(fd, p, howmuch, 0);
-#endif
+	last = EVBUFFER_LAST(buf);
+	n = recv(fd, SEGMENT_DATA(last) + last->off, howmuch, 0);
 	if (n == -1)
 		return (-1);
 	if (n == 0)
 		return (0);
 
+	last->off += n;
+#endif
 	buf->off += n;
+	evbuffer_sync(buf);
 
 	/* Tell someone about changes in this buffer */
 	if (buf->off != oldoff && buf->cb != NULL)
@@ -407,12 +872,29 @@ evbuffer_read(struct evbuffer *buf, int fd, int howmuch)
 int
 evbuffer_write(struct evbuffer *buffer, int fd)
 {
+	struct evbuffer_segment *seg;
 	int n;
-
 #ifndef WIN32
-	n = write(fd, buffer->buffer, buffer->off);
+	struct iovec iov[EVBUFFER_MAX_IOV];
+	int niov = 0;
+
+	for (seg = EVBUFFER_FIRST(buffer); seg != NULL && niov < EVBUFFER_MAX_IOV;
+	    seg = seg->next) {
+		if (seg->off == 0)
+			continue;
+		iov[niov].iov_base = (void *)SEGMENT_DATA(seg);
+		iov[niov].iov_len = seg->off;
+		niov++;
+	}
+
+	n = writev(fd, iov, niov);
 #else
-	n = send(fd, buffer->buffer, buffer->off, 0);
+	for (seg = EVBUFFER_FIRST(buffer); seg != NULL && seg->off == 0;
+	    seg = seg->next)
+		;
+	if (seg == NULL)
+		return (0);
+	n = send(fd, SEGMENT_DATA(seg), seg->off, 0);
 #endif
 	if (n == -1)
 		return (-1);
@@ -426,9 +908,14 @@ evbuffer_write(struct evbuffer *buffer, int fd)
 u_char *
 evbuffer_find(struct evbuffer *buffer, const u_char *what, size_t len)
 {
-	u_char *search = buffer->buffer, *end = search + buffer->off;
+	u_char *search = evbuffer_pullup(buffer, buffer->off);
+	u_char *end;
 	u_char *p;
 
+	if (search == NULL)
+		return (NULL);
+	end = search + buffer->off;
+
 	while (search < end &&
 	    (p = memchr(search, *what, end - search)) != NULL) {
 		if (p + len > end)
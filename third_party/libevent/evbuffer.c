@@ -342,11 +342,17 @@ bufferevent_write(struct bufferevent *bufev, const void *data, size_t size)
 int
 bufferevent_write_buffer(struct bufferevent *bufev, struct evbuffer *buf)
 {
+	size_t size = EVBUFFER_LENGTH(buf);
 	int res;
 
-	res = bufferevent_write(bufev, buf->buffer, buf->off);
-	if (res != -1)
-		evbuffer_drain(buf, buf->off);
+	res = evbuffer_add_buffer(bufev->output, buf);
+
+	if (res == -1)
+		return (res);
+
+	/* If everything is okay, we need to schedule a write */
+	if (size > 0 && (bufev->enabled & EV_WRITE))
+		bufferevent_add(&bufev->ev_write, bufev->timeout_write);
 
 	return (res);
 }
@@ -354,18 +360,8 @@ bufferevent_write_buffer(struct bufferevent *bufev, struct evbuffer *buf)
 size_t
 bufferevent_read(struct bufferevent *bufev, void *data, size_t size)
 {
-	struct evbuffer *buf = bufev->input;
-
-	if (buf->off < size)
-		size = buf->off;
-
 	/* Copy the available data to the user buffer */
-	memcpy(data, buf->buffer, size);
-
-	if (size)
-		evbuffer_drain(buf, size);
-
-	return (size);
+	return (evbuffer_remove(bufev->input, data, size));
 }
 
 int
@@ -85,6 +85,9 @@
 #ifdef HAVE_SYS_TIME_H
 #include <sys/time.h>
 #endif
+#ifdef HAVE_CLOCK_GETTIME
+#include <time.h>
+#endif
 #ifdef HAVE_STDINT_H
 #include <stdint.h>
 #endif
@@ -155,6 +158,7 @@ typedef unsigned int uint;
 
 #define TYPE_A         EVDNS_TYPE_A
 #define TYPE_CNAME     5
+#define TYPE_SOA       EVDNS_TYPE_SOA
 #define TYPE_PTR       EVDNS_TYPE_PTR
 #define TYPE_AAAA      EVDNS_TYPE_AAAA
 
@@ -654,7 +658,7 @@ reply_callback(struct request *const req, u32 ttl, u32 err, struct reply *reply)
 						 reply->data.a.addresses,
 							   req->user_pointer);
 		else
-			req->user_callback(err, 0, 0, 0, NULL, req->user_pointer);
+			req->user_callback(err, 0, 0, ttl, NULL, req->user_pointer);
 		return;
 	case TYPE_PTR:
 		if (reply) {
@@ -662,7 +666,7 @@ reply_callback(struct request *const req, u32 ttl, u32 err, struct reply *reply)
 			req->user_callback(DNS_ERR_NONE, DNS_PTR, 1, ttl,
 							   &name, req->user_pointer);
 		} else {
-			req->user_callback(err, 0, 0, 0, NULL,
+			req->user_callback(err, 0, 0, ttl, NULL,
 							   req->user_pointer);
 		}
 		return;
@@ -673,7 +677,7 @@ reply_callback(struct request *const req, u32 ttl, u32 err, struct reply *reply)
 							   reply->data.aaaa.addresses,
 							   req->user_pointer);
 		else
-			req->user_callback(err, 0, 0, 0, NULL, req->user_pointer);
+			req->user_callback(err, 0, 0, ttl, NULL, req->user_pointer);
                 return;
 	}
 	assert(0);
@@ -743,8 +747,9 @@ reply_handle(struct request *const req, u16 flags, u32 ttl, struct reply *reply)
 			}
 		}
 
-		/* all else failed. Pass the failure up */
-		reply_callback(req, 0, error, NULL);
+		/* all else failed. Pass the failure up, with the time */
+		/* for which it may be cached if it is a negative answer */
+		reply_callback(req, ttl, error, NULL);
 		request_finished(req, &req_head);
 	} else {
 		/* all ok, tell the user */
@@ -820,7 +825,7 @@ reply_parse(u8 *packet, int length) {
 
 	u16 trans_id, questions, answers, authority, additional, datalength;
         u16 flags = 0;
-	u32 ttl, ttl_r = 0xffffffff;
+	u32 ttl, ttl_r = 0xffffffff, ttl_neg = 0;
 	struct reply reply;
 	struct request *req = NULL;
 	unsigned int i;
@@ -831,7 +836,6 @@ reply_parse(u8 *packet, int length) {
 	GET16(answers);
 	GET16(authority);
 	GET16(additional);
-	(void) authority; /* suppress "unused variable" warnings. */
 	(void) additional; /* suppress "unused variable" warnings. */
 
 	req = request_find_from_trans_id(trans_id);
@@ -841,8 +845,8 @@ reply_parse(u8 *packet, int length) {
 
 	/* If it's not an answer, it doesn't correspond to any request. */
 	if (!(flags & 0x8000)) return -1;  /* must be an answer */
-	if (flags & 0x020f) {
-		/* there was an error */
+	if ((flags & 0x020f) && (flags & 0x020f) != 3) {
+		/* there was an error; NXDOMAIN goes on to find its SOA */
 		goto err;
 	}
 	/* if (!answers) return; */  /* must have an answer of some form */
@@ -944,7 +948,34 @@ reply_parse(u8 *packet, int length) {
 		}
 	}
 
-	reply_handle(req, flags, ttl_r, &reply);
+	if (!reply.have_answer) {
+		/* A negative answer may be cached for the lesser of the */
+		/* ttl and the minimum field of the SOA record in the */
+		/* authority section (RFC 2308). */
+		for (i = 0; i < authority; ++i) {
+			u16 type, class;
+			int next;
+
+			SKIP_NAME;
+			GET16(type);
+			GET16(class);
+			GET32(ttl);
+			GET16(datalength);
+			next = j + datalength;
+			if (type == TYPE_SOA && class == CLASS_INET) {
+				u32 minimum;
+				SKIP_NAME;  /* mname */
+				SKIP_NAME;  /* rname */
+				j += 16;  /* serial, refresh, retry, expire */
+				GET32(minimum);
+				ttl_neg = MIN(ttl, minimum);
+				break;
+			}
+			j = next;
+		}
+	}
+
+	reply_handle(req, flags, reply.have_answer ? ttl_r : ttl_neg, &reply);
 	return 0;
  err:
 	if (req)
@@ -2289,41 +2320,476 @@ request_submit(struct request *const req) {
 	}
 }
 
+/*/////////////////////////////////////////////////////////////////// */
+/* Answer cache */
+/* */
+/* Answers are kept by query type and the name the user asked for until */
+/* their ttl runs out. That includes negative answers, if the nameserver */
+/* said for how long they hold. A lookup of a name which is already in */
+/* flight does not send a query of its own: the caller waits on the cache */
+/* entry and all the waiters are called back with the one answer. */
+/* Answers from the cache are handed out from the event loop, never from */
+/* inside evdns_resolve_*, just like answers from the network. */
+/* */
+/* Entries with an answer are kept on an LRU list and the least recently */
+/* used ones go when the cache grows past global_cache_size bytes. */
+
+struct cache_waiter {
+	struct cache_waiter *next;
+	struct cache_entry *entry;  /* only for queued deliveries */
+	evdns_callback_type callback;
+	void *arg;
+};
+
+struct cache_entry {
+	struct cache_entry *hash_next;
+	/* entries with an answer are kept in a circular LRU list */
+	struct cache_entry *lru_next, *lru_prev;
+	u32 hash;
+	int refcount;  /* one for the table, one per queued delivery */
+	int request_type;
+	int flags;  /* DNS_QUERY_NO_SEARCH or 0 */
+	char in_table;
+	char pending;  /* a query is in flight; waiters get its answer */
+	struct cache_waiter *waiters;
+
+	/* the answer, as it is passed to the callback */
+	int result;
+	char type;
+	int count;
+	time_t expires;
+	void *addresses;  /* for TYPE_PTR, the name */
+	size_t size;  /* bytes charged against global_cache_size */
+
+	char name[1];  /* the rest of the name follows this struct */
+};
+
+static size_t global_cache_size = 0;  /* off until cache-size: is set */
+static struct cache_entry **cache_table = NULL;
+static u32 cache_table_size = 0;
+static u32 cache_table_count = 0;
+static struct cache_entry *cache_lru_head = NULL;  /* most recently used */
+static struct evdns_cache_stats cache_stats;
+
+/* cached answers waiting for the event loop to hand them out */
+static struct cache_waiter *cache_deliveries = NULL;
+static struct cache_waiter **cache_deliveries_tail = &cache_deliveries;
+static struct event cache_delivery_event;
+
+static time_t
+cache_now(void) {
+	struct timeval tv;
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+	struct timespec ts;
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+		return ts.tv_sec;
+#endif
+	evutil_gettimeofday(&tv, NULL);
+	return tv.tv_sec;
+}
+
+/* names are compared without regard to case, as DNS does */
+static u32
+cache_hash(int type, int flags, const char *name) {
+	u32 h = 2166136261U ^ (u32)(type << 1 | flags);
+	for (; *name; ++name)
+		h = (h ^ (u8)tolower((int)(u8)*name)) * 16777619U;
+	return h;
+}
+
+static int
+cache_name_eq(const char *a, const char *b) {
+	for (; *a && *b; ++a, ++b) {
+		if (tolower((int)(u8)*a) != tolower((int)(u8)*b))
+			return 0;
+	}
+	return *a == *b;
+}
+
+static void
+cache_entry_decref(struct cache_entry *const entry) {
+	if (--entry->refcount) return;
+	free(entry->addresses);
+	free(entry);
+}
+
+static void
+cache_lru_unlink(struct cache_entry *const entry) {
+	if (entry->lru_next == entry) {
+		cache_lru_head = NULL;
+	} else {
+		entry->lru_next->lru_prev = entry->lru_prev;
+		entry->lru_prev->lru_next = entry->lru_next;
+		if (cache_lru_head == entry)
+			cache_lru_head = entry->lru_next;
+	}
+}
+
+static void
+cache_lru_push(struct cache_entry *const entry) {
+	if (!cache_lru_head) {
+		entry->lru_next = entry->lru_prev = entry;
+	} else {
+		entry->lru_next = cache_lru_head;
+		entry->lru_prev = cache_lru_head->lru_prev;
+		entry->lru_prev->lru_next = entry;
+		cache_lru_head->lru_prev = entry;
+	}
+	cache_lru_head = entry;
+}
+
+/* takes an entry out of the table, along with any waiters it has */
+static void
+cache_remove(struct cache_entry *const entry) {
+	struct cache_entry **p = &cache_table[entry->hash & (cache_table_size - 1)];
+	struct cache_waiter *waiter, *next;
+
+	while (*p != entry) p = &(*p)->hash_next;
+	*p = entry->hash_next;
+	cache_table_count--;
+	entry->in_table = 0;
+
+	if (!entry->pending) {
+		cache_lru_unlink(entry);
+		cache_stats.entries--;
+		cache_stats.size -= entry->size;
+	}
+	for (waiter = entry->waiters; waiter; waiter = next) {
+		next = waiter->next;
+		free(waiter);
+	}
+	entry->waiters = NULL;
+	cache_entry_decref(entry);
+}
+
+static void
+cache_evict(void) {
+	while (cache_lru_head && cache_stats.size > global_cache_size) {
+		cache_remove(cache_lru_head->lru_prev);
+		cache_stats.evictions++;
+	}
+}
+
+static struct cache_entry *
+cache_find(int type, int flags, const char *name, u32 hash) {
+	struct cache_entry *entry;
+	if (!cache_table) return NULL;
+	for (entry = cache_table[hash & (cache_table_size - 1)]; entry;
+		 entry = entry->hash_next) {
+		if (entry->hash == hash && entry->request_type == type &&
+			entry->flags == flags && cache_name_eq(entry->name, name))
+			return entry;
+	}
+	return NULL;
+}
+
+/* adds a pending entry for a query which is about to be sent */
+static struct cache_entry *
+cache_insert(int type, int flags, const char *name, u32 hash) {
+	const size_t namelen = strlen(name);
+	struct cache_entry *entry;
+	u32 i;
+
+	if (cache_table_count >= cache_table_size) {
+		const u32 size = cache_table_size ? cache_table_size * 2 : 64;
+		struct cache_entry **table = (struct cache_entry **)
+			calloc(size, sizeof(struct cache_entry *));
+		if (!table) return NULL;
+		for (i = 0; i < cache_table_size; ++i) {
+			struct cache_entry *next;
+			for (entry = cache_table[i]; entry; entry = next) {
+				next = entry->hash_next;
+				entry->hash_next = table[entry->hash & (size - 1)];
+				table[entry->hash & (size - 1)] = entry;
+			}
+		}
+		free(cache_table);
+		cache_table = table;
+		cache_table_size = size;
+	}
+
+	entry = (struct cache_entry *) malloc(sizeof(struct cache_entry) + namelen);
+	if (!entry) return NULL;
+	memset(entry, 0, sizeof(struct cache_entry));
+	memcpy(entry->name, name, namelen + 1);
+	entry->hash = hash;
+	entry->refcount = 1;
+	entry->request_type = type;
+	entry->flags = flags;
+	entry->in_table = 1;
+	entry->pending = 1;
+	entry->hash_next = cache_table[hash & (cache_table_size - 1)];
+	cache_table[hash & (cache_table_size - 1)] = entry;
+	cache_table_count++;
+	return entry;
+}
+
+/* keeps the answer to a pending entry. returns -1 if it is not kept. */
+static int
+cache_store(struct cache_entry *const entry, int result, char type, int count,
+			int ttl, void *addresses) {
+	size_t datalen = 0;
+
+	if (ttl <= 0 || !global_cache_size) return -1;
+	if (result == DNS_ERR_NONE) {
+		switch (entry->request_type) {
+		case TYPE_A:
+			datalen = 4 * count;
+			break;
+		case TYPE_AAAA:
+			datalen = 16 * count;
+			break;
+		case TYPE_PTR:
+			addresses = *(char **)addresses;
+			datalen = strlen(addresses) + 1;
+			break;
+		}
+		if (!(entry->addresses = malloc(datalen))) return -1;
+		memcpy(entry->addresses, addresses, datalen);
+	}
+	entry->size = sizeof(struct cache_entry) + strlen(entry->name) + datalen;
+	entry->result = result;
+	entry->type = type;
+	entry->count = count;
+	entry->expires = cache_now() + ttl;
+	entry->pending = 0;
+
+	cache_lru_push(entry);
+	cache_stats.entries++;
+	cache_stats.size += entry->size;
+	cache_evict();
+	return 0;
+}
+
+/* the callback of queries sent on behalf of the cache */
+static void
+cache_reply_callback(int result, char type, int count, int ttl,
+					 void *addresses, void *arg) {
+	struct cache_entry *const entry = (struct cache_entry *) arg;
+	struct cache_waiter *waiter = entry->waiters, *next;
+
+	/* the waiters are called back after the entry is settled, so */
+	/* that they may look the name up again */
+	entry->waiters = NULL;
+	if (cache_store(entry, result, type, count, ttl, addresses) < 0)
+		cache_remove(entry);
+
+	for (; waiter; waiter = next) {
+		next = waiter->next;
+		waiter->callback(result, type, count, ttl, addresses, waiter->arg);
+		free(waiter);
+	}
+}
+
+static void
+cache_deliver(int fd, short events, void *arg) {
+	struct cache_waiter *delivery = cache_deliveries, *next;
+	const time_t now = cache_now();
+	(void)fd;
+	(void)events;
+	(void)arg;
+
+	cache_deliveries = NULL;
+	cache_deliveries_tail = &cache_deliveries;
+	for (; delivery; delivery = next) {
+		struct cache_entry *const entry = delivery->entry;
+		void *addresses = entry->addresses;
+		const int ttl = entry->expires > now ? (int)(entry->expires - now) : 0;
+
+		next = delivery->next;
+		if (entry->result == DNS_ERR_NONE && entry->request_type == TYPE_PTR)
+			addresses = &entry->addresses;
+		delivery->callback(entry->result, entry->type, entry->count, ttl,
+						   addresses, delivery->arg);
+		cache_entry_decref(entry);
+		free(delivery);
+	}
+}
+
+/* hands out the answers still waiting to be delivered at shutdown */
+static void
+cache_deliveries_flush(int fail_requests) {
+	struct cache_waiter *delivery = cache_deliveries, *next;
+
+	if (!delivery) return;
+	(void) event_del(&cache_delivery_event);
+	cache_deliveries = NULL;
+	cache_deliveries_tail = &cache_deliveries;
+	for (; delivery; delivery = next) {
+		next = delivery->next;
+		if (fail_requests)
+			delivery->callback(DNS_ERR_SHUTDOWN, 0, 0, 0, NULL,
+							   delivery->arg);
+		cache_entry_decref(delivery->entry);
+		free(delivery);
+	}
+}
+
+/* Looks a name up in the cache on behalf of evdns_resolve_*. */
+/* returns: */
+/*   0 the callback will be made with a cached answer or the answer */
+/*     of a query in flight */
+/*   1 a query must be sent; if *entryp is set then it must be sent */
+/*     with cache_reply_callback and *entryp as its callback */
+/*  -1 out of memory */
+static int
+cache_lookup(int type, const char *name, int flags,
+			 evdns_callback_type callback, void *ptr,
+			 struct cache_entry **entryp) {
+	struct cache_entry *entry;
+	struct cache_waiter *waiter;
+	u32 hash;
+
+	*entryp = NULL;
+	if (!global_cache_size) return 1;
+
+	hash = cache_hash(type, flags, name);
+	entry = cache_find(type, flags, name, hash);
+	if (entry && !entry->pending && entry->expires <= cache_now()) {
+		cache_remove(entry);
+		entry = NULL;
+	}
+
+	waiter = (struct cache_waiter *) malloc(sizeof(struct cache_waiter));
+	if (!waiter) return -1;
+	waiter->next = NULL;
+	waiter->entry = NULL;
+	waiter->callback = callback;
+	waiter->arg = ptr;
+
+	if (entry && !entry->pending) {
+		log(EVDNS_LOG_DEBUG, "Answering %s from the cache", name);
+		cache_stats.hits++;
+		if (entry != cache_lru_head) {
+			cache_lru_unlink(entry);
+			cache_lru_push(entry);
+		}
+		waiter->entry = entry;
+		entry->refcount++;
+		if (!cache_deliveries) {
+			struct timeval tv = { 0, 0 };
+			evtimer_set(&cache_delivery_event, cache_deliver, NULL);
+			evtimer_add(&cache_delivery_event, &tv);
+		}
+		*cache_deliveries_tail = waiter;
+		cache_deliveries_tail = &waiter->next;
+		return 0;
+	} else if (entry) {
+		struct cache_waiter **p = &entry->waiters;
+		log(EVDNS_LOG_DEBUG, "Joining the query in flight for %s", name);
+		cache_stats.coalesced++;
+		while (*p) p = &(*p)->next;
+		*p = waiter;
+		return 0;
+	}
+
+	cache_stats.misses++;
+	if (!(entry = cache_insert(type, flags, name, hash))) {
+		free(waiter);
+		return -1;
+	}
+	entry->waiters = waiter;
+	*entryp = entry;
+	return 1;
+}
+
 /* exported function */
-int evdns_resolve_ipv4(const char *name, int flags,
-    evdns_callback_type callback, void *ptr) {
-	log(EVDNS_LOG_DEBUG, "Resolve requested for %s", name);
-	if (flags & DNS_QUERY_NO_SEARCH) {
+void
+evdns_cache_clear(void) {
+	while (cache_lru_head)
+		cache_remove(cache_lru_head);
+}
+
+/* exported function */
+void
+evdns_cache_get_stats(struct evdns_cache_stats *stats) {
+	*stats = cache_stats;
+}
+
+/* frees the whole cache, including entries with queries in flight. */
+/* the lookups still waiting on those queries are failed whether or */
+/* not fail_requests is set, since they have no request of their own */
+/* to be discarded with; they are called back once the cache is gone */
+static void
+cache_free(int fail_requests) {
+	struct cache_waiter *waiters = NULL, **tail = &waiters, *next;
+	u32 i;
+	cache_deliveries_flush(fail_requests);
+	for (i = 0; i < cache_table_size; ++i) {
+		while (cache_table[i]) {
+			struct cache_entry *const entry = cache_table[i];
+			*tail = entry->waiters;
+			while (*tail) tail = &(*tail)->next;
+			entry->waiters = NULL;
+			cache_remove(entry);
+		}
+	}
+	free(cache_table);
+	cache_table = NULL;
+	cache_table_size = cache_table_count = 0;
+
+	for (; waiters; waiters = next) {
+		next = waiters->next;
+		waiters->callback(DNS_ERR_SHUTDOWN, 0, 0, 0, NULL, waiters->arg);
+		free(waiters);
+	}
+}
+
+static int
+request_start(int type, const char *name, int flags,
+			  evdns_callback_type callback, void *ptr) {
+	if (type == TYPE_PTR || (flags & DNS_QUERY_NO_SEARCH)) {
 		struct request *const req =
-			request_new(TYPE_A, name, flags, callback, ptr);
+			request_new(type, name, flags, callback, ptr);
 		if (req == NULL)
 			return (1);
 		request_submit(req);
 		return (0);
 	} else {
-		return (search_request_new(TYPE_A, name, flags, callback, ptr));
+		return (search_request_new(type, name, flags, callback, ptr));
+	}
+}
+
+/* starts a lookup for one of the evdns_resolve_* functions */
+static int
+resolve(int type, const char *name, int flags,
+		evdns_callback_type callback, void *ptr) {
+	struct cache_entry *entry;
+	int r;
+
+	flags &= DNS_QUERY_NO_SEARCH;
+	if (type == TYPE_PTR) flags = 0;
+
+	switch (cache_lookup(type, name, flags, callback, ptr, &entry)) {
+	case 0:
+		return (0);
+	case -1:
+		return (1);
 	}
+	if (!entry)
+		return (request_start(type, name, flags, callback, ptr));
+
+	r = request_start(type, name, flags, cache_reply_callback, entry);
+	if (r) cache_remove(entry);
+	return (r);
+}
+
+/* exported function */
+int evdns_resolve_ipv4(const char *name, int flags,
+    evdns_callback_type callback, void *ptr) {
+	log(EVDNS_LOG_DEBUG, "Resolve requested for %s", name);
+	return (resolve(TYPE_A, name, flags, callback, ptr));
 }
 
 /* exported function */
 int evdns_resolve_ipv6(const char *name, int flags,
 					   evdns_callback_type callback, void *ptr) {
 	log(EVDNS_LOG_DEBUG, "Resolve requested for %s", name);
-	if (flags & DNS_QUERY_NO_SEARCH) {
-		struct request *const req =
-			request_new(TYPE_AAAA, name, flags, callback, ptr);
-		if (req == NULL)
-			return (1);
-		request_submit(req);
-		return (0);
-	} else {
-		return (search_request_new(TYPE_AAAA, name, flags, callback, ptr));
-	}
+	return (resolve(TYPE_AAAA, name, flags, callback, ptr));
 }
 
 int evdns_resolve_reverse(const struct in_addr *in, int flags, evdns_callback_type callback, void *ptr) {
 	char buf[32];
-	struct request *req;
 	u32 a;
 	assert(in);
 	a = ntohl(in->s_addr);
@@ -2333,17 +2799,13 @@ int evdns_resolve_reverse(const struct in_addr *in, int flags, evdns_callback_ty
 			(int)(u8)((a>>16)&0xff),
 			(int)(u8)((a>>24)&0xff));
 	log(EVDNS_LOG_DEBUG, "Resolve requested for %s (reverse)", buf);
-	req = request_new(TYPE_PTR, buf, flags, callback, ptr);
-	if (!req) return 1;
-	request_submit(req);
-	return 0;
+	return (resolve(TYPE_PTR, buf, flags, callback, ptr));
 }
 
 int evdns_resolve_reverse_ipv6(const struct in6_addr *in, int flags, evdns_callback_type callback, void *ptr) {
 	/* 32 nybbles, 32 periods, "ip6.arpa", NUL. */
 	char buf[73];
 	char *cp;
-	struct request *req;
 	int i;
 	assert(in);
 	cp = buf;
@@ -2357,10 +2819,7 @@ int evdns_resolve_reverse_ipv6(const struct in6_addr *in, int flags, evdns_callb
 	assert(cp + strlen("ip6.arpa") < buf+sizeof(buf));
 	memcpy(cp, "ip6.arpa", strlen("ip6.arpa")+1);
 	log(EVDNS_LOG_DEBUG, "Resolve requested for %s (reverse)", buf);
-	req = request_new(TYPE_PTR, buf, flags, callback, ptr);
-	if (!req) return 1;
-	request_submit(req);
-	return 0;
+	return (resolve(TYPE_PTR, buf, flags, callback, ptr));
 }
 
 /*/////////////////////////////////////////////////////////////////// */
@@ -2418,6 +2877,8 @@ search_state_new(void) {
 
 static void
 search_postfix_clear(void) {
+	/* names which were searched for may now mean something else */
+	evdns_cache_clear();
 	search_state_decref(global_search_state);
 
 	global_search_state = search_state_new();
@@ -2435,6 +2896,7 @@ search_postfix_add(const char *domain) {
 	struct search_domain *sdomain;
 	while (domain[0] == '.') domain++;
 	domain_len = strlen(domain);
+	evdns_cache_clear();
 
 	if (!global_search_state) global_search_state = search_state_new();
         if (!global_search_state) return;
@@ -2477,6 +2939,7 @@ evdns_search_ndots_set(const int ndots) {
 	if (!global_search_state) global_search_state = search_state_new();
         if (!global_search_state) return;
 	global_search_state->ndots = ndots;
+	evdns_cache_clear();
 }
 
 static void
@@ -2662,6 +3125,7 @@ evdns_set_option(const char *option, const char *val, int flags)
 		if (!global_search_state) global_search_state = search_state_new();
 		if (!global_search_state) return -1;
 		global_search_state->ndots = ndots;
+		evdns_cache_clear();
 	} else if (!strncmp(option, "timeout:", 8)) {
 		const int timeout = strtoint(val);
 		if (timeout == -1) return -1;
@@ -2689,6 +3153,17 @@ evdns_set_option(const char *option, const char *val, int flags)
 		if (!(flags & DNS_OPTION_MISC)) return 0;
 		log(EVDNS_LOG_DEBUG, "Setting retries to %d", retries);
 		global_max_retransmits = retries;
+	} else if (!strncmp(option, "cache-size:", 11)) {
+		const int cachesize = strtoint_clipped(val, 0, INT_MAX);
+		if (cachesize == -1) return -1;
+		if (!(flags & DNS_OPTION_MISC)) return 0;
+		log(EVDNS_LOG_DEBUG, "Setting the cache size to %d bytes",
+			cachesize);
+		global_cache_size = cachesize;
+		if (!global_cache_size)
+			evdns_cache_clear();
+		else
+			cache_evict();
 	}
 	return 0;
 }
@@ -3050,6 +3525,9 @@ evdns_shutdown(int fail_requests)
 	}
 	global_requests_inflight = global_requests_waiting = 0;
 
+	cache_free(fail_requests);
+	memset(&cache_stats, 0, sizeof(cache_stats));
+
 	for (server = server_head; server; server = server_next) {
 		server_next = server->next;
 		if (server->socket >= 0)
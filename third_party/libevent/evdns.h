@@ -155,6 +155,17 @@
  * (a lookup for google.com) and, if it replies, we consider it working
  * again. If the nameserver fails a probe we wait longer to try again
  * with the next probe.
+ *
+ * Caching:
+ *
+ * Answers are cached by query type and the name passed to evdns_resolve
+ * for as long as their ttl says. Negative answers are cached too when the
+ * nameserver includes an SOA record saying for how long they hold. A
+ * lookup of a name which is already being resolved does not send another
+ * query; it gets the answer of the one in flight. Answers from the cache
+ * are passed to the callback from the event loop, never from within
+ * evdns_resolve. The cache is off by default; the cache-size option turns
+ * it on and bounds it, and it drops the least recently used names first.
  */
 
 #ifndef EVENTDNS_H
@@ -205,7 +216,9 @@ extern "C" {
  * The callback that contains the results from a lookup.
  * - type is either DNS_IPv4_A or DNS_PTR or DNS_IPv6_AAAA
  * - count contains the number of addresses of form type
- * - ttl is the number of seconds the resolution may be cached for.
+ * - ttl is the number of seconds the resolution may be cached for.  For
+ *   DNS_ERR_NOTEXIST it is the number of seconds for which the name is
+ *   known not to exist, or 0 if the nameserver did not say.
  * - addresses needs to be cast according to type
  */
 typedef void (*evdns_callback_type) (int result, char type, int count, int ttl, void *addresses, void *arg);
@@ -228,7 +241,9 @@ int evdns_init(void);
 
   If the 'fail_requests' option is enabled, all active requests will return
   an empty result with the error flag set to DNS_ERR_SHUTDOWN. Otherwise,
-  the requests will be silently discarded.
+  the requests will be silently discarded, except for lookups waiting on a
+  query in flight through the answer cache, which always return
+  DNS_ERR_SHUTDOWN.
 
   @param fail_requests if zero, active requests will be aborted; if non-zero,
 		active requests will return DNS_ERR_SHUTDOWN.
@@ -367,7 +382,10 @@ int evdns_resolve_reverse_ipv6(const struct in6_addr *in, int flags, evdns_callb
 
   The currently available configuration options are:
 
-    ndots, timeout, max-timeouts, max-inflight, and attempts
+    ndots, timeout, max-timeouts, max-inflight, attempts, and cache-size
+
+  cache-size is the number of bytes the answer cache may use; 0, the
+  default, disables the cache.
 
   @param option the name of the configuration option to be modified
   @param val the value to be set
@@ -377,6 +395,38 @@ int evdns_resolve_reverse_ipv6(const struct in6_addr *in, int flags, evdns_callb
 int evdns_set_option(const char *option, const char *val, int flags);
 
 
+/** Counters of the answer cache. */
+struct evdns_cache_stats {
+	unsigned long hits;		/**< lookups answered from the cache */
+	unsigned long misses;		/**< lookups which sent a query */
+	unsigned long coalesced;	/**< lookups which shared a query */
+	unsigned long evictions;	/**< names dropped to stay in budget */
+	unsigned long entries;		/**< names with a cached answer */
+	unsigned long size;		/**< bytes used by those names */
+};
+
+
+/**
+  Get the counters of the answer cache.
+
+  The counters start from zero at evdns_shutdown().
+
+  @param stats the structure to fill in
+  @see evdns_cache_clear()
+ */
+void evdns_cache_get_stats(struct evdns_cache_stats *stats);
+
+
+/**
+  Drop all cached answers.
+
+  Lookups which are in flight are not affected.
+
+  @see evdns_cache_get_stats()
+ */
+void evdns_cache_clear(void);
+
+
 /**
   Parse a resolv.conf file.
 
@@ -33,6 +33,7 @@ extern "C" {
 
 #include "config.h"
 #include "min_heap.h"
+#include "timer_wheel.h"
 #include "evsignal.h"
 
 struct eventop {
@@ -66,6 +67,8 @@ struct event_base {
 	struct timeval event_tv;
 
 	struct min_heap timeheap;
+	/* if set, holds the timeouts instead of timeheap */
+	struct timer_wheel *timewheel;
 
 	struct timeval tv_cache;
 };
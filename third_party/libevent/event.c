@@ -217,6 +217,14 @@ event_base_free(struct event_base *base)
 		event_del(ev);
 		++n_deleted;
 	}
+	if (base->timewheel != NULL) {
+		for (i = 0; i < TIMER_WHEEL_SLOTS; ++i) {
+			while ((ev = timer_wheel_first(base->timewheel, i))) {
+				event_del(ev);
+				++n_deleted;
+			}
+		}
+	}
 
 	for (i = 0; i < base->nactivequeues; ++i) {
 		for (ev = TAILQ_FIRST(base->activequeues[i]); ev; ) {
@@ -241,6 +249,7 @@ event_base_free(struct event_base *base)
 
 	assert(min_heap_empty(&base->timeheap));
 	min_heap_dtor(&base->timeheap);
+	timer_wheel_free(base->timewheel);
 
 	for (i = 0; i < base->nactivequeues; ++i)
 		free(base->activequeues[i]);
@@ -329,6 +338,55 @@ event_base_priority_init(struct event_base *base, int npriorities)
 	return (0);
 }
 
+int
+event_base_set_timer_wheel(struct event_base *base, const struct timeval *tick)
+{
+	struct timer_wheel *wheel = NULL, *old = base->timewheel;
+	struct timeval now;
+	struct event *ev;
+	int i;
+
+	if (tick != NULL) {
+		if (tick->tv_sec < 0 || tick->tv_usec < 0 ||
+		    tick->tv_usec >= 1000000 || !evutil_timerisset(tick))
+			return (-1);
+		gettime(base, &now);
+		if ((wheel = timer_wheel_new(tick, &now)) == NULL)
+			return (-1);
+		if (timer_wheel_reserve(wheel, old != NULL ?
+			timer_wheel_size(old) :
+			min_heap_size(&base->timeheap)) == -1) {
+			timer_wheel_free(wheel);
+			return (-1);	/* ENOMEM == errno */
+		}
+	} else if (old == NULL) {
+		return (0);
+	} else if (min_heap_reserve(&base->timeheap,
+		timer_wheel_size(old)) == -1) {
+		return (-1);	/* ENOMEM == errno */
+	}
+
+	/* Move the pending timeouts over */
+	if (old == NULL) {
+		while ((ev = min_heap_pop(&base->timeheap)) != NULL)
+			timer_wheel_insert(wheel, ev);
+	} else {
+		for (i = 0; i < TIMER_WHEEL_SLOTS; ++i) {
+			while ((ev = timer_wheel_first(old, i)) != NULL) {
+				timer_wheel_erase(old, ev);
+				if (wheel != NULL)
+					timer_wheel_insert(wheel, ev);
+				else
+					min_heap_push(&base->timeheap, ev);
+			}
+		}
+		timer_wheel_free(old);
+	}
+	base->timewheel = wheel;
+
+	return (0);
+}
+
 int
 event_haveevents(struct event_base *base)
 {
@@ -492,6 +550,8 @@ event_base_loop(struct event_base *base, int flags)
 		/* If we have no events, we just exit */
 		if (!event_haveevents(base)) {
 			event_debug(("%s: no events registered.", __func__));
+			/* do not leave a stale time for event_add() */
+			base->tv_cache.tv_sec = 0;
 			return (1);
 		}
 
@@ -707,7 +767,11 @@ event_add(struct event *ev, const struct timeval *tv)
 	 * failure on any step, we should not change any state.
 	 */
 	if (tv != NULL && !(ev->ev_flags & EVLIST_TIMEOUT)) {
-		if (min_heap_reserve(&base->timeheap,
+		if (base->timewheel != NULL) {
+			if (timer_wheel_reserve(base->timewheel,
+				1 + timer_wheel_size(base->timewheel)) == -1)
+				return (-1);  /* ENOMEM == errno */
+		} else if (min_heap_reserve(&base->timeheap,
 			1 + min_heap_size(&base->timeheap)) == -1)
 			return (-1);  /* ENOMEM == errno */
 	}
@@ -816,11 +880,18 @@ event_active(struct event *ev, int res, short ncalls)
 static int
 timeout_next(struct event_base *base, struct timeval **tv_p)
 {
-	struct timeval now;
+	struct timeval now, next;
+	struct timeval *when = NULL;
 	struct event *ev;
 	struct timeval *tv = *tv_p;
 
-	if ((ev = min_heap_top(&base->timeheap)) == NULL) {
+	if (base->timewheel != NULL) {
+		if (timer_wheel_next(base->timewheel, &next) != -1)
+			when = &next;
+	} else if ((ev = min_heap_top(&base->timeheap)) != NULL)
+		when = &ev->ev_timeout;
+
+	if (when == NULL) {
 		/* if no time-based events are active wait for I/O */
 		*tv_p = NULL;
 		return (0);
@@ -829,12 +900,12 @@ timeout_next(struct event_base *base, struct timeval **tv_p)
 	if (gettime(base, &now) == -1)
 		return (-1);
 
-	if (evutil_timercmp(&ev->ev_timeout, &now, <=)) {
+	if (evutil_timercmp(when, &now, <=)) {
 		evutil_timerclear(tv);
 		return (0);
 	}
 
-	evutil_timersub(&ev->ev_timeout, &now, tv);
+	evutil_timersub(when, &now, tv);
 
 	assert(tv->tv_sec >= 0);
 	assert(tv->tv_usec >= 0);
@@ -872,8 +943,11 @@ timeout_correct(struct event_base *base, struct timeval *tv)
 
 	/*
 	 * We can modify the key element of the node without destroying
-	 * the key, beause we apply it to all in the right order.
+	 * the key, beause we apply it to all in the right order.  The
+	 * timer wheel moves its origin along with the timeouts.
 	 */
+	if (base->timewheel != NULL)
+		timer_wheel_shift(base->timewheel, &off);
 	pev = base->timeheap.p;
 	size = base->timeheap.n;
 	for (; size-- > 0; ++pev) {
@@ -890,6 +964,22 @@ timeout_process(struct event_base *base)
 	struct timeval now;
 	struct event *ev;
 
+	if (base->timewheel != NULL) {
+		if (timer_wheel_empty(base->timewheel))
+			return;
+
+		gettime(base, &now);
+
+		while ((ev = timer_wheel_expired(base->timewheel, &now))) {
+			event_del(ev);
+
+			event_debug(("timeout_process: call %p",
+				 ev->ev_callback));
+			event_active(ev, EV_TIMEOUT, 1);
+		}
+		return;
+	}
+
 	if (min_heap_empty(&base->timeheap))
 		return;
 
@@ -929,7 +1019,10 @@ event_queue_remove(struct event_base *base, struct event *ev, int queue)
 		    ev, ev_active_next);
 		break;
 	case EVLIST_TIMEOUT:
-		min_heap_erase(&base->timeheap, ev);
+		if (base->timewheel != NULL)
+			timer_wheel_erase(base->timewheel, ev);
+		else
+			min_heap_erase(&base->timeheap, ev);
 		break;
 	default:
 		event_errx(1, "%s: unknown queue %x", __func__, queue);
@@ -962,7 +1055,10 @@ event_queue_insert(struct event_base *base, struct event *ev, int queue)
 		    ev,ev_active_next);
 		break;
 	case EVLIST_TIMEOUT: {
-		min_heap_push(&base->timeheap, ev);
+		if (base->timewheel != NULL)
+			timer_wheel_insert(base->timewheel, ev);
+		else
+			min_heap_push(&base->timeheap, ev);
 		break;
 	}
 	default:
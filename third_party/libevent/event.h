@@ -710,6 +710,27 @@ int	event_priority_init(int);
 int	event_base_priority_init(struct event_base *, int);
 
 
+/**
+  Keep the timeouts of an event base in a hierarchical timer wheel.
+
+  By default libevent keeps timeouts in a binary heap, which costs
+  O(log n) for every event_add() and event_del() of an event with a
+  timeout.  A timer wheel makes adding, rescheduling and deleting a
+  timeout O(1), which pays off with many events whose timeouts are
+  rescheduled over and over, such as the idle timeouts of keep-alive
+  connections.  In exchange, timeouts are rounded up to a multiple of the
+  tick of the wheel, so they may expire up to one tick late.
+
+  Timeouts already added are moved to the new structure.
+
+  @param eb the event_base structure returned by event_init()
+  @param tick the resolution of the timer wheel, with tv_usec below
+     1000000, or NULL to go back to the binary heap
+  @return 0 if successful, or -1 if an error occurred
+ */
+int	event_base_set_timer_wheel(struct event_base *, const struct timeval *);
+
+
 /**
   Assign a priority to an event.
 
@@ -987,7 +1008,8 @@ void evbuffer_free(struct evbuffer *);
 /**
   Expands the available space in an event buffer.
 
-  Expands the available space in the event buffer to at least datlen
+  Makes room for at least datlen contiguous bytes at the end of the
+  event buffer.
 
   @param buf the event buffer to be expanded
   @param datlen the new minimum length requirement
@@ -1043,6 +1065,56 @@ char *evbuffer_readline(struct evbuffer *);
 int evbuffer_add_buffer(struct evbuffer *, struct evbuffer *);
 
 
+/**
+  Move the first bytes of one evbuffer into another evbuffer.
+
+  Whole segments are moved without copying their data.  Unless dst was
+  empty, its data is then no longer contiguous; use evbuffer_pullup()
+  rather than EVBUFFER_DATA() to read it.
+
+  @param src the evbuffer to be drained
+  @param dst the evbuffer to be appended to
+  @param datlen the maximum number of bytes to move
+  @return the number of bytes moved, or -1 if an error occurred
+ */
+int evbuffer_remove_buffer(struct evbuffer *, struct evbuffer *, size_t);
+
+
+/**
+  Append a reference to memory to the end of an evbuffer.
+
+  The data is not copied.  It must not change until cleanupfn, if not
+  NULL, is called with data, datlen and arg once no evbuffer refers to
+  it anymore.  EVBUFFER_DATA() then only covers the first segment of the
+  buffer; use evbuffer_pullup() to read it.
+
+  @param buf the evbuffer to be appended to
+  @param data pointer to the beginning of the data
+  @param datlen the number of bytes of data
+  @param cleanupfn the function to call when the data is no longer needed
+  @param arg the argument for cleanupfn
+  @return 0 if successful, or -1 if an error occurred
+ */
+int evbuffer_add_reference(struct evbuffer *, const void *, size_t,
+    void (*)(const void *, size_t, void *), void *);
+
+
+/**
+  Make the first bytes of an evbuffer contiguous.
+
+  An evbuffer that evbuffer_add_reference() or evbuffer_remove_buffer()
+  added to is a chain of segments; this copies the first size bytes into
+  a single segment, unless they already are in one.  Other evbuffers are
+  always contiguous, and EVBUFFER_DATA() gives the same pointer.
+
+  @param buf the evbuffer to be made contiguous
+  @param size the number of bytes, or more than EVBUFFER_LENGTH() for all
+  @return a pointer to the first byte, or NULL if the buffer is empty or an
+          error occurred
+ */
+u_char *evbuffer_pullup(struct evbuffer *, size_t);
+
+
 /**
   Append a formatted string to the end of an evbuffer.
 
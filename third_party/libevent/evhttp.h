@@ -134,6 +134,69 @@ void evhttp_set_gencb(struct evhttp *,
  */
 void evhttp_set_timeout(struct evhttp *, int timeout_in_secs);
 
+/* Multi-reactor HTTP servers */
+
+struct evhttp_pool;
+
+/**
+ * Create a pool of HTTP servers, one for each event base.
+ *
+ * Each event base is meant to be dispatched by a thread of its own.  A
+ * connection is served entirely on the base that it was handed to, so
+ * request callbacks run on that base's thread and the servers share no
+ * state that needs locking.  Callbacks and timeouts are set for each
+ * server with evhttp_pool_get() or for all of them with the
+ * evhttp_pool_set_*() functions, before the bases are dispatched.
+ *
+ * @param bases the event bases to receive the HTTP events
+ * @param nbases the number of event bases
+ * @return a pointer to a newly initialized evhttp_pool, or NULL on error
+ * @see evhttp_pool_free()
+ */
+struct evhttp_pool *evhttp_pool_new(struct event_base **bases, int nbases);
+
+/**
+ * Binds a pool of HTTP servers on the specified address and port.
+ *
+ * Where SO_REUSEPORT is available, every server listens on a socket of
+ * its own and the kernel distributes the connections.  Otherwise the
+ * first server accepts all connections and hands them to the servers
+ * round robin.  Must be called before the event bases are dispatched.
+ *
+ * @param pool a pointer to an evhttp_pool object
+ * @param address a string containing the IP address to listen(2) on
+ * @param port the port number to listen on
+ * @return 0 on success, -1 on failure.
+ */
+int evhttp_pool_bind_socket(struct evhttp_pool *pool, const char *address,
+    u_short port);
+
+/** Returns the number of servers in the pool */
+int evhttp_pool_size(struct evhttp_pool *pool);
+
+/** Returns the server for the i-th event base, or NULL */
+struct evhttp *evhttp_pool_get(struct evhttp_pool *pool, int i);
+
+/** Set a callback for a specified URI on all servers of the pool */
+void evhttp_pool_set_cb(struct evhttp_pool *, const char *,
+    void (*)(struct evhttp_request *, void *), void *);
+
+/** Set a callback for all uncaught requests on all servers of the pool */
+void evhttp_pool_set_gencb(struct evhttp_pool *,
+    void (*)(struct evhttp_request *, void *), void *);
+
+/** Set the timeout for HTTP requests on all servers of the pool */
+void evhttp_pool_set_timeout(struct evhttp_pool *, int timeout_in_secs);
+
+/**
+ * Free a pool of HTTP servers and the servers in it.
+ *
+ * All event bases of the pool must have stopped dispatching.
+ *
+ * @param pool the evhttp_pool object to be freed
+ */
+void evhttp_pool_free(struct evhttp_pool *pool);
+
 /* Request/Response functionality */
 
 /**
@@ -157,6 +220,25 @@ void evhttp_send_error(struct evhttp_request *req, int error,
 void evhttp_send_reply(struct evhttp_request *req, int code,
     const char *reason, struct evbuffer *databuf);
 
+/**
+ * Send the contents of a file as the HTTP reply.
+ *
+ * The file is sent with sendfile(2) where available, so it is neither
+ * copied through user space nor held in memory, and otherwise through the
+ * output buffer a chunk at a time.  It is sent as the connection becomes
+ * writable, under the connection timeout.  The request takes ownership
+ * of fd and closes it once the reply has been sent or has failed.
+ *
+ * @param req a request object
+ * @param code the HTTP response code to send
+ * @param reason a brief message to send with the response code
+ * @param fd a file descriptor of a regular file
+ * @param offset where in the file the reply starts
+ * @param length the length of the reply, sent as its Content-Length
+ */
+void evhttp_send_reply_file(struct evhttp_request *req, int code,
+    const char *reason, int fd, off_t offset, size_t length);
+
 /* Low-level response interface, for streaming/chunked replies */
 void evhttp_send_reply_start(struct evhttp_request *, int, const char *);
 void evhttp_send_reply_chunk(struct evhttp_request *, struct evbuffer *);
@@ -279,6 +361,13 @@ void evhttp_connection_set_timeout(struct evhttp_connection *evcon,
 void evhttp_connection_set_retries(struct evhttp_connection *evcon,
     int retry_max);
 
+/**
+ * Sets how many requests may be in flight on this connection at once.
+ * Only GET requests without a body are pipelined; the default is 1.
+ */
+void evhttp_connection_set_max_pipelined(struct evhttp_connection *evcon,
+    int max_pipelined);
+
 /** Set a callback for connection close. */
 void evhttp_connection_set_closecb(struct evhttp_connection *evcon,
     void (*)(struct evhttp_connection *, void *), void *);
@@ -299,9 +388,63 @@ int evhttp_make_request(struct evhttp_connection *evcon,
     struct evhttp_request *req,
     enum evhttp_cmd_type type, const char *uri);
 
+/**
+ * A pool of connections to one host.  Requests made through the pool go
+ * to an idle connection, or to a new one while there are fewer than
+ * max_connections; otherwise they are pipelined, if allowed, or wait for
+ * a connection to become idle.
+ */
+struct evhttp_connection_pool;
+
+/** Idle connections are reused most recently used first */
+#define EVHTTP_POOL_REUSE_LIFO	0
+/** Idle connections are reused least recently used first */
+#define EVHTTP_POOL_REUSE_FIFO	1
+
+/** Creates a pool; base may be NULL for the current event base */
+struct evhttp_connection_pool *evhttp_connection_pool_new(
+	struct event_base *base, const char *address, unsigned short port,
+	int max_connections);
+
+/** Frees a pool, its connections and the requests still waiting */
+void evhttp_connection_pool_free(struct evhttp_connection_pool *pool);
+
+/** Sets the pipeline depth of the connections of the pool */
+void evhttp_connection_pool_set_max_pipelined(
+	struct evhttp_connection_pool *pool, int max_pipelined);
+
+/** Closes connections that were idle for longer; 0 keeps them open */
+void evhttp_connection_pool_set_idle_timeout(
+	struct evhttp_connection_pool *pool, int timeout_in_secs);
+
+/** Sets the timeout for events related to the connections of the pool */
+void evhttp_connection_pool_set_timeout(
+	struct evhttp_connection_pool *pool, int timeout_in_secs);
+
+/** Sets the order in which idle connections are reused */
+void evhttp_connection_pool_set_reuse(
+	struct evhttp_connection_pool *pool, int reuse);
+
+/** The pool gets ownership of the request */
+int evhttp_connection_pool_make_request(struct evhttp_connection_pool *pool,
+    struct evhttp_request *req,
+    enum evhttp_cmd_type type, const char *uri);
+
 const char *evhttp_request_uri(struct evhttp_request *req);
 
-/* Interfaces for dealing with HTTP headers */
+/**
+ * Finds an input header of a request like evhttp_find_header() on
+ * req->input_headers does, but in constant time for Host, Connection,
+ * Content-Length, Content-Type, Proxy-Connection and Transfer-Encoding.
+ */
+const char *evhttp_request_find_input_header(struct evhttp_request *req,
+    const char *key);
+
+/*
+ * Interfaces for dealing with HTTP headers.  evhttp_remove_header() and
+ * evhttp_clear_headers() free the entries that evhttp_add_header() and the
+ * parser create; other entries must not be put on a queue they are used on.
+ */
 
 const char *evhttp_find_header(const struct evkeyvalq *, const char *);
 int evhttp_remove_header(struct evkeyvalq *, const char *);
@@ -10,6 +10,8 @@
 #ifndef _HTTP_H_
 #define _HTTP_H_
 
+#include "evhttp.h"
+
 #define HTTP_CONNECT_TIMEOUT	45
 #define HTTP_WRITE_TIMEOUT	50
 #define HTTP_READ_TIMEOUT	50
@@ -59,6 +61,10 @@ struct evhttp_connection {
 	struct event close_ev;
 	struct evbuffer *input_buffer;
 	struct evbuffer *output_buffer;
+
+	int file_fd;			/* file sent after output_buffer */
+	off_t file_offset;		/* where the rest of the file starts */
+	size_t file_left;		/* bytes of the file still to send */
 	
 	char *bind_address;		/* address to use for binding the src */
 	u_short bind_port;		/* local port for binding the src */
@@ -70,10 +76,15 @@ struct evhttp_connection {
 #define EVHTTP_CON_INCOMING	0x0001	/* only one request on it ever */
 #define EVHTTP_CON_OUTGOING	0x0002  /* multiple requests possible */
 #define EVHTTP_CON_CLOSEDETECT  0x0004  /* detecting if persistent close */
+#define EVHTTP_CON_GOTEOF	0x0008	/* the peer closed the connection */
 
 	int timeout;			/* timeout in seconds for events */
 	int retry_cnt;			/* retry count */
 	int retry_max;			/* maximum number of retries */
+
+	int max_pipelined;		/* requests written ahead of replies */
+	int inflight;			/* requests written and not answered */
+	int idle_timeout;		/* seconds to keep an idle connection */
 	
 	enum evhttp_connection_state state;
 
@@ -89,6 +100,29 @@ struct evhttp_connection {
 	void *closecb_arg;
 
 	struct event_base *base;
+
+	/* for pooled connections, the pool they belong to */
+	struct evhttp_connection_pool *pool;
+};
+
+/*
+ * One evhttp of an evhttp_pool.  Without SO_REUSEPORT, the connections
+ * accepted on the first worker are handed over to the others through
+ * their socket pair: the acceptor writes to handoff[0] and the worker
+ * reads from handoff[1] on its own event base.
+ */
+struct evhttp_pool_worker {
+	struct evhttp *http;
+
+	int handoff[2];
+	struct event handoff_ev;
+};
+
+struct evhttp_pool {
+	struct evhttp_pool_worker *workers;
+	int nworkers;
+
+	int next;	/* worker for the next handed over connection */
 };
 
 struct evhttp_cb {
@@ -103,6 +137,97 @@ struct evhttp_cb {
 /* both the http server as well as the rpc system need to queue connections */
 TAILQ_HEAD(evconq, evhttp_connection);
 
+/*
+ * Outgoing connections to one host.  connections holds the most recently
+ * idle connection first.  Requests for which no connection has room wait
+ * in requests until one has.
+ */
+struct evhttp_connection_pool {
+	struct evconq connections;
+	int nconnections;
+	int max_connections;
+
+	int max_pipelined;
+	int idle_timeout;
+	int timeout;
+	int reuse;			/* EVHTTP_POOL_REUSE_* */
+
+	struct evcon_requestq requests;
+
+	char *address;
+	u_short port;
+	struct event_base *base;
+};
+
+/* the headers that are looked up in constant time */
+enum evhttp_header_index {
+	EVHTTP_HDR_CONNECTION,
+	EVHTTP_HDR_CONTENT_LENGTH,
+	EVHTTP_HDR_CONTENT_TYPE,
+	EVHTTP_HDR_HOST,
+	EVHTTP_HDR_PROXY_CONNECTION,
+	EVHTTP_HDR_TRANSFER_ENCODING,
+	EVHTTP_HDR_MAX
+};
+
+#define EVHTTP_ARENA_SIZE	2048
+
+struct evhttp_arena_block {
+	struct evhttp_arena_block *next;
+	/* the data follows */
+};
+
+/*
+ * The entries that evhttp puts into header queues.  A parsed header is
+ * allocated in the arena of its request and freed with it, so
+ * evhttp_remove_header() and evhttp_clear_headers() only unlink it and
+ * mark it removed.
+ */
+#define EVHTTP_HEADER_PARSED	0x01
+#define EVHTTP_HEADER_REMOVED	0x02
+
+struct evhttp_header {
+	struct evkeyval kv;		/* must be first */
+	int flags;
+};
+
+/*
+ * The first line and the headers of the message read into a request are
+ * copied into its arena, which is allocated when the first line arrives.
+ * The parsed entries of input_headers point into it.  common holds the
+ * first parsed header of each evhttp_header_index; it may be used as long
+ * as the last header of input_headers is the last one that was parsed.
+ */
+struct evhttp_header_arena {
+	struct evkeyval *common[EVHTTP_HDR_MAX];
+	struct evkeyval *last;		/* the last header parsed */
+	int indexed;			/* 0 if common may be stale */
+
+	size_t scanned;			/* bytes of a partial line searched */
+
+	char *next;			/* free space in the current block */
+	size_t avail;
+	struct evhttp_arena_block *blocks;	/* the ones after data */
+
+	union {
+		char data[EVHTTP_ARENA_SIZE];
+		void *align;
+	} first;
+};
+
+/*
+ * A request as evhttp_request_new() allocates it, with the state that is
+ * not part of the public struct.
+ */
+struct evhttp_request_private {
+	struct evhttp_request req;	/* must be first */
+
+	struct evhttp_header_arena *header_arena;
+};
+
+#define EVHTTP_REQUEST_ARENA(r) \
+	(((struct evhttp_request_private *)(r))->header_arena)
+
 /* each bound socket is stored in one of these */
 struct evhttp_bound_socket {
 	TAILQ_ENTRY(evhttp_bound_socket) (next);
@@ -136,6 +261,9 @@ void evhttp_connection_fail(struct evhttp_connection *,
 
 void evhttp_get_request(struct evhttp *, int, struct sockaddr *, socklen_t);
 
+/* binds the pool without SO_REUSEPORT, exposed for the regression tests */
+int evhttp_pool_bind_acceptor(struct evhttp_pool *, const char *, u_short);
+
 int evhttp_hostportfile(char *, char **, u_short *, char **);
 
 int evhttp_parse_firstline(struct evhttp_request *, struct evbuffer*);
@@ -54,6 +54,7 @@
 
 #ifndef WIN32
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <netdb.h>
 #endif
 
@@ -78,6 +79,12 @@
 #ifdef HAVE_FCNTL_H
 #include <fcntl.h>
 #endif
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <emmintrin.h>
+#endif
 
 #undef timeout_pending
 #undef timeout_initialized
@@ -194,6 +201,10 @@ fake_freeaddrinfo(struct addrinfo *ai)
 	if ((x)->base != NULL) event_base_set((x)->base, y);	\
 } while (0) 
 
+/* flags for bind_socket() */
+#define BIND_REUSEADDR	0x01	/* set SO_REUSEADDR */
+#define BIND_REUSEPORT	0x02	/* set SO_REUSEPORT, fail without it */
+
 extern int debug;
 
 static int socket_connect(int fd, const char *address, unsigned short port);
@@ -207,6 +218,11 @@ static void evhttp_connection_start_detectclose(
 static void evhttp_connection_stop_detectclose(
 	struct evhttp_connection *evcon);
 static void evhttp_request_dispatch(struct evhttp_connection* evcon);
+static void evhttp_connection_pool_refill(struct evhttp_connection *evcon);
+static void evhttp_set_nodelay(int fd);
+static const char *evhttp_request_header(struct evhttp_request *req,
+    struct evkeyvalq *headers, enum evhttp_header_index index,
+    const char *key);
 static void evhttp_read_firstline(struct evhttp_connection *evcon,
 				  struct evhttp_request *req);
 static void evhttp_read_header(struct evhttp_connection *evcon,
@@ -215,6 +231,8 @@ static int evhttp_add_header_internal(struct evkeyvalq *headers,
     const char *key, const char *value);
 static int evhttp_decode_uri_internal(const char *uri, size_t length,
     char *ret, int always_decode_plus);
+static int evhttp_write_file(struct evhttp_connection *evcon);
+static void evhttp_connection_close_file(struct evhttp_connection *evcon);
 
 void evhttp_read(int, short, void *);
 void evhttp_write(int, short, void *);
@@ -398,22 +416,27 @@ evhttp_make_header_request(struct evhttp_connection *evcon,
 }
 
 static int
-evhttp_is_connection_close(int flags, struct evkeyvalq* headers)
+evhttp_is_connection_close(struct evhttp_request *req,
+    struct evkeyvalq* headers)
 {
-	if (flags & EVHTTP_PROXY_REQUEST) {
+	if (req->flags & EVHTTP_PROXY_REQUEST) {
 		/* proxy connection */
-		const char *connection = evhttp_find_header(headers, "Proxy-Connection");
+		const char *connection = evhttp_request_header(req, headers,
+		    EVHTTP_HDR_PROXY_CONNECTION, "Proxy-Connection");
 		return (connection == NULL || strcasecmp(connection, "keep-alive") != 0);
 	} else {
-		const char *connection = evhttp_find_header(headers, "Connection");
+		const char *connection = evhttp_request_header(req, headers,
+		    EVHTTP_HDR_CONNECTION, "Connection");
 		return (connection != NULL && strcasecmp(connection, "close") == 0);
 	}
 }
 
 static int
-evhttp_is_connection_keepalive(struct evkeyvalq* headers)
+evhttp_is_connection_keepalive(struct evhttp_request *req,
+    struct evkeyvalq* headers)
 {
-	const char *connection = evhttp_find_header(headers, "Connection");
+	const char *connection = evhttp_request_header(req, headers,
+	    EVHTTP_HDR_CONNECTION, "Connection");
 	return (connection != NULL 
 	    && strncasecmp(connection, "keep-alive", 10) == 0);
 }
@@ -461,7 +484,7 @@ static void
 evhttp_make_header_response(struct evhttp_connection *evcon,
     struct evhttp_request *req)
 {
-	int is_keepalive = evhttp_is_connection_keepalive(req->input_headers);
+	int is_keepalive = evhttp_is_connection_keepalive(req, req->input_headers);
 	evbuffer_add_printf(evcon->output_buffer, "HTTP/%d.%d %d %s\r\n",
 	    req->major, req->minor, req->response_code,
 	    req->response_code_line);
@@ -500,7 +523,7 @@ evhttp_make_header_response(struct evhttp_connection *evcon,
 	}
 
 	/* if the request asked for a close, we send a close, too */
-	if (evhttp_is_connection_close(req->flags, req->input_headers)) {
+	if (evhttp_is_connection_close(req, req->input_headers)) {
 		evhttp_remove_header(req->output_headers, "Connection");
 		if (!(req->flags & EVHTTP_PROXY_REQUEST))
 		    evhttp_add_header(req->output_headers, "Connection", "close");
@@ -532,9 +555,11 @@ evhttp_make_header(struct evhttp_connection *evcon, struct evhttp_request *req)
 	if (EVBUFFER_LENGTH(req->output_buffer) > 0) {
 		/*
 		 * For a request, we add the POST data, for a reply, this
-		 * is the regular data.
+		 * is the regular data.  Its segments are moved rather than
+		 * copied behind the headers.
 		 */
-		evbuffer_add_buffer(evcon->output_buffer, req->output_buffer);
+		evbuffer_remove_buffer(req->output_buffer, evcon->output_buffer,
+		    EVBUFFER_LENGTH(req->output_buffer));
 	}
 }
 
@@ -661,6 +686,9 @@ evhttp_connection_fail(struct evhttp_connection *evcon,
 
 	/* reset the connection */
 	evhttp_connection_reset(evcon);
+
+	if (evcon->pool != NULL)
+		evhttp_connection_pool_refill(evcon);
 	
 	/* We are trying the next request that was queued on us */
 	if (TAILQ_FIRST(&evcon->requests) != NULL)
@@ -671,6 +699,52 @@ evhttp_connection_fail(struct evhttp_connection *evcon,
 		(*cb)(NULL, cb_arg);
 }
 
+/* Most file data read into memory at once where sendfile() is missing */
+#define EVHTTP_FILE_CHUNK	65536
+
+/*
+ * Sends the next part of the file of a evhttp_send_reply_file() reply,
+ * closing the file after the last part.  Returns the number of bytes
+ * sent, 0 if the file ended early, or -1 on error.
+ */
+static int
+evhttp_write_file(struct evhttp_connection *evcon)
+{
+	int n;
+
+#ifdef __linux__
+	n = sendfile(evcon->fd, evcon->file_fd, &evcon->file_offset,
+	    evcon->file_left);
+#else
+	/* Read a chunk into the output buffer for the next write */
+	size_t len = MIN(evcon->file_left, EVHTTP_FILE_CHUNK);
+
+	if (lseek(evcon->file_fd, evcon->file_offset, SEEK_SET) == -1)
+		return (-1);
+	n = evbuffer_read(evcon->output_buffer, evcon->file_fd, len);
+	if (n > 0)
+		evcon->file_offset += n;
+#endif
+	if (n <= 0)
+		return (n);
+
+	evcon->file_left -= n;
+	if (evcon->file_left == 0)
+		evhttp_connection_close_file(evcon);
+
+	return (n);
+}
+
+static void
+evhttp_connection_close_file(struct evhttp_connection *evcon)
+{
+	if (evcon->file_fd == -1)
+		return;
+	close(evcon->file_fd);
+	evcon->file_fd = -1;
+	evcon->file_left = 0;
+}
+
 void
 evhttp_write(int fd, short what, void *arg)
 {
@@ -682,20 +756,42 @@ evhttp_write(int fd, short what, void *arg)
 		return;
 	}
 
-	n = evbuffer_write(evcon->output_buffer, fd);
-	if (n == -1) {
-		event_debug(("%s: evbuffer_write", __func__));
-		evhttp_connection_fail(evcon, EVCON_HTTP_EOF);
-		return;
+	/* The headers and anything else buffered go before the file */
+	if (EVBUFFER_LENGTH(evcon->output_buffer) != 0 ||
+	    evcon->file_fd == -1) {
+		n = evbuffer_write(evcon->output_buffer, fd);
+		if (n == -1) {
+			event_debug(("%s: evbuffer_write", __func__));
+			evhttp_connection_fail(evcon, EVCON_HTTP_EOF);
+			return;
+		}
+
+		if (n == 0) {
+			event_debug(("%s: write nothing", __func__));
+			evhttp_connection_fail(evcon, EVCON_HTTP_EOF);
+			return;
+		}
 	}
 
-	if (n == 0) {
-		event_debug(("%s: write nothing", __func__));
-		evhttp_connection_fail(evcon, EVCON_HTTP_EOF);
-		return;
+	if (EVBUFFER_LENGTH(evcon->output_buffer) == 0 &&
+	    evcon->file_fd != -1) {
+		n = evhttp_write_file(evcon);
+		if (n == -1 && errno != EINTR && errno != EAGAIN) {
+			event_debug(("%s: evhttp_write_file", __func__));
+			evhttp_connection_fail(evcon, EVCON_HTTP_EOF);
+			return;
+		}
+
+		if (n == 0) {
+			/* the file is shorter than the length we promised */
+			event_debug(("%s: file ended early", __func__));
+			evhttp_connection_fail(evcon, EVCON_HTTP_EOF);
+			return;
+		}
 	}
 
-	if (EVBUFFER_LENGTH(evcon->output_buffer) != 0) {
+	if (EVBUFFER_LENGTH(evcon->output_buffer) != 0 ||
+	    evcon->file_fd != -1) {
 		evhttp_add_event(&evcon->ev, 
 		    evcon->timeout, HTTP_WRITE_TIMEOUT);
 		return;
@@ -724,24 +820,34 @@ evhttp_connection_done(struct evhttp_connection *evcon)
 	        int need_close;
 		TAILQ_REMOVE(&evcon->requests, req, next);
 		req->evcon = NULL;
+		if (evcon->inflight > 0)
+			evcon->inflight--;
 
 		evcon->state = EVCON_IDLE;
 
 		need_close = 
-		    evhttp_is_connection_close(req->flags, req->input_headers)||
-		    evhttp_is_connection_close(req->flags, req->output_headers);
+		    evhttp_is_connection_close(req, req->input_headers)||
+		    evhttp_is_connection_close(req, req->output_headers)||
+		    (evcon->flags & EVHTTP_CON_GOTEOF);
 
 		/* check if we got asked to close the connection */
 		if (need_close)
 			evhttp_connection_reset(evcon);
 
+		if (evcon->pool != NULL)
+			evhttp_connection_pool_refill(evcon);
+
 		if (TAILQ_FIRST(&evcon->requests) != NULL) {
 			/*
 			 * We have more requests; reset the connection
-			 * and deal with the next request.
+			 * and deal with the next request.  Requests that
+			 * were pipelined on a closed connection are sent
+			 * again on the new one.
 			 */
 			if (!evhttp_connected(evcon))
 				evhttp_connection_connect(evcon);
+			else if (evcon->inflight > 0)
+				evhttp_start_read(evcon);
 			else
 				evhttp_request_dispatch(evcon);
 		} else if (!need_close) {
@@ -885,10 +991,10 @@ evhttp_read_body(struct evhttp_connection *evcon, struct evhttp_request *req)
 		/* Read until connection close. */
 		evbuffer_add_buffer(req->input_buffer, buf);
 	} else if (EVBUFFER_LENGTH(buf) >= req->ntoread) {
-		/* Completed content length */
-		evbuffer_add(req->input_buffer, EVBUFFER_DATA(buf),
+		/* Completed content length; the input buffer is still empty,
+		 * so it stays contiguous for EVBUFFER_DATA() */
+		evbuffer_remove_buffer(buf, req->input_buffer,
 		    (size_t)req->ntoread);
-		evbuffer_drain(buf, (size_t)req->ntoread);
 		req->ntoread = 0;
 		evhttp_connection_done(evcon);
 		return;
@@ -926,15 +1032,21 @@ evhttp_read(int fd, short what, void *arg)
 		if (errno != EINTR && errno != EAGAIN) {
 			event_debug(("%s: evbuffer_read", __func__));
 			evhttp_connection_fail(evcon, EVCON_HTTP_EOF);
-		} else {
+			return;
+		} else if (len == 0) {
 			evhttp_add_event(&evcon->ev, evcon->timeout,
 			    HTTP_READ_TIMEOUT);	       
+			return;
 		}
-		return;
+		/* a pipelined message was read along with the last one */
 	} else if (n == 0) {
-		/* Connection closed */
-		evhttp_connection_done(evcon);
-		return;
+		/* Connection closed; a pipelined message may still be buffered */
+		if (len == 0 || (evcon->flags & EVHTTP_CON_GOTEOF)) {
+			evcon->flags |= EVHTTP_CON_GOTEOF;
+			evhttp_connection_done(evcon);
+			return;
+		}
+		evcon->flags |= EVHTTP_CON_GOTEOF;
 	}
 
 	switch (evcon->state) {
@@ -1001,6 +1113,12 @@ evhttp_connection_free(struct evhttp_connection *evcon)
 		TAILQ_REMOVE(&http->connections, evcon, next);
 	}
 
+	if (evcon->pool != NULL) {
+		struct evhttp_connection_pool *pool = evcon->pool;
+		TAILQ_REMOVE(&pool->connections, evcon, next);
+		pool->nconnections--;
+	}
+
 	if (event_initialized(&evcon->close_ev))
 		event_del(&evcon->close_ev);
 
@@ -1010,6 +1128,8 @@ evhttp_connection_free(struct evhttp_connection *evcon)
 	if (evcon->fd != -1)
 		EVUTIL_CLOSESOCKET(evcon->fd);
 
+	evhttp_connection_close_file(evcon);
+
 	if (evcon->bind_address != NULL)
 		free(evcon->bind_address);
 
@@ -1044,6 +1164,54 @@ evhttp_connection_set_local_port(struct evhttp_connection *evcon,
 	evcon->bind_port = port;
 }
 
+/*
+ * Only GET requests without a body and without a wish to close the
+ * connection are pipelined: the others may not be safe to send again if
+ * the connection closes before they are answered.
+ */
+static int
+evhttp_request_can_pipeline(struct evhttp_request *req)
+{
+	return (req->type == EVHTTP_REQ_GET &&
+	    EVBUFFER_LENGTH(req->output_buffer) == 0 &&
+	    !evhttp_is_connection_close(req, req->output_headers));
+}
+
+/* Returns the first request on the connection that was not written yet */
+static struct evhttp_request *
+evhttp_connection_next_unsent(struct evhttp_connection *evcon)
+{
+	struct evhttp_request *req = TAILQ_FIRST(&evcon->requests);
+	int i;
+
+	for (i = 0; i < evcon->inflight && req != NULL; ++i)
+		req = TAILQ_NEXT(req, next);
+	return (req);
+}
+
+/* Checks if req may be written behind the requests in flight */
+static int
+evhttp_connection_can_pipeline(struct evhttp_connection *evcon,
+    struct evhttp_request *req)
+{
+	return (req != NULL && evcon->inflight < evcon->max_pipelined &&
+	    evhttp_request_can_pipeline(TAILQ_FIRST(&evcon->requests)) &&
+	    evhttp_request_can_pipeline(req));
+}
+
+/* Adds req to the output buffer; its reply is read next */
+static void
+evhttp_request_write(struct evhttp_connection *evcon,
+    struct evhttp_request *req)
+{
+	/* Create the header from the store arguments */
+	req->kind = EVHTTP_REQUEST;
+	evhttp_make_header(evcon, req);
+	req->kind = EVHTTP_RESPONSE;
+
+	evcon->inflight++;
+}
+
 static void
 evhttp_request_dispatch(struct evhttp_connection* evcon)
 {
@@ -1061,8 +1229,12 @@ evhttp_request_dispatch(struct evhttp_connection* evcon)
 
 	evcon->state = EVCON_WRITING;
 
-	/* Create the header from the store arguments */
-	evhttp_make_header(evcon, req);
+	/* write as many of the queued requests as may be pipelined */
+	evcon->inflight = 0;
+	do {
+		evhttp_request_write(evcon, req);
+		req = TAILQ_NEXT(req, next);
+	} while (evhttp_connection_can_pipeline(evcon, req));
 
 	evhttp_write_buffer(evcon, evhttp_write_connectioncb, NULL);
 }
@@ -1083,7 +1255,10 @@ evhttp_connection_reset(struct evhttp_connection *evcon)
 		evcon->fd = -1;
 	}
 	evcon->state = EVCON_DISCONNECTED;
+	evcon->flags &= ~EVHTTP_CON_GOTEOF;
+	evcon->inflight = 0;
 
+	evhttp_connection_close_file(evcon);
 	evbuffer_drain(evcon->input_buffer,
 	    EVBUFFER_LENGTH(evcon->input_buffer));
 	evbuffer_drain(evcon->output_buffer,
@@ -1107,7 +1282,8 @@ evhttp_connection_start_detectclose(struct evhttp_connection *evcon)
 	event_set(&evcon->close_ev, evcon->fd, EV_READ,
 	    evhttp_detect_close_cb, evcon);
 	EVHTTP_BASE_SET(evcon, &evcon->close_ev);
-	event_add(&evcon->close_ev, NULL);
+	/* an idle connection is closed after idle_timeout, if set */
+	evhttp_add_event(&evcon->close_ev, evcon->idle_timeout, 0);
 }
 
 static void
@@ -1191,6 +1367,13 @@ evhttp_connectioncb(int fd, short what, void *arg)
 		request->cb(request, request->cb_arg);
 		evhttp_request_free(request);
 	}
+
+	/* requests waiting in a pool get a connection attempt of their own */
+	if (evcon->pool != NULL) {
+		evhttp_connection_pool_refill(evcon);
+		if (TAILQ_FIRST(&evcon->requests) != NULL)
+			evhttp_connection_connect(evcon);
+	}
 }
 
 /*
@@ -1318,6 +1501,23 @@ evhttp_find_header(const struct evkeyvalq *headers, const char *key)
 	return (NULL);
 }
 
+/* Frees a header that was removed from its queue */
+static void
+evhttp_header_free(struct evkeyval *header)
+{
+	struct evhttp_header *entry = (struct evhttp_header *)header;
+
+	/* parsed headers are freed along with their request */
+	if (entry->flags & EVHTTP_HEADER_PARSED) {
+		entry->flags |= EVHTTP_HEADER_REMOVED;
+		return;
+	}
+
+	free(header->key);
+	free(header->value);
+	free(header);
+}
+
 void
 evhttp_clear_headers(struct evkeyvalq *headers)
 {
@@ -1327,9 +1527,7 @@ evhttp_clear_headers(struct evkeyvalq *headers)
 	    header != NULL;
 	    header = TAILQ_FIRST(headers)) {
 		TAILQ_REMOVE(headers, header, next);
-		free(header->key);
-		free(header->value);
-		free(header);
+		evhttp_header_free(header);
 	}
 }
 
@@ -1353,13 +1551,17 @@ evhttp_remove_header(struct evkeyvalq *headers, const char *key)
 
 	/* Free and remove the header that we found */
 	TAILQ_REMOVE(headers, header, next);
-	free(header->key);
-	free(header->value);
-	free(header);
+	evhttp_header_free(header);
 
 	return (0);
 }
 
+static int
+evhttp_header_is_valid_key(const char *key)
+{
+	return (strchr(key, '\r') == NULL && strchr(key, '\n') == NULL);
+}
+
 static int
 evhttp_header_is_valid_value(const char *value)
 {
@@ -1381,7 +1583,7 @@ evhttp_add_header(struct evkeyvalq *headers,
 {
 	event_debug(("%s: key: %s val: %s\n", __func__, key, value));
 
-	if (strchr(key, '\r') != NULL || strchr(key, '\n') != NULL) {
+	if (!evhttp_header_is_valid_key(key)) {
 		/* drop illegal headers */
 		event_debug(("%s: dropping illegal header key\n", __func__));
 		return (-1);
@@ -1399,7 +1601,7 @@ static int
 evhttp_add_header_internal(struct evkeyvalq *headers,
     const char *key, const char *value)
 {
-	struct evkeyval *header = calloc(1, sizeof(struct evkeyval));
+	struct evkeyval *header = calloc(1, sizeof(struct evhttp_header));
 	if (header == NULL) {
 		event_warn("%s: calloc", __func__);
 		return (-1);
@@ -1421,6 +1623,288 @@ evhttp_add_header_internal(struct evkeyvalq *headers,
 	return (0);
 }
 
+/*
+ * Returns the first CR or LF in [p, end), or NULL if there is none.  With
+ * SSE2, 16 bytes are compared at a time.
+ */
+static const char *
+evhttp_find_eol(const char *p, const char *end)
+{
+#if defined(__SSE2__) && defined(__GNUC__)
+	const __m128i cr = _mm_set1_epi8('\r');
+	const __m128i lf = _mm_set1_epi8('\n');
+
+	for (; end - p >= 16; p += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)p);
+		int mask = _mm_movemask_epi8(_mm_or_si128(
+		    _mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, lf)));
+		if (mask != 0)
+			return (p + __builtin_ctz(mask));
+	}
+#endif
+	for (; p < end; ++p) {
+		if (*p == '\r' || *p == '\n')
+			return (p);
+	}
+	return (NULL);
+}
+
+/*
+ * Returns the next line in the buffer without its end of line, which ends
+ * where evbuffer_readline() ends it: at the first CR or LF, along with
+ * the next character if that is the other one of the two.  *plen is set
+ * to its length and *pnext to the number of bytes to drain.  Only the
+ * line and its end of line are made contiguous.  Returns NULL if the line
+ * is not complete, or ends in a CR that is the last byte of the buffer
+ * and may be followed by an LF; the next call does not search the same
+ * bytes again.
+ */
+static const char *
+evhttp_peek_line(struct evhttp_header_arena *arena, struct evbuffer *buffer,
+    size_t *plen, size_t *pnext)
+{
+	size_t len = EVBUFFER_LENGTH(buffer), size;
+	const char *data, *eol;
+
+	if (arena->scanned > len)
+		arena->scanned = 0;
+	/* the line is made contiguous a piece at a time */
+	for (size = arena->scanned + 256;; size *= 2) {
+		if (arena->scanned >= len)
+			return (NULL);
+		if (size > len)
+			size = len;
+		data = (const char *)evbuffer_pullup(buffer, size);
+		if (data == NULL)
+			return (NULL);
+		eol = evhttp_find_eol(data + arena->scanned, data + size);
+		if (eol != NULL)
+			break;
+		arena->scanned = size;
+	}
+
+	*plen = eol - data;
+	if (*plen + 1 == len) {
+		if (*eol == '\r') {
+			arena->scanned = *plen;
+			return (NULL);
+		}
+		*pnext = len;
+	} else {
+		if (*plen + 1 == size &&
+		    (data = (const char *)evbuffer_pullup(buffer,
+			size + 1)) == NULL)
+			return (NULL);
+		eol = data + *plen;
+		*pnext = *plen + ((eol[1] == '\r' || eol[1] == '\n') &&
+		    eol[1] != eol[0] ? 2 : 1);
+	}
+
+	arena->scanned = 0;
+	return (data);
+}
+
+/* Returns the arena of req, which is allocated on first use */
+static struct evhttp_header_arena *
+evhttp_request_arena(struct evhttp_request *req)
+{
+	struct evhttp_header_arena *arena = EVHTTP_REQUEST_ARENA(req);
+
+	if (arena != NULL)
+		return (arena);
+	if ((arena = malloc(sizeof(struct evhttp_header_arena))) == NULL) {
+		event_warn("%s: malloc", __func__);
+		return (NULL);
+	}
+	memset(arena->common, 0, sizeof(arena->common));
+	arena->last = NULL;
+	arena->indexed = 1;
+	arena->scanned = 0;
+	arena->next = arena->first.data;
+	arena->avail = sizeof(arena->first.data);
+	arena->blocks = NULL;
+
+	EVHTTP_REQUEST_ARENA(req) = arena;
+	return (arena);
+}
+
+static void
+evhttp_arena_free(struct evhttp_header_arena *arena)
+{
+	struct evhttp_arena_block *block;
+
+	while ((block = arena->blocks) != NULL) {
+		arena->blocks = block->next;
+		free(block);
+	}
+	free(arena);
+}
+
+/* Allocates pointer aligned memory that lives as long as the arena */
+static void *
+evhttp_arena_alloc(struct evhttp_header_arena *arena, size_t size)
+{
+	struct evhttp_arena_block *block;
+	size_t block_size;
+	void *p;
+
+	size = (size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+	if (size > arena->avail) {
+		block_size = size > EVHTTP_ARENA_SIZE ? size : EVHTTP_ARENA_SIZE;
+		block = malloc(sizeof(struct evhttp_arena_block) + block_size);
+		if (block == NULL) {
+			event_warn("%s: malloc", __func__);
+			return (NULL);
+		}
+		block->next = arena->blocks;
+		arena->blocks = block;
+		arena->next = (char *)(block + 1);
+		arena->avail = block_size;
+	}
+
+	p = arena->next;
+	arena->next += size;
+	arena->avail -= size;
+	return (p);
+}
+
+/* Returns the evhttp_header_index of a header name, or -1 */
+static int
+evhttp_header_index(const char *key, size_t len)
+{
+	static const char *names[EVHTTP_HDR_MAX] = {
+		"Connection", "Content-Length", "Content-Type", "Host",
+		"Proxy-Connection", "Transfer-Encoding"
+	};
+	int index;
+
+	switch (len) {
+	case 4:
+		index = EVHTTP_HDR_HOST;
+		break;
+	case 10:
+		index = EVHTTP_HDR_CONNECTION;
+		break;
+	case 12:
+		index = EVHTTP_HDR_CONTENT_TYPE;
+		break;
+	case 14:
+		index = EVHTTP_HDR_CONTENT_LENGTH;
+		break;
+	case 16:
+		index = EVHTTP_HDR_PROXY_CONNECTION;
+		break;
+	case 17:
+		index = EVHTTP_HDR_TRANSFER_ENCODING;
+		break;
+	default:
+		return (-1);
+	}
+
+	return (strncasecmp(key, names[index], len) == 0 ? index : -1);
+}
+
+/* Copies a parsed header into the arena and appends it to headers */
+static int
+evhttp_arena_add_header(struct evhttp_header_arena *arena,
+    struct evkeyvalq *headers,
+    const char *key, size_t key_len, const char *value, size_t value_len)
+{
+	struct evhttp_header *entry;
+	struct evkeyval *header;
+	int index;
+
+	entry = evhttp_arena_alloc(arena,
+	    sizeof(struct evhttp_header) + key_len + value_len + 2);
+	if (entry == NULL)
+		return (-1);
+	entry->flags = EVHTTP_HEADER_PARSED;
+
+	header = &entry->kv;
+	header->key = (char *)(entry + 1);
+	memcpy(header->key, key, key_len);
+	header->key[key_len] = '\0';
+	header->value = header->key + key_len + 1;
+	memcpy(header->value, value, value_len);
+	header->value[value_len] = '\0';
+
+	/* the same checks as evhttp_add_header() */
+	if (!evhttp_header_is_valid_key(header->key) ||
+	    !evhttp_header_is_valid_value(header->value)) {
+		event_debug(("%s: dropping illegal header\n", __func__));
+		return (-1);
+	}
+
+	/* headers added by the user since the last parse may precede it */
+	if (TAILQ_LAST(headers, evkeyvalq) != arena->last)
+		arena->indexed = 0;
+	if ((index = evhttp_header_index(key, key_len)) != -1 &&
+	    arena->common[index] == NULL)
+		arena->common[index] = header;
+
+	TAILQ_INSERT_TAIL(headers, header, next);
+	arena->last = header;
+
+	return (0);
+}
+
+static int
+evhttp_arena_append_to_last_header(struct evhttp_header_arena *arena,
+    const char *line, size_t line_len)
+{
+	struct evkeyval *header = arena->last;
+	char *newval;
+	size_t old_len;
+
+	if (header == NULL)
+		return (-1);
+
+	old_len = strlen(header->value);
+	newval = evhttp_arena_alloc(arena, old_len + line_len + 1);
+	if (newval == NULL)
+		return (-1);
+
+	memcpy(newval, header->value, old_len);
+	memcpy(newval + old_len, line, line_len);
+	newval[old_len + line_len] = '\0';
+	header->value = newval;
+
+	return (0);
+}
+
+/*
+ * Looks up a header of req; the parsed input headers are found through
+ * the index of the arena unless it might be stale.
+ */
+static const char *
+evhttp_request_header(struct evhttp_request *req, struct evkeyvalq *headers,
+    enum evhttp_header_index index, const char *key)
+{
+	struct evhttp_header_arena *arena = EVHTTP_REQUEST_ARENA(req);
+	struct evkeyval *header;
+
+	if (arena != NULL && headers == req->input_headers &&
+	    arena->indexed && TAILQ_LAST(headers, evkeyvalq) == arena->last) {
+		if ((header = arena->common[index]) == NULL)
+			return (NULL);
+		if (!(((struct evhttp_header *)header)->flags &
+			EVHTTP_HEADER_REMOVED))
+			return (header->value);
+	}
+
+	return (evhttp_find_header(headers, key));
+}
+
+const char *
+evhttp_request_find_input_header(struct evhttp_request *req, const char *key)
+{
+	int index = evhttp_header_index(key, strlen(key));
+
+	if (index == -1)
+		return (evhttp_find_header(req->input_headers, key));
+	return (evhttp_request_header(req, req->input_headers, index, key));
+}
+
 /*
  * Parses header lines from a request or a response into the specified
  * request object given an event buffer.
@@ -1434,13 +1918,24 @@ evhttp_add_header_internal(struct evkeyvalq *headers,
 enum message_read_status
 evhttp_parse_firstline(struct evhttp_request *req, struct evbuffer *buffer)
 {
-	char *line;
+	struct evhttp_header_arena *arena;
 	enum message_read_status status = ALL_DATA_READ;
+	const char *data;
+	char *line;
+	size_t len, next;
 
-	line = evbuffer_readline(buffer);
-	if (line == NULL)
+	if ((arena = evhttp_request_arena(req)) == NULL)
+		return (DATA_CORRUPTED);
+	if ((data = evhttp_peek_line(arena, buffer, &len, &next)) == NULL)
 		return (MORE_DATA_EXPECTED);
 
+	/* the line is parsed in place */
+	if ((line = evhttp_arena_alloc(arena, len + 1)) == NULL)
+		return (DATA_CORRUPTED);
+	memcpy(line, data, len);
+	line[len] = '\0';
+	evbuffer_drain(buffer, next);
+
 	switch (req->kind) {
 	case EVHTTP_REQUEST:
 		if (evhttp_parse_request_line(req, line) == -1)
@@ -1454,77 +1949,52 @@ evhttp_parse_firstline(struct evhttp_request *req, struct evbuffer *buffer)
 		status = DATA_CORRUPTED;
 	}
 
-	free(line);
 	return (status);
 }
 
-static int
-evhttp_append_to_last_header(struct evkeyvalq *headers, const char *line)
-{
-	struct evkeyval *header = TAILQ_LAST(headers, evkeyvalq);
-	char *newval;
-	size_t old_len, line_len;
-
-	if (header == NULL)
-		return (-1);
-
-	old_len = strlen(header->value);
-	line_len = strlen(line);
-
-	newval = realloc(header->value, old_len + line_len + 1);
-	if (newval == NULL)
-		return (-1);
-
-	memcpy(newval + old_len, line, line_len + 1);
-	header->value = newval;
-
-	return (0);
-}
-
+/*
+ * Header lines are parsed as they arrive, straight from the buffer, into
+ * the arena of the request.
+ */
 enum message_read_status
 evhttp_parse_headers(struct evhttp_request *req, struct evbuffer* buffer)
 {
-	char *line;
-	enum message_read_status status = MORE_DATA_EXPECTED;
-
-	struct evkeyvalq* headers = req->input_headers;
-	while ((line = evbuffer_readline(buffer))
-	       != NULL) {
-		char *skey, *svalue;
+	struct evhttp_header_arena *arena;
+	const char *line, *colon, *value;
+	size_t len, next;
 
-		if (*line == '\0') { /* Last header - Done */
-			status = ALL_DATA_READ;
-			free(line);
-			break;
+	if ((arena = evhttp_request_arena(req)) == NULL)
+		return (DATA_CORRUPTED);
+	while ((line = evhttp_peek_line(arena, buffer, &len, &next)) != NULL) {
+		if (len == 0) { /* Last header - Done */
+			evbuffer_drain(buffer, next);
+			return (ALL_DATA_READ);
 		}
 
 		/* Check if this is a continuation line */
 		if (*line == ' ' || *line == '\t') {
-			if (evhttp_append_to_last_header(headers, line) == -1)
-				goto error;
-			free(line);
+			if (evhttp_arena_append_to_last_header(arena,
+				line, len) == -1)
+				return (DATA_CORRUPTED);
+			evbuffer_drain(buffer, next);
 			continue;
 		}
 
 		/* Processing of header lines */
-		svalue = line;
-		skey = strsep(&svalue, ":");
-		if (svalue == NULL)
-			goto error;
-
-		svalue += strspn(svalue, " ");
+		if ((colon = memchr(line, ':', len)) == NULL)
+			return (DATA_CORRUPTED);
+		for (value = colon + 1; value < line + len && *value == ' ';
+		     ++value)
+			;
 
-		if (evhttp_add_header(headers, skey, svalue) == -1)
-			goto error;
+		if (evhttp_arena_add_header(arena, req->input_headers,
+			line, colon - line, value, line + len - value) == -1)
+			return (DATA_CORRUPTED);
 
-		free(line);
+		evbuffer_drain(buffer, next);
 	}
 
-	return (status);
-
- error:
-	free(line);
-	return (DATA_CORRUPTED);
+	return (MORE_DATA_EXPECTED);
 }
 
 static int
@@ -1534,8 +2004,10 @@ evhttp_get_body_length(struct evhttp_request *req)
 	const char *content_length;
 	const char *connection;
 
-	content_length = evhttp_find_header(headers, "Content-Length");
-	connection = evhttp_find_header(headers, "Connection");
+	content_length = evhttp_request_header(req, headers,
+	    EVHTTP_HDR_CONTENT_LENGTH, "Content-Length");
+	connection = evhttp_request_header(req, headers,
+	    EVHTTP_HDR_CONNECTION, "Connection");
 		
 	if (content_length == NULL && connection == NULL)
 		req->ntoread = -1;
@@ -1577,7 +2049,8 @@ evhttp_get_body(struct evhttp_connection *evcon, struct evhttp_request *req)
 		return;
 	}
 	evcon->state = EVCON_READING_BODY;
-	xfer_enc = evhttp_find_header(req->input_headers, "Transfer-Encoding");
+	xfer_enc = evhttp_request_header(req, req->input_headers,
+	    EVHTTP_HDR_TRANSFER_ENCODING, "Transfer-Encoding");
 	if (xfer_enc != NULL && strcasecmp(xfer_enc, "chunked") == 0) {
 		req->chunked = 1;
 		req->ntoread = -1;
@@ -1686,10 +2159,12 @@ evhttp_connection_new(const char *address, unsigned short port)
 	}
 
 	evcon->fd = -1;
+	evcon->file_fd = -1;
 	evcon->port = port;
 
 	evcon->timeout = -1;
 	evcon->retry_cnt = evcon->retry_max = 0;
+	evcon->max_pipelined = 1;
 
 	if ((evcon->address = strdup(address)) == NULL) {
 		event_warn("%s: strdup failed", __func__);
@@ -1739,6 +2214,15 @@ evhttp_connection_set_retries(struct evhttp_connection *evcon,
 	evcon->retry_max = retry_max;
 }
 
+void
+evhttp_connection_set_max_pipelined(struct evhttp_connection *evcon,
+    int max_pipelined)
+{
+	evcon->max_pipelined = max_pipelined > 1 ? max_pipelined : 1;
+	if (evcon->max_pipelined > 1 && evcon->fd != -1)
+		evhttp_set_nodelay(evcon->fd);
+}
+
 void
 evhttp_connection_set_closecb(struct evhttp_connection *evcon,
     void (*cb)(struct evhttp_connection *, void *), void *cbarg)
@@ -1779,6 +2263,10 @@ evhttp_connection_connect(struct evhttp_connection *evcon)
 		return (-1);
 	}
 
+	/* pipelined requests may be added after the first was written */
+	if (evcon->max_pipelined > 1)
+		evhttp_set_nodelay(evcon->fd);
+
 	/* Set up a callback for successful connection setup */
 	event_set(&evcon->ev, evcon->fd, EV_WRITE, evhttp_connectioncb, evcon);
 	EVHTTP_BASE_SET(evcon, &evcon->ev);
@@ -1795,9 +2283,8 @@ evhttp_connection_connect(struct evhttp_connection *evcon)
  * this will start the connection.
  */
 
-int
-evhttp_make_request(struct evhttp_connection *evcon,
-    struct evhttp_request *req,
+static void
+evhttp_request_prepare(struct evhttp_request *req,
     enum evhttp_cmd_type type, const char *uri)
 {
 	/* We are making a request */
@@ -1815,8 +2302,16 @@ evhttp_make_request(struct evhttp_connection *evcon,
 	}
 	
 	assert(req->evcon == NULL);
-	req->evcon = evcon;
 	assert(!(req->flags & EVHTTP_REQ_OWN_CONNECTION));
+}
+
+int
+evhttp_make_request(struct evhttp_connection *evcon,
+    struct evhttp_request *req,
+    enum evhttp_cmd_type type, const char *uri)
+{
+	evhttp_request_prepare(req, type, uri);
+	req->evcon = evcon;
 	
 	TAILQ_INSERT_TAIL(&evcon->requests, req, next);
 
@@ -1826,12 +2321,235 @@ evhttp_make_request(struct evhttp_connection *evcon,
 
 	/*
 	 * If it's connected already and we are the first in the queue,
-	 * then we can dispatch this request immediately.  Otherwise, it
-	 * will be dispatched once the pending requests are completed.
+	 * then we can dispatch this request immediately.  If the requests
+	 * ahead of us are still being written, we may be pipelined behind
+	 * them.  Otherwise, it will be dispatched once the pending requests
+	 * are completed.
 	 */
 	if (TAILQ_FIRST(&evcon->requests) == req)
 		evhttp_request_dispatch(evcon);
+	else if (evcon->state == EVCON_WRITING &&
+	    evhttp_connection_next_unsent(evcon) == req &&
+	    evhttp_connection_can_pipeline(evcon, req))
+		evhttp_request_write(evcon, req);
+
+	return (0);
+}
+
+/*
+ * Connection pools
+ */
+
+struct evhttp_connection_pool *
+evhttp_connection_pool_new(struct event_base *base, const char *address,
+    unsigned short port, int max_connections)
+{
+	struct evhttp_connection_pool *pool;
+
+	if ((pool = calloc(1, sizeof(struct evhttp_connection_pool))) == NULL) {
+		event_warn("%s: calloc failed", __func__);
+		return (NULL);
+	}
+	if ((pool->address = strdup(address)) == NULL) {
+		event_warn("%s: strdup failed", __func__);
+		free(pool);
+		return (NULL);
+	}
+
+	TAILQ_INIT(&pool->connections);
+	TAILQ_INIT(&pool->requests);
+	pool->max_connections = max_connections > 1 ? max_connections : 1;
+	pool->max_pipelined = 1;
+	pool->timeout = -1;
+	pool->reuse = EVHTTP_POOL_REUSE_LIFO;
+	pool->port = port;
+	pool->base = base;
+
+	return (pool);
+}
+
+void
+evhttp_connection_pool_free(struct evhttp_connection_pool *pool)
+{
+	struct evhttp_connection *evcon;
+	struct evhttp_request *req;
+
+	while ((evcon = TAILQ_FIRST(&pool->connections)) != NULL) {
+		TAILQ_REMOVE(&pool->connections, evcon, next);
+		evcon->pool = NULL;
+		evhttp_connection_free(evcon);
+	}
+
+	while ((req = TAILQ_FIRST(&pool->requests)) != NULL) {
+		TAILQ_REMOVE(&pool->requests, req, next);
+		evhttp_request_free(req);
+	}
+
+	free(pool->address);
+	free(pool);
+}
+
+void
+evhttp_connection_pool_set_max_pipelined(struct evhttp_connection_pool *pool,
+    int max_pipelined)
+{
+	struct evhttp_connection *evcon;
+
+	pool->max_pipelined = max_pipelined > 1 ? max_pipelined : 1;
+	TAILQ_FOREACH(evcon, &pool->connections, next)
+		evhttp_connection_set_max_pipelined(evcon,
+		    pool->max_pipelined);
+}
+
+void
+evhttp_connection_pool_set_idle_timeout(struct evhttp_connection_pool *pool,
+    int timeout_in_secs)
+{
+	struct evhttp_connection *evcon;
+
+	pool->idle_timeout = timeout_in_secs > 0 ? timeout_in_secs : 0;
+	TAILQ_FOREACH(evcon, &pool->connections, next)
+		evcon->idle_timeout = pool->idle_timeout;
+}
+
+void
+evhttp_connection_pool_set_reuse(struct evhttp_connection_pool *pool,
+    int reuse)
+{
+	pool->reuse = reuse;
+}
+
+void
+evhttp_connection_pool_set_timeout(struct evhttp_connection_pool *pool,
+    int timeout_in_secs)
+{
+	struct evhttp_connection *evcon;
+
+	pool->timeout = timeout_in_secs;
+	TAILQ_FOREACH(evcon, &pool->connections, next)
+		evcon->timeout = timeout_in_secs;
+}
+
+static struct evhttp_connection *
+evhttp_connection_pool_add(struct evhttp_connection_pool *pool)
+{
+	struct evhttp_connection *evcon;
+
+	evcon = evhttp_connection_new(pool->address, pool->port);
+	if (evcon == NULL)
+		return (NULL);
+	if (pool->base != NULL)
+		evhttp_connection_set_base(evcon, pool->base);
+	evcon->timeout = pool->timeout;
+	evcon->max_pipelined = pool->max_pipelined;
+	evcon->idle_timeout = pool->idle_timeout;
+	evcon->pool = pool;
+
+	TAILQ_INSERT_HEAD(&pool->connections, evcon, next);
+	pool->nconnections++;
+
+	return (evcon);
+}
+
+static int
+evhttp_connection_queued(struct evhttp_connection *evcon)
+{
+	struct evhttp_request *req;
+	int n = 0;
+
+	TAILQ_FOREACH(req, &evcon->requests, next)
+		n++;
+	return (n);
+}
 
+/*
+ * Picks the connection for req: an idle connection that is still open,
+ * in the order of the reuse policy, then an idle closed one, then a new
+ * one, and finally the one with the shortest pipeline that has room.
+ * Returns NULL if req has to wait for a connection.
+ */
+static struct evhttp_connection *
+evhttp_connection_pool_pick(struct evhttp_connection_pool *pool,
+    struct evhttp_request *req)
+{
+	struct evhttp_connection *evcon, *idle = NULL, *best = NULL;
+	int fifo = pool->reuse == EVHTTP_POOL_REUSE_FIFO;
+	int n, best_n = 0;
+
+	/* connections are kept most recently idle first */
+	for (evcon = fifo ? TAILQ_LAST(&pool->connections, evconq) :
+		 TAILQ_FIRST(&pool->connections);
+	     evcon != NULL;
+	     evcon = fifo ? TAILQ_PREV(evcon, evconq, next) :
+		 TAILQ_NEXT(evcon, next)) {
+		if (!TAILQ_EMPTY(&evcon->requests))
+			continue;
+		if (evhttp_connected(evcon))
+			return (evcon);
+		if (idle == NULL)
+			idle = evcon;
+	}
+	if (idle != NULL)
+		return (idle);
+
+	if (pool->nconnections < pool->max_connections &&
+	    (evcon = evhttp_connection_pool_add(pool)) != NULL)
+		return (evcon);
+
+	if (pool->max_pipelined < 2 || !evhttp_request_can_pipeline(req))
+		return (NULL);
+	TAILQ_FOREACH(evcon, &pool->connections, next) {
+		n = evhttp_connection_queued(evcon);
+		if (n < evcon->max_pipelined && (best == NULL || n < best_n) &&
+		    evhttp_request_can_pipeline(TAILQ_FIRST(&evcon->requests))) {
+			best = evcon;
+			best_n = n;
+		}
+	}
+	return (best);
+}
+
+/*
+ * Called when evcon has finished with a request: moves the requests that
+ * wait in its pool over to it, as many as it has room for.
+ */
+static void
+evhttp_connection_pool_refill(struct evhttp_connection *evcon)
+{
+	struct evhttp_connection_pool *pool = evcon->pool;
+	struct evhttp_request *req;
+	int n = evhttp_connection_queued(evcon);
+
+	while ((req = TAILQ_FIRST(&pool->requests)) != NULL &&
+	    (n == 0 || (n < evcon->max_pipelined &&
+		evhttp_request_can_pipeline(req) &&
+		evhttp_request_can_pipeline(TAILQ_FIRST(&evcon->requests))))) {
+		TAILQ_REMOVE(&pool->requests, req, next);
+		req->evcon = evcon;
+		TAILQ_INSERT_TAIL(&evcon->requests, req, next);
+		n++;
+	}
+
+	if (n == 0) {
+		/* keep the most recently idle connection first */
+		TAILQ_REMOVE(&pool->connections, evcon, next);
+		TAILQ_INSERT_HEAD(&pool->connections, evcon, next);
+	}
+}
+
+int
+evhttp_connection_pool_make_request(struct evhttp_connection_pool *pool,
+    struct evhttp_request *req,
+    enum evhttp_cmd_type type, const char *uri)
+{
+	struct evhttp_connection *evcon = evhttp_connection_pool_pick(pool, req);
+
+	if (evcon != NULL)
+		return (evhttp_make_request(evcon, req, type, uri));
+
+	/* wait until a connection has room */
+	evhttp_request_prepare(req, type, uri);
+	TAILQ_INSERT_TAIL(&pool->requests, req, next);
 	return (0);
 }
 
@@ -1851,6 +2569,10 @@ evhttp_start_read(struct evhttp_connection *evcon)
 	
 	evhttp_add_event(&evcon->ev, evcon->timeout, HTTP_READ_TIMEOUT);
 	evcon->state = EVCON_READING_FIRSTLINE;
+
+	/* a pipelined message may have been read already */
+	if (EVBUFFER_LENGTH(evcon->input_buffer) != 0)
+		event_active(&evcon->ev, EV_READ, 1);
 }
 
 static void
@@ -1865,9 +2587,9 @@ evhttp_send_done(struct evhttp_connection *evcon, void *arg)
 	
 	need_close =
 	    (req->minor == 0 &&
-		!evhttp_is_connection_keepalive(req->input_headers))||
-	    evhttp_is_connection_close(req->flags, req->input_headers) ||
-	    evhttp_is_connection_close(req->flags, req->output_headers);
+		!evhttp_is_connection_keepalive(req, req->input_headers))||
+	    evhttp_is_connection_close(req, req->input_headers) ||
+	    evhttp_is_connection_close(req, req->output_headers);
 
 	assert(req->flags & EVHTTP_REQ_OWN_CONNECTION);
 	evhttp_request_free(req);
@@ -1939,6 +2661,31 @@ evhttp_send_reply(struct evhttp_request *req, int code, const char *reason,
 	evhttp_send(req, databuf);
 }
 
+void
+evhttp_send_reply_file(struct evhttp_request *req, int code,
+    const char *reason, int fd, off_t offset, size_t length)
+{
+	struct evhttp_connection *evcon = req->evcon;
+	char len[22];
+
+	evhttp_response_code(req, code, reason);
+
+	evutil_snprintf(len, sizeof(len), "%lu", (unsigned long)length);
+	evhttp_remove_header(req->output_headers, "Content-Length");
+	evhttp_add_header(req->output_headers, "Content-Length", len);
+
+	evhttp_connection_close_file(evcon);
+	if (length > 0) {
+		evcon->file_fd = fd;
+		evcon->file_offset = offset;
+		evcon->file_left = length;
+	} else {
+		close(fd);
+	}
+
+	evhttp_send(req, NULL);
+}
+
 void
 evhttp_send_reply_start(struct evhttp_request *req, int code,
     const char *reason)
@@ -1961,7 +2708,8 @@ evhttp_send_reply_chunk(struct evhttp_request *req, struct evbuffer *databuf)
 		evbuffer_add_printf(req->evcon->output_buffer, "%x\r\n",
 				    (unsigned)EVBUFFER_LENGTH(databuf));
 	}
-	evbuffer_add_buffer(req->evcon->output_buffer, databuf);
+	evbuffer_remove_buffer(databuf, req->evcon->output_buffer,
+	    EVBUFFER_LENGTH(databuf));
 	if (req->chunked) {
 		evbuffer_add(req->evcon->output_buffer, "\r\n", 2);
 	}
@@ -2248,13 +2996,13 @@ accept_socket(int fd, short what, void *arg)
 	evhttp_get_request(http, nfd, (struct sockaddr *)&ss, addrlen);
 }
 
-int
-evhttp_bind_socket(struct evhttp *http, const char *address, u_short port)
+/* Binds a listening socket, as evhttp_bind_socket() does. */
+static int
+listen_socket(const char *address, u_short port, int reuse)
 {
 	int fd;
-	int res;
 
-	if ((fd = bind_socket(address, port, 1 /*reuse*/)) == -1)
+	if ((fd = bind_socket(address, port, reuse)) == -1)
 		return (-1);
 
 	if (listen(fd, 128) == -1) {
@@ -2263,6 +3011,18 @@ evhttp_bind_socket(struct evhttp *http, const char *address, u_short port)
 		return (-1);
 	}
 
+	return (fd);
+}
+
+int
+evhttp_bind_socket(struct evhttp *http, const char *address, u_short port)
+{
+	int fd;
+	int res;
+
+	if ((fd = listen_socket(address, port, BIND_REUSEADDR)) == -1)
+		return (-1);
+
 	res = evhttp_accept_socket(http, fd);
 	
 	if (res != -1)
@@ -2272,8 +3032,13 @@ evhttp_bind_socket(struct evhttp *http, const char *address, u_short port)
 	return (res);
 }
 
-int
-evhttp_accept_socket(struct evhttp *http, int fd)
+/*
+ * Schedules fd for accepting on the base of http; cb is called whenever
+ * it is readable.  The socket is closed by evhttp_free().
+ */
+static int
+evhttp_accept_socket_cb(struct evhttp *http, int fd,
+    void (*cb)(int, short, void *), void *arg)
 {
 	struct evhttp_bound_socket *bound;
 	struct event *ev;
@@ -2286,7 +3051,7 @@ evhttp_accept_socket(struct evhttp *http, int fd)
 	ev = &bound->bind_ev;
 
 	/* Schedule the socket for accepting */
-	event_set(ev, fd, EV_READ | EV_PERSIST, accept_socket, http);
+	event_set(ev, fd, EV_READ | EV_PERSIST, cb, arg);
 	EVHTTP_BASE_SET(http, ev);
 
 	res = event_add(ev, NULL);
@@ -2301,6 +3066,12 @@ evhttp_accept_socket(struct evhttp *http, int fd)
 	return (0);
 }
 
+int
+evhttp_accept_socket(struct evhttp *http, int fd)
+{
+	return (evhttp_accept_socket_cb(http, fd, accept_socket, http));
+}
+
 static struct evhttp*
 evhttp_new_object(void)
 {
@@ -2429,6 +3200,337 @@ evhttp_set_gencb(struct evhttp *http,
 	http->gencbarg = cbarg;
 }
 
+/*
+ * Multi-reactor servers: one evhttp per event base, each base dispatched
+ * by its own thread.  Nothing is shared between the evhttps after
+ * evhttp_pool_bind_socket() returns, so no locking is needed.
+ */
+
+/* an accepted connection on its way to another worker */
+struct evhttp_handoff {
+	int fd;
+	socklen_t addrlen;
+	struct sockaddr_storage ss;
+};
+
+static void
+evhttp_pool_handoff_cb(int fd, short what, void *arg)
+{
+	struct evhttp_pool_worker *worker = arg;
+	struct evhttp_handoff handoff;
+
+	if (recv(fd, (void *)&handoff, sizeof(handoff), 0) !=
+	    sizeof(handoff)) {
+		if (errno != EAGAIN && errno != EINTR)
+			event_warn("%s: recv", __func__);
+		return;
+	}
+
+	evhttp_get_request(worker->http, handoff.fd,
+	    (struct sockaddr *)&handoff.ss, handoff.addrlen);
+}
+
+/* Accepts on the first worker and passes the connection on round robin. */
+static void
+evhttp_pool_accept_cb(int fd, short what, void *arg)
+{
+	struct evhttp_pool *pool = arg;
+	struct evhttp_pool_worker *worker;
+	struct evhttp_handoff handoff;
+
+	handoff.addrlen = sizeof(handoff.ss);
+	handoff.fd = accept(fd, (struct sockaddr *)&handoff.ss,
+	    &handoff.addrlen);
+	if (handoff.fd == -1) {
+		if (errno != EAGAIN && errno != EINTR)
+			event_warn("%s: bad accept", __func__);
+		return;
+	}
+	if (evutil_make_socket_nonblocking(handoff.fd) < 0) {
+		EVUTIL_CLOSESOCKET(handoff.fd);
+		return;
+	}
+
+	worker = &pool->workers[pool->next];
+	pool->next = (pool->next + 1) % pool->nworkers;
+
+	/*
+	 * The handoff sockets do not block: when a worker is too busy to
+	 * drain its queue, the connection stays with the acceptor rather
+	 * than stalling it.  A handoff is far smaller than a socket buffer,
+	 * so it is either queued whole or not at all.
+	 */
+	if (worker != &pool->workers[0]) {
+		if (send(worker->handoff[0], (void *)&handoff,
+			sizeof(handoff), 0) == sizeof(handoff))
+			return;
+		if (errno != EAGAIN && errno != EINTR) {
+			event_warn("%s: send", __func__);
+			EVUTIL_CLOSESOCKET(handoff.fd);
+			return;
+		}
+	}
+
+	evhttp_get_request(pool->workers[0].http, handoff.fd,
+	    (struct sockaddr *)&handoff.ss, handoff.addrlen);
+}
+
+struct evhttp_pool *
+evhttp_pool_new(struct event_base **bases, int nbases)
+{
+	struct evhttp_pool *pool;
+	int i;
+
+	if (nbases < 1)
+		return (NULL);
+
+	if ((pool = calloc(1, sizeof(struct evhttp_pool))) == NULL) {
+		event_warn("%s: calloc", __func__);
+		return (NULL);
+	}
+
+	pool->workers = calloc(nbases, sizeof(struct evhttp_pool_worker));
+	if (pool->workers == NULL) {
+		event_warn("%s: calloc", __func__);
+		free(pool);
+		return (NULL);
+	}
+
+	for (i = 0; i < nbases; ++i) {
+		struct evhttp_pool_worker *worker = &pool->workers[i];
+		worker->handoff[0] = worker->handoff[1] = -1;
+		if ((worker->http = evhttp_new(bases[i])) == NULL) {
+			evhttp_pool_free(pool);
+			return (NULL);
+		}
+		pool->nworkers++;
+	}
+
+	return (pool);
+}
+
+#ifdef SO_REUSEPORT
+static u_short
+evhttp_sockaddr_port(const struct sockaddr *sa)
+{
+#ifdef AF_INET6
+	if (sa->sa_family == AF_INET6)
+		return (ntohs(((const struct sockaddr_in6 *)sa)->sin6_port));
+#endif
+	return (ntohs(((const struct sockaddr_in *)sa)->sin_port));
+}
+
+/* Stops accepting on fd, undoing evhttp_accept_socket(), but leaves it open */
+static void
+evhttp_unaccept_socket(struct evhttp *http, int fd)
+{
+	struct evhttp_bound_socket *bound;
+
+	TAILQ_FOREACH(bound, &http->sockets, next) {
+		if (bound->bind_ev.ev_fd == fd)
+			break;
+	}
+	if (bound == NULL)
+		return;
+
+	TAILQ_REMOVE(&http->sockets, bound, next);
+	event_del(&bound->bind_ev);
+	free(bound);
+}
+
+/*
+ * Gives every worker a listening socket of its own and lets the kernel
+ * spread the connections over them.
+ */
+static int
+evhttp_pool_bind_reuseport(struct evhttp_pool *pool, const char *address,
+    u_short port)
+{
+	struct sockaddr_storage ss;
+	socklen_t sslen = sizeof(ss);
+	int *fds;
+	int bound, taken = 0;
+
+	if ((fds = malloc(pool->nworkers * sizeof(int))) == NULL)
+		return (-1);
+
+	for (bound = 0; bound < pool->nworkers; ++bound) {
+		fds[bound] = listen_socket(address, port,
+		    BIND_REUSEADDR | BIND_REUSEPORT);
+		if (fds[bound] == -1)
+			goto out;
+		/* all workers need to listen on the port picked for the first */
+		if (port == 0) {
+			if (getsockname(fds[bound], (struct sockaddr *)&ss,
+				&sslen) == -1) {
+				EVUTIL_CLOSESOCKET(fds[bound]);
+				goto out;
+			}
+			port = evhttp_sockaddr_port((struct sockaddr *)&ss);
+		}
+	}
+
+	for (taken = 0; taken < pool->nworkers; ++taken) {
+		if (evhttp_accept_socket(pool->workers[taken].http,
+			fds[taken]) == -1)
+			break;
+	}
+	if (taken == pool->nworkers) {
+		free(fds);
+		return (0);
+	}
+
+	/* the workers that took a socket give it back before the fallback */
+	while (taken > 0) {
+		--taken;
+		evhttp_unaccept_socket(pool->workers[taken].http, fds[taken]);
+	}
+
+ out:
+	while (taken < bound)
+		EVUTIL_CLOSESOCKET(fds[taken++]);
+	free(fds);
+	return (-1);
+}
+#endif
+
+/*
+ * Accepts on the first worker only, which hands the connections it does
+ * not keep to the other workers.
+ */
+int
+evhttp_pool_bind_acceptor(struct evhttp_pool *pool, const char *address,
+    u_short port)
+{
+	struct evhttp_pool_worker *worker;
+	int fd, i;
+
+	for (i = 1; i < pool->nworkers; ++i) {
+		worker = &pool->workers[i];
+		if (worker->handoff[0] != -1)
+			continue;
+		if (evutil_socketpair(AF_UNIX, SOCK_STREAM, 0,
+			worker->handoff) == -1) {
+			event_warn("%s: socketpair", __func__);
+			worker->handoff[0] = worker->handoff[1] = -1;
+			return (-1);
+		}
+		if (evutil_make_socket_nonblocking(worker->handoff[0]) < 0 ||
+		    evutil_make_socket_nonblocking(worker->handoff[1]) < 0) {
+			EVUTIL_CLOSESOCKET(worker->handoff[0]);
+			EVUTIL_CLOSESOCKET(worker->handoff[1]);
+			worker->handoff[0] = worker->handoff[1] = -1;
+			return (-1);
+		}
+		event_set(&worker->handoff_ev, worker->handoff[1],
+		    EV_READ | EV_PERSIST, evhttp_pool_handoff_cb, worker);
+		EVHTTP_BASE_SET(worker->http, &worker->handoff_ev);
+		if (event_add(&worker->handoff_ev, NULL) == -1) {
+			EVUTIL_CLOSESOCKET(worker->handoff[0]);
+			EVUTIL_CLOSESOCKET(worker->handoff[1]);
+			worker->handoff[0] = worker->handoff[1] = -1;
+			return (-1);
+		}
+	}
+
+	if ((fd = listen_socket(address, port, BIND_REUSEADDR)) == -1)
+		return (-1);
+
+	if (evhttp_accept_socket_cb(pool->workers[0].http, fd,
+		evhttp_pool_accept_cb, pool) == -1) {
+		EVUTIL_CLOSESOCKET(fd);
+		return (-1);
+	}
+
+	return (0);
+}
+
+int
+evhttp_pool_bind_socket(struct evhttp_pool *pool, const char *address,
+    u_short port)
+{
+	if (pool->nworkers == 1)
+		return (evhttp_bind_socket(pool->workers[0].http,
+			address, port));
+
+#ifdef SO_REUSEPORT
+	if (evhttp_pool_bind_reuseport(pool, address, port) == 0)
+		return (0);
+#endif
+
+	return (evhttp_pool_bind_acceptor(pool, address, port));
+}
+
+int
+evhttp_pool_size(struct evhttp_pool *pool)
+{
+	return (pool->nworkers);
+}
+
+struct evhttp *
+evhttp_pool_get(struct evhttp_pool *pool, int i)
+{
+	if (i < 0 || i >= pool->nworkers)
+		return (NULL);
+	return (pool->workers[i].http);
+}
+
+void
+evhttp_pool_set_timeout(struct evhttp_pool *pool, int timeout_in_secs)
+{
+	int i;
+
+	for (i = 0; i < pool->nworkers; ++i)
+		evhttp_set_timeout(pool->workers[i].http, timeout_in_secs);
+}
+
+void
+evhttp_pool_set_cb(struct evhttp_pool *pool, const char *uri,
+    void (*cb)(struct evhttp_request *, void *), void *cbarg)
+{
+	int i;
+
+	for (i = 0; i < pool->nworkers; ++i)
+		evhttp_set_cb(pool->workers[i].http, uri, cb, cbarg);
+}
+
+void
+evhttp_pool_set_gencb(struct evhttp_pool *pool,
+    void (*cb)(struct evhttp_request *, void *), void *cbarg)
+{
+	int i;
+
+	for (i = 0; i < pool->nworkers; ++i)
+		evhttp_set_gencb(pool->workers[i].http, cb, cbarg);
+}
+
+void
+evhttp_pool_free(struct evhttp_pool *pool)
+{
+	struct evhttp_pool_worker *worker;
+	struct evhttp_handoff handoff;
+	int i;
+
+	/* stop accepting before closing what was never picked up */
+	for (i = 0; i < pool->nworkers; ++i)
+		evhttp_free(pool->workers[i].http);
+
+	for (i = 0; i < pool->nworkers; ++i) {
+		worker = &pool->workers[i];
+		if (worker->handoff[0] == -1)
+			continue;
+		event_del(&worker->handoff_ev);
+		EVUTIL_CLOSESOCKET(worker->handoff[0]);
+		while (recv(worker->handoff[1], (void *)&handoff,
+			sizeof(handoff), 0) == sizeof(handoff))
+			EVUTIL_CLOSESOCKET(handoff.fd);
+		EVUTIL_CLOSESOCKET(worker->handoff[1]);
+	}
+
+	free(pool->workers);
+	free(pool);
+}
+
 /*
  * Request related functions
  */
@@ -2439,7 +3541,7 @@ evhttp_request_new(void (*cb)(struct evhttp_request *, void *), void *arg)
 	struct evhttp_request *req = NULL;
 
 	/* Allocate request structure */
-	if ((req = calloc(1, sizeof(struct evhttp_request))) == NULL) {
+	if ((req = calloc(1, sizeof(struct evhttp_request_private))) == NULL) {
 		event_warn("%s: calloc", __func__);
 		goto error;
 	}
@@ -2490,11 +3592,17 @@ evhttp_request_free(struct evhttp_request *req)
 	if (req->response_code_line != NULL)
 		free(req->response_code_line);
 
-	evhttp_clear_headers(req->input_headers);
-	free(req->input_headers);
+	if (req->input_headers != NULL) {
+		evhttp_clear_headers(req->input_headers);
+		free(req->input_headers);
+	}
+	if (EVHTTP_REQUEST_ARENA(req) != NULL)
+		evhttp_arena_free(EVHTTP_REQUEST_ARENA(req));
 
-	evhttp_clear_headers(req->output_headers);
-	free(req->output_headers);
+	if (req->output_headers != NULL) {
+		evhttp_clear_headers(req->output_headers);
+		free(req->output_headers);
+	}
 
 	if (req->input_buffer != NULL)
 		evbuffer_free(req->input_buffer);
@@ -2561,6 +3669,12 @@ evhttp_get_request_connection(
 	
 	evcon->fd = fd;
 
+	/*
+	 * The replies to pipelined requests are written one by one; they
+	 * must not wait for the peer to acknowledge the previous one.
+	 */
+	evhttp_set_nodelay(fd);
+
 	return (evcon);
 }
 
@@ -2676,6 +3790,17 @@ name_from_addr(struct sockaddr *sa, socklen_t salen,
 	*pport = strdup(strport);
 }
 
+/* Sends small writes right away instead of waiting to coalesce them */
+static void
+evhttp_set_nodelay(int fd)
+{
+#ifdef TCP_NODELAY
+	int on = 1;
+
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, (void *)&on, sizeof(on));
+#endif
+}
+
 /* Create a non-blocking socket and bind it */
 /* todo: rename this function */
 static int
@@ -2702,10 +3827,16 @@ bind_socket_ai(struct addrinfo *ai, int reuse)
 #endif
 
         setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, (void *)&on, sizeof(on));
-	if (reuse) {
+	if (reuse & BIND_REUSEADDR) {
 		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR,
 		    (void *)&on, sizeof(on));
 	}
+#ifdef SO_REUSEPORT
+	if ((reuse & BIND_REUSEPORT) &&
+	    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT,
+		(void *)&on, sizeof(on)) == -1)
+		goto out;
+#endif
 
 	if (ai != NULL) {
 		r = bind(fd, ai->ai_addr, ai->ai_addrlen);
@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) 2016 The Chromium Authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Resolves names against an evdns server port on the loopback interface,
+ * once with the answer cache disabled and once with it enabled, keeping a
+ * fixed number of lookups in flight.  Popular names are looked up far more
+ * often than the rest, as they are by a crawler or a proxy.  Reports
+ * lookups per second and the number of queries the server saw.
+ *
+ * usage: bench_dns [-n lookups] [-d distinct names] [-c concurrency]
+ *                  [-p port]
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <event.h>
+#include <evdns.h>
+#include <evutil.h>
+
+static int num_lookups = 100000;
+static int num_names = 1000;
+static int concurrency = 64;
+static u_short port = 35353;
+
+static char **names;
+static int *order;		/* the name of each lookup */
+static int issued, done, failed, queries;
+
+static void
+server_cb(struct evdns_server_request *req, void *arg)
+{
+	ev_uint32_t addr = htonl(0x0a000001UL);
+	int i;
+
+	for (i = 0; i < req->nquestions; ++i) {
+		evdns_server_request_add_a_reply(req,
+		    req->questions[i]->name, 1, &addr, 300);
+		queries++;
+	}
+	evdns_server_request_respond(req, 0);
+}
+
+static void lookup(void);
+
+static void
+lookup_cb(int result, char type, int count, int ttl, void *addresses,
+    void *arg)
+{
+	if (result != DNS_ERR_NONE)
+		failed++;
+	if (++done == num_lookups)
+		event_loopexit(NULL);
+	else if (issued < num_lookups)
+		lookup();
+}
+
+static void
+lookup(void)
+{
+	evdns_resolve_ipv4(names[order[issued++]], DNS_QUERY_NO_SEARCH,
+	    lookup_cb, NULL);
+}
+
+static double
+run_once(const char *cache_size, struct evdns_cache_stats *stats)
+{
+	struct evdns_server_port *server;
+	struct sockaddr_in sin;
+	struct timeval start, end;
+	char ns[32];
+	int fd, i;
+
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_port = htons(port);
+	sin.sin_addr.s_addr = htonl(0x7f000001UL);
+	if ((fd = socket(AF_INET, SOCK_DGRAM, 0)) == -1 ||
+	    bind(fd, (struct sockaddr *)&sin, sizeof(sin)) == -1) {
+		perror("bind");
+		exit(1);
+	}
+	evutil_make_socket_nonblocking(fd);
+	server = evdns_add_server_port(fd, 0, server_cb, NULL);
+
+	evutil_snprintf(ns, sizeof(ns), "127.0.0.1:%d", port);
+	evdns_nameserver_ip_add(ns);
+	evdns_set_option("max-inflight:", "65000", DNS_OPTION_MISC);
+	evdns_set_option("cache-size:", cache_size, DNS_OPTION_MISC);
+
+	issued = done = failed = queries = 0;
+	gettimeofday(&start, NULL);
+	for (i = 0; i < concurrency && i < num_lookups; ++i)
+		lookup();
+	event_dispatch();
+	gettimeofday(&end, NULL);
+	if (failed) {
+		fprintf(stderr, "%d of %d lookups failed\n", failed,
+		    num_lookups);
+		exit(1);
+	}
+
+	evdns_cache_get_stats(stats);
+	evdns_close_server_port(server);
+	evdns_shutdown(0);
+	EVUTIL_CLOSESOCKET(fd);
+
+	evutil_timersub(&end, &start, &end);
+	return (num_lookups / (end.tv_sec + end.tv_usec / 1000000.0));
+}
+
+int
+main(int argc, char **argv)
+{
+	struct evdns_cache_stats stats;
+	double rate;
+	int c, i;
+
+	while ((c = getopt(argc, argv, "n:d:c:p:")) != -1) {
+		switch (c) {
+		case 'n':
+			num_lookups = atoi(optarg);
+			break;
+		case 'd':
+			num_names = atoi(optarg);
+			break;
+		case 'c':
+			concurrency = atoi(optarg);
+			break;
+		case 'p':
+			port = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "Illegal argument \"%c\"\n", c);
+			exit(1);
+		}
+	}
+	if (num_lookups < 1 || num_names < 1 || concurrency < 1) {
+		fprintf(stderr, "Arguments must be positive\n");
+		exit(1);
+	}
+
+	names = calloc(num_names, sizeof(char *));
+	order = calloc(num_lookups, sizeof(int));
+	if (names == NULL || order == NULL) {
+		perror("calloc");
+		exit(1);
+	}
+	for (i = 0; i < num_names; ++i) {
+		char name[64];
+		evutil_snprintf(name, sizeof(name), "host%d.example.com", i);
+		if ((names[i] = strdup(name)) == NULL) {
+			perror("strdup");
+			exit(1);
+		}
+	}
+	/* the cube of a uniform variable favours the first names */
+	for (i = 0; i < num_lookups; ++i) {
+		double u = (double)random() / ((double)RAND_MAX + 1);
+		order[i] = (int)(num_names * u * u * u);
+	}
+
+	event_init();
+
+	printf("cache\tlookups/s\tqueries\thits\tcoalesced\n");
+	rate = run_once("0", &stats);
+	printf("off\t%.0f\t%d\t-\t-\n", rate, queries);
+	rate = run_once("1048576", &stats);
+	printf("on\t%.0f\t%d\t%lu\t%lu\n", rate, queries, stats.hits,
+	    stats.coalesced);
+
+	for (i = 0; i < num_names; ++i)
+		free(names[i]);
+	free(order);
+	free(names);
+	return (0);
+}
@@ -0,0 +1,300 @@
+/*
+ * Copyright (c) 2016 The Chromium Authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Serves a large temporary file with evhttp, once read into an evbuffer
+ * and sent with evhttp_send_reply() and once with evhttp_send_reply_file(),
+ * and reports the throughput a keep-alive client gets and the peak RSS of
+ * the server.  Each server runs in a child process of its own so that the
+ * peak RSS of one mode does not hide that of the other.
+ *
+ * usage: bench_file [-s file size in MB] [-n requests] [-p port]
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <sys/queue.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include <event.h>
+#include <evhttp.h>
+#include <evutil.h>
+
+static const char *address = "127.0.0.1";
+static u_short port = 8080;
+static size_t file_size = 64 << 20;
+static int num_requests = 8;
+
+static FILE *file;
+
+/* The server writes a byte to ready_pair[1] once it listens and leaves
+ * its loop when the parent closes stop_pair[0]. */
+static int ready_pair[2];
+static int stop_pair[2];
+
+static void
+http_buffer_cb(struct evhttp_request *req, void *arg)
+{
+	struct evbuffer *evb = evbuffer_new();
+	int fd = fileno(file);
+	int n;
+
+	lseek(fd, 0, SEEK_SET);
+	while ((n = evbuffer_read(evb, fd, 65536)) > 0)
+		;
+	evhttp_send_reply(req, HTTP_OK, "OK", evb);
+	evbuffer_free(evb);
+}
+
+static void
+http_file_cb(struct evhttp_request *req, void *arg)
+{
+	evhttp_send_reply_file(req, HTTP_OK, "OK", dup(fileno(file)), 0,
+	    file_size);
+}
+
+static void
+server_stop_cb(int fd, short what, void *arg)
+{
+	event_base_loopbreak(arg);
+}
+
+static void
+server_main(void (*cb)(struct evhttp_request *, void *))
+{
+	struct event_base *base = event_base_new();
+	struct evhttp *http = evhttp_new(base);
+	struct event stop_ev;
+
+	evhttp_set_gencb(http, cb, NULL);
+	if (evhttp_bind_socket(http, address, port) == -1) {
+		fprintf(stderr, "Could not bind to %s:%d\n", address, port);
+		exit(1);
+	}
+
+	event_set(&stop_ev, stop_pair[1], EV_READ, server_stop_cb, base);
+	event_base_set(base, &stop_ev);
+	event_add(&stop_ev, NULL);
+
+	if (write(ready_pair[1], "", 1) != 1)
+		exit(1);
+	event_base_dispatch(base);
+
+	evhttp_free(http);
+	event_base_free(base);
+	exit(0);
+}
+
+/* Reads one response off fd and returns the length of its body. */
+static long
+client_response(int fd, char *buf, size_t size)
+{
+	size_t have = 0;
+	long length = -1, left;
+	char *end, *p;
+	ssize_t n;
+
+	/* the headers */
+	for (;;) {
+		n = read(fd, buf + have, size - have - 1);
+		if (n <= 0)
+			return (-1);
+		have += n;
+		buf[have] = '\0';
+		if ((end = strstr(buf, "\r\n\r\n")) != NULL)
+			break;
+		if (have == size - 1)
+			return (-1);
+	}
+	if ((p = strstr(buf, "Content-Length: ")) != NULL && p < end)
+		length = strtol(p + 16, NULL, 10);
+	if (length < 0)
+		return (-1);
+
+	/* the body, which is dropped as it comes in */
+	left = length - (long)(have - (end + 4 - buf));
+	while (left > 0) {
+		n = read(fd, buf, left < (long)size ? (size_t)left : size);
+		if (n <= 0)
+			return (-1);
+		left -= n;
+	}
+	return (length);
+}
+
+/* Returns the MB/s that num_requests requests get, and the peak RSS of
+ * the server in kilobytes in *maxrss. */
+static double
+run_once(void (*cb)(struct evhttp_request *, void *), long *maxrss)
+{
+	static const char request[] =
+	    "GET / HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n";
+	struct sockaddr_in sin;
+	struct timeval start, end;
+	struct rusage usage;
+	char buf[65536];
+	double elapsed, bytes = 0;
+	pid_t pid;
+	int fd, i, status;
+
+	if (evutil_socketpair(AF_UNIX, SOCK_STREAM, 0, ready_pair) == -1 ||
+	    evutil_socketpair(AF_UNIX, SOCK_STREAM, 0, stop_pair) == -1) {
+		perror("socketpair");
+		exit(1);
+	}
+
+	if ((pid = fork()) == -1) {
+		perror("fork");
+		exit(1);
+	}
+	if (pid == 0) {
+		EVUTIL_CLOSESOCKET(stop_pair[0]);
+		server_main(cb);
+	}
+	EVUTIL_CLOSESOCKET(stop_pair[1]);
+	if (read(ready_pair[0], buf, 1) != 1) {
+		fprintf(stderr, "The server did not start\n");
+		exit(1);
+	}
+
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_port = htons(port);
+	sin.sin_addr.s_addr = inet_addr(address);
+	if ((fd = socket(AF_INET, SOCK_STREAM, 0)) == -1 ||
+	    connect(fd, (struct sockaddr *)&sin, sizeof(sin)) == -1) {
+		perror("connect");
+		exit(1);
+	}
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < num_requests; ++i) {
+		long length;
+
+		if (write(fd, request, sizeof(request) - 1) !=
+		    sizeof(request) - 1 ||
+		    (length = client_response(fd, buf, sizeof(buf))) !=
+		    (long)file_size) {
+			fprintf(stderr, "Request %d failed\n", i);
+			exit(1);
+		}
+		bytes += length;
+	}
+	gettimeofday(&end, NULL);
+	EVUTIL_CLOSESOCKET(fd);
+
+	EVUTIL_CLOSESOCKET(stop_pair[0]);
+	if (wait4(pid, &status, 0, &usage) == -1 ||
+	    !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		fprintf(stderr, "The server failed\n");
+		exit(1);
+	}
+	EVUTIL_CLOSESOCKET(ready_pair[0]);
+	EVUTIL_CLOSESOCKET(ready_pair[1]);
+
+	*maxrss = usage.ru_maxrss;
+	evutil_timersub(&end, &start, &end);
+	elapsed = end.tv_sec + end.tv_usec / 1000000.0;
+	return (bytes / elapsed / 1000000);
+}
+
+int
+main(int argc, char **argv)
+{
+	static const struct {
+		const char *name;
+		void (*cb)(struct evhttp_request *, void *);
+	} modes[] = {
+		{ "buffer", http_buffer_cb },
+		{ "file", http_file_cb },
+	};
+	char chunk[65536];
+	size_t written;
+	double rate;
+	long maxrss;
+	int c;
+
+	while ((c = getopt(argc, argv, "s:n:p:")) != -1) {
+		switch (c) {
+		case 's':
+			file_size = (size_t)atoi(optarg) << 20;
+			break;
+		case 'n':
+			num_requests = atoi(optarg);
+			break;
+		case 'p':
+			port = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "Illegal argument \"%c\"\n", c);
+			exit(1);
+		}
+	}
+	if (file_size == 0 || num_requests < 1) {
+		fprintf(stderr, "Arguments must be positive\n");
+		exit(1);
+	}
+
+	if ((file = tmpfile()) == NULL) {
+		perror("tmpfile");
+		exit(1);
+	}
+	for (c = 0; c < (int)sizeof(chunk); ++c)
+		chunk[c] = 'a' + c % 26;
+	for (written = 0; written < file_size; written += sizeof(chunk)) {
+		if (fwrite(chunk, sizeof(chunk), 1, file) != 1) {
+			perror("fwrite");
+			exit(1);
+		}
+	}
+	fflush(file);
+	file_size = written;
+
+	printf("mode\tMB/s\tmax RSS (KB)\n");
+	fflush(stdout);
+	for (c = 0; c < (int)(sizeof(modes) / sizeof(modes[0])); ++c) {
+		rate = run_once(modes[c].cb, &maxrss);
+		printf("%s\t%.0f\t%ld\n", modes[c].name, rate, maxrss);
+		fflush(stdout);
+	}
+
+	fclose(file);
+	return (0);
+}
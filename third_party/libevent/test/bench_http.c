@@ -0,0 +1,322 @@
+/*
+ * Copyright (c) 2016 The Chromium Authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Load generator for evhttp_pool: serves a small page from 1, 2, 4, ...
+ * server threads, each dispatching an event base of its own, and reports
+ * the requests per second that keep-alive clients in a second set of
+ * threads get out of it.
+ *
+ * usage: bench_http [-t max server threads] [-l client threads]
+ *                   [-c connections per client thread] [-d seconds]
+ *                   [-p port]
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/queue.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include <event.h>
+#include <evhttp.h>
+#include <evutil.h>
+
+static const char *address = "127.0.0.1";
+static u_short port = 8080;
+static int num_clients = 2;
+static int num_connections = 8;
+static int seconds = 2;
+
+static struct evbuffer *page;
+
+/* Closing the write end makes every server base leave its loop. */
+static int stop_pair[2];
+
+struct server {
+	pthread_t thread;
+	struct event_base *base;
+	struct event stop_ev;
+};
+
+struct client;
+
+struct connection {
+	struct client *client;
+	struct evhttp_connection *evcon;
+};
+
+struct client {
+	pthread_t thread;
+	struct event_base *base;
+	struct connection *connections;
+	int done;		/* the time is up, do not start new requests */
+	long requests;		/* requests completed */
+	long errors;		/* requests failed */
+};
+
+static void
+http_page_cb(struct evhttp_request *req, void *arg)
+{
+	struct evbuffer *evb = evbuffer_new();
+
+	evbuffer_add(evb, EVBUFFER_DATA(page), EVBUFFER_LENGTH(page));
+	evhttp_add_header(req->output_headers, "Content-Type", "text/plain");
+	evhttp_send_reply(req, HTTP_OK, "OK", evb);
+	evbuffer_free(evb);
+}
+
+static void
+server_stop_cb(int fd, short what, void *arg)
+{
+	struct server *server = arg;
+
+	event_base_loopbreak(server->base);
+}
+
+static void *
+server_main(void *arg)
+{
+	struct server *server = arg;
+
+	event_base_dispatch(server->base);
+	return (NULL);
+}
+
+static void client_request(struct connection *);
+
+static void
+client_done_cb(struct evhttp_request *req, void *arg)
+{
+	struct connection *connection = arg;
+	struct client *client = connection->client;
+
+	if (req == NULL || req->response_code != HTTP_OK) {
+		client->errors++;
+		return;
+	}
+	client->requests++;
+
+	if (!client->done)
+		client_request(connection);
+}
+
+static void
+client_request(struct connection *connection)
+{
+	struct evhttp_request *req;
+
+	req = evhttp_request_new(client_done_cb, connection);
+	evhttp_add_header(req->output_headers, "Host", address);
+	if (evhttp_make_request(connection->evcon, req, EVHTTP_REQ_GET,
+		"/") == -1)
+		connection->client->errors++;
+}
+
+static void
+client_timeout_cb(int fd, short what, void *arg)
+{
+	struct client *client = arg;
+
+	client->done = 1;
+	event_base_loopbreak(client->base);
+}
+
+static void *
+client_main(void *arg)
+{
+	struct client *client = arg;
+	struct event timeout_ev;
+	struct timeval tv;
+	int i;
+
+	for (i = 0; i < num_connections; ++i)
+		client_request(&client->connections[i]);
+
+	evtimer_set(&timeout_ev, client_timeout_cb, client);
+	event_base_set(client->base, &timeout_ev);
+	tv.tv_sec = seconds;
+	tv.tv_usec = 0;
+	evtimer_add(&timeout_ev, &tv);
+
+	event_base_dispatch(client->base);
+	return (NULL);
+}
+
+/* Returns the requests per second that num_servers threads serve. */
+static double
+run_once(int num_servers)
+{
+	struct server *servers;
+	struct client *clients;
+	struct event_base **bases;
+	struct evhttp_pool *pool;
+	struct timeval start, end;
+	long requests = 0, errors = 0;
+	double elapsed;
+	int i, j;
+
+	if (evutil_socketpair(AF_UNIX, SOCK_STREAM, 0, stop_pair) == -1) {
+		perror("socketpair");
+		exit(1);
+	}
+
+	servers = calloc(num_servers, sizeof(struct server));
+	bases = calloc(num_servers, sizeof(struct event_base *));
+	for (i = 0; i < num_servers; ++i) {
+		servers[i].base = bases[i] = event_base_new();
+		event_set(&servers[i].stop_ev, stop_pair[1], EV_READ,
+		    server_stop_cb, &servers[i]);
+		event_base_set(servers[i].base, &servers[i].stop_ev);
+		event_add(&servers[i].stop_ev, NULL);
+	}
+
+	pool = evhttp_pool_new(bases, num_servers);
+	evhttp_pool_set_gencb(pool, http_page_cb, NULL);
+	if (evhttp_pool_bind_socket(pool, address, port) == -1) {
+		fprintf(stderr, "Could not bind to %s:%d\n", address, port);
+		exit(1);
+	}
+
+	clients = calloc(num_clients, sizeof(struct client));
+	for (i = 0; i < num_clients; ++i) {
+		clients[i].base = event_base_new();
+		clients[i].connections = calloc(num_connections,
+		    sizeof(struct connection));
+		for (j = 0; j < num_connections; ++j) {
+			struct connection *connection =
+			    &clients[i].connections[j];
+			connection->client = &clients[i];
+			connection->evcon = evhttp_connection_new(address, port);
+			evhttp_connection_set_base(connection->evcon,
+			    clients[i].base);
+		}
+	}
+
+	for (i = 0; i < num_servers; ++i)
+		pthread_create(&servers[i].thread, NULL, server_main,
+		    &servers[i]);
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < num_clients; ++i)
+		pthread_create(&clients[i].thread, NULL, client_main,
+		    &clients[i]);
+	for (i = 0; i < num_clients; ++i) {
+		pthread_join(clients[i].thread, NULL);
+		requests += clients[i].requests;
+		errors += clients[i].errors;
+	}
+	gettimeofday(&end, NULL);
+
+	EVUTIL_CLOSESOCKET(stop_pair[0]);
+	for (i = 0; i < num_servers; ++i)
+		pthread_join(servers[i].thread, NULL);
+	EVUTIL_CLOSESOCKET(stop_pair[1]);
+
+	for (i = 0; i < num_clients; ++i) {
+		for (j = 0; j < num_connections; ++j)
+			evhttp_connection_free(clients[i].connections[j].evcon);
+		free(clients[i].connections);
+		event_base_free(clients[i].base);
+	}
+	free(clients);
+
+	evhttp_pool_free(pool);
+	for (i = 0; i < num_servers; ++i)
+		event_base_free(bases[i]);
+	free(bases);
+	free(servers);
+
+	if (errors)
+		fprintf(stderr, "%ld requests failed\n", errors);
+
+	evutil_timersub(&end, &start, &end);
+	elapsed = end.tv_sec + end.tv_usec / 1000000.0;
+	return (requests / elapsed);
+}
+
+int
+main(int argc, char **argv)
+{
+	int max_servers = 4;
+	int num_servers, c;
+	double base_rate = 0, rate;
+
+	while ((c = getopt(argc, argv, "t:l:c:d:p:")) != -1) {
+		switch (c) {
+		case 't':
+			max_servers = atoi(optarg);
+			break;
+		case 'l':
+			num_clients = atoi(optarg);
+			break;
+		case 'c':
+			num_connections = atoi(optarg);
+			break;
+		case 'd':
+			seconds = atoi(optarg);
+			break;
+		case 'p':
+			port = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "Illegal argument \"%c\"\n", c);
+			exit(1);
+		}
+	}
+	if (max_servers < 1 || num_clients < 1 || num_connections < 1 ||
+	    seconds < 1) {
+		fprintf(stderr, "Arguments must be positive\n");
+		exit(1);
+	}
+
+	page = evbuffer_new();
+	for (c = 0; c < 16; ++c)
+		evbuffer_add_printf(page, "This is funny. Line %d.\n", c);
+
+	printf("threads\treq/s\tscaling\n");
+	for (num_servers = 1; num_servers <= max_servers; num_servers *= 2) {
+		rate = run_once(num_servers);
+		if (num_servers == 1)
+			base_rate = rate;
+		printf("%d\t%.0f\t%.2fx\n", num_servers, rate,
+		    base_rate > 0 ? rate / base_rate : 0);
+		fflush(stdout);
+	}
+
+	evbuffer_free(page);
+	return (0);
+}
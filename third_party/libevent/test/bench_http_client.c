@@ -0,0 +1,244 @@
+/*
+ * Copyright (c) 2016 The Chromium Authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Sends GET requests to an evhttp server on the loopback interface from
+ * the same event loop, keeping a fixed number of them outstanding: queued
+ * on one connection one at a time, pipelined on one connection, and
+ * spread over a connection pool.  The server may wait before it answers,
+ * as a backend does.  Reports the p50 and p99 latency of a request, from
+ * the moment it is made, and requests per second.
+ *
+ * usage: bench_http_client [-n requests] [-c outstanding requests]
+ *                          [-m pool connections] [-w server wait in us]
+ *                          [-p port]
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <sys/types.h>
+#include <sys/time.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <event.h>
+#include <evhttp.h>
+#include <evutil.h>
+
+static int num_requests = 20000;
+static int outstanding = 16;
+static int pool_connections = 4;
+static struct timeval server_wait;
+static u_short port = 8080;
+
+static struct evbuffer *page;
+
+enum { MODE_SEQUENTIAL, MODE_PIPELINED, MODE_POOLED, NUM_MODES };
+static const char *mode_names[NUM_MODES] = {
+	"sequential", "pipelined", "pooled"
+};
+
+static struct evhttp_connection *evcon;
+static struct evhttp_connection_pool *pool;
+static struct timeval *started;	/* when each request was made */
+static double *latencies;	/* of each request, in us */
+static int issued, done, failed;
+
+static void
+reply_cb(int fd, short what, void *arg)
+{
+	struct evhttp_request *req = arg;
+
+	evhttp_send_reply(req, HTTP_OK, "OK", page);
+}
+
+static void
+server_cb(struct evhttp_request *req, void *arg)
+{
+	if (evutil_timerisset(&server_wait))
+		event_once(-1, EV_TIMEOUT, reply_cb, req, &server_wait);
+	else
+		evhttp_send_reply(req, HTTP_OK, "OK", page);
+}
+
+static void request(void);
+
+static void
+request_done(struct evhttp_request *req, void *arg)
+{
+	int i = (int)(long)arg;
+	struct timeval now;
+
+	if (req == NULL || req->response_code != HTTP_OK)
+		failed++;
+
+	evutil_gettimeofday(&now, NULL);
+	evutil_timersub(&now, &started[i], &now);
+	latencies[i] = now.tv_sec * 1e6 + now.tv_usec;
+
+	if (++done == num_requests)
+		event_loopexit(NULL);
+	else if (issued < num_requests)
+		request();
+}
+
+static void
+request(void)
+{
+	struct evhttp_request *req;
+	int i = issued++;
+
+	req = evhttp_request_new(request_done, (void *)(long)i);
+	evhttp_add_header(req->output_headers, "Host", "localhost");
+	evutil_gettimeofday(&started[i], NULL);
+	if (pool != NULL)
+		evhttp_connection_pool_make_request(pool, req,
+		    EVHTTP_REQ_GET, "/");
+	else
+		evhttp_make_request(evcon, req, EVHTTP_REQ_GET, "/");
+}
+
+static int
+compare_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return (x < y ? -1 : x > y);
+}
+
+static void
+run_once(int mode)
+{
+	struct timeval start, end;
+	double secs;
+	int i;
+
+	if (mode == MODE_POOLED) {
+		pool = evhttp_connection_pool_new(NULL, "127.0.0.1", port,
+		    pool_connections);
+	} else {
+		evcon = evhttp_connection_new("127.0.0.1", port);
+		if (mode == MODE_PIPELINED)
+			evhttp_connection_set_max_pipelined(evcon,
+			    outstanding);
+	}
+
+	issued = done = failed = 0;
+	evutil_gettimeofday(&start, NULL);
+	for (i = 0; i < outstanding && i < num_requests; ++i)
+		request();
+	event_dispatch();
+	evutil_gettimeofday(&end, NULL);
+	if (failed) {
+		fprintf(stderr, "%d of %d requests failed\n", failed,
+		    num_requests);
+		exit(1);
+	}
+
+	if (pool != NULL) {
+		evhttp_connection_pool_free(pool);
+		pool = NULL;
+	} else {
+		evhttp_connection_free(evcon);
+		evcon = NULL;
+	}
+
+	evutil_timersub(&end, &start, &end);
+	secs = end.tv_sec + end.tv_usec / 1000000.0;
+	qsort(latencies, num_requests, sizeof(double), compare_double);
+	printf("%s\t%.0f\t%.0f\t%.0f\n", mode_names[mode],
+	    latencies[num_requests / 2], latencies[num_requests * 99 / 100],
+	    num_requests / secs);
+}
+
+int
+main(int argc, char **argv)
+{
+	struct evhttp *http;
+	int c, i;
+
+	while ((c = getopt(argc, argv, "n:c:m:w:p:")) != -1) {
+		switch (c) {
+		case 'n':
+			num_requests = atoi(optarg);
+			break;
+		case 'c':
+			outstanding = atoi(optarg);
+			break;
+		case 'm':
+			pool_connections = atoi(optarg);
+			break;
+		case 'w':
+			server_wait.tv_sec = atoi(optarg) / 1000000;
+			server_wait.tv_usec = atoi(optarg) % 1000000;
+			break;
+		case 'p':
+			port = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "Illegal argument \"%c\"\n", c);
+			exit(1);
+		}
+	}
+	if (num_requests < 1 || outstanding < 1 || pool_connections < 1) {
+		fprintf(stderr, "Arguments must be positive\n");
+		exit(1);
+	}
+
+	started = calloc(num_requests, sizeof(struct timeval));
+	latencies = calloc(num_requests, sizeof(double));
+	if (started == NULL || latencies == NULL) {
+		perror("calloc");
+		exit(1);
+	}
+
+	event_init();
+
+	page = evbuffer_new();
+	evbuffer_add_printf(page, "<html><body>Hello</body></html>\n");
+
+	http = evhttp_new(NULL);
+	if (evhttp_bind_socket(http, "127.0.0.1", port) == -1) {
+		fprintf(stderr, "Could not bind to port %d\n", port);
+		exit(1);
+	}
+	evhttp_set_gencb(http, server_cb, NULL);
+
+	printf("mode\tp50 us\tp99 us\treq/s\n");
+	for (i = 0; i < NUM_MODES; ++i)
+		run_once(i);
+
+	evhttp_free(http);
+	evbuffer_free(page);
+	free(latencies);
+	free(started);
+	return (0);
+}
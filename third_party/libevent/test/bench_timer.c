@@ -0,0 +1,215 @@
+/*
+ * Copyright (c) 2016 The Chromium Authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Compares the binary heap and the timer wheel of an event base: adds a
+ * population of timers with a few fixed durations, like the idle timeouts
+ * of keep-alive connections, re-arms random ones of them over and over,
+ * deletes them all, and finally has the loop run a population of timers
+ * that are all due.  The work is done from an event callback, where
+ * event_add() reads the cached time as it does in a server.  Reports ns
+ * per operation.
+ *
+ * usage: bench_timer [-n timers] [-r re-arms] [-t tick in us]
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <sys/types.h>
+#include <sys/time.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <event.h>
+#include <evutil.h>
+
+static int num_timers = 100000;
+static int num_rearms = 1000000;
+static struct timeval tick = { 0, 1000 };
+
+/* the idle timeouts in use, in seconds */
+static const int durations[] = { 5, 30, 60, 120 };
+#define NUM_DURATIONS	(int)(sizeof(durations) / sizeof(durations[0]))
+
+static struct event *timers;
+static int *order;		/* timers to re-arm */
+static int *perm;		/* all timers, shuffled */
+static int expired;
+
+enum { OP_ADD, OP_REARM, OP_DEL, OP_EXPIRE, NUM_OPS };
+static const char *op_names[NUM_OPS] = { "add", "re-arm", "del", "expire" };
+
+static double
+ns_since(const struct timeval *start, int ops)
+{
+	struct timeval end;
+
+	evutil_gettimeofday(&end, NULL);
+	evutil_timersub(&end, start, &end);
+	return ((end.tv_sec * 1e9 + end.tv_usec * 1e3) / ops);
+}
+
+static void
+timer_cb(int fd, short what, void *arg)
+{
+	expired++;
+}
+
+/* Adds, re-arms and deletes the timers, with results in arg. */
+static void
+work_cb(int fd, short what, void *arg)
+{
+	double *ns = arg;
+	struct timeval start, tv;
+	int i;
+
+	tv.tv_usec = 0;
+
+	evutil_gettimeofday(&start, NULL);
+	for (i = 0; i < num_timers; ++i) {
+		tv.tv_sec = durations[i % NUM_DURATIONS];
+		evtimer_add(&timers[i], &tv);
+	}
+	ns[OP_ADD] = ns_since(&start, num_timers);
+
+	evutil_gettimeofday(&start, NULL);
+	for (i = 0; i < num_rearms; ++i) {
+		int n = order[i];
+		tv.tv_sec = durations[n % NUM_DURATIONS];
+		evtimer_add(&timers[n], &tv);
+	}
+	ns[OP_REARM] = ns_since(&start, num_rearms);
+
+	evutil_gettimeofday(&start, NULL);
+	for (i = 0; i < num_timers; ++i)
+		evtimer_del(&timers[perm[i]]);
+	ns[OP_DEL] = ns_since(&start, num_timers);
+}
+
+static void
+run_once(int wheel, double *ns)
+{
+	struct event_base *base = event_base_new();
+	struct event work;
+	struct timeval tv, start;
+	int i;
+
+	if (wheel && event_base_set_timer_wheel(base, &tick) == -1) {
+		fprintf(stderr, "Could not use a timer wheel\n");
+		exit(1);
+	}
+
+	for (i = 0; i < num_timers; ++i) {
+		evtimer_set(&timers[i], timer_cb, NULL);
+		event_base_set(base, &timers[i]);
+	}
+
+	evtimer_set(&work, work_cb, ns);
+	event_base_set(base, &work);
+	evutil_timerclear(&tv);
+	evtimer_add(&work, &tv);
+	event_base_dispatch(base);
+
+	/* timers spread over 100ms, all due by the time the loop runs */
+	expired = 0;
+	for (i = 0; i < num_timers; ++i) {
+		tv.tv_sec = 0;
+		tv.tv_usec = perm[i] % 100000;
+		evtimer_add(&timers[i], &tv);
+	}
+	usleep(110000);
+	evutil_gettimeofday(&start, NULL);
+	event_base_dispatch(base);
+	ns[OP_EXPIRE] = ns_since(&start, num_timers);
+	if (expired != num_timers) {
+		fprintf(stderr, "%d of %d timers expired\n", expired,
+		    num_timers);
+		exit(1);
+	}
+
+	event_base_free(base);
+}
+
+int
+main(int argc, char **argv)
+{
+	double heap[NUM_OPS], wheel[NUM_OPS];
+	int c, i;
+
+	while ((c = getopt(argc, argv, "n:r:t:")) != -1) {
+		switch (c) {
+		case 'n':
+			num_timers = atoi(optarg);
+			break;
+		case 'r':
+			num_rearms = atoi(optarg);
+			break;
+		case 't':
+			tick.tv_sec = atoi(optarg) / 1000000;
+			tick.tv_usec = atoi(optarg) % 1000000;
+			break;
+		default:
+			fprintf(stderr, "Illegal argument \"%c\"\n", c);
+			exit(1);
+		}
+	}
+	if (num_timers < 1 || num_rearms < 1 || !evutil_timerisset(&tick)) {
+		fprintf(stderr, "Arguments must be positive\n");
+		exit(1);
+	}
+
+	timers = calloc(num_timers, sizeof(struct event));
+	order = calloc(num_rearms, sizeof(int));
+	perm = calloc(num_timers, sizeof(int));
+	if (timers == NULL || order == NULL || perm == NULL) {
+		perror("calloc");
+		exit(1);
+	}
+	for (i = 0; i < num_rearms; ++i)
+		order[i] = random() % num_timers;
+	for (i = 0; i < num_timers; ++i) {
+		int j = random() % (i + 1);
+		perm[i] = perm[j];
+		perm[j] = i;
+	}
+
+	run_once(0, heap);
+	run_once(1, wheel);
+
+	printf("op\theap ns\twheel ns\n");
+	for (i = 0; i < NUM_OPS; ++i)
+		printf("%s\t%.1f\t%.1f\n", op_names[i], heap[i], wheel[i]);
+
+	free(perm);
+	free(order);
+	free(timers);
+	return (0);
+}
@@ -1002,6 +1002,118 @@ test_loopbreak(void)
 	cleanup_test();
 }
 
+struct test_wheel_event {
+	struct event ev;
+	struct timeval deadline;	/* wall clock time it may fire at */
+	int fired;			/* order in which it fired */
+};
+
+static int test_wheel_fired;
+static struct timeval test_wheel_last;
+
+static void
+test_wheel_cb(int fd, short what, void *arg)
+{
+	struct test_wheel_event *te = arg;
+	struct timeval now, tick = { 0, 1000 };
+
+	evutil_gettimeofday(&now, NULL);
+	/* neither early nor out of order */
+	if (evutil_timercmp(&now, &te->deadline, <))
+		test_ok = 0;
+	evutil_timersub(&test_wheel_last, &tick, &test_wheel_last);
+	if (evutil_timercmp(&te->deadline, &test_wheel_last, <))
+		test_ok = 0;
+	test_wheel_last = te->deadline;
+	te->fired = ++test_wheel_fired;
+}
+
+static void
+test_wheel_add(struct test_wheel_event *te, struct event_base *base,
+    long usec)
+{
+	struct timeval tv, now;
+
+	tv.tv_sec = usec / 1000000;
+	tv.tv_usec = usec % 1000000;
+	evutil_gettimeofday(&now, NULL);
+	evutil_timeradd(&now, &tv, &te->deadline);
+	te->fired = 0;
+	if (event_initialized(&te->ev))
+		evtimer_del(&te->ev);
+	else {
+		evtimer_set(&te->ev, test_wheel_cb, te);
+		event_base_set(base, &te->ev);
+	}
+	evtimer_add(&te->ev, &tv);
+}
+
+static void
+test_timer_wheel(void)
+{
+	struct event_base *base;
+	struct test_wheel_event a, b, c, d, e, many[1000];
+	struct timeval tick = { 0, 10 };
+	int i;
+
+	setup_test("Timer wheel: ");
+
+	test_ok = 1;
+	test_wheel_fired = 0;
+	evutil_timerclear(&test_wheel_last);
+	memset(&a, 0, sizeof(a));
+	memset(&b, 0, sizeof(b));
+	memset(&c, 0, sizeof(c));
+	memset(&d, 0, sizeof(d));
+	memset(&e, 0, sizeof(e));
+	memset(many, 0, sizeof(many));
+
+	/* with 10us ticks, these go into levels 0, 1 and 2 */
+	base = event_base_new();
+	test_wheel_add(&c, base, 200000);
+	if (event_base_set_timer_wheel(base, &tick) == -1)
+		test_ok = 0;
+	test_wheel_add(&a, base, 1000);
+	test_wheel_add(&b, base, 50000);
+	test_wheel_add(&d, base, 24*60*60*1000000L);
+	test_wheel_add(&e, base, 30000);
+	test_wheel_add(&e, base, 120000);
+	evtimer_del(&d.ev);
+
+	event_base_dispatch(base);
+
+	if (a.fired != 1 || b.fired != 2 || e.fired != 3 || c.fired != 4 ||
+	    d.fired != 0)
+		test_ok = 0;
+
+	/* timeouts all over the levels, and back to the heap */
+	test_wheel_fired = 0;
+	evutil_timerclear(&test_wheel_last);
+	for (i = 0; i < 1000; ++i)
+		test_wheel_add(&many[i], base, rand() % 300000);
+	test_wheel_add(&a, base, 250000);
+	event_base_loop(base, EVLOOP_ONCE);
+	if (event_base_set_timer_wheel(base, NULL) == -1)
+		test_ok = 0;
+	event_base_dispatch(base);
+
+	if (test_wheel_fired != 1001 || a.fired == 0)
+		test_ok = 0;
+
+	/* a tick of a million microseconds is out of range */
+	tick.tv_usec = 1000000;
+	if (event_base_set_timer_wheel(base, &tick) != -1)
+		test_ok = 0;
+	tick.tv_usec = 10;
+
+	/* the base frees the timeouts left in the wheel */
+	event_base_set_timer_wheel(base, &tick);
+	test_wheel_add(&d, base, 24*60*60*1000000L);
+	event_base_free(base);
+
+	cleanup_test();
+}
+
 static void
 test_evbuffer(void) {
 
@@ -1074,6 +1186,88 @@ test_evbuffer_find(void)
 	evbuffer_free(buf);
 }
 
+static int chain_cleanups;
+
+static void
+chain_cleanup_cb(const void *data, size_t len, void *arg)
+{
+	chain_cleanups++;
+}
+
+static void
+test_evbuffer_chain(void)
+{
+	struct evbuffer *src = evbuffer_new();
+	struct evbuffer *dst = evbuffer_new();
+	char big[8192];
+	char *line;
+	unsigned int i;
+
+	setup_test("Testing Evbuffer chain: ");
+	chain_cleanups = 0;
+
+	/* a line that spans a copied and a referenced segment */
+	evbuffer_add(src, "hello ", 6);
+	evbuffer_add_reference(src, "world\r\nmore", 11, chain_cleanup_cb,
+	    NULL);
+	line = evbuffer_readline(src);
+	if (line == NULL || strcmp(line, "hello world") != 0)
+		goto out;
+	free(line);
+	if (EVBUFFER_LENGTH(src) != 4)
+		goto out;
+
+	/* a referenced segment that is split is shared by both buffers */
+	if (evbuffer_remove_buffer(src, dst, 2) != 2 ||
+	    EVBUFFER_LENGTH(src) != 2 || EVBUFFER_LENGTH(dst) != 2)
+		goto out;
+	evbuffer_drain(src, 2);
+	if (chain_cleanups != 0 || memcmp(EVBUFFER_DATA(dst), "mo", 2) != 0)
+		goto out;
+	evbuffer_drain(dst, 2);
+	if (chain_cleanups != 1)
+		goto out;
+
+	/* segments move between buffers and go through writev and readv */
+	for (i = 0; i < sizeof(big); ++i)
+		big[i] = 'a' + i % 26;
+	evbuffer_add(src, big, 1000);
+	evbuffer_add_reference(src, big + 1000, sizeof(big) - 1000,
+	    chain_cleanup_cb, NULL);
+	evbuffer_add_buffer(dst, src);
+	if (EVBUFFER_LENGTH(src) != 0 || EVBUFFER_LENGTH(dst) != sizeof(big))
+		goto out;
+	/* EVBUFFER_DATA() shows the first segment, evbuffer_pullup() more */
+	if (memcmp(EVBUFFER_DATA(dst), big, 1000) != 0 ||
+	    memcmp(evbuffer_pullup(dst, 1500), big, 1500) != 0 ||
+	    EVBUFFER_DATA(dst) != evbuffer_pullup(dst, 1500))
+		goto out;
+	while (EVBUFFER_LENGTH(dst) > 0) {
+		if (evbuffer_write(dst, pair[0]) <= 0)
+			goto out;
+		while (evbuffer_read(src, pair[1], -1) > 0)
+			;
+	}
+	if (chain_cleanups != 2 || EVBUFFER_LENGTH(src) != sizeof(big))
+		goto out;
+	/* reads into a buffer without references keep it contiguous */
+	if (memcmp(EVBUFFER_DATA(src), big, sizeof(big)) != 0)
+		goto out;
+
+	/* an owned segment that is split is copied */
+	if (evbuffer_remove_buffer(src, dst, 5000) != 5000 ||
+	    memcmp(EVBUFFER_DATA(dst), big, 5000) != 0 ||
+	    memcmp(EVBUFFER_DATA(src), big + 5000, sizeof(big) - 5000) != 0)
+		goto out;
+
+	test_ok = 1;
+
+ out:
+	evbuffer_free(src);
+	evbuffer_free(dst);
+	cleanup_test();
+}
+
 /*
  * simple bufferevent test
  */
@@ -1640,6 +1834,7 @@ main (int argc, char **argv)
 
 	test_evbuffer();
 	test_evbuffer_find();
+	test_evbuffer_chain();
 	
 	test_bufferevent();
 	test_bufferevent_watermarks();
@@ -1680,6 +1875,8 @@ main (int argc, char **argv)
 	test_loopbreak();
 
 	test_loopexit_multiple();
+
+	test_timer_wheel();
 	
 	test_multiple_events_for_same_fd();
 
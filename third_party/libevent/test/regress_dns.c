@@ -292,16 +292,12 @@ dns_server_gethostbyname_cb(int result, char type, int count, int ttl,
 	}
 }
 
-static void
-dns_server(void)
+/* Adds ourself as the only nameserver and returns the socket to serve on. */
+static int
+dns_server_socket(void)
 {
 	int sock;
 	struct sockaddr_in my_addr;
-	struct evdns_server_port *port;
-	struct in_addr resolve_addr;
-
-	dns_ok = 1;
-	fprintf(stdout, "DNS server support: ");
 
 	/* Add ourself as the only nameserver, and make sure we really are
 	 * the only nameserver. */
@@ -333,6 +329,20 @@ dns_server(void)
 		perror("bind");
 		exit (1);
 	}
+	return (sock);
+}
+
+static void
+dns_server(void)
+{
+	int sock;
+	struct evdns_server_port *port;
+	struct in_addr resolve_addr;
+
+	dns_ok = 1;
+	fprintf(stdout, "DNS server support: ");
+
+	sock = dns_server_socket();
 	port = evdns_add_server_port(sock, 0, dns_server_request_cb, NULL);
 
 	/* Send two queries. */
@@ -362,10 +372,197 @@ dns_server(void)
 #endif
 }
 
+static int n_cache_queries = 0;
+static int n_cache_pending = 0;
+
+struct dns_cache_result {
+	int result;
+	int ttl;
+	ev_uint32_t addr;
+};
+
+static void
+dns_cache_request_cb(struct evdns_server_request *req, void *data)
+{
+	/* an SOA record for example.com with a minimum field of 60s */
+	static const char soa[] =
+	    "\2ns\7example\3com\0" "\4root\7example\3com\0"
+	    "\0\0\0\1" "\0\0\16\20" "\0\0\7\10" "\0\11\72\200" "\0\0\0\74";
+	int i, err = 0;
+
+	for (i = 0; i < req->nquestions; ++i) {
+		const char *name = req->questions[i]->name;
+		ev_uint32_t addr = htonl(0x0a000000UL + ++n_cache_queries);
+
+		if (!strcmp(name, "nx.example.com")) {
+			evdns_server_request_add_reply(req,
+			    EVDNS_AUTHORITY_SECTION, "example.com",
+			    EVDNS_TYPE_SOA, EVDNS_CLASS_INET, 300,
+			    sizeof(soa) - 1, 0, soa);
+			err = DNS_ERR_NOTEXIST;
+		} else {
+			evdns_server_request_add_a_reply(req, name, 1, &addr,
+			    !strcmp(name, "zero.example.com") ? 0 : 100);
+		}
+	}
+	if (evdns_server_request_respond(req, err) < 0) {
+		fprintf(stdout, "Couldn't send reply. ");
+		dns_ok = 0;
+	}
+}
+
+static void
+dns_cache_cb(int result, char type, int count, int ttl,
+    void *addresses, void *arg)
+{
+	struct dns_cache_result *res = arg;
+
+	res->result = result;
+	res->ttl = ttl;
+	res->addr = 0;
+	if (result == DNS_ERR_NONE && type == DNS_IPv4_A && count == 1)
+		res->addr = ((ev_uint32_t *)addresses)[0];
+	if (--n_cache_pending == 0)
+		event_loopexit(NULL);
+}
+
+/* Looks name up n times at once and checks what the n callbacks got. */
+static void
+dns_cache_resolve(const char *name, int n, int queries, int result,
+    int min_ttl, int max_ttl)
+{
+	struct dns_cache_result res[8];
+	const int before = n_cache_queries;
+	int i;
+
+	for (i = 0; i < n; ++i)
+		evdns_resolve_ipv4(name, DNS_QUERY_NO_SEARCH, dns_cache_cb,
+		    &res[i]);
+	/* answers from the cache come from the loop, too */
+	n_cache_pending += n;
+	if (n_cache_pending != n) {
+		fprintf(stdout, "Callback from evdns_resolve_ipv4. ");
+		dns_ok = 0;
+	}
+	event_dispatch();
+
+	if (n_cache_queries != queries) {
+		fprintf(stdout, "%s: %d queries, expected %d. ", name,
+		    n_cache_queries, queries);
+		dns_ok = 0;
+	}
+	for (i = 0; i < n; ++i) {
+		if (res[i].result != result || res[i].ttl < min_ttl ||
+		    res[i].ttl > max_ttl ||
+		    (queries - before <= 1 && res[i].addr != res[0].addr)) {
+			fprintf(stdout, "%s: bad answer %d %d. ", name,
+			    res[i].result, res[i].ttl);
+			dns_ok = 0;
+		}
+	}
+}
+
+static void
+dns_cache(void)
+{
+	struct evdns_cache_stats stats;
+	struct evdns_server_port *port;
+	struct dns_cache_result res[3];
+	char size[32];
+	int sock, i;
+
+	dns_ok = 1;
+	fprintf(stdout, "DNS cache: ");
+
+	sock = dns_server_socket();
+	port = evdns_add_server_port(sock, 0, dns_cache_request_cb, NULL);
+	evdns_set_option("cache-size:", "1048576", DNS_OPTION_MISC);
+
+	/* concurrent lookups share a query, later ones use its answer */
+	dns_cache_resolve("a.example.com", 4, 1, DNS_ERR_NONE, 100, 100);
+	dns_cache_resolve("a.example.com", 2, 1, DNS_ERR_NONE, 98, 100);
+	dns_cache_resolve("A.Example.COM", 1, 1, DNS_ERR_NONE, 98, 100);
+
+	/* NXDOMAIN is cached for the minimum field of the SOA */
+	dns_cache_resolve("nx.example.com", 2, 2, DNS_ERR_NOTEXIST, 60, 60);
+	dns_cache_resolve("nx.example.com", 1, 2, DNS_ERR_NOTEXIST, 58, 60);
+
+	/* a ttl of 0 is not cached */
+	dns_cache_resolve("zero.example.com", 1, 3, DNS_ERR_NONE, 0, 0);
+	dns_cache_resolve("zero.example.com", 1, 4, DNS_ERR_NONE, 0, 0);
+
+	/* with room for two names, the least recently used one goes */
+	evdns_cache_get_stats(&stats);
+	if (stats.entries != 2) {
+		fprintf(stdout, "%lu entries. ", stats.entries);
+		dns_ok = 0;
+	}
+	evutil_snprintf(size, sizeof(size), "%lu", stats.size);
+	evdns_set_option("cache-size:", size, DNS_OPTION_MISC);
+	dns_cache_resolve("b.example.com", 1, 5, DNS_ERR_NONE, 100, 100);
+	dns_cache_resolve("nx.example.com", 1, 5, DNS_ERR_NOTEXIST, 58, 60);
+	dns_cache_resolve("a.example.com", 1, 6, DNS_ERR_NONE, 100, 100);
+
+	evdns_cache_get_stats(&stats);
+	if (stats.hits != 5 || stats.misses != 6 || stats.coalesced != 4 ||
+	    stats.evictions != 2 || stats.entries != 2) {
+		fprintf(stdout, "Bad stats %lu %lu %lu %lu %lu. ", stats.hits,
+		    stats.misses, stats.coalesced, stats.evictions,
+		    stats.entries);
+		dns_ok = 0;
+	}
+	evdns_cache_clear();
+	evdns_cache_get_stats(&stats);
+	if (stats.entries != 0 || stats.size != 0) {
+		fprintf(stdout, "Cache not cleared. ");
+		dns_ok = 0;
+	}
+
+	/* without a cache every lookup is a query */
+	evdns_set_option("cache-size:", "0", DNS_OPTION_MISC);
+	dns_cache_resolve("a.example.com", 2, 8, DNS_ERR_NONE, 100, 100);
+	dns_cache_resolve("a.example.com", 1, 9, DNS_ERR_NONE, 100, 100);
+
+	/* lookups sharing a query in flight fail at shutdown, even when */
+	/* the requests are discarded */
+	evdns_set_option("cache-size:", "1048576", DNS_OPTION_MISC);
+	for (i = 0; i < 3; ++i) {
+		res[i].result = DNS_ERR_NONE;
+		evdns_resolve_ipv4("c.example.com", DNS_QUERY_NO_SEARCH,
+		    dns_cache_cb, &res[i]);
+	}
+	n_cache_pending = 3;
+	evdns_shutdown(0);
+	for (i = 0; i < 3; ++i) {
+		if (res[i].result != DNS_ERR_SHUTDOWN) {
+			fprintf(stdout, "Waiter %d not failed at shutdown. ",
+			    i);
+			dns_ok = 0;
+		}
+	}
+	n_cache_pending = 0;
+	evdns_set_option("cache-size:", "0", DNS_OPTION_MISC);
+
+	if (dns_ok) {
+		fprintf(stdout, "OK\n");
+	} else {
+		fprintf(stdout, "FAILED\n");
+		exit(1);
+	}
+
+	evdns_close_server_port(port);
+#ifdef WIN32
+	closesocket(sock);
+#else
+	close(sock);
+#endif
+}
+
 void
 dns_suite(void)
 {
 	dns_server(); /* Do this before we call evdns_init. */
+	dns_cache();
 
 	evdns_init();
 	dns_gethostbyname();
@@ -71,6 +71,7 @@ static void http_chunked_cb(struct evhttp_request *req, void *arg);
 void http_post_cb(struct evhttp_request *req, void *arg);
 void http_dispatcher_cb(struct evhttp_request *req, void *arg);
 static void http_large_delay_cb(struct evhttp_request *req, void *arg);
+static void http_file_cb(struct evhttp_request *req, void *arg);
 
 static struct evhttp *
 http_setup(short *pport, struct event_base *base)
@@ -96,6 +97,7 @@ http_setup(short *pport, struct event_base *base)
 	evhttp_set_cb(myhttp, "/chunked", http_chunked_cb, NULL);
 	evhttp_set_cb(myhttp, "/postit", http_post_cb, NULL);
 	evhttp_set_cb(myhttp, "/largedelay", http_large_delay_cb, NULL);
+	evhttp_set_cb(myhttp, "/file", http_file_cb, NULL);
 	evhttp_set_cb(myhttp, "/", http_dispatcher_cb, NULL);
 
 	*pport = port;
@@ -1017,6 +1019,149 @@ fail:
 	exit(1);
 }
 
+/*
+ * Lines end where evbuffer_readline() ends them, also when the message is
+ * spread over several segments of the buffer.
+ */
+static int
+http_header_parse_eol_test(void)
+{
+	static const char *pieces[] = {
+	    "GET /eol HTTP/1.0\n\r",
+	    "X-A: 1\n\rX-B: 2\rX-C: 3\r",
+	    "\nX-Long: ",
+	    NULL,	/* a value of more than one segment */
+	    "\r\n\r\n"
+	};
+	struct evhttp_request *req = evhttp_request_new(NULL, NULL);
+	struct evbuffer *buf = evbuffer_new();
+	char value[1000];
+	const char *header;
+	int i, res = -1;
+
+	memset(value, 'x', sizeof(value));
+	for (i = 0; i < (int)(sizeof(pieces) / sizeof(pieces[0])); ++i) {
+		if (pieces[i] != NULL)
+			evbuffer_add_reference(buf, pieces[i],
+			    strlen(pieces[i]), NULL, NULL);
+		else
+			evbuffer_add_reference(buf, value, sizeof(value),
+			    NULL, NULL);
+	}
+
+	req->kind = EVHTTP_REQUEST;
+	if (evhttp_parse_firstline(req, buf) != ALL_DATA_READ ||
+	    evhttp_parse_headers(req, buf) != ALL_DATA_READ ||
+	    EVBUFFER_LENGTH(buf) != 0)
+		goto out;
+	header = evhttp_find_header(req->input_headers, "X-Long");
+	if (strcmp(req->uri, "/eol") != 0 ||
+	    strcmp(evhttp_find_header(req->input_headers, "X-A"), "1") != 0 ||
+	    strcmp(evhttp_find_header(req->input_headers, "X-B"), "2") != 0 ||
+	    strcmp(evhttp_find_header(req->input_headers, "X-C"), "3") != 0 ||
+	    header == NULL || strlen(header) != sizeof(value) ||
+	    header[0] != 'x' || header[sizeof(value) - 1] != 'x')
+		goto out;
+	res = 0;
+
+ out:
+	evhttp_request_free(req);
+	evbuffer_free(buf);
+	return (res);
+}
+
+static void
+http_header_parse_test(void)
+{
+	const char *message =
+	    "GET /index.html HTTP/1.1\r\n"
+	    "Host: somehost\r\n"
+	    "X-Long: a\r\n"
+	    "  b\n"
+	    "Content-Length:  12\r\n"
+	    "Connection: keep-alive\r\n"
+	    "host: other\r\n"
+	    "\r\n";
+	struct evhttp_request *req = evhttp_request_new(NULL, NULL);
+	struct evbuffer *buf = evbuffer_new();
+	struct evkeyval *header;
+	int i, n, res = MORE_DATA_EXPECTED, firstline = 1;
+
+	fprintf(stdout, "Testing HTTP Header parsing: ");
+
+	/* the arena comes with the first byte of the message */
+	if (EVHTTP_REQUEST_ARENA(req) != NULL)
+		goto fail;
+
+	/* the message arrives one byte at a time */
+	req->kind = EVHTTP_REQUEST;
+	for (i = 0; message[i] != '\0'; ++i) {
+		if (res == ALL_DATA_READ)
+			goto fail;
+		evbuffer_add(buf, message + i, 1);
+		if (firstline) {
+			res = evhttp_parse_firstline(req, buf);
+			if (res == ALL_DATA_READ) {
+				firstline = 0;
+				res = MORE_DATA_EXPECTED;
+			}
+		} else {
+			res = evhttp_parse_headers(req, buf);
+		}
+		if (res == DATA_CORRUPTED)
+			goto fail;
+	}
+	if (res != ALL_DATA_READ || EVBUFFER_LENGTH(buf) != 0)
+		goto fail;
+
+	if (strcmp(req->uri, "/index.html") != 0 ||
+	    strcmp(evhttp_request_find_input_header(req, "host"),
+		"somehost") != 0 ||
+	    strcmp(evhttp_request_find_input_header(req, "X-Long"),
+		"a  b") != 0 ||
+	    strcmp(evhttp_request_find_input_header(req, "Content-Length"),
+		"12") != 0 ||
+	    strcmp(evhttp_request_find_input_header(req, "Connection"),
+		"keep-alive") != 0 ||
+	    evhttp_request_find_input_header(req, "Content-Type") != NULL)
+		goto fail;
+
+	/* the parsed headers are in input_headers, too */
+	n = 0;
+	TAILQ_FOREACH(header, req->input_headers, next)
+		n++;
+	if (n != 5 || strcmp(evhttp_find_header(req->input_headers,
+		    "Content-Length"), "12") != 0)
+		goto fail;
+
+	/* changes to input_headers show in the lookups */
+	if (evhttp_remove_header(req->input_headers, "Host") != 0 ||
+	    strcmp(evhttp_request_find_input_header(req, "Host"),
+		"other") != 0)
+		goto fail;
+	evhttp_add_header(req->input_headers, "Content-Type", "text/html");
+	if (evhttp_request_find_input_header(req, "Content-Type") == NULL)
+		goto fail;
+
+	/* parsed and added headers are cleared alike */
+	evhttp_clear_headers(req->input_headers);
+	if (evhttp_request_find_input_header(req, "Connection") != NULL ||
+	    evhttp_add_header(req->input_headers, "X-Bad", "a\r\nb") != -1)
+		goto fail;
+
+	evhttp_request_free(req);
+	evbuffer_free(buf);
+
+	if (http_header_parse_eol_test() == -1)
+		goto fail;
+
+	fprintf(stdout, "OK\n");
+	return;
+fail:
+	fprintf(stdout, "FAILED\n");
+	exit(1);
+}
+
 static int validate_header(
 	const struct evkeyvalq* headers,
 	const char *key, const char *value) 
@@ -1453,11 +1598,398 @@ http_negative_content_length_test(void)
 	fprintf(stdout, "OK\n");
 }
 
+/*
+ * Replies with part of a file.
+ */
+
+#define FILE_SIZE	(1024 * 1024)
+#define FILE_OFFSET	1000
+#define FILE_LENGTH	(FILE_SIZE - 2 * FILE_OFFSET)
+
+static char *file_data;
+static FILE *file;
+
+static void
+http_file_cb(struct evhttp_request *req, void *arg)
+{
+	evhttp_add_header(req->output_headers, "Content-Type",
+	    "application/octet-stream");
+	evhttp_send_reply_file(req, HTTP_OK, "Everything is fine",
+	    dup(fileno(file)), FILE_OFFSET, FILE_LENGTH);
+}
+
+static void
+http_file_done(struct evhttp_request *req, void *arg)
+{
+	if (req->response_code != HTTP_OK ||
+	    EVBUFFER_LENGTH(req->input_buffer) != FILE_LENGTH ||
+	    memcmp(EVBUFFER_DATA(req->input_buffer), file_data + FILE_OFFSET,
+		FILE_LENGTH) != 0) {
+		fprintf(stdout, "FAILED\n");
+		exit(1);
+	}
+
+	if (++test_ok == 2)
+		event_loopexit(NULL);
+}
+
+static void
+http_file_test(void)
+{
+	short port = -1;
+	struct evhttp_connection *evcon = NULL;
+	struct evhttp_request *req = NULL;
+	int i;
+
+	test_ok = 0;
+	fprintf(stdout, "Testing HTTP File Reply: ");
+
+	file_data = malloc(FILE_SIZE);
+	for (i = 0; i < FILE_SIZE; ++i)
+		file_data[i] = i * 7 + i / 1000;
+	if ((file = tmpfile()) == NULL ||
+	    fwrite(file_data, FILE_SIZE, 1, file) != 1 ||
+	    fflush(file) != 0) {
+		fprintf(stdout, "FAILED\n");
+		exit(1);
+	}
+
+	http = http_setup(&port, NULL);
+
+	evcon = evhttp_connection_new("127.0.0.1", port);
+	if (evcon == NULL) {
+		fprintf(stdout, "FAILED\n");
+		exit(1);
+	}
+
+	/* two requests, so that the connection has to survive the first */
+	for (i = 0; i < 2; ++i) {
+		req = evhttp_request_new(http_file_done, NULL);
+		evhttp_add_header(req->output_headers, "Host", "somehost");
+		if (evhttp_make_request(evcon, req, EVHTTP_REQ_GET,
+			"/file") == -1) {
+			fprintf(stdout, "FAILED\n");
+			exit(1);
+		}
+	}
+
+	event_dispatch();
+
+	evhttp_connection_free(evcon);
+	evhttp_free(http);
+	fclose(file);
+	free(file_data);
+
+	if (test_ok != 2) {
+		fprintf(stdout, "FAILED\n");
+		exit(1);
+	}
+
+	fprintf(stdout, "OK\n");
+}
+
+/*
+ * HTTP pipelining and connection pool tests
+ */
+
+static int http_requests_expected;
+
+static void
+http_pipeline_done(struct evhttp_request *req, void *arg)
+{
+	struct evhttp_connection *evcon = arg;
+	const char *what = "This is funny";
+
+	if (req->response_code != HTTP_OK ||
+	    EVBUFFER_LENGTH(req->input_buffer) != strlen(what) ||
+	    memcmp(EVBUFFER_DATA(req->input_buffer), what, strlen(what)) != 0) {
+		fprintf(stdout, "FAILED\n");
+		exit(1);
+	}
+
+	/* all requests were written before the first reply was read */
+	if (evcon != NULL && test_ok == 0 &&
+	    evcon->inflight != http_requests_expected - 1) {
+		fprintf(stdout, "FAILED\n");
+		exit(1);
+	}
+
+	if (++test_ok == http_requests_expected)
+		event_loopexit(NULL);
+}
+
+static void
+http_pipeline_test(void)
+{
+	short port = -1;
+	struct evhttp_connection *evcon = NULL;
+	struct evhttp_request *req = NULL;
+	int i;
+
+	test_ok = 0;
+	fprintf(stdout, "Testing HTTP Pipelining: ");
+
+	http = http_setup(&port, NULL);
+
+	evcon = evhttp_connection_new("127.0.0.1", port);
+	if (evcon == NULL) {
+		fprintf(stdout, "FAILED\n");
+		exit(1);
+	}
+	evhttp_connection_set_max_pipelined(evcon, 4);
+
+	http_requests_expected = 4;
+	for (i = 0; i < http_requests_expected; ++i) {
+		req = evhttp_request_new(http_pipeline_done, evcon);
+		evhttp_add_header(req->output_headers, "Host", "somehost");
+		if (evhttp_make_request(evcon, req, EVHTTP_REQ_GET,
+			"/test") == -1) {
+			fprintf(stdout, "FAILED\n");
+			exit(1);
+		}
+	}
+
+	event_dispatch();
+
+	if (test_ok != http_requests_expected) {
+		fprintf(stdout, "FAILED\n");
+		exit(1);
+	}
+
+	/* a request that closes the connection ends the pipeline */
+	test_ok = 0;
+	http_requests_expected = 3;
+	for (i = 0; i < http_requests_expected; ++i) {
+		req = evhttp_request_new(http_pipeline_done, NULL);
+		evhttp_add_header(req->output_headers, "Host", "somehost");
+		if (i == 1)
+			evhttp_add_header(req->output_headers,
+			    "Connection", "close");
+		if (evhttp_make_request(evcon, req, EVHTTP_REQ_GET,
+			"/test") == -1) {
+			fprintf(stdout, "FAILED\n");
+			exit(1);
+		}
+	}
+
+	if (evcon->inflight != 1) {
+		fprintf(stdout, "FAILED\n");
+		exit(1);
+	}
+
+	event_dispatch();
+
+	evhttp_connection_free(evcon);
+	evhttp_free(http);
+
+	if (test_ok != http_requests_expected) {
+		fprintf(stdout, "FAILED\n");
+		exit(1);
+	}
+
+	fprintf(stdout, "OK\n");
+}
+
+static void
+http_connection_pool_test(int reuse)
+{
+	short port = -1;
+	struct evhttp_connection_pool *pool = NULL;
+	struct evhttp_connection *evcon;
+	struct evhttp_request *req = NULL;
+	int i, n;
+
+	test_ok = 0;
+	fprintf(stdout, "Testing HTTP Connection Pool (%s): ",
+	    reuse == EVHTTP_POOL_REUSE_LIFO ? "lifo" : "fifo");
+
+	http = http_setup(&port, NULL);
+
+	pool = evhttp_connection_pool_new(NULL, "127.0.0.1", port, 2);
+	if (pool == NULL) {
+		fprintf(stdout, "FAILED\n");
+		exit(1);
+	}
+	evhttp_connection_pool_set_reuse(pool, reuse);
+
+	http_requests_expected = 6;
+	for (i = 0; i < http_requests_expected; ++i) {
+		req = evhttp_request_new(http_pipeline_done, NULL);
+		evhttp_add_header(req->output_headers, "Host", "somehost");
+		if (evhttp_connection_pool_make_request(pool, req,
+			EVHTTP_REQ_GET, "/test") == -1) {
+			fprintf(stdout, "FAILED\n");
+			exit(1);
+		}
+	}
+
+	/* two connections, the other requests wait for one of them */
+	n = 0;
+	TAILQ_FOREACH(req, &pool->requests, next)
+		n++;
+	if (pool->nconnections != 2 || n != 4) {
+		fprintf(stdout, "FAILED\n");
+		exit(1);
+	}
+
+	event_dispatch();
+
+	if (test_ok != http_requests_expected) {
+		fprintf(stdout, "FAILED\n");
+		exit(1);
+	}
+
+	/* the server saw no more than two connections */
+	n = 0;
+	TAILQ_FOREACH(evcon, &http->connections, next)
+		n++;
+	if (n != 2) {
+		fprintf(stdout, "FAILED\n");
+		exit(1);
+	}
+
+	/* the next request reuses the idle connection the policy prefers */
+	test_ok = 0;
+	http_requests_expected = 1;
+	evcon = reuse == EVHTTP_POOL_REUSE_LIFO ?
+	    TAILQ_FIRST(&pool->connections) :
+	    TAILQ_LAST(&pool->connections, evconq);
+	req = evhttp_request_new(http_pipeline_done, NULL);
+	evhttp_add_header(req->output_headers, "Host", "somehost");
+	if (evhttp_connection_pool_make_request(pool, req,
+		EVHTTP_REQ_GET, "/test") == -1 || req->evcon != evcon) {
+		fprintf(stdout, "FAILED\n");
+		exit(1);
+	}
+
+	event_dispatch();
+
+	evhttp_connection_pool_free(pool);
+	evhttp_free(http);
+
+	if (test_ok != http_requests_expected) {
+		fprintf(stdout, "FAILED\n");
+		exit(1);
+	}
+
+	fprintf(stdout, "OK\n");
+}
+
+static void
+http_pool_cb(struct evhttp_request *req, void *arg)
+{
+	int *served = arg;
+	struct evbuffer *evb = evbuffer_new();
+
+	++*served;
+	evbuffer_add_printf(evb, "This is funny");
+	evhttp_send_reply(req, HTTP_OK, "Everything is fine", evb);
+	evbuffer_free(evb);
+}
+
+static void
+http_pool_done(struct evhttp_request *req, void *arg)
+{
+	if (req == NULL || req->response_code != HTTP_OK) {
+		fprintf(stdout, "FAILED\n");
+		exit(1);
+	}
+	test_ok++;
+}
+
+static void
+http_pool_test(int acceptor)
+{
+	struct event_base *bases[3];
+	struct evhttp_pool *pool;
+	struct evhttp_connection *evcons[8];
+	struct evhttp_request *req;
+	struct evhttp_bound_socket *bound;
+	struct sockaddr_storage ss;
+	socklen_t sslen = sizeof(ss);
+	struct timeval now, deadline;
+	int served[2] = { 0, 0 };
+	int i, res;
+	u_short port;
+
+	test_ok = 0;
+	fprintf(stdout, "Testing HTTP Server Pool (%s): ",
+	    acceptor ? "acceptor" : "default");
+
+	for (i = 0; i < 3; ++i)
+		bases[i] = event_base_new();
+	pool = evhttp_pool_new(bases, 2);
+	if (pool == NULL) {
+		fprintf(stdout, "FAILED\n");
+		exit(1);
+	}
+	for (i = 0; i < 2; ++i) {
+		evhttp_set_cb(evhttp_pool_get(pool, i), "/test",
+		    http_pool_cb, &served[i]);
+	}
+
+	/* port 0 picks a free port, which all the workers then share */
+	if (acceptor)
+		res = evhttp_pool_bind_acceptor(pool, "127.0.0.1", 0);
+	else
+		res = evhttp_pool_bind_socket(pool, "127.0.0.1", 0);
+	bound = TAILQ_FIRST(&evhttp_pool_get(pool, 0)->sockets);
+	if (res == -1 || bound == NULL ||
+	    getsockname(bound->bind_ev.ev_fd, (struct sockaddr *)&ss,
+		&sslen) == -1) {
+		fprintf(stdout, "FAILED\n");
+		exit(1);
+	}
+	port = ntohs(((struct sockaddr_in *)&ss)->sin_port);
+
+	/* one connection per request, so that they can go to either worker */
+	for (i = 0; i < 8; ++i) {
+		evcons[i] = evhttp_connection_new("127.0.0.1", port);
+		evhttp_connection_set_base(evcons[i], bases[2]);
+		req = evhttp_request_new(http_pool_done, NULL);
+		evhttp_add_header(req->output_headers, "Host", "somehost");
+		if (evhttp_make_request(evcons[i], req,
+			EVHTTP_REQ_GET, "/test") == -1) {
+			fprintf(stdout, "FAILED\n");
+			exit(1);
+		}
+	}
+
+	/* the workers would have threads of their own; here they take turns */
+	gettimeofday(&deadline, NULL);
+	deadline.tv_sec += 10;
+	do {
+		for (i = 0; i < 3; ++i)
+			event_base_loop(bases[i], EVLOOP_NONBLOCK);
+		gettimeofday(&now, NULL);
+	} while (test_ok < 8 && timercmp(&now, &deadline, <));
+
+	for (i = 0; i < 8; ++i)
+		evhttp_connection_free(evcons[i]);
+	evhttp_pool_free(pool);
+	for (i = 0; i < 3; ++i)
+		event_base_free(bases[i]);
+
+	if (test_ok != 8 || served[0] + served[1] != 8) {
+		fprintf(stdout, "FAILED\n");
+		exit(1);
+	}
+
+	/* the acceptor hands the connections out round robin */
+	if (acceptor && (served[0] != 4 || served[1] != 4)) {
+		fprintf(stdout, "FAILED\n");
+		exit(1);
+	}
+
+	fprintf(stdout, "OK\n");
+}
+
 void
 http_suite(void)
 {
 	http_base_test();
 	http_bad_header_test();
+	http_header_parse_test();
 	http_parse_query_test();
 	http_basic_test();
 	http_connection_test(0 /* not-persistent */);
@@ -1473,4 +2005,12 @@ http_suite(void)
 	http_negative_content_length_test();
 
 	http_chunked_test();
+	http_file_test();
+
+	http_pipeline_test();
+	http_connection_pool_test(EVHTTP_POOL_REUSE_LIFO);
+	http_connection_pool_test(EVHTTP_POOL_REUSE_FIFO);
+
+	http_pool_test(0 /* SO_REUSEPORT where available */);
+	http_pool_test(1 /* acceptor */);
 }
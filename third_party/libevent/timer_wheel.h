@@ -0,0 +1,431 @@
+/*
+ * Copyright (c) 2016 The Chromium Authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _TIMER_WHEEL_H_
+#define _TIMER_WHEEL_H_
+
+#include "event.h"
+#include "evutil.h"
+
+/*
+ * A hierarchical timing wheel for the timeouts of an event_base, selected
+ * with event_base_set_timer_wheel().  Time is counted in ticks since
+ * "origin".  Level 0 has a slot for each of the next 256 ticks and each
+ * of the four levels above it has 64 slots, each covering 64 times the
+ * ticks of a slot of the level below.  A timeout goes into the lowest
+ * level whose range reaches it, so adding and deleting one is O(1); when
+ * level 0 wraps around, the next slot of the level above is cascaded
+ * down into it.  Timeouts are rounded up to whole ticks.
+ *
+ * The events of a slot are linked through nodes that the wheel allocates
+ * itself, so that struct event needs no room for the links; an event in
+ * the wheel keeps the index of its node in min_heap_idx.
+ */
+
+#define TIMER_WHEEL_BITS0	8
+#define TIMER_WHEEL_BITS	6
+#define TIMER_WHEEL_LEVELS	5
+#define TIMER_WHEEL_SIZE0	(1 << TIMER_WHEEL_BITS0)
+#define TIMER_WHEEL_SIZE	(1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_SLOTS \
+    (TIMER_WHEEL_SIZE0 + (TIMER_WHEEL_LEVELS - 1) * TIMER_WHEEL_SIZE)
+/* Timeouts further out than this many ticks come back early and are
+ * put back into the wheel. */
+#define TIMER_WHEEL_MAX_TICKS \
+    ((ev_uint64_t)1 << (TIMER_WHEEL_BITS0 + \
+        (TIMER_WHEEL_LEVELS - 1) * TIMER_WHEEL_BITS))
+/* The end of a list of nodes. */
+#define TIMER_WHEEL_NIL		((unsigned)-1)
+
+/* A slot is a list of nodes in the order they were added; the prev of its
+ * first node is its last one. */
+struct timer_wheel_node
+{
+    struct event* ev;
+    unsigned slot;
+    unsigned next, prev;
+};
+
+typedef struct timer_wheel
+{
+    unsigned slots[TIMER_WHEEL_SLOTS];  /* first node of each slot */
+    struct timer_wheel_node* nodes;
+    unsigned a;                 /* nodes allocated */
+    unsigned spare;             /* first unused node */
+    unsigned count[TIMER_WHEEL_LEVELS];  /* events per level */
+    unsigned n;                 /* events in all levels */
+    ev_uint64_t current;        /* the next tick to run */
+    int running;                /* level 0 slot of the tick being run, or -1 */
+    struct timeval origin;      /* the time of tick 0 */
+    ev_uint64_t tick;           /* microseconds per tick */
+} timer_wheel_t;
+
+static inline timer_wheel_t* timer_wheel_new(const struct timeval* tick, const struct timeval* now);
+static inline void           timer_wheel_free(timer_wheel_t* w);
+static inline int            timer_wheel_empty(timer_wheel_t* w);
+static inline unsigned       timer_wheel_size(timer_wheel_t* w);
+static inline int            timer_wheel_reserve(timer_wheel_t* w, unsigned n);
+static inline struct event*  timer_wheel_first(timer_wheel_t* w, unsigned slot);
+static inline int            timer_wheel_insert(timer_wheel_t* w, struct event* e);
+static inline void           timer_wheel_erase(timer_wheel_t* w, struct event* e);
+static inline int            timer_wheel_next(timer_wheel_t* w, struct timeval* tv);
+static inline struct event*  timer_wheel_expired(timer_wheel_t* w, const struct timeval* now);
+static inline void           timer_wheel_shift(timer_wheel_t* w, const struct timeval* off);
+static inline unsigned       timer_wheel_level_(unsigned slot);
+static inline unsigned       timer_wheel_shift_(unsigned level);
+static inline unsigned       timer_wheel_base_(unsigned level);
+static inline ev_uint64_t    timer_wheel_ticks_(timer_wheel_t* w, const struct timeval* tv, int round_up);
+static inline void           timer_wheel_link_(timer_wheel_t* w, unsigned node);
+static inline void           timer_wheel_unlink_(timer_wheel_t* w, unsigned node);
+static inline void           timer_wheel_cascade_(timer_wheel_t* w, unsigned level, unsigned index);
+static inline void           timer_wheel_skip_(timer_wheel_t* w, ev_uint64_t now_tick);
+
+unsigned timer_wheel_level_(unsigned slot)
+{
+    return slot < TIMER_WHEEL_SIZE0 ? 0 :
+        1 + (slot - TIMER_WHEEL_SIZE0) / TIMER_WHEEL_SIZE;
+}
+
+/* The bit position of the slot index in a tick number on level. */
+unsigned timer_wheel_shift_(unsigned level)
+{
+    return level == 0 ? 0 :
+        TIMER_WHEEL_BITS0 + (level - 1) * TIMER_WHEEL_BITS;
+}
+
+/* The first slot of level. */
+unsigned timer_wheel_base_(unsigned level)
+{
+    return level == 0 ? 0 :
+        TIMER_WHEEL_SIZE0 + (level - 1) * TIMER_WHEEL_SIZE;
+}
+
+timer_wheel_t* timer_wheel_new(const struct timeval* tick, const struct timeval* now)
+{
+    timer_wheel_t* w;
+    unsigned i;
+
+    if(!(w = (timer_wheel_t*)calloc(1, sizeof *w)))
+        return 0;
+    for(i = 0; i < TIMER_WHEEL_SLOTS; ++i)
+        w->slots[i] = TIMER_WHEEL_NIL;
+    w->spare = TIMER_WHEEL_NIL;
+    w->running = -1;
+    w->origin = *now;
+    w->tick = (ev_uint64_t)tick->tv_sec * 1000000 + tick->tv_usec;
+    return w;
+}
+
+void timer_wheel_free(timer_wheel_t* w)
+{
+    if(w)
+        free(w->nodes);
+    free(w);
+}
+
+int timer_wheel_empty(timer_wheel_t* w) { return 0u == w->n; }
+unsigned timer_wheel_size(timer_wheel_t* w) { return w->n; }
+
+/* Makes room for n events, so that inserting them cannot fail. */
+int timer_wheel_reserve(timer_wheel_t* w, unsigned n)
+{
+    if(w->a < n)
+    {
+        struct timer_wheel_node* p;
+        unsigned a = w->a ? w->a * 2 : 8;
+        if(a < n)
+            a = n;
+        if(!(p = (struct timer_wheel_node*)realloc(w->nodes, a * sizeof *p)))
+            return -1;
+        w->nodes = p;
+        /* the new nodes go onto the free list */
+        while(w->a < a)
+        {
+            p[w->a].next = w->spare;
+            w->spare = w->a++;
+        }
+    }
+    return 0;
+}
+
+/* The first event of a slot, or 0 if it is empty. */
+struct event* timer_wheel_first(timer_wheel_t* w, unsigned slot)
+{
+    unsigned node = w->slots[slot];
+    return node == TIMER_WHEEL_NIL ? 0 : w->nodes[node].ev;
+}
+
+/* The tick that tv falls into, or the first one that starts at or after
+ * tv if round_up is set. */
+ev_uint64_t timer_wheel_ticks_(timer_wheel_t* w, const struct timeval* tv, int round_up)
+{
+    ev_uint64_t usec;
+
+    if(evutil_timercmp(tv, &w->origin, <))
+        return 0;
+    usec = (ev_uint64_t)(tv->tv_sec - w->origin.tv_sec) * 1000000 +
+        tv->tv_usec - w->origin.tv_usec;
+    return round_up ? (usec + w->tick - 1) / w->tick : usec / w->tick;
+}
+
+void timer_wheel_link_(timer_wheel_t* w, unsigned node)
+{
+    struct timer_wheel_node* n = &w->nodes[node];
+    struct event* e = n->ev;
+    ev_uint64_t expires = timer_wheel_ticks_(w, &e->ev_timeout, 1);
+    ev_uint64_t delta;
+    unsigned level, slot;
+
+    if(expires < w->current)
+    {
+        /* already expired: run it with the next tick */
+        level = 0;
+        slot = (unsigned)w->current & (TIMER_WHEEL_SIZE0 - 1);
+    }
+    else
+    {
+        delta = expires - w->current;
+        if(delta >= TIMER_WHEEL_MAX_TICKS)
+            expires = w->current + TIMER_WHEEL_MAX_TICKS - 1;
+        for(level = 0; level < TIMER_WHEEL_LEVELS - 1; ++level)
+            if(delta < (ev_uint64_t)1 << timer_wheel_shift_(level + 1))
+                break;
+        slot = timer_wheel_base_(level) +
+            ((unsigned)(expires >> timer_wheel_shift_(level)) &
+             (level ? TIMER_WHEEL_SIZE - 1 : TIMER_WHEEL_SIZE0 - 1));
+    }
+    n->slot = slot;
+    n->next = TIMER_WHEEL_NIL;
+    if(w->slots[slot] == TIMER_WHEEL_NIL)
+    {
+        n->prev = node;
+        w->slots[slot] = node;
+    }
+    else
+    {
+        struct timer_wheel_node* first = &w->nodes[w->slots[slot]];
+        n->prev = first->prev;
+        w->nodes[first->prev].next = node;
+        first->prev = node;
+    }
+    w->count[level]++;
+}
+
+void timer_wheel_unlink_(timer_wheel_t* w, unsigned node)
+{
+    struct timer_wheel_node* n = &w->nodes[node];
+    unsigned* first = &w->slots[n->slot];
+
+    if(*first == node)
+        *first = n->next;
+    else
+        w->nodes[n->prev].next = n->next;
+    if(n->next != TIMER_WHEEL_NIL)
+        w->nodes[n->next].prev = n->prev;
+    else if(*first != TIMER_WHEEL_NIL)
+        w->nodes[*first].prev = n->prev;
+    w->count[timer_wheel_level_(n->slot)]--;
+}
+
+int timer_wheel_insert(timer_wheel_t* w, struct event* e)
+{
+    unsigned node;
+
+    if(timer_wheel_reserve(w, w->n + 1))
+        return -1;
+    node = w->spare;
+    w->spare = w->nodes[node].next;
+    w->nodes[node].ev = e;
+    e->min_heap_idx = node;
+    timer_wheel_link_(w, node);
+    w->n++;
+    return 0;
+}
+
+void timer_wheel_erase(timer_wheel_t* w, struct event* e)
+{
+    unsigned node = e->min_heap_idx;
+
+    if(((unsigned int)-1) != node)
+    {
+        timer_wheel_unlink_(w, node);
+        w->nodes[node].next = w->spare;
+        w->spare = node;
+        w->n--;
+        e->min_heap_idx = -1;
+    }
+}
+
+/* Moves the events of a slot on level down to the levels below it. */
+void timer_wheel_cascade_(timer_wheel_t* w, unsigned level, unsigned index)
+{
+    unsigned* slot = &w->slots[timer_wheel_base_(level) + index];
+    unsigned node;
+
+    while((node = *slot) != TIMER_WHEEL_NIL)
+    {
+        timer_wheel_unlink_(w, node);
+        timer_wheel_link_(w, node);
+    }
+}
+
+/* Skips ahead over ticks that have nothing to run or cascade, so that a
+ * long idle period does not cost a pass over every tick in it. */
+void timer_wheel_skip_(timer_wheel_t* w, ev_uint64_t now_tick)
+{
+    ev_uint64_t mask, next;
+    unsigned level;
+
+    if(w->count[0])
+        return;
+    for(level = 1; level < TIMER_WHEEL_LEVELS; ++level)
+        if(w->count[level])
+            break;
+    if(level == TIMER_WHEEL_LEVELS)
+    {
+        w->current = now_tick + 1;
+        return;
+    }
+    /* the next tick at which a slot of level is cascaded */
+    mask = ((ev_uint64_t)1 << timer_wheel_shift_(level)) - 1;
+    next = (w->current + mask) & ~mask;
+    w->current = next < now_tick + 1 ? next : now_tick + 1;
+}
+
+/* Returns an event whose timeout has passed at now, or 0 when there is
+ * none left.  The caller must erase it before asking for the next one. */
+struct event* timer_wheel_expired(timer_wheel_t* w, const struct timeval* now)
+{
+    ev_uint64_t now_tick = timer_wheel_ticks_(w, now, 0);
+    struct event* e;
+    unsigned node, index, level;
+
+    for(;;)
+    {
+        if(w->running != -1)
+        {
+            if((node = w->slots[w->running]) != TIMER_WHEEL_NIL)
+            {
+                e = w->nodes[node].ev;
+                if(!evutil_timercmp(&e->ev_timeout, now, >))
+                    return e;
+                /* beyond TIMER_WHEEL_MAX_TICKS: put it back */
+                timer_wheel_unlink_(w, node);
+                timer_wheel_link_(w, node);
+                continue;
+            }
+            w->running = -1;
+        }
+        if(w->current > now_tick)
+            return 0;
+        timer_wheel_skip_(w, now_tick);
+        if(w->current > now_tick)
+            return 0;
+        index = (unsigned)w->current & (TIMER_WHEEL_SIZE0 - 1);
+        for(level = 1; !index && level < TIMER_WHEEL_LEVELS; ++level)
+        {
+            index = (unsigned)(w->current >> timer_wheel_shift_(level)) &
+                (TIMER_WHEEL_SIZE - 1);
+            timer_wheel_cascade_(w, level, index);
+        }
+        w->running = (unsigned)w->current & (TIMER_WHEEL_SIZE0 - 1);
+        w->current++;
+    }
+}
+
+/* Sets tv to a time at or before the earliest timeout in the wheel, which
+ * may be in the past.  Returns -1 if the wheel is empty. */
+int timer_wheel_next(timer_wheel_t* w, struct timeval* tv)
+{
+    ev_uint64_t best = (ev_uint64_t)-1, first, t, usec;
+    unsigned level, shift, i;
+
+    if(!w->n)
+        return -1;
+    if(w->running != -1 && w->slots[w->running] != TIMER_WHEEL_NIL)
+        best = w->current - 1;
+    else if(w->count[0])
+    {
+        /* level 0 holds the timeouts of the next TIMER_WHEEL_SIZE0 ticks */
+        for(i = 0; i < TIMER_WHEEL_SIZE0; ++i)
+        {
+            t = w->current + i;
+            if(w->slots[t & (TIMER_WHEEL_SIZE0 - 1)] != TIMER_WHEEL_NIL)
+            {
+                best = t;
+                break;
+            }
+        }
+    }
+    /* the timeouts of a higher level are no earlier than the tick at
+     * which their slot is cascaded */
+    for(level = 1; level < TIMER_WHEEL_LEVELS; ++level)
+    {
+        if(!w->count[level])
+            continue;
+        shift = timer_wheel_shift_(level);
+        first = (w->current + ((ev_uint64_t)1 << shift) - 1) >> shift;
+        for(i = 0; i < TIMER_WHEEL_SIZE; ++i)
+        {
+            t = (first + i) << shift;
+            if(t >= best)
+                break;
+            if(w->slots[timer_wheel_base_(level) +
+                ((unsigned)(first + i) & (TIMER_WHEEL_SIZE - 1))] != TIMER_WHEEL_NIL)
+            {
+                best = t;
+                break;
+            }
+        }
+    }
+    usec = best * w->tick;
+    tv->tv_sec = w->origin.tv_sec + (long)(usec / 1000000);
+    tv->tv_usec = w->origin.tv_usec + (long)(usec % 1000000);
+    if(tv->tv_usec >= 1000000)
+    {
+        tv->tv_sec++;
+        tv->tv_usec -= 1000000;
+    }
+    return 0;
+}
+
+/* Moves the timeouts and the origin of the wheel back by off. */
+void timer_wheel_shift(timer_wheel_t* w, const struct timeval* off)
+{
+    struct event* e;
+    unsigned i, node;
+
+    for(i = 0; i < TIMER_WHEEL_SLOTS; ++i)
+        for(node = w->slots[i]; node != TIMER_WHEEL_NIL;
+            node = w->nodes[node].next)
+        {
+            e = w->nodes[node].ev;
+            evutil_timersub(&e->ev_timeout, off, &e->ev_timeout);
+        }
+    evutil_timersub(&w->origin, off, &w->origin);
+}
+
+#endif /* _TIMER_WHEEL_H_ */
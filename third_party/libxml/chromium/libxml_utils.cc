@@ -4,8 +4,439 @@
 
 #include "libxml_utils.h"
 
+#include <ctype.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#if defined(LIBXML_UTILS_PARALLEL_RECORDS)
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#include "libxml/dict.h"
+#include "libxml/parser.h"
 #include "libxml/xmlreader.h"
 
+namespace {
+
+const int kParseOptions = XML_PARSE_RECOVER |  // recover on errors
+                          XML_PARSE_NONET;     // forbid network access
+
+#if defined(LIBXML_UTILS_PARALLEL_RECORDS)
+// The size past which a run of records is cut at the next record boundary.
+// Runs this large keep the per-run setup of the parsers and the reader down
+// while leaving enough runs to keep the threads busy.
+const size_t kRecordRunSize = 64 * 1024;
+
+// The number of parsed runs allowed ahead of the reader, per thread.
+const size_t kRunsAheadPerThread = 4;
+
+// The layout of a document found by ScanRecords(): the bytes of |input| up
+// to the end of the root start tag, the children of the root cut into runs
+// of whole records, and the root end tag with the rest of the document.
+struct RecordLayout {
+  size_t root_start;        // offset of the '<' of the root start tag
+  size_t root_start_end;    // offset just past the root start tag
+  size_t root_end;          // offset of the '<' of the root end tag
+  std::string root_name;    // the qualified name of the root element
+  std::vector<size_t> cuts; // offsets of the starts of the runs but the first
+};
+
+bool IsXmlSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+// Returns the offset just past the first |pattern| at or after |pos|, or
+// std::string::npos.
+size_t SkipPast(const std::string& input, size_t pos, const char* pattern) {
+  size_t found = input.find(pattern, pos);
+  if (found == std::string::npos)
+    return found;
+  return found + strlen(pattern);
+}
+
+// Returns the offset just past the tag starting at |pos|, skipping '>' in
+// quoted attribute values, or std::string::npos.  Sets |empty| if the tag
+// ends with "/>".
+size_t SkipTag(const std::string& input, size_t pos, bool* empty) {
+  const char* data = input.data();
+  size_t size = input.size();
+  char quote = 0;
+
+  for (; pos < size; ++pos) {
+    char c = data[pos];
+    if (quote) {
+      if (c == quote)
+        quote = 0;
+    } else if (c == '"' || c == '\'') {
+      quote = c;
+    } else if (c == '>') {
+      *empty = data[pos - 1] == '/';
+      return pos + 1;
+    }
+  }
+  return std::string::npos;
+}
+
+// Returns true if the XML declaration from |begin| to |end| declares no
+// encoding or UTF-8.
+bool IsUtf8Declaration(const std::string& input, size_t begin, size_t end) {
+  size_t pos = input.find("encoding", begin);
+  if (pos == std::string::npos || pos >= end)
+    return true;
+  pos = input.find_first_of("\"'", pos);
+  if (pos == std::string::npos || pos >= end)
+    return false;
+  size_t close = input.find(input[pos], pos + 1);
+  if (close == std::string::npos || close >= end)
+    return false;
+  std::string encoding = input.substr(pos + 1, close - pos - 1);
+  std::transform(encoding.begin(), encoding.end(), encoding.begin(), ::toupper);
+  return encoding == "UTF-8" || encoding == "UTF8";
+}
+
+// Scans |input| for the children of the root element, cutting them into runs
+// of about kRecordRunSize bytes at the ends of child elements, without
+// parsing any of it.  Returns false if the document cannot be split safely:
+// a DOCTYPE may declare entities and default attributes the runs would miss,
+// only UTF-8 is handled, and anything the scan does not expect is left to
+// the parser to report.
+bool ScanRecords(const std::string& input, RecordLayout* layout) {
+  const char* data = input.data();
+  size_t size = input.size();
+  size_t pos = 0;
+  bool empty = false;
+
+  if (size >= 3 && memcmp(data, "\xEF\xBB\xBF", 3) == 0)
+    pos = 3;
+
+  // The prolog.
+  for (;;) {
+    while (pos < size && IsXmlSpace(data[pos]))
+      ++pos;
+    if (pos >= size || data[pos] != '<')
+      return false;
+    if (input.compare(pos, 5, "<?xml") == 0 && pos + 5 < size &&
+        IsXmlSpace(data[pos + 5])) {
+      size_t begin = pos;
+      pos = SkipPast(input, pos, "?>");
+      if (pos == std::string::npos || !IsUtf8Declaration(input, begin, pos))
+        return false;
+    } else if (input.compare(pos, 2, "<?") == 0) {
+      pos = SkipPast(input, pos, "?>");
+    } else if (input.compare(pos, 4, "<!--") == 0) {
+      pos = SkipPast(input, pos + 4, "-->");
+    } else if (input.compare(pos, 2, "<!") == 0) {
+      return false;
+    } else {
+      break;
+    }
+    if (pos == std::string::npos)
+      return false;
+  }
+
+  layout->root_start = pos;
+  size_t name_end = pos + 1;
+  while (name_end < size && !IsXmlSpace(data[name_end]) &&
+         data[name_end] != '/' && data[name_end] != '>')
+    ++name_end;
+  layout->root_name.assign(data + pos + 1, name_end - pos - 1);
+  pos = SkipTag(input, pos, &empty);
+  if (pos == std::string::npos || empty || layout->root_name.empty())
+    return false;
+  layout->root_start_end = pos;
+  layout->cuts.clear();
+
+  // The content of the root, at |depth| below it.
+  size_t run_start = pos;
+  int depth = 0;
+  for (;;) {
+    const void* found = memchr(data + pos, '<', size - pos);
+    if (!found)
+      return false;
+    pos = static_cast<const char*>(found) - data;
+    bool record_end = false;
+    if (input.compare(pos, 4, "<!--") == 0) {
+      pos = SkipPast(input, pos + 4, "-->");
+    } else if (input.compare(pos, 9, "<![CDATA[") == 0) {
+      pos = SkipPast(input, pos + 9, "]]>");
+    } else if (input.compare(pos, 2, "<?") == 0) {
+      pos = SkipPast(input, pos, "?>");
+    } else if (input.compare(pos, 2, "<!") == 0) {
+      return false;
+    } else if (input.compare(pos, 2, "</") == 0) {
+      if (depth == 0)
+        break;
+      pos = SkipTag(input, pos, &empty);
+      record_end = --depth == 0;
+    } else {
+      pos = SkipTag(input, pos, &empty);
+      if (empty)
+        record_end = depth == 0;
+      else
+        ++depth;
+    }
+    if (pos == std::string::npos)
+      return false;
+    if (record_end && pos - run_start >= kRecordRunSize) {
+      layout->cuts.push_back(pos);
+      run_start = pos;
+    }
+  }
+
+  // The root end tag, which must match for the runs to be closed the same.
+  layout->root_end = pos;
+  pos += 2;
+  if (input.compare(pos, layout->root_name.size(), layout->root_name) != 0)
+    return false;
+  pos += layout->root_name.size();
+  while (pos < size && IsXmlSpace(data[pos]))
+    ++pos;
+  if (pos >= size || data[pos] != '>')
+    return false;
+
+  // A cut with only the end of the root after it would leave an empty run.
+  if (!layout->cuts.empty() && layout->cuts.back() == layout->root_end)
+    layout->cuts.pop_back();
+  return !layout->cuts.empty();
+}
+#endif  // defined(LIBXML_UTILS_PARALLEL_RECORDS)
+
+}  // namespace
+
+#if defined(LIBXML_UTILS_PARALLEL_RECORDS)
+
+// XmlRecordStream parses the runs of records of a document split by
+// ScanRecords() on a pool of threads, each run as a document of its own
+// made of the root start tag, the run and the root end tag, so that the
+// records see the namespaces and attributes of the root.  The first run
+// also carries the prolog and the last one the epilog.  All the parser
+// contexts intern their names in one concurrent dictionary, and the trees
+// are allocated from arenas since the reader only walks and frees them.
+// The threads keep their errors and warnings to themselves: a run that had
+// any is parsed again by Take(), so that they reach the handlers of the
+// reader's thread, in document order.
+class XmlRecordStream {
+ public:
+  XmlRecordStream(const std::string& input, const RecordLayout& layout);
+  ~XmlRecordStream();
+
+  // Starts |num_threads| threads parsing the runs.  Returns false on error or
+  // if no thread could be started.
+  bool Start(int num_threads);
+
+  size_t size() const { return layout_.cuts.size() + 1; }
+
+  // Frees the tree of the previous run and returns the tree of run |index|,
+  // waiting for it to be parsed, or NULL on error.  The runs must be taken
+  // in order.
+  xmlDocPtr Take(size_t index);
+
+ private:
+  enum RunState {
+    RUN_PENDING,  // not parsed yet
+    RUN_PARSED,   // parsed into |docs_|
+    RUN_NOISY,    // to be parsed again by Take() for its messages
+  };
+
+  // The thread main function, parsing runs until there are none left.
+  static void* ThreadMain(void* arg);
+  void ParseRuns();
+
+  // The error handler of the threads, noting that there was a message.
+  static void NoteMessage(void* ctx, const char* msg, ...);
+
+  // Parses run |index| with |ctxt|.  Returns NULL if it is not well-formed.
+  xmlDocPtr Parse(xmlParserCtxtPtr ctxt, size_t index);
+
+  // Returns a parser context interning its names in |dict_|.
+  xmlParserCtxtPtr NewContext();
+
+  const std::string& input_;
+  const RecordLayout layout_;
+  xmlDictPtr dict_;
+  std::vector<xmlDocPtr> docs_;
+  std::vector<RunState> states_;
+  xmlDocPtr current_;
+  xmlParserCtxtPtr ctxt_;  // the context of Take()
+
+  pthread_mutex_t lock_;
+  pthread_cond_t cond_;    // signaled when a run is parsed or taken
+  std::vector<pthread_t> threads_;
+  size_t next_;            // the next run to parse
+  size_t taken_;           // the number of runs taken
+  size_t ahead_;           // the number of runs parsed ahead of Take()
+  bool stop_;
+};
+
+XmlRecordStream::XmlRecordStream(const std::string& input,
+                                 const RecordLayout& layout)
+    : input_(input),
+      layout_(layout),
+      dict_(NULL),
+      docs_(size(), NULL),
+      states_(size(), RUN_PENDING),
+      current_(NULL),
+      ctxt_(NULL),
+      next_(0),
+      taken_(0),
+      ahead_(0),
+      stop_(false) {
+  pthread_mutex_init(&lock_, NULL);
+  pthread_cond_init(&cond_, NULL);
+}
+
+XmlRecordStream::~XmlRecordStream() {
+  pthread_mutex_lock(&lock_);
+  stop_ = true;
+  pthread_cond_broadcast(&cond_);
+  pthread_mutex_unlock(&lock_);
+  for (size_t i = 0; i < threads_.size(); ++i)
+    pthread_join(threads_[i], NULL);
+  pthread_cond_destroy(&cond_);
+  pthread_mutex_destroy(&lock_);
+  for (size_t i = 0; i < docs_.size(); ++i) {
+    if (docs_[i])
+      xmlFreeDoc(docs_[i]);
+  }
+  if (current_)
+    xmlFreeDoc(current_);
+  if (ctxt_)
+    xmlFreeParserCtxt(ctxt_);
+  if (dict_)
+    xmlDictFree(dict_);
+}
+
+bool XmlRecordStream::Start(int num_threads) {
+  dict_ = xmlDictCreateConcurrent();
+  if (!dict_)
+    return false;
+  if (num_threads <= 0)
+    num_threads = static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+  num_threads = std::max(1, std::min(num_threads, static_cast<int>(size())));
+  ahead_ = num_threads * kRunsAheadPerThread;
+  for (int i = 0; i < num_threads; ++i) {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, &XmlRecordStream::ThreadMain, this) != 0)
+      break;
+    threads_.push_back(thread);
+  }
+  // Parsing the runs on the reader's thread alone would be Load() with the
+  // overhead of the runs.
+  if (threads_.empty())
+    return false;
+  ctxt_ = NewContext();
+  return ctxt_ != NULL;
+}
+
+xmlDocPtr XmlRecordStream::Take(size_t index) {
+  if (current_) {
+    xmlFreeDoc(current_);
+    current_ = NULL;
+  }
+  if (index >= size())
+    return NULL;
+  pthread_mutex_lock(&lock_);
+  taken_ = index + 1;
+  pthread_cond_broadcast(&cond_);
+  while (states_[index] == RUN_PENDING)
+    pthread_cond_wait(&cond_, &lock_);
+  pthread_mutex_unlock(&lock_);
+  if (states_[index] != RUN_PARSED) {
+    docs_[index] = Parse(ctxt_, index);
+    states_[index] = RUN_PARSED;
+  }
+  current_ = docs_[index];
+  docs_[index] = NULL;
+  return current_;
+}
+
+void* XmlRecordStream::ThreadMain(void* arg) {
+  static_cast<XmlRecordStream*>(arg)->ParseRuns();
+  return NULL;
+}
+
+void XmlRecordStream::ParseRuns() {
+  xmlParserCtxtPtr ctxt = NewContext();
+  bool noisy = false;
+
+  xmlSetGenericErrorFunc(&noisy, &XmlRecordStream::NoteMessage);
+  pthread_mutex_lock(&lock_);
+  while (!stop_ && next_ < size()) {
+    if (next_ >= taken_ + ahead_) {
+      pthread_cond_wait(&cond_, &lock_);
+      continue;
+    }
+    size_t index = next_++;
+    pthread_mutex_unlock(&lock_);
+    noisy = !ctxt;
+    xmlDocPtr doc = ctxt ? Parse(ctxt, index) : NULL;
+    if (noisy && doc) {
+      xmlFreeDoc(doc);
+      doc = NULL;
+    }
+    pthread_mutex_lock(&lock_);
+    docs_[index] = doc;
+    states_[index] = noisy ? RUN_NOISY : RUN_PARSED;
+    pthread_cond_broadcast(&cond_);
+  }
+  pthread_mutex_unlock(&lock_);
+
+  if (ctxt)
+    xmlFreeParserCtxt(ctxt);
+}
+
+void XmlRecordStream::NoteMessage(void* ctx, const char* msg, ...) {
+  *static_cast<bool*>(ctx) = true;
+}
+
+xmlDocPtr XmlRecordStream::Parse(xmlParserCtxtPtr ctxt, size_t index) {
+  size_t begin = index == 0 ? layout_.root_start_end
+                            : layout_.cuts[index - 1];
+  size_t end = index == size() - 1 ? layout_.root_end : layout_.cuts[index];
+  std::string run;
+
+  if (index == 0)
+    run.assign(input_, 0, layout_.root_start_end);
+  else
+    run.assign(input_, layout_.root_start,
+               layout_.root_start_end - layout_.root_start);
+  run.append(input_, begin, end - begin);
+  if (index == size() - 1) {
+    run.append(input_, layout_.root_end, std::string::npos);
+  } else {
+    run.append("</");
+    run.append(layout_.root_name);
+    run.append(">");
+  }
+  xmlDocPtr doc = xmlReaderTreeForMemory(
+      ctxt, run.data(), static_cast<int>(run.size()), NULL, NULL,
+      kParseOptions | XML_PARSE_ARENA);
+  // A reader parsing the document stops at the first error, recovery or not.
+  if (doc && !ctxt->wellFormed) {
+    xmlFreeDoc(doc);
+    doc = NULL;
+  }
+  return doc;
+}
+
+xmlParserCtxtPtr XmlRecordStream::NewContext() {
+  xmlParserCtxtPtr ctxt = xmlNewParserCtxt();
+  if (!ctxt)
+    return NULL;
+  // As parser.c does for the context of an entity.
+  xmlDictFree(ctxt->dict);
+  ctxt->dict = dict_;
+  xmlDictReference(dict_);
+  ctxt->str_xml = xmlDictLookup(dict_, BAD_CAST "xml", 3);
+  ctxt->str_xmlns = xmlDictLookup(dict_, BAD_CAST "xmlns", 5);
+  ctxt->str_xml_ns = xmlDictLookup(dict_, XML_XML_NAMESPACE, 36);
+  return ctxt;
+}
+#endif  // defined(LIBXML_UTILS_PARALLEL_RECORDS)
+
 std::string XmlStringToStdString(const xmlChar* xmlstring) {
   // xmlChar*s are UTF-8, so this cast is safe.
   if (xmlstring)
@@ -14,17 +445,23 @@ std::string XmlStringToStdString(const xmlChar* xmlstring) {
     return "";
 }
 
+#if defined(LIBXML_UTILS_PARALLEL_RECORDS)
+XmlReader::XmlReader() : reader_(NULL), current_records_(0) {
+}
+#else
 XmlReader::XmlReader() : reader_(NULL) {
 }
+#endif
 
 XmlReader::~XmlReader() {
   if (reader_)
     xmlFreeTextReader(reader_);
+#if defined(LIBXML_UTILS_PARALLEL_RECORDS)
+  records_.reset();
+#endif
 }
 
 bool XmlReader::Load(const std::string& input) {
-  const int kParseOptions = XML_PARSE_RECOVER |  // recover on errors
-                            XML_PARSE_NONET;     // forbid network access
   // TODO(evanm): Verify it's OK to pass NULL for the URL and encoding.
   // The libxml code allows for these, but it's unclear what effect is has.
   reader_ = xmlReaderForMemory(input.data(), static_cast<int>(input.size()),
@@ -33,12 +470,33 @@ bool XmlReader::Load(const std::string& input) {
 }
 
 bool XmlReader::LoadFile(const std::string& file_path) {
-  const int kParseOptions = XML_PARSE_RECOVER |  // recover on errors
-                            XML_PARSE_NONET;     // forbid network access
   reader_ = xmlReaderForFile(file_path.c_str(), NULL, kParseOptions);
   return reader_ != NULL;
 }
 
+bool XmlReader::LoadRecords(const std::string& input, int num_threads) {
+#if defined(LIBXML_UTILS_PARALLEL_RECORDS)
+  RecordLayout layout;
+  if (!ScanRecords(input, &layout))
+    return Load(input);
+
+  // The library must be initialized before threads use it.
+  xmlInitParser();
+  records_.reset(new XmlRecordStream(input, layout));
+  if (!records_->Start(num_threads)) {
+    records_.reset();
+    return Load(input);
+  }
+  // As with Load(), an error in the document shows in Read().
+  xmlDocPtr doc = records_->Take(0);
+  if (doc)
+    reader_ = xmlReaderWalker(doc);
+  return true;
+#else
+  return Load(input);
+#endif
+}
+
 bool XmlReader::NodeAttribute(const char* name, std::string* out) {
   xmlChar* value = xmlTextReaderGetAttribute(reader_, BAD_CAST name);
   if (!value)
@@ -48,6 +506,55 @@ bool XmlReader::NodeAttribute(const char* name, std::string* out) {
   return true;
 }
 
+#if defined(LIBXML_UTILS_PARALLEL_RECORDS)
+bool XmlReader::ReadRecords(bool next) {
+  // Next() reads up to the end of the element as xmlTextReaderNext() does
+  // when parsing, the walker's own version skipping some end elements.
+  if (next && NodeType() == XML_READER_TYPE_ELEMENT &&
+      !xmlTextReaderIsEmptyElement(reader_)) {
+    const int depth = Depth();
+    // On the root element, go straight to the last run.
+    if (depth == 0 && current_records_ + 1 < records_->size()) {
+      while (current_records_ + 1 < records_->size()) {
+        if (!OpenNextRecords())
+          return false;
+      }
+      if (xmlTextReaderRead(reader_) != 1)
+        return false;
+    }
+    do {
+      if (!ReadRecords(false))
+        return false;
+    } while (Depth() != depth || NodeType() != XML_READER_TYPE_END_ELEMENT);
+  }
+
+  int ret = xmlTextReaderRead(reader_);
+
+  // The end of the root element of a run but the last one is not part of
+  // the document: continue with the first record of the next run, past its
+  // copy of the root start tag.
+  while (ret == 1 && current_records_ + 1 < records_->size() &&
+         Depth() == 0 && NodeType() == XML_READER_TYPE_END_ELEMENT) {
+    if (!OpenNextRecords())
+      return false;
+    ret = xmlTextReaderRead(reader_);
+    if (ret == 1)
+      ret = xmlTextReaderRead(reader_);
+  }
+  return ret == 1;
+}
+
+bool XmlReader::OpenNextRecords() {
+  xmlFreeTextReader(reader_);
+  reader_ = NULL;
+  xmlDocPtr doc = records_->Take(++current_records_);
+  if (!doc)
+    return false;
+  reader_ = xmlReaderWalker(doc);
+  return reader_ != NULL;
+}
+#endif  // defined(LIBXML_UTILS_PARALLEL_RECORDS)
+
 bool XmlReader::IsClosingElement() {
   return NodeType() == XML_READER_TYPE_END_ELEMENT;
 }
@@ -6,6 +6,9 @@
 #define THIRD_PARTY_LIBXML_CHROMIUM_LIBXML_UTILS_H_
 #pragma once
 
+#include <stddef.h>
+
+#include <memory>
 #include <string>
 
 #include "libxml/xmlreader.h"
@@ -34,6 +37,14 @@ class ScopedXmlErrorFunc {
   void* old_error_context_;
 };
 
+// XmlReader::LoadRecords() parses on threads, with the concurrent dictionary,
+// xmlReaderTreeForMemory() and XML_PARSE_ARENA that the bundled libxml adds.
+// With a system libxml or on Windows, it is Load().
+#if !defined(USE_SYSTEM_LIBXML) && !defined(_WIN32)
+#define LIBXML_UTILS_PARALLEL_RECORDS
+class XmlRecordStream;
+#endif
+
 // XmlReader is a wrapper class around libxml's xmlReader,
 // providing a simplified C++ API.
 class XmlReader {
@@ -49,14 +60,39 @@ class XmlReader {
   // Load a document into the reader from a file.  Returns false on error.
   bool LoadFile(const std::string& file_path);
 
+  // Load a document made of a root element holding many independent sibling
+  // records, like a feed, to be read as after Load().  A quick scan of
+  // |input| splits the children of the root into runs of records, which
+  // |num_threads| worker threads (zero for one per processor) parse ahead of
+  // the reader, each with its own parser context; the reader still sees the
+  // nodes in document order.  Documents the scan cannot split safely, such
+  // as those with a DOCTYPE or not in UTF-8, are read as by Load().  Read()
+  // fails at the start of the run holding the first error of the document,
+  // where it would fail at the error itself after Load().  |input| must exist
+  // for the lifetime of this object.  Without LIBXML_UTILS_PARALLEL_RECORDS,
+  // or if no thread can be started, this is Load().  Returns false on error.
+  bool LoadRecords(const std::string& input, int num_threads);
+
   // Wrappers around libxml functions -----------------------------------------
 
   // Read() advances to the next node.  Returns false on EOF or error.
-  bool Read() { return xmlTextReaderRead(reader_) == 1; }
+  bool Read() {
+#if defined(LIBXML_UTILS_PARALLEL_RECORDS)
+    if (records_)
+      return ReadRecords(false);
+#endif
+    return xmlTextReaderRead(reader_) == 1;
+  }
 
   // Next(), when pointing at an opening tag, advances to the node after
   // the matching closing tag.  Returns false on EOF or error.
-  bool Next() { return xmlTextReaderNext(reader_) == 1; }
+  bool Next() {
+#if defined(LIBXML_UTILS_PARALLEL_RECORDS)
+    if (records_)
+      return ReadRecords(true);
+#endif
+    return xmlTextReaderNext(reader_) == 1;
+  }
 
   // Return the depth in the tree of the current node.
   int Depth() { return xmlTextReaderDepth(reader_); }
@@ -95,8 +131,25 @@ class XmlReader {
   // Returns the libxml node type of the current node.
   int NodeType() { return xmlTextReaderNodeType(reader_); }
 
-  // The underlying libxml xmlTextReader.
+#if defined(LIBXML_UTILS_PARALLEL_RECORDS)
+  // Read() and Next() after LoadRecords(), moving |reader_| from one run of
+  // records to the next at the end of the root element of each.
+  bool ReadRecords(bool next);
+
+  // Switches |reader_| to the next run of records.  Returns false on error.
+  bool OpenNextRecords();
+#endif
+
+  // The underlying libxml xmlTextReader.  After LoadRecords(), it walks the
+  // tree of the current run of records.
   xmlTextReaderPtr reader_;
+
+#if defined(LIBXML_UTILS_PARALLEL_RECORDS)
+  // The runs of records being parsed, if the document was split, and the
+  // index of the run |reader_| walks.
+  std::unique_ptr<XmlRecordStream> records_;
+  size_t current_records_;
+#endif
 };
 
 // XmlWriter is a wrapper class around libxml's xmlWriter,
@@ -0,0 +1,88 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+
+#include "base/strings/string_number_conversions.h"
+#include "base/sys_info.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+#include "third_party/libxml/chromium/libxml_utils.h"
+
+namespace {
+
+const size_t kFeedSize = 64 * 1024 * 1024;
+
+class XmlReaderPerfTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    // A feed of small quotes, the shape LoadRecords() is meant for.
+    feed_ =
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        "<quotes xmlns=\"http://example.com/quotes\">\n";
+    feed_.reserve(kFeedSize + 4096);
+    char record[256];
+    for (int i = 0; feed_.size() < kFeedSize; ++i) {
+      snprintf(record, sizeof(record),
+               "  <quote id=\"q%d\" seq=\"%d\">\n"
+               "    <symbol>S%04d</symbol>\n"
+               "    <bid size=\"%d\">%d.%02d</bid>\n"
+               "    <note>the feed &amp; record of market data</note>\n"
+               "  </quote>\n",
+               i, i * 3, i % 5000, i % 1000, i % 500, i % 100);
+      feed_ += record;
+    }
+    feed_ += "</quotes>\n";
+  }
+
+  // Reads every node of the loaded document, the way a feed consumer would,
+  // and reports the throughput over |feed_| as |trace|, including the load.
+  // Returns a hash of the names, depths and attributes seen so the readers
+  // can be checked against each other.
+  uint64_t Measure(const std::string& trace, int num_threads) {
+    base::TimeTicks start = base::TimeTicks::Now();
+    XmlReader reader;
+    if (num_threads < 0)
+      EXPECT_TRUE(reader.Load(feed_));
+    else
+      EXPECT_TRUE(reader.LoadRecords(feed_, num_threads));
+
+    uint64_t hash = UINT64_C(14695981039346656037);
+    std::string value;
+    while (reader.Read()) {
+      std::string name = reader.NodeName();
+      if (reader.NodeAttribute("id", &value))
+        name += value;
+      name += static_cast<char>(reader.Depth());
+      for (char c : name) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= UINT64_C(1099511628211);
+      }
+    }
+    base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+
+    perf_test::PrintResult("xml_reader", std::string(), trace,
+                           feed_.size() / elapsed.InSecondsF() / 1e6, "MB/s",
+                           true);
+    return hash;
+  }
+
+  std::string feed_;
+};
+
+TEST_F(XmlReaderPerfTest, LoadRecords) {
+  uint64_t serial = Measure("serial", -1);
+  int processors = base::SysInfo::NumberOfProcessors();
+  for (int num_threads = 1; num_threads < 2 * processors; num_threads *= 2) {
+    EXPECT_EQ(serial, Measure("records_" + base::IntToString(num_threads),
+                              num_threads));
+  }
+}
+
+}  // namespace
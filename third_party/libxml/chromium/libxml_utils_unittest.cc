@@ -0,0 +1,178 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "third_party/libxml/chromium/libxml_utils.h"
+
+#include <stdio.h>
+
+#include <string>
+
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+// Large enough for LoadRecords() to cut it into several runs of records.
+const size_t kFeedSize = 1024 * 1024;
+
+// The thread counts LoadRecords() is checked with, zero for one per
+// processor.
+const int kThreadCounts[] = {0, 1, 2, 4};
+
+// Returns a feed of |size| bytes of records of all the shapes the runs must
+// keep: namespaces and attributes of the root, empty elements written both
+// ways, text, entities, CDATA, comments and processing instructions.
+std::string MakeFeed(size_t size) {
+  std::string feed =
+      "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+      "<!-- a feed -->\n"
+      "<feed xmlns=\"http://example.com/feed\" "
+      "xmlns:m=\"http://example.com/meta\" m:version=\"2\">\n";
+  char record[512];
+  for (int i = 0; feed.size() < size; ++i) {
+    snprintf(record, sizeof(record),
+             "  <item id=\"r%d\" m:kind=\"%s\">\n"
+             "    <title>Record &amp; number %d</title>\n"
+             "    <m:empty/><m:empty></m:empty>\n"
+             "    <note><![CDATA[raw <data> %d]]> and &lt;text&gt;</note>\n"
+             "    <?audit seq=\"%d\"?><!-- comment %d -->\n"
+             "  </item>\n",
+             i, i % 3 ? "quote" : "trade", i, i, i, i);
+    feed += record;
+  }
+  feed += "</feed>\n<!-- the end -->\n";
+  return feed;
+}
+
+// Appends what |reader| shows of its current node to |trace|.
+void TraceNode(XmlReader* reader, std::string* trace) {
+  std::string value;
+  *trace += std::to_string(reader->Depth());
+  *trace += reader->IsClosingElement() ? " /" : " ";
+  *trace += reader->NodeName();
+  if (reader->NodeAttribute("id", &value))
+    *trace += " id=" + value;
+  if (reader->NodeAttribute("m:kind", &value))
+    *trace += " m:kind=" + value;
+  *trace += "\n";
+}
+
+// Loads |input| with Load() if |num_threads| is negative and LoadRecords()
+// otherwise.
+void LoadInto(XmlReader* reader, const std::string& input, int num_threads) {
+  if (num_threads < 0)
+    EXPECT_TRUE(reader->Load(input));
+  else
+    EXPECT_TRUE(reader->LoadRecords(input, num_threads));
+}
+
+// Returns the trace of reading |input| with Read() up to its end or its
+// first error, reading the content of the titles.
+std::string ReadAll(const std::string& input, int num_threads) {
+  XmlReader reader;
+  LoadInto(&reader, input, num_threads);
+
+  std::string trace;
+  bool ok = reader.Read();
+  while (ok) {
+    TraceNode(&reader, &trace);
+    if (reader.NodeName() == "title" && !reader.IsClosingElement()) {
+      std::string content;
+      ok = reader.ReadElementContent(&content);
+      trace += content + "\n";
+    } else {
+      ok = reader.Read();
+    }
+  }
+  return trace;
+}
+
+// Returns the trace of reading |input| skipping two records out of three
+// with Next().
+std::string SkipRecords(const std::string& input, int num_threads) {
+  XmlReader reader;
+  LoadInto(&reader, input, num_threads);
+
+  std::string trace;
+  bool ok = reader.Read();
+  for (int i = 0; ok; ++i) {
+    TraceNode(&reader, &trace);
+    if (reader.Depth() == 1 && reader.NodeName() == "item" &&
+        !reader.IsClosingElement() && i % 3 != 0)
+      ok = reader.Next();
+    else
+      ok = reader.Read();
+  }
+  return trace;
+}
+
+// Returns the trace of reading |input| skipping the root with Next().
+std::string SkipRoot(const std::string& input, int num_threads) {
+  XmlReader reader;
+  LoadInto(&reader, input, num_threads);
+
+  std::string trace;
+  EXPECT_TRUE(reader.Read());
+  EXPECT_TRUE(reader.SkipToElement());
+  TraceNode(&reader, &trace);
+  bool ok = reader.Next();
+  while (ok) {
+    TraceNode(&reader, &trace);
+    ok = reader.Read();
+  }
+  return trace;
+}
+
+TEST(XmlReaderTest, LoadRecordsReadsAsLoad) {
+  std::string feed = MakeFeed(kFeedSize);
+  std::string expected = ReadAll(feed, -1);
+  EXPECT_NE(std::string::npos, expected.find("0 /feed\n0 #comment\n"));
+  for (int num_threads : kThreadCounts)
+    EXPECT_EQ(expected, ReadAll(feed, num_threads)) << num_threads;
+}
+
+TEST(XmlReaderTest, LoadRecordsNextAsLoad) {
+  std::string feed = MakeFeed(kFeedSize);
+  std::string expected = SkipRecords(feed, -1);
+  std::string expected_root = SkipRoot(feed, -1);
+  EXPECT_EQ("0 feed\n0 #comment\n", expected_root);
+  for (int num_threads : kThreadCounts) {
+    EXPECT_EQ(expected, SkipRecords(feed, num_threads)) << num_threads;
+    EXPECT_EQ(expected_root, SkipRoot(feed, num_threads)) << num_threads;
+  }
+}
+
+TEST(XmlReaderTest, LoadRecordsUnsplitDocuments) {
+  const char* const kDocuments[] = {
+      "<feed><item id=\"a\"/><item id=\"b\"></item></feed>",
+      "<?xml version=\"1.0\" encoding=\"ISO-8859-1\"?>\n"
+      "<feed><item id=\"caf\xe9\"/></feed>",
+      "<!DOCTYPE feed [<!ENTITY e \"text\">]>\n"
+      "<feed><title>&e;</title></feed>",
+  };
+  for (const char* document : kDocuments) {
+    std::string input = document;
+    EXPECT_EQ(ReadAll(input, -1), ReadAll(input, 2)) << document;
+  }
+}
+
+TEST(XmlReaderTest, LoadRecordsStopsBeforeAnError) {
+  std::string feed = MakeFeed(kFeedSize);
+  size_t middle = feed.find("<item", feed.size() / 2);
+  ASSERT_NE(std::string::npos, middle);
+  // A mismatched end tag, which the scan for the records does not check.
+  feed.replace(feed.find("</title>", middle), 8, "</titel>");
+
+  std::string expected = ReadAll(feed, -1);
+  EXPECT_EQ(std::string::npos, expected.find("0 /feed"));
+  for (int num_threads : kThreadCounts) {
+    std::string trace = ReadAll(feed, num_threads);
+#if defined(LIBXML_UTILS_PARALLEL_RECORDS)
+    // The run holding the error is not read at all.
+    EXPECT_LT(trace.size(), expected.size());
+#endif
+    EXPECT_EQ(trace, expected.substr(0, trace.size())) << num_threads;
+  }
+}
+
+}  // namespace
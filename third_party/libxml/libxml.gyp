@@ -131,6 +131,8 @@
             'src/include/libxml/xpointer.h',
             'src/include/win32config.h',
             'src/include/wsockcompat.h',
+            'src/arena.c',
+            'src/arena.h',
             'src/buf.c',
             'src/buf.h',
             'src/c14n.c',
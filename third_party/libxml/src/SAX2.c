@@ -27,6 +27,8 @@
 #include <libxml/HTMLtree.h>
 #include <libxml/globals.h>
 
+#include "arena.h"
+
 /* Define SIZE_T_MAX unless defined through <limits.h>. */
 #ifndef SIZE_T_MAX
 # define SIZE_T_MAX     ((size_t)-1)
@@ -1015,6 +1017,13 @@ xmlSAX2StartDocument(void *ctx)
 	    if (ctxt->options & XML_PARSE_OLD10)
 	        doc->properties |= XML_DOC_OLD10;
 	    doc->parseFlags = ctxt->options;
+	    if (ctxt->options & XML_PARSE_ARENA) {
+		((xmlDocPrivate *) doc)->arena = xmlArenaCreate();
+		if (((xmlDocPrivate *) doc)->arena == NULL) {
+		    xmlSAX2ErrMemory(ctxt, "xmlSAX2StartDocument");
+		    return;
+		}
+	    }
 	    if (ctxt->encoding != NULL)
 		doc->encoding = xmlStrdup(ctxt->encoding);
 	    else
@@ -1844,14 +1853,19 @@ static xmlNodePtr
 xmlSAX2TextNode(xmlParserCtxtPtr ctxt, const xmlChar *str, int len) {
     xmlNodePtr ret;
     const xmlChar *intern = NULL;
+    xmlArenaPtr arena = NULL;
 
     /*
      * Allocate
      */
+    if (ctxt->myDoc != NULL)
+        arena = XML_DOC_ARENA(ctxt->myDoc);
     if (ctxt->freeElems != NULL) {
 	ret = ctxt->freeElems;
 	ctxt->freeElems = ret->next;
 	ctxt->freeElemsNr--;
+    } else if (arena != NULL) {
+	ret = (xmlNodePtr) xmlArenaMalloc(arena, sizeof(xmlNode));
     } else {
 	ret = (xmlNodePtr) xmlMalloc(sizeof(xmlNode));
     }
@@ -1892,10 +1906,14 @@ skip:
 
     ret->name = xmlStringText;
     if (intern == NULL) {
-	ret->content = xmlStrndup(str, len);
+	if (arena != NULL)
+	    ret->content = xmlArenaStrndup(arena, str, len);
+	else
+	    ret->content = xmlStrndup(str, len);
 	if (ret->content == NULL) {
 	    xmlSAX2ErrMemory(ctxt, "xmlSAX2TextNode");
-	    xmlFree(ret);
+	    if ((arena == NULL) || (!xmlArenaOwns(arena, ret)))
+		xmlFree(ret);
 	    return(NULL);
 	}
     } else
@@ -1973,6 +1991,7 @@ xmlSAX2AttributeNs(xmlParserCtxtPtr ctxt,
     xmlAttrPtr ret;
     xmlNsPtr namespace = NULL;
     xmlChar *dup = NULL;
+    xmlArenaPtr arena = NULL;
 
     /*
      * Note: if prefix == NULL, the attribute is not in the default namespace
@@ -1983,10 +2002,20 @@ xmlSAX2AttributeNs(xmlParserCtxtPtr ctxt,
     /*
      * allocate the node
      */
-    if (ctxt->freeAttrs != NULL) {
-        ret = ctxt->freeAttrs;
-	ctxt->freeAttrs = ret->next;
-	ctxt->freeAttrsNr--;
+    if (ctxt->myDoc != NULL)
+        arena = XML_DOC_ARENA(ctxt->myDoc);
+    if ((ctxt->freeAttrs != NULL) || (arena != NULL)) {
+        if (ctxt->freeAttrs != NULL) {
+	    ret = ctxt->freeAttrs;
+	    ctxt->freeAttrs = ret->next;
+	    ctxt->freeAttrsNr--;
+	} else {
+	    ret = (xmlAttrPtr) xmlArenaMalloc(arena, sizeof(xmlAttr));
+	    if (ret == NULL) {
+		xmlErrMemory(ctxt, "xmlSAX2AttributeNs");
+		return;
+	    }
+	}
 	memset(ret, 0, sizeof(xmlAttr));
 	ret->type = XML_ATTRIBUTE_NODE;
 
@@ -2245,12 +2274,25 @@ xmlSAX2StartElementNs(void *ctx,
     /*
      * allocate the node
      */
-    if (ctxt->freeElems != NULL) {
-        ret = ctxt->freeElems;
-	ctxt->freeElems = ret->next;
-	ctxt->freeElemsNr--;
+    if ((ctxt->freeElems != NULL) ||
+        ((ctxt->myDoc != NULL) && (XML_DOC_ARENA(ctxt->myDoc) != NULL))) {
+	if (ctxt->freeElems != NULL) {
+	    ret = ctxt->freeElems;
+	    ctxt->freeElems = ret->next;
+	    ctxt->freeElemsNr--;
+	} else {
+	    ret = (xmlNodePtr) xmlArenaMalloc(XML_DOC_ARENA(ctxt->myDoc),
+	                                      sizeof(xmlNode));
+	    if (ret == NULL) {
+		if (lname != NULL)
+		    xmlFree(lname);
+		xmlSAX2ErrMemory(ctxt, "xmlSAX2StartElementNs");
+		return;
+	    }
+	}
 	memset(ret, 0, sizeof(xmlNode));
 	ret->type = XML_ELEMENT_NODE;
+	ret->doc = ctxt->myDoc;
 
 	if (ctxt->dictNames)
 	    ret->name = localname;
@@ -2595,10 +2637,18 @@ xmlSAX2Characters(void *ctx, const xmlChar *ch, int len)
 	    if (ctxt->nodelen + len >= ctxt->nodemem) {
 		xmlChar *newbuf;
 		size_t size;
+		xmlArenaPtr arena = NULL;
 
+		if (lastChild->doc != NULL)
+		    arena = XML_DOC_ARENA(lastChild->doc);
 		size = ctxt->nodemem + len;
 		size *= 2;
-                newbuf = (xmlChar *) xmlRealloc(lastChild->content,size);
+		if ((arena != NULL) &&
+		    (xmlArenaOwns(arena, lastChild->content)))
+		    newbuf = (xmlChar *) xmlArenaGrow(arena,
+		                  lastChild->content, ctxt->nodelen + 1, size);
+		else
+		    newbuf = (xmlChar *) xmlRealloc(lastChild->content,size);
 		if (newbuf == NULL) {
 		    xmlSAX2ErrMemory(ctxt, "xmlSAX2Characters");
 		    return;
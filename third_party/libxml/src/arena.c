@@ -0,0 +1,290 @@
+/*
+ * arena.c: the bump allocator of documents parsed with XML_PARSE_ARENA
+ *
+ * The tree builder of SAX2.c takes the element, attribute and text nodes
+ * and the text content of such a document from its arena, one pointer
+ * increment each, instead of one xmlMalloc() each, and xmlFreeDoc() gives
+ * the chunks of the arena back at once. The free and modification
+ * routines of tree.c check xmlArenaOwns() the way they check
+ * xmlDictOwns(), so that a tree mixing arena and xmlMalloc() memory can
+ * still be edited and freed node by node.
+ *
+ * Copyright 2016 The Chromium Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#define IN_LIBXML
+#include "libxml.h"
+
+#include <string.h>
+
+#include <libxml/xmlmemory.h>
+#include <libxml/globals.h>
+#include "arena.h"
+
+/*
+ * The chunks double from ARENA_CHUNK_MIN up to ARENA_CHUNK_MAX, so a small
+ * document costs one small chunk and a large one a few hundred at most.
+ * Requests larger than half the current chunk get a chunk of their own.
+ */
+#define ARENA_CHUNK_MIN (4 * 1024)
+#define ARENA_CHUNK_MAX (1024 * 1024)
+
+#define ARENA_ALIGN 8
+
+typedef struct _xmlArenaChunk xmlArenaChunk;
+struct _xmlArenaChunk {
+    xmlChar *start;
+    xmlChar *end;
+};
+
+struct _xmlArena {
+    xmlChar *cur;		/* the first free byte of the current chunk */
+    xmlChar *end;		/* the end of the current chunk */
+    xmlChar *last;		/* the last allocation, which can grow in place */
+    xmlArenaChunk *chunks;	/* all the chunks, sorted by address */
+    int nbChunks;
+    int maxChunks;
+    int hit;			/* the chunk xmlArenaOwns() found last */
+    size_t chunkSize;		/* the size of the next chunk */
+    size_t size;		/* the total size of the chunks */
+};
+
+/**
+ * xmlArenaCreate:
+ *
+ * Create a new arena, with no chunk until the first allocation
+ *
+ * Returns the newly created arena, or NULL if an error occured.
+ */
+xmlArenaPtr
+xmlArenaCreate(void) {
+    xmlArenaPtr arena;
+
+    arena = xmlMalloc(sizeof(xmlArena));
+    if (arena == NULL)
+        return(NULL);
+    memset(arena, 0, sizeof(xmlArena));
+    arena->chunkSize = ARENA_CHUNK_MIN;
+    return(arena);
+}
+
+/**
+ * xmlArenaFree:
+ * @arena:  the arena
+ *
+ * Free the arena and all the memory it handed out
+ */
+void
+xmlArenaFree(xmlArenaPtr arena) {
+    int i;
+
+    if (arena == NULL)
+        return;
+    for (i = 0; i < arena->nbChunks; i++)
+        xmlFree(arena->chunks[i].start);
+    if (arena->chunks != NULL)
+        xmlFree(arena->chunks);
+    xmlFree(arena);
+}
+
+/**
+ * xmlArenaAddChunk:
+ * @arena:  the arena
+ * @size:  the size of the chunk
+ *
+ * Allocate a chunk and insert it in the sorted table
+ *
+ * Returns the chunk start or NULL in case of error
+ */
+static xmlChar *
+xmlArenaAddChunk(xmlArenaPtr arena, size_t size) {
+    xmlChar *start;
+    int i;
+
+    if (arena->nbChunks >= arena->maxChunks) {
+        xmlArenaChunk *tmp;
+        int max = arena->maxChunks ? 2 * arena->maxChunks : 16;
+
+        tmp = xmlRealloc(arena->chunks, max * sizeof(xmlArenaChunk));
+        if (tmp == NULL)
+            return(NULL);
+        arena->chunks = tmp;
+        arena->maxChunks = max;
+    }
+    start = xmlMalloc(size);
+    if (start == NULL)
+        return(NULL);
+
+    for (i = arena->nbChunks; i > 0; i--) {
+        if (arena->chunks[i - 1].start < start)
+            break;
+        arena->chunks[i] = arena->chunks[i - 1];
+    }
+    arena->chunks[i].start = start;
+    arena->chunks[i].end = start + size;
+    arena->nbChunks++;
+    arena->size += size;
+    return(start);
+}
+
+/**
+ * xmlArenaMalloc:
+ * @arena:  the arena
+ * @size:  the number of bytes
+ *
+ * Allocate @size bytes suitably aligned for any tree structure
+ *
+ * Returns the memory, or NULL in case of error
+ */
+void *
+xmlArenaMalloc(xmlArenaPtr arena, size_t size) {
+    xmlChar *ret;
+    size_t pad;
+
+    if ((arena == NULL) || (size == 0))
+        return(NULL);
+
+    pad = (ARENA_ALIGN - ((size_t) arena->cur & (ARENA_ALIGN - 1))) &
+          (ARENA_ALIGN - 1);
+    if ((arena->cur != NULL) &&
+        (size + pad <= (size_t) (arena->end - arena->cur))) {
+        ret = arena->cur + pad;
+        arena->cur = ret + size;
+        arena->last = ret;
+        return(ret);
+    }
+
+    if (size > arena->chunkSize / 2) {
+        /* a chunk of its own, keeping the current one */
+        ret = xmlArenaAddChunk(arena, size);
+        return(ret);
+    }
+
+    ret = xmlArenaAddChunk(arena, arena->chunkSize);
+    if (ret == NULL)
+        return(NULL);
+    arena->end = ret + arena->chunkSize;
+    arena->cur = ret + size;
+    arena->last = ret;
+    if (arena->chunkSize < ARENA_CHUNK_MAX)
+        arena->chunkSize *= 2;
+    return(ret);
+}
+
+/**
+ * xmlArenaStrndup:
+ * @arena:  the arena
+ * @str:  the input string
+ * @len:  the length of @str
+ *
+ * a strndup for the arena, the copy is not aligned
+ *
+ * Returns the copy, or NULL in case of error
+ */
+xmlChar *
+xmlArenaStrndup(xmlArenaPtr arena, const xmlChar *str, int len) {
+    xmlChar *ret;
+
+    if ((arena == NULL) || (str == NULL) || (len < 0))
+        return(NULL);
+
+    if ((arena->cur != NULL) &&
+        ((size_t) len + 1 <= (size_t) (arena->end - arena->cur))) {
+        ret = arena->cur;
+        arena->cur += len + 1;
+        arena->last = ret;
+    } else {
+        ret = xmlArenaMalloc(arena, (size_t) len + 1);
+        if (ret == NULL)
+            return(NULL);
+    }
+    memcpy(ret, str, len);
+    ret[len] = 0;
+    return(ret);
+}
+
+/**
+ * xmlArenaGrow:
+ * @arena:  the arena
+ * @ptr:  memory from the arena
+ * @used:  the number of bytes of @ptr to keep
+ * @size:  the new size
+ *
+ * The realloc of the arena: @ptr grows in place if it is the last block
+ * handed out and the chunk has room, else it is copied to a new block and
+ * its old space is only reclaimed with the arena.
+ *
+ * Returns the grown memory, or NULL in case of error
+ */
+void *
+xmlArenaGrow(xmlArenaPtr arena, void *ptr, size_t used, size_t size) {
+    xmlChar *ret;
+
+    if ((arena == NULL) || (ptr == NULL) || (used > size))
+        return(NULL);
+
+    if ((ptr == arena->last) &&
+        (size <= (size_t) (arena->end - (xmlChar *) ptr))) {
+        arena->cur = (xmlChar *) ptr + size;
+        return(ptr);
+    }
+    ret = xmlArenaMalloc(arena, size);
+    if (ret == NULL)
+        return(NULL);
+    memcpy(ret, ptr, used);
+    return(ret);
+}
+
+/**
+ * xmlArenaOwns:
+ * @arena:  the arena
+ * @ptr:  a pointer
+ *
+ * check if @ptr was handed out by @arena
+ *
+ * Returns 1 if true, 0 if false
+ */
+int
+xmlArenaOwns(xmlArenaPtr arena, const void *ptr) {
+    const xmlChar *p = ptr;
+    int low, high, mid;
+
+    if ((arena == NULL) || (p == NULL))
+        return(0);
+
+    /* a tree being freed in document order stays in one chunk for long */
+    if ((arena->hit < arena->nbChunks) &&
+        (p >= arena->chunks[arena->hit].start) &&
+        (p < arena->chunks[arena->hit].end))
+        return(1);
+
+    low = 0;
+    high = arena->nbChunks - 1;
+    while (low <= high) {
+        mid = (low + high) / 2;
+        if (p < arena->chunks[mid].start)
+            high = mid - 1;
+        else if (p >= arena->chunks[mid].end)
+            low = mid + 1;
+        else {
+            arena->hit = mid;
+            return(1);
+        }
+    }
+    return(0);
+}
+
+/**
+ * xmlArenaSize:
+ * @arena:  the arena
+ *
+ * Returns the number of bytes of the chunks of @arena
+ */
+size_t
+xmlArenaSize(xmlArenaPtr arena) {
+    if (arena == NULL)
+        return(0);
+    return(arena->size);
+}
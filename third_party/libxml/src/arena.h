@@ -0,0 +1,60 @@
+/*
+ * Summary: Internal Interfaces for the tree arena in libxml2
+ * Description: a bump allocator a document parsed with XML_PARSE_ARENA
+ *              takes its nodes, attributes and text from, freed at
+ *              once with the document. Those are private routines.
+ *
+ * Copyright 2016 The Chromium Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef __XML_ARENA_H__
+#define __XML_ARENA_H__
+
+#include <libxml/xmlstring.h>
+#include <libxml/parser.h>
+#include <libxml/tree.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _xmlArena xmlArena;
+typedef xmlArena *xmlArenaPtr;
+
+xmlArenaPtr xmlArenaCreate(void);
+void xmlArenaFree(xmlArenaPtr arena);
+
+void *xmlArenaMalloc(xmlArenaPtr arena, size_t size);
+xmlChar *xmlArenaStrndup(xmlArenaPtr arena, const xmlChar *str, int len);
+void *xmlArenaGrow(xmlArenaPtr arena, void *ptr, size_t used, size_t size);
+
+int xmlArenaOwns(xmlArenaPtr arena, const void *ptr);
+size_t xmlArenaSize(xmlArenaPtr arena);
+
+/*
+ * A document as xmlNewDoc() allocates it, with the arena after the public
+ * struct so that its layout does not change
+ */
+typedef struct _xmlDocPrivate xmlDocPrivate;
+struct _xmlDocPrivate {
+    xmlDoc doc;
+    xmlArenaPtr arena;
+};
+
+/*
+ * The arena of @doc, or NULL.  Only documents parsed with XML_PARSE_ARENA
+ * are read past the public struct, since the others may not be from
+ * xmlNewDoc().
+ */
+#define XML_DOC_ARENA(doc)						\
+    ((((doc)->type == XML_DOCUMENT_NODE) &&				\
+      ((doc)->parseFlags & XML_PARSE_ARENA)) ?				\
+     ((const xmlDocPrivate *) (doc))->arena : NULL)
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* __XML_ARENA_H__ */
+
@@ -57,6 +57,7 @@ typedef unsigned __int32 uint32_t;
 #include <libxml/xmlmemory.h>
 #include <libxml/xmlerror.h>
 #include <libxml/globals.h>
+#include <libxml/parserInternals.h>
 
 /* #define DEBUG_GROW */
 /* #define DICT_DEBUG_PATTERNS */
@@ -109,6 +110,60 @@ struct _xmlDictStrings {
     size_t nbStrings;
     xmlChar array[1];
 };
+
+/*
+ * A slot in the open-addressed table of a concurrent dictionnary shard,
+ * empty while name is NULL
+ */
+typedef struct _xmlDictSlot xmlDictSlot;
+struct _xmlDictSlot {
+    const xmlChar *name;
+    unsigned int len;
+    unsigned int okey;
+};
+
+typedef struct _xmlDictTable xmlDictTable;
+typedef xmlDictTable *xmlDictTablePtr;
+struct _xmlDictTable {
+    xmlDictTablePtr retired;	/* the smaller table this one replaced */
+    size_t mask;
+    xmlDictSlot slots[1];
+};
+
+#define DICT_SHARD_ALIGN 64
+
+/*
+ * A shard of a concurrent dictionnary, alone on its cache line: the
+ * shards are allocated DICT_SHARD_ALIGN aligned
+ */
+typedef struct _xmlDictShard xmlDictShard;
+typedef xmlDictShard *xmlDictShardPtr;
+struct _xmlDictShard {
+    xmlDictTablePtr table;
+    xmlMutexPtr lock;		/* held to add to the shard */
+    size_t nbElems;
+    xmlDictStringsPtr strings;
+    char pad[DICT_SHARD_ALIGN - 4 * sizeof(void *)];
+};
+
+/*
+ * The string chunks of a concurrent dictionnary by page, for xmlDictOwns
+ */
+typedef struct _xmlDictPage xmlDictPage;
+struct _xmlDictPage {
+    size_t page;
+    xmlDictStringsPtr chunk;
+};
+
+typedef struct _xmlDictPages xmlDictPages;
+typedef xmlDictPages *xmlDictPagesPtr;
+struct _xmlDictPages {
+    xmlDictPagesPtr retired;
+    size_t mask;
+    size_t nbElems;
+    xmlDictPage slots[1];
+};
+
 /*
  * The entire dictionnary
  */
@@ -125,6 +180,13 @@ struct _xmlDict {
     int seed;
     /* used to impose a limit on size */
     size_t limit;
+
+    /* only for a concurrent dictionnary, see xmlDictCreateConcurrent */
+    xmlDictShardPtr shards;
+    void *shardsMem;		/* the allocation shards is aligned in */
+    xmlDictPagesPtr pages;
+    xmlMutexPtr pagesLock;	/* held to add to pages and usage */
+    size_t usage;
 };
 
 /*
@@ -528,6 +590,384 @@ xmlDictComputeFastQKey(const xmlChar *prefix, int plen,
     return(value);
 }
 
+/*
+ * Concurrent dictionnaries
+ *
+ * The strings of a concurrent dictionnary are spread over DICT_SHARDS
+ * shards on the top bits of their key.  Each shard is an open-addressed
+ * table with linear probing that lookups walk without taking a lock: a
+ * slot is published by storing its name last, and a table replaced by a
+ * bigger one is retired but kept until the dictionnary is freed, since a
+ * reader may still be walking it.  Adding a string takes the lock of its
+ * shard only, and allocates the string from the chunks of that shard,
+ * whose size is capped so that a long lived dictionnary does not end up
+ * with a few huge, mostly empty chunks.  Compilers without atomic builtins
+ * take the shard lock for lookups too.
+ */
+#if defined(__clang__) || (defined(__GNUC__) && \
+    ((__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 7))))
+#define DICT_ATOMICS
+#define DICT_LOAD(p) __atomic_load_n(&(p), __ATOMIC_ACQUIRE)
+#define DICT_STORE(p, v) __atomic_store_n(&(p), (v), __ATOMIC_RELEASE)
+#define DICT_READ_LOCK(m)
+#define DICT_READ_UNLOCK(m)
+#else
+#define DICT_LOAD(p) (p)
+#define DICT_STORE(p, v) ((p) = (v))
+#define DICT_READ_LOCK(m) xmlMutexLock(m)
+#define DICT_READ_UNLOCK(m) xmlMutexUnlock(m)
+#endif
+
+#define DICT_SHARD_BITS 6
+#define DICT_SHARDS (1 << DICT_SHARD_BITS)
+#define DICT_SHARD_MIN_SIZE 64
+#define DICT_CHUNK_MIN 256
+#define DICT_CHUNK_MAX (64 * 1024)
+#define DICT_PAGE_SHIFT 12
+#define DICT_PAGES_MIN_SIZE 64
+
+#define xmlDictPageKey(page) ((size_t) ((unsigned int) (page) * 2654435761U))
+
+static xmlDictTablePtr
+xmlDictTableNew(size_t size) {
+    xmlDictTablePtr table;
+
+    table = xmlMalloc(sizeof(xmlDictTable) + (size - 1) * sizeof(xmlDictSlot));
+    if (table == NULL)
+        return(NULL);
+    memset(table->slots, 0, size * sizeof(xmlDictSlot));
+    table->retired = NULL;
+    table->mask = size - 1;
+    return(table);
+}
+
+static xmlDictPagesPtr
+xmlDictPagesNew(size_t size) {
+    xmlDictPagesPtr pages;
+
+    pages = xmlMalloc(sizeof(xmlDictPages) + (size - 1) * sizeof(xmlDictPage));
+    if (pages == NULL)
+        return(NULL);
+    memset(pages->slots, 0, size * sizeof(xmlDictPage));
+    pages->retired = NULL;
+    pages->mask = size - 1;
+    pages->nbElems = 0;
+    return(pages);
+}
+
+static void
+xmlDictPagesInsert(xmlDictPagesPtr pages, size_t page,
+                   xmlDictStringsPtr chunk) {
+    size_t i;
+
+    for (i = xmlDictPageKey(page) & pages->mask;
+         pages->slots[i].chunk != NULL;
+         i = (i + 1) & pages->mask)
+        ;
+    pages->slots[i].page = page;
+    DICT_STORE(pages->slots[i].chunk, chunk);
+    pages->nbElems++;
+}
+
+/*
+ * xmlDictSharedAddChunk:
+ * @dict: the concurrent dictionnary
+ * @size: the size of the strings it holds
+ *
+ * Allocate a string chunk and record its pages for xmlDictOwns
+ *
+ * Returns the chunk or NULL past the limit or in case of error
+ */
+static xmlDictStringsPtr
+xmlDictSharedAddChunk(xmlDictPtr dict, size_t size) {
+    xmlDictStringsPtr chunk;
+    xmlDictPagesPtr pages, grown;
+    size_t first, last, page, i, nb;
+
+    chunk = (xmlDictStringsPtr) xmlMalloc(sizeof(xmlDictStrings) + size);
+    if (chunk == NULL)
+        return(NULL);
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->nbStrings = 0;
+    chunk->free = &chunk->array[0];
+    chunk->end = &chunk->array[size];
+    first = ((size_t) chunk->free) >> DICT_PAGE_SHIFT;
+    last = ((size_t) (chunk->end - 1)) >> DICT_PAGE_SHIFT;
+    nb = last - first + 1;
+
+    xmlMutexLock(dict->pagesLock);
+    if ((dict->limit > 0) && (dict->usage > dict->limit))
+        goto error;
+    pages = dict->pages;
+    if (2 * (pages->nbElems + nb) > pages->mask + 1) {
+        size = 2 * (pages->mask + 1);
+        while (2 * (pages->nbElems + nb) > size)
+            size *= 2;
+        grown = xmlDictPagesNew(size);
+        if (grown == NULL)
+            goto error;
+        for (i = 0; i <= pages->mask; i++) {
+            if (pages->slots[i].chunk != NULL)
+                xmlDictPagesInsert(grown, pages->slots[i].page,
+                                   pages->slots[i].chunk);
+        }
+        grown->retired = pages;
+        DICT_STORE(dict->pages, grown);
+        pages = grown;
+    }
+    for (page = first; page <= last; page++)
+        xmlDictPagesInsert(pages, page, chunk);
+    DICT_STORE(dict->usage, dict->usage + chunk->size);
+    xmlMutexUnlock(dict->pagesLock);
+    return(chunk);
+
+error:
+    xmlMutexUnlock(dict->pagesLock);
+    xmlFree(chunk);
+    return(NULL);
+}
+
+/*
+ * xmlDictSharedAddString:
+ * @dict: the concurrent dictionnary
+ * @shard: the shard, locked
+ * @prefix: the prefix of the userdata or NULL
+ * @plen: the prefix length
+ * @name: the name of the userdata
+ * @namelen: the length of the name
+ *
+ * Add the string or QName to the chunks of @shard
+ *
+ * Returns the pointer of the local string, or NULL in case of error.
+ */
+static const xmlChar *
+xmlDictSharedAddString(xmlDictPtr dict, xmlDictShardPtr shard,
+                       const xmlChar *prefix, unsigned int plen,
+                       const xmlChar *name, unsigned int namelen) {
+    xmlDictStringsPtr pool = shard->strings;
+    xmlChar *ret;
+    size_t len, size;
+
+    len = namelen + 1;
+    if (prefix != NULL)
+        len += plen + 1;
+
+    if (len > DICT_CHUNK_MAX / 4) {
+        /*
+         * A big string gets a chunk of its own, put behind the current
+         * one which keeps its room for the next ones
+         */
+        pool = xmlDictSharedAddChunk(dict, len);
+        if (pool == NULL)
+            return(NULL);
+        if (shard->strings != NULL) {
+            pool->next = shard->strings->next;
+            shard->strings->next = pool;
+        } else {
+            shard->strings = pool;
+        }
+    } else if ((pool == NULL) || ((size_t) (pool->end - pool->free) < len)) {
+        if (pool == NULL)
+            size = DICT_CHUNK_MIN;
+        else if (pool->size >= DICT_CHUNK_MAX / 2)
+            size = DICT_CHUNK_MAX;
+        else
+            size = 2 * pool->size;
+        pool = xmlDictSharedAddChunk(dict, size);
+        if (pool == NULL)
+            return(NULL);
+        pool->next = shard->strings;
+        shard->strings = pool;
+    }
+
+    ret = pool->free;
+    if (prefix != NULL) {
+        memcpy(pool->free, prefix, plen);
+        pool->free += plen;
+        *(pool->free++) = ':';
+    }
+    memcpy(pool->free, name, namelen);
+    pool->free += namelen;
+    *(pool->free++) = 0;
+    pool->nbStrings++;
+    return(ret);
+}
+
+static const xmlChar *
+xmlDictTableFind(xmlDictTablePtr table, unsigned int okey,
+                 const xmlChar *prefix, const xmlChar *name,
+                 unsigned int len) {
+    const xmlChar *cur;
+    size_t i;
+
+    for (i = okey & table->mask;
+         (cur = DICT_LOAD(table->slots[i].name)) != NULL;
+         i = (i + 1) & table->mask) {
+        if ((table->slots[i].okey == okey) && (table->slots[i].len == len)) {
+            if (prefix == NULL) {
+                if (!memcmp(cur, name, len))
+                    return(cur);
+            } else if (xmlStrQEqual(prefix, name, cur)) {
+                return(cur);
+            }
+        }
+    }
+    return(NULL);
+}
+
+static void
+xmlDictTableInsert(xmlDictTablePtr table, const xmlChar *name,
+                   unsigned int len, unsigned int okey) {
+    size_t i;
+
+    for (i = okey & table->mask;
+         table->slots[i].name != NULL;
+         i = (i + 1) & table->mask)
+        ;
+    table->slots[i].len = len;
+    table->slots[i].okey = okey;
+    DICT_STORE(table->slots[i].name, name);
+}
+
+/*
+ * xmlDictSharedLookup:
+ * @dict: the concurrent dictionnary
+ * @prefix: the prefix or NULL
+ * @plen: the prefix length
+ * @name: the name
+ * @l: the name length
+ * @create: whether to add the string if not present
+ *
+ * Lookup the string or QName in @dict, the key is the same for the
+ * QName prefix:name and the string "prefix:name".
+ *
+ * Returns the internal copy of the string, or NULL if not found and
+ * in case of error
+ */
+static const xmlChar *
+xmlDictSharedLookup(xmlDictPtr dict, const xmlChar *prefix,
+                    unsigned int plen, const xmlChar *name,
+                    unsigned int l, int create) {
+    xmlDictShardPtr shard;
+    xmlDictTablePtr table, grown;
+    unsigned int okey, len;
+    const xmlChar *ret;
+    size_t i;
+
+    if (prefix == NULL) {
+        okey = xmlDictComputeBigKey(name, l, dict->seed);
+        len = l;
+    } else {
+        okey = xmlDictComputeBigQKey(prefix, plen, name, l, dict->seed);
+        len = plen + 1 + l;
+    }
+    shard = &dict->shards[okey >> (32 - DICT_SHARD_BITS)];
+
+    DICT_READ_LOCK(shard->lock);
+    ret = xmlDictTableFind(DICT_LOAD(shard->table), okey, prefix, name, len);
+    DICT_READ_UNLOCK(shard->lock);
+    if ((ret != NULL) || (!create))
+        return(ret);
+
+    xmlMutexLock(shard->lock);
+    /* another thread may have added it in the meantime */
+    table = shard->table;
+    ret = xmlDictTableFind(table, okey, prefix, name, len);
+    if (ret != NULL)
+        goto done;
+
+    if (2 * (shard->nbElems + 1) > table->mask + 1) {
+        grown = xmlDictTableNew(2 * (table->mask + 1));
+        if (grown == NULL)
+            goto done;
+        for (i = 0; i <= table->mask; i++) {
+            if (table->slots[i].name != NULL)
+                xmlDictTableInsert(grown, table->slots[i].name,
+                                   table->slots[i].len, table->slots[i].okey);
+        }
+        grown->retired = table;
+        DICT_STORE(shard->table, grown);
+        table = grown;
+    }
+
+    ret = xmlDictSharedAddString(dict, shard, prefix, plen, name, l);
+    if (ret == NULL)
+        goto done;
+    xmlDictTableInsert(table, ret, len, okey);
+    DICT_STORE(shard->nbElems, shard->nbElems + 1);
+
+done:
+    xmlMutexUnlock(shard->lock);
+    return(ret);
+}
+
+static int
+xmlDictSharedOwns(xmlDictPtr dict, const xmlChar *str) {
+    xmlDictPagesPtr pages;
+    xmlDictStringsPtr chunk;
+    size_t page = ((size_t) str) >> DICT_PAGE_SHIFT;
+    size_t i;
+    int ret = 0;
+
+    DICT_READ_LOCK(dict->pagesLock);
+    pages = DICT_LOAD(dict->pages);
+    for (i = xmlDictPageKey(page) & pages->mask;
+         (chunk = DICT_LOAD(pages->slots[i].chunk)) != NULL;
+         i = (i + 1) & pages->mask) {
+        if ((pages->slots[i].page == page) &&
+            (str >= &chunk->array[0]) && (str < chunk->end)) {
+            ret = 1;
+            break;
+        }
+    }
+    DICT_READ_UNLOCK(dict->pagesLock);
+    return(ret);
+}
+
+static int
+xmlDictSharedSize(xmlDictPtr dict) {
+    size_t nbElems = 0;
+    int i;
+
+    for (i = 0; i < DICT_SHARDS; i++)
+        nbElems += DICT_LOAD(dict->shards[i].nbElems);
+    return(nbElems);
+}
+
+static void
+xmlDictFreeShared(xmlDictPtr dict) {
+    xmlDictShardPtr shard;
+    xmlDictTablePtr table;
+    xmlDictStringsPtr pool;
+    xmlDictPagesPtr pages;
+    void *next;
+    int i;
+
+    if (dict->shards != NULL) {
+        for (i = 0; i < DICT_SHARDS; i++) {
+            shard = &dict->shards[i];
+            for (table = shard->table; table != NULL; table = next) {
+                next = table->retired;
+                xmlFree(table);
+            }
+            for (pool = shard->strings; pool != NULL; pool = next) {
+                next = pool->next;
+                xmlFree(pool);
+            }
+            if (shard->lock != NULL)
+                xmlFreeMutex(shard->lock);
+        }
+        xmlFree(dict->shardsMem);
+    }
+    for (pages = dict->pages; pages != NULL; pages = next) {
+        next = pages->retired;
+        xmlFree(pages);
+    }
+    if (dict->pagesLock != NULL)
+        xmlFreeMutex(dict->pagesLock);
+}
+
 /**
  * xmlDictCreate:
  *
@@ -557,6 +997,11 @@ xmlDictCreate(void) {
         dict->dict = xmlMalloc(MIN_DICT_SIZE * sizeof(xmlDictEntry));
 	dict->strings = NULL;
 	dict->subdict = NULL;
+        dict->shards = NULL;
+        dict->shardsMem = NULL;
+        dict->pages = NULL;
+        dict->pagesLock = NULL;
+        dict->usage = 0;
         if (dict->dict) {
 	    memset(dict->dict, 0, MIN_DICT_SIZE * sizeof(xmlDictEntry));
 #ifdef DICT_RANDOMIZATION
@@ -597,6 +1042,55 @@ xmlDictCreateSub(xmlDictPtr sub) {
     return(dict);
 }
 
+/**
+ * xmlDictCreateConcurrent:
+ *
+ * Create a new dictionary that many threads can use at once, like a
+ * dictionary shared by the parsers of a pool of threads. Lookups of
+ * strings already present do not take a lock, and adding a string
+ * only locks out the threads adding a string to the same shard.
+ * Its size limit is XML_MAX_DICTIONARY_LIMIT, that of a parser without
+ * XML_PARSE_HUGE, and xmlDictSetLimit() does not change it.
+ *
+ * Returns the newly created dictionnary, or NULL if an error occured.
+ */
+xmlDictPtr
+xmlDictCreateConcurrent(void) {
+    xmlDictPtr dict;
+    int i;
+
+    dict = xmlDictCreate();
+    if (dict == NULL)
+        return(NULL);
+
+    /* the parsers sharing it would all set it, while others look it up */
+    dict->limit = XML_MAX_DICTIONARY_LIMIT;
+
+    dict->shardsMem = xmlMalloc(DICT_SHARDS * sizeof(xmlDictShard) +
+                                DICT_SHARD_ALIGN - 1);
+    if (dict->shardsMem == NULL)
+        goto error;
+    dict->shards = (xmlDictShardPtr)
+        (((size_t) dict->shardsMem + DICT_SHARD_ALIGN - 1) &
+         ~((size_t) DICT_SHARD_ALIGN - 1));
+    memset(dict->shards, 0, DICT_SHARDS * sizeof(xmlDictShard));
+    for (i = 0; i < DICT_SHARDS; i++) {
+        dict->shards[i].lock = xmlNewMutex();
+        dict->shards[i].table = xmlDictTableNew(DICT_SHARD_MIN_SIZE);
+        if ((dict->shards[i].lock == NULL) || (dict->shards[i].table == NULL))
+            goto error;
+    }
+    dict->pagesLock = xmlNewMutex();
+    dict->pages = xmlDictPagesNew(DICT_PAGES_MIN_SIZE);
+    if ((dict->pagesLock == NULL) || (dict->pages == NULL))
+        goto error;
+    return(dict);
+
+error:
+    xmlDictFree(dict);
+    return(NULL);
+}
+
 /**
  * xmlDictReference:
  * @dict: the dictionnary
@@ -612,9 +1106,13 @@ xmlDictReference(xmlDictPtr dict) {
             return(-1);
 
     if (dict == NULL) return -1;
+#ifdef DICT_ATOMICS
+    __atomic_add_fetch(&dict->ref_counter, 1, __ATOMIC_RELAXED);
+#else
     xmlRMutexLock(xmlDictMutex);
     dict->ref_counter++;
     xmlRMutexUnlock(xmlDictMutex);
+#endif
     return(0);
 }
 
@@ -776,6 +1274,10 @@ xmlDictFree(xmlDictPtr dict) {
             return;
 
     /* decrement the counter, it may be shared by a parser and docs */
+#ifdef DICT_ATOMICS
+    if (__atomic_sub_fetch(&dict->ref_counter, 1, __ATOMIC_ACQ_REL) > 0)
+        return;
+#else
     xmlRMutexLock(xmlDictMutex);
     dict->ref_counter--;
     if (dict->ref_counter > 0) {
@@ -784,6 +1286,7 @@ xmlDictFree(xmlDictPtr dict) {
     }
 
     xmlRMutexUnlock(xmlDictMutex);
+#endif
 
     if (dict->subdict != NULL) {
         xmlDictFree(dict->subdict);
@@ -812,6 +1315,7 @@ xmlDictFree(xmlDictPtr dict) {
 	xmlFree(pool);
 	pool = nextp;
     }
+    xmlDictFreeShared(dict);
     xmlFree(dict);
 }
 
@@ -845,6 +1349,9 @@ xmlDictLookup(xmlDictPtr dict, const xmlChar *name, int len) {
         (l > INT_MAX / 2))
         return(NULL);
 
+    if (dict->shards != NULL)
+        return(xmlDictSharedLookup(dict, NULL, 0, name, l, 1));
+
     /*
      * Check for duplicate and insertion location.
      */
@@ -879,7 +1386,11 @@ xmlDictLookup(xmlDictPtr dict, const xmlChar *name, int len) {
 #endif
     }
 
-    if (dict->subdict) {
+    if ((dict->subdict) && (dict->subdict->shards != NULL)) {
+        ret = xmlDictSharedLookup(dict->subdict, NULL, 0, name, l, 0);
+        if (ret != NULL)
+            return(ret);
+    } else if (dict->subdict) {
         unsigned long skey;
 
         /* we cannot always reuse the same okey for the subdict */
@@ -969,6 +1480,7 @@ const xmlChar *
 xmlDictExists(xmlDictPtr dict, const xmlChar *name, int len) {
     unsigned long key, okey, nbi = 0;
     xmlDictEntryPtr insert;
+    const xmlChar *ret;
     unsigned int l;
 
     if ((dict == NULL) || (name == NULL))
@@ -982,6 +1494,9 @@ xmlDictExists(xmlDictPtr dict, const xmlChar *name, int len) {
         (l > INT_MAX / 2))
         return(NULL);
 
+    if (dict->shards != NULL)
+        return(xmlDictSharedLookup(dict, NULL, 0, name, l, 0));
+
     /*
      * Check for duplicate and insertion location.
      */
@@ -1016,7 +1531,11 @@ xmlDictExists(xmlDictPtr dict, const xmlChar *name, int len) {
 #endif
     }
 
-    if (dict->subdict) {
+    if ((dict->subdict) && (dict->subdict->shards != NULL)) {
+        ret = xmlDictSharedLookup(dict->subdict, NULL, 0, name, l, 0);
+        if (ret != NULL)
+            return(ret);
+    } else if (dict->subdict) {
         unsigned long skey;
 
         /* we cannot always reuse the same okey for the subdict */
@@ -1090,6 +1609,9 @@ xmlDictQLookup(xmlDictPtr dict, const xmlChar *prefix, const xmlChar *name) {
     plen = strlen((const char *) prefix);
     len += 1 + plen;
 
+    if (dict->shards != NULL)
+        return(xmlDictSharedLookup(dict, prefix, plen, name, l, 1));
+
     /*
      * Check for duplicate and insertion location.
      */
@@ -1110,7 +1632,11 @@ xmlDictQLookup(xmlDictPtr dict, const xmlChar *prefix, const xmlChar *name) {
 	    return(insert->name);
     }
 
-    if (dict->subdict) {
+    if ((dict->subdict) && (dict->subdict->shards != NULL)) {
+        ret = xmlDictSharedLookup(dict->subdict, prefix, plen, name, l, 0);
+        if (ret != NULL)
+            return(ret);
+    } else if (dict->subdict) {
         unsigned long skey;
 
         /* we cannot always reuse the same okey for the subdict */
@@ -1184,6 +1710,8 @@ xmlDictOwns(xmlDictPtr dict, const xmlChar *str) {
 
     if ((dict == NULL) || (str == NULL))
 	return(-1);
+    if (dict->shards != NULL)
+        return(xmlDictSharedOwns(dict, str));
     pool = dict->strings;
     while (pool != NULL) {
         if ((str >= &pool->array[0]) && (str <= pool->free))
@@ -1208,6 +1736,10 @@ int
 xmlDictSize(xmlDictPtr dict) {
     if (dict == NULL)
 	return(-1);
+    if (dict->shards != NULL)
+        return(xmlDictSharedSize(dict));
+    if ((dict->subdict) && (dict->subdict->shards != NULL))
+        return(dict->nbElems + xmlDictSharedSize(dict->subdict));
     if (dict->subdict)
         return(dict->nbElems + dict->subdict->nbElems);
     return(dict->nbElems);
@@ -1218,7 +1750,7 @@ xmlDictSize(xmlDictPtr dict) {
  * @dict: the dictionnary
  * @limit: the limit in bytes
  *
- * Set a size limit for the dictionary
+ * Set a size limit for the dictionary, unless it is a concurrent one
  * Added in 2.9.0
  *
  * Returns the previous limit of the dictionary or 0
@@ -1230,7 +1762,9 @@ xmlDictSetLimit(xmlDictPtr dict, size_t limit) {
     if (dict == NULL)
 	return(0);
     ret = dict->limit;
-    dict->limit = limit;
+    /* the limit of a concurrent dictionary is fixed when it is created */
+    if (dict->shards == NULL)
+        dict->limit = limit;
     return(ret);
 }
 
@@ -1250,6 +1784,8 @@ xmlDictGetUsage(xmlDictPtr dict) {
 
     if (dict == NULL)
 	return(0);
+    if (dict->shards != NULL)
+        return(DICT_LOAD(dict->usage));
     pool = dict->strings;
     while (pool != NULL) {
         limit += pool->size;
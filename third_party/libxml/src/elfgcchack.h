@@ -2881,6 +2881,16 @@ extern __typeof (xmlDictCreate) xmlDictCreate__internal_alias __attribute((visib
 #endif
 #endif
 
+#ifdef bottom_dict
+#undef xmlDictCreateConcurrent
+extern __typeof (xmlDictCreateConcurrent) xmlDictCreateConcurrent __attribute((alias("xmlDictCreateConcurrent__internal_alias")));
+#else
+#ifndef xmlDictCreateConcurrent
+extern __typeof (xmlDictCreateConcurrent) xmlDictCreateConcurrent__internal_alias __attribute((visibility("hidden")));
+#define xmlDictCreateConcurrent xmlDictCreateConcurrent__internal_alias
+#endif
+#endif
+
 #ifdef bottom_dict
 #undef xmlDictCreateSub
 extern __typeof (xmlDictCreateSub) xmlDictCreateSub __attribute((alias("xmlDictCreateSub__internal_alias")));
@@ -8197,6 +8207,18 @@ extern __typeof (xmlReaderNewWalker) xmlReaderNewWalker__internal_alias __attrib
 #endif
 #endif
 
+#if defined(LIBXML_READER_ENABLED)
+#ifdef bottom_xmlreader
+#undef xmlReaderTreeForMemory
+extern __typeof (xmlReaderTreeForMemory) xmlReaderTreeForMemory __attribute((alias("xmlReaderTreeForMemory__internal_alias")));
+#else
+#ifndef xmlReaderTreeForMemory
+extern __typeof (xmlReaderTreeForMemory) xmlReaderTreeForMemory__internal_alias __attribute((visibility("hidden")));
+#define xmlReaderTreeForMemory xmlReaderTreeForMemory__internal_alias
+#endif
+#endif
+#endif
+
 #if defined(LIBXML_READER_ENABLED)
 #ifdef bottom_xmlreader
 #undef xmlReaderWalker
@@ -15903,6 +15925,30 @@ extern __typeof (xmlXPathCmpNodes) xmlXPathCmpNodes__internal_alias __attribute(
 #endif
 #endif
 
+#if defined(LIBXML_XPATH_ENABLED)
+#ifdef bottom_xpath
+#undef xmlXPathCompCacheLookup
+extern __typeof (xmlXPathCompCacheLookup) xmlXPathCompCacheLookup __attribute((alias("xmlXPathCompCacheLookup__internal_alias")));
+#else
+#ifndef xmlXPathCompCacheLookup
+extern __typeof (xmlXPathCompCacheLookup) xmlXPathCompCacheLookup__internal_alias __attribute((visibility("hidden")));
+#define xmlXPathCompCacheLookup xmlXPathCompCacheLookup__internal_alias
+#endif
+#endif
+#endif
+
+#if defined(LIBXML_XPATH_ENABLED)
+#ifdef bottom_xpath
+#undef xmlXPathCompCacheRelease
+extern __typeof (xmlXPathCompCacheRelease) xmlXPathCompCacheRelease __attribute((alias("xmlXPathCompCacheRelease__internal_alias")));
+#else
+#ifndef xmlXPathCompCacheRelease
+extern __typeof (xmlXPathCompCacheRelease) xmlXPathCompCacheRelease__internal_alias __attribute((visibility("hidden")));
+#define xmlXPathCompCacheRelease xmlXPathCompCacheRelease__internal_alias
+#endif
+#endif
+#endif
+
 #if defined(LIBXML_XPATH_ENABLED)
 #ifdef bottom_xpath
 #undef xmlXPathCompareValues
@@ -15939,6 +15985,18 @@ extern __typeof (xmlXPathCompiledEval) xmlXPathCompiledEval__internal_alias __at
 #endif
 #endif
 
+#if defined(LIBXML_XPATH_ENABLED)
+#ifdef bottom_xpath
+#undef xmlXPathCompiledEvalStream
+extern __typeof (xmlXPathCompiledEvalStream) xmlXPathCompiledEvalStream __attribute((alias("xmlXPathCompiledEvalStream__internal_alias")));
+#else
+#ifndef xmlXPathCompiledEvalStream
+extern __typeof (xmlXPathCompiledEvalStream) xmlXPathCompiledEvalStream__internal_alias __attribute((visibility("hidden")));
+#define xmlXPathCompiledEvalStream xmlXPathCompiledEvalStream__internal_alias
+#endif
+#endif
+#endif
+
 #if defined(LIBXML_XPATH_ENABLED)
 #ifdef bottom_xpath
 #undef xmlXPathCompiledEvalToBoolean
@@ -16227,6 +16285,18 @@ extern __typeof (xmlXPathFloorFunction) xmlXPathFloorFunction__internal_alias __
 #endif
 #endif
 
+#if defined(LIBXML_XPATH_ENABLED)
+#ifdef bottom_xpath
+#undef xmlXPathFreeCompCache
+extern __typeof (xmlXPathFreeCompCache) xmlXPathFreeCompCache __attribute((alias("xmlXPathFreeCompCache__internal_alias")));
+#else
+#ifndef xmlXPathFreeCompCache
+extern __typeof (xmlXPathFreeCompCache) xmlXPathFreeCompCache__internal_alias __attribute((visibility("hidden")));
+#define xmlXPathFreeCompCache xmlXPathFreeCompCache__internal_alias
+#endif
+#endif
+#endif
+
 #if defined(LIBXML_XPATH_ENABLED)
 #ifdef bottom_xpath
 #undef xmlXPathFreeCompExpr
@@ -16527,6 +16597,18 @@ extern __typeof (xmlXPathNewCString) xmlXPathNewCString__internal_alias __attrib
 #endif
 #endif
 
+#if defined(LIBXML_XPATH_ENABLED)
+#ifdef bottom_xpath
+#undef xmlXPathNewCompCache
+extern __typeof (xmlXPathNewCompCache) xmlXPathNewCompCache __attribute((alias("xmlXPathNewCompCache__internal_alias")));
+#else
+#ifndef xmlXPathNewCompCache
+extern __typeof (xmlXPathNewCompCache) xmlXPathNewCompCache__internal_alias __attribute((visibility("hidden")));
+#define xmlXPathNewCompCache xmlXPathNewCompCache__internal_alias
+#endif
+#endif
+#endif
+
 #if defined(LIBXML_XPATH_ENABLED)
 #ifdef bottom_xpath
 #undef xmlXPathNewContext
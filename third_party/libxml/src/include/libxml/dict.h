@@ -42,6 +42,8 @@ XMLPUBFUN size_t XMLCALL
 			xmlDictGetUsage (xmlDictPtr dict);
 XMLPUBFUN xmlDictPtr XMLCALL
 			xmlDictCreateSub(xmlDictPtr sub);
+XMLPUBFUN xmlDictPtr XMLCALL
+			xmlDictCreateConcurrent(void);
 XMLPUBFUN int XMLCALL
 			xmlDictReference(xmlDictPtr dict);
 XMLPUBFUN void XMLCALL
@@ -1111,7 +1111,10 @@ typedef enum {
     XML_PARSE_HUGE      = 1<<19,/* relax any hardcoded limit from the parser */
     XML_PARSE_OLDSAX    = 1<<20,/* parse using SAX2 interface before 2.7.0 */
     XML_PARSE_IGNORE_ENC= 1<<21,/* ignore internal document encoding hint */
-    XML_PARSE_BIG_LINES = 1<<22 /* Store big lines numbers in text PSVI field */
+    XML_PARSE_BIG_LINES = 1<<22,/* Store big lines numbers in text PSVI field */
+    XML_PARSE_ARENA     = 1<<23 /* allocate the tree from an arena freed with
+                                   the document; nodes must not be moved to
+                                   another document nor outlive it */
 } xmlParserOption;
 
 XMLPUBFUN void XMLCALL
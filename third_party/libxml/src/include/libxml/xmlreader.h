@@ -320,6 +320,13 @@ XMLPUBFUN long XMLCALL
  */
 XMLPUBFUN xmlTextReaderPtr XMLCALL
 		xmlReaderWalker		(xmlDocPtr doc);
+XMLPUBFUN xmlDocPtr XMLCALL
+		xmlReaderTreeForMemory	(xmlParserCtxtPtr ctxt,
+					 const char *buffer,
+					 int size,
+					 const char *URL,
+					 const char *encoding,
+					 int options);
 XMLPUBFUN xmlTextReaderPtr XMLCALL
 		xmlReaderForDoc		(const xmlChar * cur,
 					 const char *URL,
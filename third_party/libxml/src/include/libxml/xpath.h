@@ -361,6 +361,26 @@ struct _xmlXPathContext {
 typedef struct _xmlXPathCompExpr xmlXPathCompExpr;
 typedef xmlXPathCompExpr *xmlXPathCompExprPtr;
 
+/*
+ * A cache of compiled expressions, shared by the threads evaluating
+ * them; the structure is not public.
+ */
+
+typedef struct _xmlXPathCompCache xmlXPathCompCache;
+typedef xmlXPathCompCache *xmlXPathCompCachePtr;
+
+/**
+ * xmlXPathStreamFunc:
+ * @data:  the user data given to xmlXPathCompiledEvalStream()
+ * @node:  the next node selected by the expression
+ *
+ * Prototype for the callbacks receiving the nodes of a streamed
+ * evaluation, in document order.
+ *
+ * Returns 0 to go on, anything else to stop the evaluation.
+ */
+typedef int (*xmlXPathStreamFunc) (void *data, xmlNodePtr node);
+
 /**
  * xmlXPathParserContext:
  *
@@ -538,8 +558,27 @@ XMLPUBFUN xmlXPathObjectPtr XMLCALL
 XMLPUBFUN int XMLCALL
 		    xmlXPathCompiledEvalToBoolean(xmlXPathCompExprPtr comp,
 						 xmlXPathContextPtr ctxt);
+XMLPUBFUN int XMLCALL
+		    xmlXPathCompiledEvalStream	(xmlXPathCompExprPtr comp,
+						 xmlXPathContextPtr ctxt,
+						 xmlXPathStreamFunc func,
+						 void *data);
 XMLPUBFUN void XMLCALL
 		    xmlXPathFreeCompExpr	(xmlXPathCompExprPtr comp);
+/**
+ * Compiled expression cache.
+ */
+XMLPUBFUN xmlXPathCompCachePtr XMLCALL
+		    xmlXPathNewCompCache	(int max);
+XMLPUBFUN void XMLCALL
+		    xmlXPathFreeCompCache	(xmlXPathCompCachePtr cache);
+XMLPUBFUN xmlXPathCompExprPtr XMLCALL
+		    xmlXPathCompCacheLookup	(xmlXPathCompCachePtr cache,
+						 xmlXPathContextPtr ctxt,
+						 const xmlChar *str);
+XMLPUBFUN void XMLCALL
+		    xmlXPathCompCacheRelease	(xmlXPathCompCachePtr cache,
+						 xmlXPathCompExprPtr comp);
 #endif /* LIBXML_XPATH_ENABLED */
 #if defined(LIBXML_XPATH_ENABLED) || defined(LIBXML_SCHEMAS_ENABLED)
 XMLPUBFUN void XMLCALL
@@ -8169,6 +8169,31 @@ test_xmlDictCreate(void) {
 }
 
 
+static int
+test_xmlDictCreateConcurrent(void) {
+    int test_ret = 0;
+
+    int mem_base;
+    xmlDictPtr ret_val;
+
+        mem_base = xmlMemBlocks();
+
+        ret_val = xmlDictCreateConcurrent();
+        desret_xmlDictPtr(ret_val);
+        call_tests++;
+        xmlResetLastError();
+        if (mem_base != xmlMemBlocks()) {
+            printf("Leak of %d blocks found in xmlDictCreateConcurrent",
+	           xmlMemBlocks() - mem_base);
+	    test_ret++;
+            printf("\n");
+        }
+    function_tests++;
+
+    return(test_ret);
+}
+
+
 static int
 test_xmlDictCreateSub(void) {
     int test_ret = 0;
@@ -8491,9 +8516,10 @@ static int
 test_dict(void) {
     int test_ret = 0;
 
-    if (quiet == 0) printf("Testing dict : 10 of 13 functions ...\n");
+    if (quiet == 0) printf("Testing dict : 11 of 14 functions ...\n");
     test_ret += test_xmlDictCleanup();
     test_ret += test_xmlDictCreate();
+    test_ret += test_xmlDictCreateConcurrent();
     test_ret += test_xmlDictCreateSub();
     test_ret += test_xmlDictExists();
     test_ret += test_xmlDictGetUsage();
@@ -30460,6 +30486,75 @@ test_xmlReaderNewWalker(void) {
 }
 
 
+static int
+test_xmlReaderTreeForMemory(void) {
+    int test_ret = 0;
+
+#if defined(LIBXML_READER_ENABLED)
+    int mem_base;
+    xmlDocPtr ret_val;
+    xmlParserCtxtPtr ctxt; /* an XML parser context using the default SAX2 tree builder */
+    int n_ctxt;
+    char * buffer; /* a pointer to a char array */
+    int n_buffer;
+    int size; /* the size of the array */
+    int n_size;
+    const char * URL; /* the base URL to use for the document */
+    int n_URL;
+    char * encoding; /* the document encoding, or NULL */
+    int n_encoding;
+    int options; /* a combination of xmlParserOption */
+    int n_options;
+
+    for (n_ctxt = 0;n_ctxt < gen_nb_xmlParserCtxtPtr;n_ctxt++) {
+    for (n_buffer = 0;n_buffer < gen_nb_const_char_ptr;n_buffer++) {
+    for (n_size = 0;n_size < gen_nb_int;n_size++) {
+    for (n_URL = 0;n_URL < gen_nb_filepath;n_URL++) {
+    for (n_encoding = 0;n_encoding < gen_nb_const_char_ptr;n_encoding++) {
+    for (n_options = 0;n_options < gen_nb_parseroptions;n_options++) {
+        mem_base = xmlMemBlocks();
+        ctxt = gen_xmlParserCtxtPtr(n_ctxt, 0);
+        buffer = gen_const_char_ptr(n_buffer, 1);
+        size = gen_int(n_size, 2);
+        URL = gen_filepath(n_URL, 3);
+        encoding = gen_const_char_ptr(n_encoding, 4);
+        options = gen_parseroptions(n_options, 5);
+
+        ret_val = xmlReaderTreeForMemory(ctxt, (const char *)buffer, size, URL, (const char *)encoding, options);
+        desret_xmlDocPtr(ret_val);
+        call_tests++;
+        des_xmlParserCtxtPtr(n_ctxt, ctxt, 0);
+        des_const_char_ptr(n_buffer, (const char *)buffer, 1);
+        des_int(n_size, size, 2);
+        des_filepath(n_URL, URL, 3);
+        des_const_char_ptr(n_encoding, (const char *)encoding, 4);
+        des_parseroptions(n_options, options, 5);
+        xmlResetLastError();
+        if (mem_base != xmlMemBlocks()) {
+            printf("Leak of %d blocks found in xmlReaderTreeForMemory",
+	           xmlMemBlocks() - mem_base);
+	    test_ret++;
+            printf(" %d", n_ctxt);
+            printf(" %d", n_buffer);
+            printf(" %d", n_size);
+            printf(" %d", n_URL);
+            printf(" %d", n_encoding);
+            printf(" %d", n_options);
+            printf("\n");
+        }
+    }
+    }
+    }
+    }
+    }
+    }
+    function_tests++;
+#endif
+
+    return(test_ret);
+}
+
+
 static int
 test_xmlReaderWalker(void) {
     int test_ret = 0;
@@ -32973,7 +33068,7 @@ static int
 test_xmlreader(void) {
     int test_ret = 0;
 
-    if (quiet == 0) printf("Testing xmlreader : 76 of 86 functions ...\n");
+    if (quiet == 0) printf("Testing xmlreader : 77 of 87 functions ...\n");
     test_ret += test_xmlNewTextReader();
     test_ret += test_xmlNewTextReaderFilename();
     test_ret += test_xmlReaderForDoc();
@@ -32983,6 +33078,7 @@ test_xmlreader(void) {
     test_ret += test_xmlReaderNewFile();
     test_ret += test_xmlReaderNewMemory();
     test_ret += test_xmlReaderNewWalker();
+    test_ret += test_xmlReaderTreeForMemory();
     test_ret += test_xmlReaderWalker();
     test_ret += test_xmlTextReaderAttributeCount();
     test_ret += test_xmlTextReaderBaseUri();
@@ -46364,6 +46460,26 @@ test_xmlXPathCmpNodes(void) {
 }
 
 
+static int
+test_xmlXPathCompCacheLookup(void) {
+    int test_ret = 0;
+
+
+    /* missing type support */
+    return(test_ret);
+}
+
+
+static int
+test_xmlXPathCompCacheRelease(void) {
+    int test_ret = 0;
+
+
+    /* missing type support */
+    return(test_ret);
+}
+
+
 static int
 test_xmlXPathCompile(void) {
     int test_ret = 0;
@@ -46435,6 +46551,16 @@ test_xmlXPathCompiledEval(void) {
 }
 
 
+static int
+test_xmlXPathCompiledEvalStream(void) {
+    int test_ret = 0;
+
+
+    /* missing type support */
+    return(test_ret);
+}
+
+
 static int
 test_xmlXPathCompiledEvalToBoolean(void) {
     int test_ret = 0;
@@ -46862,6 +46988,16 @@ test_xmlXPathIsNaN(void) {
 }
 
 
+static int
+test_xmlXPathNewCompCache(void) {
+    int test_ret = 0;
+
+
+    /* missing type support */
+    return(test_ret);
+}
+
+
 static int
 test_xmlXPathNewContext(void) {
     int test_ret = 0;
@@ -47066,7 +47202,7 @@ static int
 test_xpath(void) {
     int test_ret = 0;
 
-    if (quiet == 0) printf("Testing xpath : 32 of 40 functions ...\n");
+    if (quiet == 0) printf("Testing xpath : 32 of 44 functions ...\n");
     test_ret += test_xmlXPathCastBooleanToNumber();
     test_ret += test_xmlXPathCastBooleanToString();
     test_ret += test_xmlXPathCastNodeSetToBoolean();
@@ -47082,8 +47218,11 @@ test_xpath(void) {
     test_ret += test_xmlXPathCastToNumber();
     test_ret += test_xmlXPathCastToString();
     test_ret += test_xmlXPathCmpNodes();
+    test_ret += test_xmlXPathCompCacheLookup();
+    test_ret += test_xmlXPathCompCacheRelease();
     test_ret += test_xmlXPathCompile();
     test_ret += test_xmlXPathCompiledEval();
+    test_ret += test_xmlXPathCompiledEvalStream();
     test_ret += test_xmlXPathCompiledEvalToBoolean();
     test_ret += test_xmlXPathContextSetCache();
     test_ret += test_xmlXPathConvertBoolean();
@@ -47096,6 +47235,7 @@ test_xpath(void) {
     test_ret += test_xmlXPathInit();
     test_ret += test_xmlXPathIsInf();
     test_ret += test_xmlXPathIsNaN();
+    test_ret += test_xmlXPathNewCompCache();
     test_ret += test_xmlXPathNewContext();
     test_ret += test_xmlXPathNodeEval();
     test_ret += test_xmlXPathNodeSetCreate();
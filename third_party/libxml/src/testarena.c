@@ -0,0 +1,265 @@
+/*
+ * Copyright 2016 The Chromium Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * testarena.c: parses a fixed generated corpus into trees, with the nodes
+ * allocated one by one and with XML_PARSE_ARENA, each mode in a child
+ * process so that the peak RSS of one does not hide the other.  Reports
+ * the parse and xmlFreeDoc() times and the peak RSS, and fails unless both
+ * modes built the same tree.
+ *
+ * usage: testarena [-s document size in MB] [-d documents] [-r rounds]
+ */
+
+#include "libxml.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#if defined(HAVE_UNISTD_H) && defined(HAVE_SYS_TIME_H) && \
+    defined(LIBXML_OUTPUT_ENABLED)
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <libxml/parser.h>
+#include <libxml/tree.h>
+
+static int doc_mb = 16;
+static int num_docs = 4;
+static int rounds = 3;
+
+static char *corpus;
+static int corpus_len;
+
+static const char *mode_names[] = { "malloc", "arena" };
+static const int mode_options[] = { 0, XML_PARSE_ARENA };
+#define NB_MODES (int) (sizeof(mode_names) / sizeof(mode_names[0]))
+
+/*
+ * The corpus
+ */
+static unsigned int seed = 1;
+
+static int
+next_random(int n) {
+    seed = seed * 1103515245 + 12345;
+    return((int) ((seed >> 8) % n));
+}
+
+static const char *words[] = {
+    "the", "feed", "record", "of", "market", "data", "values", "and",
+    "prices", "for", "each", "instrument", "with", "bid", "ask", "last",
+    "caf\xc3\xa9", "&amp;", "&lt;"
+};
+#define NB_WORDS (int) (sizeof(words) / sizeof(words[0]))
+
+static void
+append(int *size, const char *str) {
+    int len = strlen(str);
+
+    if (corpus_len + len + 1 > *size) {
+        *size = 2 * (*size) + len;
+        corpus = realloc(corpus, *size);
+        if (corpus == NULL) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    memcpy(corpus + corpus_len, str, len);
+    corpus_len += len;
+    corpus[corpus_len] = 0;
+}
+
+/*
+ * Many small records, as a feed of quotes: a few attributes, short text
+ * fields and the odd longer description, which is the shape that makes
+ * one allocation per node and per string expensive.
+ */
+static void
+generate_corpus(void) {
+    char buf[256];
+    int size = 0, i, j, n;
+
+    append(&size, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+           "<quotes xmlns=\"http://example.com/quotes\">\n");
+    for (i = 0; corpus_len < doc_mb * 1024 * 1024; i++) {
+        snprintf(buf, sizeof(buf),
+                 "  <quote id=\"q%d\" venue=\"X%d\" seq=\"%d\">\n"
+                 "    <symbol>S%04d</symbol>\n"
+                 "    <bid size=\"%d\">%d.%02d</bid>\n"
+                 "    <ask size=\"%d\">%d.%02d</ask>\n",
+                 i, i % 7, i * 3, i % 5000,
+                 next_random(1000), next_random(500), next_random(100),
+                 next_random(1000), next_random(500), next_random(100));
+        append(&size, buf);
+        if (next_random(4) == 0) {
+            append(&size, "    <note>");
+            for (j = 0, n = 4 + next_random(40); j < n; j++) {
+                append(&size, words[next_random(NB_WORDS)]);
+                append(&size, " ");
+            }
+            append(&size, "</note>\n");
+        }
+        append(&size, "  </quote>\n");
+    }
+    append(&size, "</quotes>\n");
+}
+
+static double
+seconds_since(const struct timeval *start) {
+    struct timeval end;
+
+    gettimeofday(&end, NULL);
+    return((end.tv_sec - start->tv_sec) +
+           (end.tv_usec - start->tv_usec) / 1000000.0);
+}
+
+/*
+ * FNV-1a of the serialized tree
+ */
+static unsigned long long
+hash_doc(xmlDocPtr doc) {
+    unsigned long long hash = 14695981039346656037ULL;
+    xmlChar *mem;
+    int size, i;
+
+    xmlDocDumpMemory(doc, &mem, &size);
+    for (i = 0; i < size; i++) {
+        hash ^= mem[i];
+        hash *= 1099511628211ULL;
+    }
+    xmlFree(mem);
+    return(hash);
+}
+
+/*
+ * Parse the corpus @num_docs times, holding all the trees at once, and
+ * free them, reporting the best times of the rounds, the peak RSS and
+ * the hash of a tree on @fd.
+ */
+static void
+run_child(int fd, int mode) {
+    xmlDocPtr *docs;
+    struct timeval start;
+    struct rusage usage;
+    double secs, best_parse = 0, best_free = 0;
+    unsigned long long hash = 0;
+    char line[128];
+    int i, j;
+
+    docs = calloc(num_docs, sizeof(xmlDocPtr));
+    if (docs == NULL)
+        _exit(1);
+    xmlInitParser();
+
+    for (i = 0; i < rounds; i++) {
+        gettimeofday(&start, NULL);
+        for (j = 0; j < num_docs; j++) {
+            docs[j] = xmlReadMemory(corpus, corpus_len, NULL, NULL,
+                                    mode_options[mode]);
+            if (docs[j] == NULL) {
+                fprintf(stderr, "The corpus failed to parse\n");
+                _exit(1);
+            }
+        }
+        secs = seconds_since(&start);
+        if ((best_parse == 0) || (secs < best_parse))
+            best_parse = secs;
+
+        if (i == 0)
+            hash = hash_doc(docs[0]);
+
+        gettimeofday(&start, NULL);
+        for (j = 0; j < num_docs; j++)
+            xmlFreeDoc(docs[j]);
+        secs = seconds_since(&start);
+        if ((best_free == 0) || (secs < best_free))
+            best_free = secs;
+    }
+    free(docs);
+
+    getrusage(RUSAGE_SELF, &usage);
+    snprintf(line, sizeof(line), "%.1f\t%.1f\t%.1f\t%ld\t%016llx\n",
+             best_parse * 1000, best_free * 1000,
+             (best_parse + best_free) * 1000, usage.ru_maxrss / 1024, hash);
+    if (write(fd, line, strlen(line)) != (ssize_t) strlen(line))
+        _exit(1);
+    _exit(0);
+}
+
+int
+main(int argc, char **argv) {
+    char first[32], line[128];
+    int i, fds[2], status, len;
+    pid_t pid;
+
+    for (i = 1; i < argc; i++) {
+        if ((i + 1 < argc) && (!strcmp(argv[i], "-s")))
+            doc_mb = atoi(argv[++i]);
+        else if ((i + 1 < argc) && (!strcmp(argv[i], "-d")))
+            num_docs = atoi(argv[++i]);
+        else if ((i + 1 < argc) && (!strcmp(argv[i], "-r")))
+            rounds = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "Illegal argument \"%s\"\n", argv[i]);
+            exit(1);
+        }
+    }
+    if ((doc_mb < 1) || (num_docs < 1) || (rounds < 1)) {
+        fprintf(stderr, "Arguments must be positive\n");
+        exit(1);
+    }
+
+    generate_corpus();
+
+    printf("%d documents of %.1f MB\n", num_docs, corpus_len / 1048576.0);
+    printf("mode\tparse ms\tfree ms\ttotal ms\tpeak RSS MB\ttree hash\n");
+    first[0] = 0;
+    for (i = 0; i < NB_MODES; i++) {
+        if (pipe(fds) != 0) {
+            perror("pipe");
+            exit(1);
+        }
+        fflush(stdout);
+        pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            exit(1);
+        }
+        if (pid == 0) {
+            close(fds[0]);
+            run_child(fds[1], i);
+        }
+        close(fds[1]);
+        len = read(fds[0], line, sizeof(line) - 1);
+        close(fds[0]);
+        if ((waitpid(pid, &status, 0) != pid) || (!WIFEXITED(status)) ||
+            (WEXITSTATUS(status) != 0) || (len <= 0)) {
+            fprintf(stderr, "%s: the parse failed\n", mode_names[i]);
+            exit(1);
+        }
+        line[len] = 0;
+        printf("%s\t%s", mode_names[i], line);
+        if (first[0] == 0) {
+            snprintf(first, sizeof(first), "%s", strrchr(line, '\t') + 1);
+        } else if (strcmp(first, strrchr(line, '\t') + 1)) {
+            fprintf(stderr, "%s: the trees differ\n", mode_names[i]);
+            exit(1);
+        }
+    }
+
+    free(corpus);
+    return(0);
+}
+
+#else /* !HAVE_UNISTD_H || !HAVE_SYS_TIME_H || !LIBXML_OUTPUT_ENABLED */
+int
+main(void) {
+    fprintf(stderr, "testarena needs fork() and the output support\n");
+    return(0);
+}
+#endif
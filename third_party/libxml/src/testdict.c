@@ -1,6 +1,7 @@
 #include <string.h>
 #include <libxml/parser.h>
 #include <libxml/dict.h>
+#include <libxml/parserInternals.h>
 
 /* #define WITH_PRINT */
 
@@ -307,9 +308,9 @@ static int run_test2(xmlDictPtr parent) {
 }
 
 /*
- * Test a single dictionary
+ * Test a single dictionary, concurrent or not
  */
-static int run_test1(void) {
+static int run_test1(int concurrent) {
     int i, j;
     xmlDictPtr dict;
     int ret = 0;
@@ -317,11 +318,22 @@ static int run_test1(void) {
     xmlChar *cur, *pref;
     const xmlChar *tmp;
 
-    dict = xmlDictCreate();
+    if (concurrent)
+        dict = xmlDictCreateConcurrent();
+    else
+        dict = xmlDictCreate();
     if (dict == NULL) {
 	fprintf(stderr, "Out of memory while creating dictionary\n");
 	exit(1);
     }
+    /* the limit of a concurrent dictionary is fixed */
+    if ((concurrent) &&
+        ((xmlDictSetLimit(dict, 0) != XML_MAX_DICTIONARY_LIMIT) ||
+         (xmlDictSetLimit(dict, 0) != XML_MAX_DICTIONARY_LIMIT))) {
+	fprintf(stderr, "Concurrent dictionary limit changed\n");
+	ret = 1;
+	nbErrors++;
+    }
     memset(test1, 0, sizeof(test1));
 
     /*
@@ -431,7 +443,9 @@ int main(void)
 #ifdef WITH_PRINT
     print_strings();
 #endif
-    ret = run_test1();
+    ret = run_test1(0);
+    if (ret == 0)
+        ret = run_test1(1);
     if (ret == 0) {
         printf("dictionary tests succeeded %d strings\n", 2 * NB_STRINGS_MAX);
     } else {
@@ -0,0 +1,279 @@
+/*
+ * Copyright 2016 The Chromium Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * testdictmt.c: parses a set of generated documents on a pool of threads,
+ * each thread with a parser context of its own, and the names interned in
+ * one of three ways: a dictionary private to each context, a sub-dictionary
+ * of a read-only dictionary holding the common names, and one concurrent
+ * dictionary shared by all the contexts.  Reports documents/s against the
+ * thread count, and the memory the dictionaries use for strings.
+ *
+ * usage: testdictmt [-n documents] [-e entries per document]
+ *                   [-v distinct names] [-t max threads]
+ */
+
+#include "libxml.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#if defined(LIBXML_THREAD_ENABLED) && defined(HAVE_PTHREAD_H)
+#include <string.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <libxml/parser.h>
+#include <libxml/tree.h>
+#include <libxml/dict.h>
+
+static int num_docs = 4000;
+static int num_entries = 20;
+static int num_names = 2000;
+static int max_threads = 8;
+
+static char **docs;
+static int *doc_lens;
+
+enum { MODE_PRIVATE, MODE_SUB, MODE_CONCURRENT, NUM_MODES };
+static const char *mode_names[NUM_MODES] = {
+    "private", "sub", "concurrent"
+};
+
+struct worker {
+    pthread_t tid;
+    int first;
+    int step;
+    xmlParserCtxtPtr ctxt;
+    int failed;
+};
+
+static int
+random_below(int n) {
+    return((int) ((double) rand() / ((double) RAND_MAX + 1) * n));
+}
+
+/*
+ * A feed of entries, whose field names are drawn from the vocabulary with
+ * the first names far more common than the rest.
+ */
+static void
+generate_docs(void) {
+    char *buf;
+    int size, len, i, j, k;
+
+    docs = calloc(num_docs, sizeof(char *));
+    doc_lens = calloc(num_docs, sizeof(int));
+    size = 256 + num_entries * 512;
+    if ((docs == NULL) || (doc_lens == NULL)) {
+        perror("calloc");
+        exit(1);
+    }
+    for (i = 0; i < num_docs; i++) {
+        buf = malloc(size);
+        if (buf == NULL) {
+            perror("malloc");
+            exit(1);
+        }
+        len = snprintf(buf, size,
+            "<?xml version=\"1.0\"?>\n"
+            "<feed xmlns=\"http://example.com/feed\" "
+            "xmlns:m=\"http://example.com/meta\">\n");
+        for (j = 0; j < num_entries; j++) {
+            len += snprintf(buf + len, size - len,
+                "<entry id=\"%d-%d\" m:rank=\"%d\">"
+                "<title>Entry %d of feed %d</title>"
+                "<link href=\"http://example.com/%d/%d\"/>",
+                i, j, random_below(100), j, i, i, j);
+            for (k = 0; k < 4; k++) {
+                double u = (double) rand() / ((double) RAND_MAX + 1);
+                int name = (int) (num_names * u * u);
+
+                len += snprintf(buf + len, size - len,
+                    "<m:f%d>%d</m:f%d>", name, random_below(1000), name);
+            }
+            len += snprintf(buf + len, size - len, "</entry>\n");
+        }
+        len += snprintf(buf + len, size - len, "</feed>\n");
+        docs[i] = buf;
+        doc_lens[i] = len;
+    }
+}
+
+/*
+ * Have the context intern its names in @dict, as parser.c does for the
+ * context of an entity.
+ */
+static void
+use_dict(xmlParserCtxtPtr ctxt, xmlDictPtr dict) {
+    xmlDictFree(ctxt->dict);
+    ctxt->dict = dict;
+    xmlDictReference(dict);
+    ctxt->str_xml = xmlDictLookup(dict, BAD_CAST "xml", 3);
+    ctxt->str_xmlns = xmlDictLookup(dict, BAD_CAST "xmlns", 5);
+    ctxt->str_xml_ns = xmlDictLookup(dict, XML_XML_NAMESPACE, 36);
+}
+
+static void *
+parse_docs(void *arg) {
+    struct worker *w = arg;
+    xmlDocPtr doc;
+    xmlNodePtr root;
+    int i;
+
+    for (i = w->first; i < num_docs; i += w->step) {
+        doc = xmlCtxtReadMemory(w->ctxt, docs[i], doc_lens[i], NULL, NULL,
+                                XML_PARSE_NONET);
+        root = xmlDocGetRootElement(doc);
+        if ((root == NULL) ||
+            (xmlDictOwns(w->ctxt->dict, root->name) != 1) ||
+            (root->name != xmlDictLookup(w->ctxt->dict, BAD_CAST "feed", 4)))
+            w->failed++;
+        xmlFreeDoc(doc);
+    }
+    return(NULL);
+}
+
+/*
+ * Parse all the documents on @nb_threads threads.
+ *
+ * Returns the documents per second, with the string usage in @usage
+ */
+static double
+run_once(int mode, int nb_threads, size_t *usage) {
+    struct worker *workers;
+    xmlDictPtr dict = NULL;
+    struct timeval start, end;
+    int i;
+
+    workers = calloc(nb_threads, sizeof(struct worker));
+    if (workers == NULL) {
+        perror("calloc");
+        exit(1);
+    }
+
+    if (mode == MODE_SUB) {
+        /* the common names, filled in before the threads start */
+        xmlParserCtxtPtr ctxt = xmlNewParserCtxt();
+
+        dict = xmlDictCreate();
+        use_dict(ctxt, dict);
+        for (i = 0; (i < num_docs) && (i < 10); i++)
+            xmlFreeDoc(xmlCtxtReadMemory(ctxt, docs[i], doc_lens[i], NULL,
+                                         NULL, XML_PARSE_NONET));
+        xmlFreeParserCtxt(ctxt);
+    } else if (mode == MODE_CONCURRENT) {
+        dict = xmlDictCreateConcurrent();
+    }
+
+    for (i = 0; i < nb_threads; i++) {
+        workers[i].first = i;
+        workers[i].step = nb_threads;
+        workers[i].ctxt = xmlNewParserCtxt();
+        if (workers[i].ctxt == NULL) {
+            fprintf(stderr, "Failed to create a parser context\n");
+            exit(1);
+        }
+        if (mode == MODE_SUB) {
+            xmlDictPtr sub = xmlDictCreateSub(dict);
+
+            use_dict(workers[i].ctxt, sub);
+            xmlDictFree(sub);
+        } else if (mode == MODE_CONCURRENT) {
+            use_dict(workers[i].ctxt, dict);
+        }
+    }
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < nb_threads; i++) {
+        if (pthread_create(&workers[i].tid, NULL, parse_docs,
+                           &workers[i]) != 0) {
+            perror("pthread_create");
+            exit(1);
+        }
+    }
+    for (i = 0; i < nb_threads; i++) {
+        if (pthread_join(workers[i].tid, NULL) != 0) {
+            perror("pthread_join");
+            exit(1);
+        }
+    }
+    gettimeofday(&end, NULL);
+
+    *usage = (mode == MODE_PRIVATE) ? 0 : xmlDictGetUsage(dict);
+    for (i = 0; i < nb_threads; i++) {
+        if (workers[i].failed) {
+            fprintf(stderr, "%s: %d documents failed\n", mode_names[mode],
+                    workers[i].failed);
+            exit(1);
+        }
+        if (mode != MODE_CONCURRENT)
+            *usage += xmlDictGetUsage(workers[i].ctxt->dict);
+        xmlFreeParserCtxt(workers[i].ctxt);
+    }
+    xmlDictFree(dict);
+    free(workers);
+
+    return(num_docs / ((end.tv_sec - start.tv_sec) +
+                       (end.tv_usec - start.tv_usec) / 1000000.0));
+}
+
+int
+main(int argc, char **argv) {
+    size_t usage[NUM_MODES];
+    int i, mode, nb_threads;
+
+    for (i = 1; i < argc; i++) {
+        if ((i + 1 < argc) && (!strcmp(argv[i], "-n")))
+            num_docs = atoi(argv[++i]);
+        else if ((i + 1 < argc) && (!strcmp(argv[i], "-e")))
+            num_entries = atoi(argv[++i]);
+        else if ((i + 1 < argc) && (!strcmp(argv[i], "-v")))
+            num_names = atoi(argv[++i]);
+        else if ((i + 1 < argc) && (!strcmp(argv[i], "-t")))
+            max_threads = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "Illegal argument \"%s\"\n", argv[i]);
+            exit(1);
+        }
+    }
+    if ((num_docs < 1) || (num_entries < 1) || (num_names < 1) ||
+        (max_threads < 1)) {
+        fprintf(stderr, "Arguments must be positive\n");
+        exit(1);
+    }
+
+    xmlInitParser();
+    generate_docs();
+
+    printf("threads");
+    for (mode = 0; mode < NUM_MODES; mode++)
+        printf("\t%s docs/s", mode_names[mode]);
+    printf("\n");
+    for (nb_threads = 1; nb_threads <= max_threads; nb_threads *= 2) {
+        printf("%d", nb_threads);
+        for (mode = 0; mode < NUM_MODES; mode++)
+            printf("\t%.0f", run_once(mode, nb_threads, &usage[mode]));
+        printf("\n");
+    }
+    printf("dict KB");
+    for (mode = 0; mode < NUM_MODES; mode++)
+        printf("\t%lu", (unsigned long) (usage[mode] / 1024));
+    printf("\n");
+
+    for (i = 0; i < num_docs; i++)
+        free(docs[i]);
+    free(doc_lens);
+    free(docs);
+    xmlCleanupParser();
+    xmlMemoryDump();
+    return(0);
+}
+
+#else /* !LIBXML_THREAD_ENABLED || !HAVE_PTHREAD_H */
+int
+main(void) {
+    fprintf(stderr, "libxml was not compiled with thread support\n");
+    return(0);
+}
+#endif
@@ -0,0 +1,368 @@
+/*
+ * Copyright 2016 The Chromium Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * testscan.c: parses a fixed generated corpus with the byte by byte and
+ * SSE2 scanners of the parser, each in a child process started with
+ * XML_SIMD set, with SAX callbacks that hash the events and with a tree
+ * being built.  Reports MB/s of both, and fails unless every scanner gave
+ * the same SAX event stream.  A build without SSE2 scans byte by byte
+ * for both.  The mixed corpus is records of short and long text runs, the
+ * text and attr ones are elements holding runs of about -l bytes of words
+ * as their text or as an attribute value.
+ *
+ * usage: testscan [-c mixed|text|attr] [-l run length] [-s corpus size in MB]
+ *                 [-r rounds]
+ */
+
+#include "libxml.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#if defined(HAVE_UNISTD_H) && defined(HAVE_SYS_TIME_H) && \
+    defined(LIBXML_SAX1_ENABLED)
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <libxml/parser.h>
+#include <libxml/tree.h>
+
+static const char *corpus_kind = "mixed";
+static int run_len = 200;
+static int corpus_mb = 16;
+static int rounds = 5;
+
+static char *corpus;
+static int corpus_len;
+
+static const char *scanners[] = { "none", "sse2" };
+#define NB_SCANNERS (int) (sizeof(scanners) / sizeof(scanners[0]))
+
+/*
+ * The corpus
+ */
+static unsigned int seed = 1;
+
+static int
+next_random(int n) {
+    seed = seed * 1103515245 + 12345;
+    return((int) ((seed >> 8) % n));
+}
+
+static const char *words[] = {
+    "the", "feed", "record", "of", "market", "data", "values", "and",
+    "parsing", "throughput", "is", "bounded", "by", "scanning", "bytes",
+    "with", "plain", "ASCII", "content", "in", "most", "documents",
+    "caf\xc3\xa9", "&amp;", "&lt;", "price", "&#233;t\xc3\xa9"
+};
+#define NB_WORDS (int) (sizeof(words) / sizeof(words[0]))
+
+static const char *names[] = {
+    "a", "p", "id", "item", "title", "description", "link",
+    "publicationDate", "m:category", "m:extendedAttributeValueList"
+};
+#define NB_NAMES (int) (sizeof(names) / sizeof(names[0]))
+
+static void
+append(int *size, const char *str, int len) {
+    if (corpus_len + len + 1 > *size) {
+        *size = 2 * (*size) + len;
+        corpus = realloc(corpus, *size);
+        if (corpus == NULL) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    memcpy(corpus + corpus_len, str, len);
+    corpus_len += len;
+    corpus[corpus_len] = 0;
+}
+
+static void
+append_str(int *size, const char *str) {
+    append(size, str, strlen(str));
+}
+
+/*
+ * Indented records with text runs of a few words to a few hundred, long
+ * and short attribute values, names of all lengths, and a little
+ * non-ASCII, entities and CDATA.
+ */
+static void
+generate_corpus(void) {
+    char buf[256];
+    int size = 0, i, j, n;
+
+    append_str(&size, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+               "<feed xmlns=\"http://example.com/feed\" "
+               "xmlns:m=\"http://example.com/meta\">\n");
+    for (i = 0; corpus_len < corpus_mb * 1024 * 1024; i++) {
+        snprintf(buf, sizeof(buf),
+                 "  <item id=\"r%d\" href=\"http://example.com/feeds/"
+                 "archive/%d/records/item-%d.xml?format=full&amp;"
+                 "lang=en\">\n", i, i % 97, i);
+        append_str(&size, buf);
+        for (j = 0; j < 4; j++) {
+            const char *name = names[next_random(NB_NAMES)];
+
+            append_str(&size, "    <");
+            append_str(&size, name);
+            append_str(&size, " m:kind=\"text\">");
+            for (n = next_random(4) == 0 ? 200 : 1 + next_random(12);
+                 n > 0; n--) {
+                append_str(&size, words[next_random(NB_WORDS)]);
+                append_str(&size, (n % 16) == 0 ? "\n" : " ");
+            }
+            if (next_random(8) == 0)
+                append_str(&size, "<![CDATA[raw <data> & ]] more]]>");
+            append_str(&size, "</");
+            append_str(&size, name);
+            append_str(&size, ">\n");
+        }
+        append_str(&size, "  </item>\n");
+    }
+    append_str(&size, "</feed>\n");
+}
+
+/*
+ * Elements holding runs of plain ASCII words of about run_len bytes, as
+ * their text or as the value of their attribute.
+ */
+static void
+generate_runs_corpus(int attr) {
+    const char *word;
+    int size = 0, n;
+
+    append_str(&size, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<doc>\n");
+    while (corpus_len < corpus_mb * 1024 * 1024) {
+        append_str(&size, attr ? "  <p v=\"" : "  <p>");
+        for (n = 0; n < run_len; n += strlen(word) + 1) {
+            /* the first words of the list are plain ASCII */
+            word = words[next_random(16)];
+            append_str(&size, word);
+            append_str(&size, " ");
+        }
+        append_str(&size, attr ? "\"/>\n" : "</p>\n");
+    }
+    append_str(&size, "</doc>\n");
+}
+
+/*
+ * SAX callbacks hashing the events with FNV-1a
+ */
+static unsigned long long hash;
+
+static void
+hash_bytes(const void *data, int len) {
+    const unsigned char *cur = data;
+    int i;
+
+    for (i = 0; i < len; i++) {
+        hash ^= cur[i];
+        hash *= 1099511628211ULL;
+    }
+}
+
+static void
+hash_str(const xmlChar *str) {
+    if (str != NULL)
+        hash_bytes(str, strlen((const char *) str) + 1);
+    else
+        hash_bytes("", 1);
+}
+
+static void
+hash_start_element(void *ctx ATTRIBUTE_UNUSED, const xmlChar *localname,
+                   const xmlChar *prefix, const xmlChar *URI,
+                   int nb_namespaces, const xmlChar **namespaces,
+                   int nb_attributes, int nb_defaulted ATTRIBUTE_UNUSED,
+                   const xmlChar **attributes) {
+    int i;
+
+    hash_bytes("S", 1);
+    hash_str(localname);
+    hash_str(prefix);
+    hash_str(URI);
+    for (i = 0; i < 2 * nb_namespaces; i++)
+        hash_str(namespaces[i]);
+    for (i = 0; i < nb_attributes; i++) {
+        hash_str(attributes[5 * i]);
+        hash_str(attributes[5 * i + 1]);
+        hash_str(attributes[5 * i + 2]);
+        hash_bytes(attributes[5 * i + 3],
+                   attributes[5 * i + 4] - attributes[5 * i + 3]);
+    }
+}
+
+static void
+hash_end_element(void *ctx ATTRIBUTE_UNUSED, const xmlChar *localname,
+                 const xmlChar *prefix, const xmlChar *URI) {
+    hash_bytes("E", 1);
+    hash_str(localname);
+    hash_str(prefix);
+    hash_str(URI);
+}
+
+static void
+hash_characters(void *ctx ATTRIBUTE_UNUSED, const xmlChar *ch, int len) {
+    hash_bytes("C", 1);
+    hash_bytes(ch, len);
+}
+
+static void
+hash_cdata_block(void *ctx ATTRIBUTE_UNUSED, const xmlChar *value, int len) {
+    hash_bytes("D", 1);
+    hash_bytes(value, len);
+}
+
+static double
+seconds_since(const struct timeval *start) {
+    struct timeval end;
+
+    gettimeofday(&end, NULL);
+    return((end.tv_sec - start->tv_sec) +
+           (end.tv_usec - start->tv_usec) / 1000000.0);
+}
+
+/*
+ * Parse the corpus with the scanners XML_SIMD selects, reporting the
+ * best MB/s of the rounds and the hash on @fd.
+ */
+static void
+run_child(int fd) {
+    xmlSAXHandler sax;
+    struct timeval start;
+    double secs, best_sax = 0, best_tree = 0;
+    char line[128];
+    xmlDocPtr doc;
+    int i;
+
+    xmlInitParser();
+
+    memset(&sax, 0, sizeof(sax));
+    sax.initialized = XML_SAX2_MAGIC;
+    sax.startElementNs = hash_start_element;
+    sax.endElementNs = hash_end_element;
+    sax.characters = hash_characters;
+    sax.ignorableWhitespace = hash_characters;
+    sax.cdataBlock = hash_cdata_block;
+
+    for (i = 0; i < rounds; i++) {
+        hash = 14695981039346656037ULL;
+        gettimeofday(&start, NULL);
+        if (xmlSAXUserParseMemory(&sax, NULL, corpus, corpus_len) != 0) {
+            fprintf(stderr, "The corpus failed to parse\n");
+            _exit(1);
+        }
+        secs = seconds_since(&start);
+        if ((best_sax == 0) || (secs < best_sax))
+            best_sax = secs;
+
+        gettimeofday(&start, NULL);
+        doc = xmlReadMemory(corpus, corpus_len, NULL, NULL, 0);
+        secs = seconds_since(&start);
+        if (doc == NULL) {
+            fprintf(stderr, "The corpus failed to parse\n");
+            _exit(1);
+        }
+        xmlFreeDoc(doc);
+        if ((best_tree == 0) || (secs < best_tree))
+            best_tree = secs;
+    }
+
+    snprintf(line, sizeof(line), "%.1f\t%.1f\t%016llx\n",
+             corpus_len / best_sax / 1048576, corpus_len / best_tree / 1048576,
+             hash);
+    if (write(fd, line, strlen(line)) != (ssize_t) strlen(line))
+        _exit(1);
+    _exit(0);
+}
+
+int
+main(int argc, char **argv) {
+    char first[32], line[128];
+    int i, fds[2], status, len;
+    pid_t pid;
+
+    for (i = 1; i < argc; i++) {
+        if ((i + 1 < argc) && (!strcmp(argv[i], "-c")))
+            corpus_kind = argv[++i];
+        else if ((i + 1 < argc) && (!strcmp(argv[i], "-l")))
+            run_len = atoi(argv[++i]);
+        else if ((i + 1 < argc) && (!strcmp(argv[i], "-s")))
+            corpus_mb = atoi(argv[++i]);
+        else if ((i + 1 < argc) && (!strcmp(argv[i], "-r")))
+            rounds = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "Illegal argument \"%s\"\n", argv[i]);
+            exit(1);
+        }
+    }
+    if ((run_len < 1) || (corpus_mb < 1) || (rounds < 1)) {
+        fprintf(stderr, "Arguments must be positive\n");
+        exit(1);
+    }
+
+    /* the library is initialized in the children, once XML_SIMD is set */
+    if (!strcmp(corpus_kind, "mixed")) {
+        generate_corpus();
+    } else if (!strcmp(corpus_kind, "text")) {
+        generate_runs_corpus(0);
+    } else if (!strcmp(corpus_kind, "attr")) {
+        generate_runs_corpus(1);
+    } else {
+        fprintf(stderr, "Unknown corpus \"%s\"\n", corpus_kind);
+        exit(1);
+    }
+
+    printf("scanner\tSAX MB/s\ttree MB/s\tSAX hash\n");
+    first[0] = 0;
+    for (i = 0; i < NB_SCANNERS; i++) {
+        if (pipe(fds) != 0) {
+            perror("pipe");
+            exit(1);
+        }
+        fflush(stdout);
+        pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            exit(1);
+        }
+        if (pid == 0) {
+            close(fds[0]);
+            setenv("XML_SIMD", scanners[i], 1);
+            run_child(fds[1]);
+        }
+        close(fds[1]);
+        len = read(fds[0], line, sizeof(line) - 1);
+        close(fds[0]);
+        if ((waitpid(pid, &status, 0) != pid) || (!WIFEXITED(status)) ||
+            (WEXITSTATUS(status) != 0) || (len <= 0)) {
+            fprintf(stderr, "%s: the parse failed\n", scanners[i]);
+            exit(1);
+        }
+        line[len] = 0;
+        printf("%s\t%s", scanners[i], line);
+        if (first[0] == 0) {
+            snprintf(first, sizeof(first), "%s", strrchr(line, '\t') + 1);
+        } else if (strcmp(first, strrchr(line, '\t') + 1)) {
+            fprintf(stderr, "%s: the SAX events differ\n", scanners[i]);
+            exit(1);
+        }
+    }
+
+    free(corpus);
+    return(0);
+}
+
+#else /* !HAVE_UNISTD_H || !HAVE_SYS_TIME_H || !LIBXML_SAX1_ENABLED */
+int
+main(void) {
+    fprintf(stderr, "testscan needs fork() and the SAX1 interfaces\n");
+    return(0);
+}
+#endif
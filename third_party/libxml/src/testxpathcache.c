@@ -0,0 +1,395 @@
+/*
+ * Copyright 2016 The Chromium Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * testxpathcache.c: evaluates a fixed workload of XPath expressions over a
+ * set of generated documents on a pool of threads, the expressions compiled
+ * for every evaluation, taken from one xmlXPathCompCache shared by the
+ * threads, and taken from the cache with the streamed evaluation of
+ * location paths.  Each mode runs in a child process since the streaming is
+ * picked at xmlInitParser() time.  Reports expressions/s against the thread
+ * count, and fails unless all the modes found the same results.
+ *
+ * usage: testxpathcache [-n evaluations] [-d documents] [-q quotes]
+ *                       [-v distinct expressions] [-c cache size]
+ *                       [-t max threads]
+ */
+
+#include "libxml.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#if defined(LIBXML_THREAD_ENABLED) && defined(HAVE_PTHREAD_H) && \
+    defined(HAVE_UNISTD_H) && defined(LIBXML_XPATH_ENABLED)
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <libxml/parser.h>
+#include <libxml/tree.h>
+#include <libxml/xpath.h>
+#include <libxml/xpathInternals.h>
+
+static int num_evals = 50000;
+static int num_docs = 16;
+static int num_quotes = 200;
+static int num_exprs = 500;
+static int cache_size = 1024;
+static int max_threads = 8;
+
+static xmlDocPtr *docs;
+static char **exprs;
+static int *workload;
+
+enum { MODE_COMPILE, MODE_CACHE, MODE_STREAM, NUM_MODES };
+static const char *mode_names[NUM_MODES] = {
+    "compile", "cache", "stream"
+};
+
+struct worker {
+    pthread_t tid;
+    int first;
+    int step;
+    xmlXPathCompCachePtr cache;
+    unsigned long long sum;
+    int failed;
+};
+
+static unsigned int seed = 1;
+
+static int
+next_random(int n) {
+    seed = seed * 1103515245 + 12345;
+    return((int) ((seed >> 8) % n));
+}
+
+/*
+ * Quote feeds of the shape testarena.c parses.
+ */
+static void
+generate_docs(void) {
+    char *buf, record[256];
+    int size, len, i, j;
+
+    docs = calloc(num_docs, sizeof(xmlDocPtr));
+    size = 256 + num_quotes * 256;
+    buf = malloc(size);
+    if ((docs == NULL) || (buf == NULL)) {
+        perror("malloc");
+        exit(1);
+    }
+    for (i = 0; i < num_docs; i++) {
+        len = snprintf(buf, size,
+            "<?xml version=\"1.0\"?>\n"
+            "<quotes xmlns=\"http://example.com/quotes\">\n");
+        for (j = 0; j < num_quotes; j++) {
+            snprintf(record, sizeof(record),
+                     "  <quote id=\"q%d\" venue=\"X%d\" seq=\"%d\">\n"
+                     "    <symbol>S%04d</symbol>\n"
+                     "    <bid size=\"%d\">%d.%02d</bid>\n"
+                     "    <ask size=\"%d\">%d.%02d</ask>\n"
+                     "%s"
+                     "  </quote>\n",
+                     j, j % 7, i * num_quotes + j, next_random(5000),
+                     next_random(1000), next_random(500), next_random(100),
+                     next_random(1000), next_random(500), next_random(100),
+                     next_random(4) ? "" : "    <note>late</note>\n");
+            len += snprintf(buf + len, size - len, "%s", record);
+        }
+        len += snprintf(buf + len, size - len, "</quotes>\n");
+        docs[i] = xmlReadMemory(buf, len, NULL, NULL, XML_PARSE_NONET);
+        if (docs[i] == NULL) {
+            fprintf(stderr, "Failed to parse a generated document\n");
+            exit(1);
+        }
+    }
+    free(buf);
+}
+
+/*
+ * The kind of lookups a feed consumer makes, the literals varying from one
+ * expression to the next.  The last three are not location paths and are
+ * always evaluated on node-sets.
+ */
+static const char *templates[] = {
+    "/q:quotes/q:quote[@id='q%d']/q:bid",
+    "//q:quote[q:symbol='S%04d']/q:ask/@size",
+    "count(/q:quotes/q:quote[@venue='X%d'])",
+    "/q:quotes/q:quote[%d]/q:symbol",
+    "//q:bid[@size > %d]",
+    "boolean(//q:quote[@seq='%d']/q:note)",
+    "(//q:quote)[%d]/@id",
+    "sum(//q:quote[@venue='X%d']/q:ask)"
+};
+#define NB_TEMPLATES (int) (sizeof(templates) / sizeof(templates[0]))
+
+/*
+ * The expressions, and the order in which they are evaluated, with the
+ * first expressions far more common than the rest.
+ */
+static void
+generate_workload(void) {
+    char buf[256];
+    int i;
+
+    exprs = calloc(num_exprs, sizeof(char *));
+    workload = calloc(num_evals, sizeof(int));
+    if ((exprs == NULL) || (workload == NULL)) {
+        perror("calloc");
+        exit(1);
+    }
+    for (i = 0; i < num_exprs; i++) {
+        snprintf(buf, sizeof(buf), templates[i % NB_TEMPLATES],
+                 next_random(num_quotes) + 1);
+        exprs[i] = strdup(buf);
+        if (exprs[i] == NULL) {
+            perror("strdup");
+            exit(1);
+        }
+    }
+    for (i = 0; i < num_evals; i++) {
+        if (next_random(2))
+            workload[i] = next_random(num_exprs / 10 + 1);
+        else
+            workload[i] = next_random(num_exprs);
+    }
+}
+
+static unsigned long long
+result_value(xmlXPathObjectPtr res) {
+    switch (res->type) {
+        case XPATH_NODESET:
+            if (res->nodesetval == NULL)
+                return(0);
+            return(res->nodesetval->nodeNr);
+        case XPATH_BOOLEAN:
+            return(res->boolval);
+        case XPATH_NUMBER:
+            return((unsigned long long) (res->floatval * 100));
+        default:
+            return(0);
+    }
+}
+
+static void *
+eval_exprs(void *arg) {
+    struct worker *worker = arg;
+    xmlXPathContextPtr ctxt;
+    xmlXPathCompExprPtr comp;
+    xmlXPathObjectPtr res;
+    const xmlChar *str;
+    int i;
+
+    ctxt = xmlXPathNewContext(NULL);
+    if ((ctxt == NULL) ||
+        (xmlXPathRegisterNs(ctxt, BAD_CAST "q",
+                            BAD_CAST "http://example.com/quotes") != 0)) {
+        worker->failed = num_evals;
+        return(NULL);
+    }
+    for (i = worker->first; i < num_evals; i += worker->step) {
+        ctxt->doc = docs[i % num_docs];
+        ctxt->node = (xmlNodePtr) ctxt->doc;
+        str = BAD_CAST exprs[workload[i]];
+
+        if (worker->cache == NULL)
+            comp = xmlXPathCtxtCompile(ctxt, str);
+        else
+            comp = xmlXPathCompCacheLookup(worker->cache, ctxt, str);
+        if (comp == NULL) {
+            worker->failed++;
+            continue;
+        }
+        res = xmlXPathCompiledEval(comp, ctxt);
+        if (res == NULL) {
+            worker->failed++;
+        } else {
+            worker->sum += (workload[i] + 1) * result_value(res);
+            xmlXPathFreeObject(res);
+        }
+        if (worker->cache == NULL)
+            xmlXPathFreeCompExpr(comp);
+        else
+            xmlXPathCompCacheRelease(worker->cache, comp);
+    }
+    xmlXPathFreeContext(ctxt);
+    return(NULL);
+}
+
+/*
+ * Evaluate the workload on @nb_threads threads, and return the
+ * expressions/s and in @sum a checksum of the results.
+ */
+static double
+run_once(int mode, int nb_threads, unsigned long long *sum) {
+    struct worker *workers;
+    struct timeval start, end;
+    xmlXPathCompCachePtr cache = NULL;
+    int i;
+
+    workers = calloc(nb_threads, sizeof(struct worker));
+    if (workers == NULL)
+        _exit(1);
+    if (mode != MODE_COMPILE) {
+        cache = xmlXPathNewCompCache(cache_size);
+        if (cache == NULL)
+            _exit(1);
+    }
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < nb_threads; i++) {
+        workers[i].first = i;
+        workers[i].step = nb_threads;
+        workers[i].cache = cache;
+        if (pthread_create(&workers[i].tid, NULL, eval_exprs,
+                           &workers[i]) != 0) {
+            perror("pthread_create");
+            _exit(1);
+        }
+    }
+    for (i = 0; i < nb_threads; i++) {
+        if (pthread_join(workers[i].tid, NULL) != 0) {
+            perror("pthread_join");
+            _exit(1);
+        }
+    }
+    gettimeofday(&end, NULL);
+
+    *sum = 0;
+    for (i = 0; i < nb_threads; i++) {
+        if (workers[i].failed) {
+            fprintf(stderr, "%s: %d evaluations failed\n", mode_names[mode],
+                    workers[i].failed);
+            _exit(1);
+        }
+        *sum += workers[i].sum;
+    }
+    xmlXPathFreeCompCache(cache);
+    free(workers);
+
+    return(num_evals / ((end.tv_sec - start.tv_sec) +
+                        (end.tv_usec - start.tv_usec) / 1000000.0));
+}
+
+/*
+ * Run every thread count in @mode, writing the rates and the checksum of
+ * the results as one line on @fd.
+ */
+static void
+run_child(int fd, int mode) {
+    unsigned long long sum, first_sum = 0;
+    char line[512];
+    int len = 0, nb_threads;
+
+    if (mode != MODE_STREAM)
+        setenv("XML_XPATH_STREAM", "none", 1);
+    xmlInitParser();
+    generate_docs();
+
+    for (nb_threads = 1; nb_threads <= max_threads; nb_threads *= 2) {
+        len += snprintf(line + len, sizeof(line) - len, "\t%.0f",
+                        run_once(mode, nb_threads, &sum));
+        if (nb_threads == 1)
+            first_sum = sum;
+        else if (sum != first_sum)
+            _exit(1);
+    }
+    len += snprintf(line + len, sizeof(line) - len, "\t%016llx\n",
+                    first_sum);
+    if (write(fd, line, len) != len)
+        _exit(1);
+    _exit(0);
+}
+
+int
+main(int argc, char **argv) {
+    char first[32], line[512];
+    int i, fds[2], status, len, nb_threads;
+    pid_t pid;
+
+    for (i = 1; i < argc; i++) {
+        if ((i + 1 < argc) && (!strcmp(argv[i], "-n")))
+            num_evals = atoi(argv[++i]);
+        else if ((i + 1 < argc) && (!strcmp(argv[i], "-d")))
+            num_docs = atoi(argv[++i]);
+        else if ((i + 1 < argc) && (!strcmp(argv[i], "-q")))
+            num_quotes = atoi(argv[++i]);
+        else if ((i + 1 < argc) && (!strcmp(argv[i], "-v")))
+            num_exprs = atoi(argv[++i]);
+        else if ((i + 1 < argc) && (!strcmp(argv[i], "-c")))
+            cache_size = atoi(argv[++i]);
+        else if ((i + 1 < argc) && (!strcmp(argv[i], "-t")))
+            max_threads = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "Illegal argument \"%s\"\n", argv[i]);
+            exit(1);
+        }
+    }
+    if ((num_evals < 1) || (num_docs < 1) || (num_quotes < 1) ||
+        (num_exprs < 1) || (cache_size < 1) || (max_threads < 1)) {
+        fprintf(stderr, "Arguments must be positive\n");
+        exit(1);
+    }
+    if (max_threads > 64)
+        max_threads = 64;
+
+    generate_workload();
+
+    printf("%d evaluations of %d expressions over %d documents of %d "
+           "quotes\n", num_evals, num_exprs, num_docs, num_quotes);
+    printf("mode");
+    for (nb_threads = 1; nb_threads <= max_threads; nb_threads *= 2)
+        printf("\t%d thr/s", nb_threads);
+    printf("\tresults\n");
+    first[0] = 0;
+    for (i = 0; i < NUM_MODES; i++) {
+        if (pipe(fds) != 0) {
+            perror("pipe");
+            exit(1);
+        }
+        fflush(stdout);
+        pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            exit(1);
+        }
+        if (pid == 0) {
+            close(fds[0]);
+            run_child(fds[1], i);
+        }
+        close(fds[1]);
+        len = read(fds[0], line, sizeof(line) - 1);
+        close(fds[0]);
+        if ((waitpid(pid, &status, 0) != pid) || (!WIFEXITED(status)) ||
+            (WEXITSTATUS(status) != 0) || (len <= 0)) {
+            fprintf(stderr, "%s: the evaluation failed\n", mode_names[i]);
+            exit(1);
+        }
+        line[len] = 0;
+        printf("%s%s", mode_names[i], line);
+        if (first[0] == 0) {
+            snprintf(first, sizeof(first), "%s", strrchr(line, '\t') + 1);
+        } else if (strcmp(first, strrchr(line, '\t') + 1)) {
+            fprintf(stderr, "%s: the results differ\n", mode_names[i]);
+            exit(1);
+        }
+    }
+
+    for (i = 0; i < num_exprs; i++)
+        free(exprs[i]);
+    free(exprs);
+    free(workload);
+    return(0);
+}
+
+#else
+int
+main(void) {
+    fprintf(stderr, "testxpathcache needs threads, fork() and XPath\n");
+    return(0);
+}
+#endif
@@ -43,6 +43,7 @@
 
 #include "buf.h"
 #include "save.h"
+#include "arena.h"
 
 int __xmlRegisterCallbacks = 0;
 
@@ -1053,6 +1054,52 @@ xmlCreateIntSubset(xmlDocPtr doc, const xmlChar *name,
 	    xmlFree((char *)(str));
 
 
+/**
+ * ARENA_FREE:
+ * @ptr:  a node or an attribute
+ *
+ * Free a node or an attribute if it is not owned by the "arena" of the
+ * document in the current scope
+ */
+#define ARENA_FREE(ptr)						\
+	if ((!arena) || (xmlArenaOwns(arena, (ptr)) == 0))	\
+	    xmlFree(ptr);
+
+/**
+ * TREE_FREE:
+ * @str:  a string
+ *
+ * Free a string if it is owned neither by the "arena" nor by the "dict"
+ * dictionnary in the current scope
+ */
+#define TREE_FREE(str)						\
+	if ((str) && ((!arena) ||				\
+	    (xmlArenaOwns(arena, (str)) == 0)) && ((!dict) ||	\
+	    (xmlDictOwns(dict, (const xmlChar *)(str)) == 0)))	\
+	    xmlFree((char *)(str));
+
+/**
+ * xmlDocOwnsString:
+ * @doc:  the document, or NULL
+ * @str:  a string of one of its nodes
+ *
+ * Check if @str comes from the dictionnary or the arena of @doc, so it
+ * must be neither freed nor reallocated
+ *
+ * Returns 1 if true, 0 if false
+ */
+static int
+xmlDocOwnsString(const xmlDoc *doc, const xmlChar *str) {
+    if (doc == NULL)
+        return(0);
+    if ((XML_DOC_ARENA(doc) != NULL) &&
+        (xmlArenaOwns(XML_DOC_ARENA(doc), str)))
+        return(1);
+    if ((doc->dict != NULL) && (xmlDictOwns(doc->dict, str)))
+        return(1);
+    return(0);
+}
+
 /**
  * DICT_COPY:
  * @str:  a string
@@ -1162,12 +1209,12 @@ xmlNewDoc(const xmlChar *version) {
     /*
      * Allocate a new document and fill the fields.
      */
-    cur = (xmlDocPtr) xmlMalloc(sizeof(xmlDoc));
+    cur = (xmlDocPtr) xmlMalloc(sizeof(xmlDocPrivate));
     if (cur == NULL) {
 	xmlTreeErrMemory("building doc");
 	return(NULL);
     }
-    memset(cur, 0, sizeof(xmlDoc));
+    memset(cur, 0, sizeof(xmlDocPrivate));
     cur->type = XML_DOCUMENT_NODE;
 
     cur->version = xmlStrdup(version);
@@ -1203,6 +1250,7 @@ void
 xmlFreeDoc(xmlDocPtr cur) {
     xmlDtdPtr extSubset, intSubset;
     xmlDictPtr dict = NULL;
+    xmlArenaPtr arena;
 
     if (cur == NULL) {
 #ifdef DEBUG_TREE
@@ -1251,8 +1299,11 @@ xmlFreeDoc(xmlDocPtr cur) {
     DICT_FREE(cur->name)
     DICT_FREE(cur->encoding)
     DICT_FREE(cur->URL)
+    arena = XML_DOC_ARENA(cur);
     xmlFree(cur);
     if (dict) xmlDictFree(dict);
+    /* last, the DTD and entities may hold nodes from the arena */
+    if (arena) xmlArenaFree(arena);
 }
 
 /**
@@ -2072,9 +2123,13 @@ xmlFreePropList(xmlAttrPtr cur) {
 void
 xmlFreeProp(xmlAttrPtr cur) {
     xmlDictPtr dict = NULL;
+    xmlArenaPtr arena = NULL;
     if (cur == NULL) return;
 
-    if (cur->doc != NULL) dict = cur->doc->dict;
+    if (cur->doc != NULL) {
+	dict = cur->doc->dict;
+	arena = XML_DOC_ARENA(cur->doc);
+    }
 
     if ((__xmlRegisterCallbacks) && (xmlDeregisterNodeDefaultValue))
 	xmlDeregisterNodeDefaultValue((xmlNodePtr)cur);
@@ -2085,7 +2140,7 @@ xmlFreeProp(xmlAttrPtr cur) {
     }
     if (cur->children != NULL) xmlFreeNodeList(cur->children);
     DICT_FREE(cur->name)
-    xmlFree(cur);
+    ARENA_FREE(cur)
 }
 
 /**
@@ -3654,6 +3709,7 @@ void
 xmlFreeNodeList(xmlNodePtr cur) {
     xmlNodePtr next;
     xmlDictPtr dict = NULL;
+    xmlArenaPtr arena = NULL;
 
     if (cur == NULL) return;
     if (cur->type == XML_NAMESPACE_DECL) {
@@ -3668,7 +3724,10 @@ xmlFreeNodeList(xmlNodePtr cur) {
 	xmlFreeDoc((xmlDocPtr) cur);
 	return;
     }
-    if (cur->doc != NULL) dict = cur->doc->dict;
+    if (cur->doc != NULL) {
+	dict = cur->doc->dict;
+	arena = XML_DOC_ARENA(cur->doc);
+    }
     while (cur != NULL) {
         next = cur->next;
 	if (cur->type != XML_DTD_NODE) {
@@ -3689,7 +3748,7 @@ xmlFreeNodeList(xmlNodePtr cur) {
 		(cur->type != XML_XINCLUDE_END) &&
 		(cur->type != XML_ENTITY_REF_NODE) &&
 		(cur->content != (xmlChar *) &(cur->properties))) {
-		DICT_FREE(cur->content)
+		TREE_FREE(cur->content)
 	    }
 	    if (((cur->type == XML_ELEMENT_NODE) ||
 	         (cur->type == XML_XINCLUDE_START) ||
@@ -3707,7 +3766,7 @@ xmlFreeNodeList(xmlNodePtr cur) {
 		(cur->type != XML_TEXT_NODE) &&
 		(cur->type != XML_COMMENT_NODE))
 		DICT_FREE(cur->name)
-	    xmlFree(cur);
+	    ARENA_FREE(cur)
 	}
 	cur = next;
     }
@@ -3723,6 +3782,7 @@ xmlFreeNodeList(xmlNodePtr cur) {
 void
 xmlFreeNode(xmlNodePtr cur) {
     xmlDictPtr dict = NULL;
+    xmlArenaPtr arena = NULL;
 
     if (cur == NULL) return;
 
@@ -3743,7 +3803,10 @@ xmlFreeNode(xmlNodePtr cur) {
     if ((__xmlRegisterCallbacks) && (xmlDeregisterNodeDefaultValue))
 	xmlDeregisterNodeDefaultValue(cur);
 
-    if (cur->doc != NULL) dict = cur->doc->dict;
+    if (cur->doc != NULL) {
+	dict = cur->doc->dict;
+	arena = XML_DOC_ARENA(cur->doc);
+    }
 
     if (cur->type == XML_ENTITY_DECL) {
         xmlEntityPtr ent = (xmlEntityPtr) cur;
@@ -3764,7 +3827,7 @@ xmlFreeNode(xmlNodePtr cur) {
 	(cur->type != XML_XINCLUDE_END) &&
 	(cur->type != XML_XINCLUDE_START) &&
 	(cur->content != (xmlChar *) &(cur->properties))) {
-	DICT_FREE(cur->content)
+	TREE_FREE(cur->content)
     }
 
     /*
@@ -3782,7 +3845,7 @@ xmlFreeNode(xmlNodePtr cur) {
 	 (cur->type == XML_XINCLUDE_END)) &&
 	(cur->nsDef != NULL))
 	xmlFreeNsList(cur->nsDef);
-    xmlFree(cur);
+    ARENA_FREE(cur)
 }
 
 /**
@@ -5640,8 +5703,7 @@ xmlNodeSetContent(xmlNodePtr cur, const xmlChar *content) {
         case XML_COMMENT_NODE:
 	    if ((cur->content != NULL) &&
 	        (cur->content != (xmlChar *) &(cur->properties))) {
-	        if (!((cur->doc != NULL) && (cur->doc->dict != NULL) &&
-		    (xmlDictOwns(cur->doc->dict, cur->content))))
+	        if (!xmlDocOwnsString(cur->doc, cur->content))
 		    xmlFree(cur->content);
 	    }
 	    if (cur->children != NULL) xmlFreeNodeList(cur->children);
@@ -5718,8 +5780,7 @@ xmlNodeSetContentLen(xmlNodePtr cur, const xmlChar *content, int len) {
         case XML_NOTATION_NODE:
 	    if ((cur->content != NULL) &&
 	        (cur->content != (xmlChar *) &(cur->properties))) {
-	        if (!((cur->doc != NULL) && (cur->doc->dict != NULL) &&
-		    (xmlDictOwns(cur->doc->dict, cur->content))))
+	        if (!xmlDocOwnsString(cur->doc, cur->content))
 		    xmlFree(cur->content);
 	    }
 	    if (cur->children != NULL) xmlFreeNodeList(cur->children);
@@ -5804,8 +5865,7 @@ xmlNodeAddContentLen(xmlNodePtr cur, const xmlChar *content, int len) {
         case XML_NOTATION_NODE:
 	    if (content != NULL) {
 	        if ((cur->content == (xmlChar *) &(cur->properties)) ||
-		    ((cur->doc != NULL) && (cur->doc->dict != NULL) &&
-			    xmlDictOwns(cur->doc->dict, cur->content))) {
+		    (xmlDocOwnsString(cur->doc, cur->content))) {
 		    cur->content = xmlStrncatNew(cur->content, content, len);
 		    cur->properties = NULL;
 		    cur->nsDef = NULL;
@@ -6978,10 +7038,9 @@ xmlTextConcat(xmlNodePtr node, const xmlChar *content, int len) {
 #endif
         return(-1);
     }
-    /* need to check if content is currently in the dictionary */
+    /* need to check if content is currently in the dictionary or arena */
     if ((node->content == (xmlChar *) &(node->properties)) ||
-        ((node->doc != NULL) && (node->doc->dict != NULL) &&
-		xmlDictOwns(node->doc->dict, node->content))) {
+        (xmlDocOwnsString(node->doc, node->content))) {
 	node->content = xmlStrncatNew(node->content, content, len);
     } else {
         node->content = xmlStrncat(node->content, content, len);
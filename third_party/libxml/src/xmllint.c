@@ -3012,6 +3012,7 @@ static void usage(const char *name) {
     printf("\t--load-trace : print trace of all external entities loaded\n");
     printf("\t--nonet : refuse to fetch DTDs or entities over network\n");
     printf("\t--nocompact : do not generate compact text nodes\n");
+    printf("\t--arena : allocate the tree from an arena freed with the document\n");
     printf("\t--htmlout : output results as HTML\n");
     printf("\t--nowrap : do not put HTML doc wrapper\n");
 #ifdef LIBXML_VALID_ENABLED
@@ -3456,6 +3457,9 @@ main(int argc, char **argv) {
         } else if ((!strcmp(argv[i], "-nocompact")) ||
                    (!strcmp(argv[i], "--nocompact"))) {
 	    options &= ~XML_PARSE_COMPACT;
+        } else if ((!strcmp(argv[i], "-arena")) ||
+                   (!strcmp(argv[i], "--arena"))) {
+	    options |= XML_PARSE_ARENA;
 	} else if ((!strcmp(argv[i], "-load-trace")) ||
 	           (!strcmp(argv[i], "--load-trace"))) {
 	    load_trace++;
@@ -32,6 +32,7 @@
 #include <libxml/xmlIO.h>
 #include <libxml/xmlreader.h>
 #include <libxml/parserInternals.h>
+#include <libxml/SAX2.h>
 #ifdef LIBXML_SCHEMAS_ENABLED
 #include <libxml/relaxng.h>
 #include <libxml/xmlschemas.h>
@@ -1986,6 +1987,14 @@ next_node:
             reader->state = XML_TEXTREADER_BACKTRACK;
             goto found_node;
         }
+
+        /* an element written as a start and an end tag, see below */
+        if ((reader->node->type == XML_ELEMENT_NODE) &&
+            (reader->doc->properties & XML_DOC_EMPTYTAGS) &&
+            ((reader->node->extra & NODE_IS_EMPTY) == 0)) {
+            reader->state = XML_TEXTREADER_BACKTRACK;
+            goto found_node;
+        }
     }
 
     if (reader->node->next != NULL) {
@@ -3087,7 +3096,8 @@ xmlTextReaderIsEmptyElement(xmlTextReaderPtr reader) {
 	return(0);
     if (reader->state == XML_TEXTREADER_END)
 	return(0);
-    if (reader->doc != NULL)
+    if ((reader->doc != NULL) &&
+        ((reader->doc->properties & XML_DOC_EMPTYTAGS) == 0))
         return(1);
 #ifdef LIBXML_XINCLUDE_ENABLED
     if (reader->in_xinclude > 0)
@@ -5124,6 +5134,11 @@ xmlTextReaderSetup(xmlTextReaderPtr reader,
      * since usr applications should never modify the tree
      */
     options |= XML_PARSE_COMPACT;
+    /*
+     * the reader frees the nodes it moved past one by one, an arena would
+     * only grow until the end of the document
+     */
+    options &= ~XML_PARSE_ARENA;
 
     reader->doc = NULL;
     reader->entNr = 0;
@@ -5360,6 +5375,73 @@ xmlReaderWalker(xmlDocPtr doc)
     return(ret);
 }
 
+/**
+ * xmlTextReaderTreeStartElementNs:
+ *
+ * The startElementNs callback of xmlReaderTreeForMemory(), marking the
+ * elements written as empty tags as xmlTextReaderStartElementNs() does.
+ */
+static void
+xmlTextReaderTreeStartElementNs(void *ctx,
+                      const xmlChar *localname,
+		      const xmlChar *prefix,
+		      const xmlChar *URI,
+		      int nb_namespaces,
+		      const xmlChar **namespaces,
+		      int nb_attributes,
+		      int nb_defaulted,
+		      const xmlChar **attributes)
+{
+    xmlParserCtxtPtr ctxt = (xmlParserCtxtPtr) ctx;
+
+    xmlSAX2StartElementNs(ctx, localname, prefix, URI, nb_namespaces,
+                          namespaces, nb_attributes, nb_defaulted,
+			  attributes);
+    if ((ctxt->node != NULL) && (ctxt->input != NULL) &&
+        (ctxt->input->cur != NULL) && (ctxt->input->cur[0] == '/') &&
+        (ctxt->input->cur[1] == '>'))
+        ctxt->node->extra = NODE_IS_EMPTY;
+}
+
+/**
+ * xmlReaderTreeForMemory:
+ * @ctxt:  an XML parser context using the default SAX2 tree builder
+ * @buffer:  a pointer to a char array
+ * @size:  the size of the array
+ * @URL:  the base URL to use for the document
+ * @encoding:  the document encoding, or NULL
+ * @options:  a combination of xmlParserOption
+ *
+ * Parse an XML in-memory document into a tree for xmlReaderWalker(), as
+ * xmlCtxtReadMemory() does but recording which elements were written as
+ * empty tags. A walker on the tree then reports the nodes a reader parsing
+ * the document would: an element without children written as a start and
+ * an end tag is followed by an end element, and is not empty for
+ * xmlTextReaderIsEmptyElement(). This lets the parsing happen apart from
+ * the reading, on another thread for example. XML_PARSE_SAX1 is ignored.
+ *
+ * Returns the resulting document tree or NULL in case of error
+ */
+xmlDocPtr
+xmlReaderTreeForMemory(xmlParserCtxtPtr ctxt, const char *buffer, int size,
+                       const char *URL, const char *encoding, int options)
+{
+    startElementNsSAX2Func startElementNs;
+    xmlDocPtr ret;
+
+    if ((ctxt == NULL) || (ctxt->sax == NULL))
+        return(NULL);
+
+    startElementNs = ctxt->sax->startElementNs;
+    ctxt->sax->startElementNs = xmlTextReaderTreeStartElementNs;
+    ret = xmlCtxtReadMemory(ctxt, buffer, size, URL, encoding,
+                            options & ~XML_PARSE_SAX1);
+    ctxt->sax->startElementNs = startElementNs;
+    if (ret != NULL)
+        ret->properties |= XML_DOC_EMPTYTAGS;
+    return(ret);
+}
+
 /**
  * xmlReaderForDoc:
  * @cur:  a pointer to a zero terminated string
@@ -19,6 +19,9 @@
 
 #include <string.h>
 
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
 #ifdef HAVE_SYS_TYPES_H
 #include <sys/types.h>
 #endif
@@ -483,6 +486,14 @@ double xmlXPathPINF = 1;
 double xmlXPathNINF = -1;
 static double xmlXPathNZERO = 0; /* not exported from headers */
 static int xmlXPathInitialized = 0;
+#ifdef LIBXML_XPATH_ENABLED
+/*
+ * Whether location paths are evaluated in one walk of the tree, see
+ * xmlXPathStreamPath(), XML_XPATH_STREAM=none in the environment turns
+ * it off.
+ */
+static int xmlXPathStreamPaths = 1;
+#endif
 
 /**
  * xmlXPathInit:
@@ -491,12 +502,21 @@ static int xmlXPathInitialized = 0;
  */
 void
 xmlXPathInit(void) {
+#ifdef LIBXML_XPATH_ENABLED
+    const char *env;
+#endif
+
     if (xmlXPathInitialized) return;
 
     xmlXPathPINF = trio_pinf();
     xmlXPathNINF = trio_ninf();
     xmlXPathNAN = trio_nan();
     xmlXPathNZERO = trio_nzero();
+#ifdef LIBXML_XPATH_ENABLED
+    env = getenv("XML_XPATH_STREAM");
+    if ((env != NULL) && (!strcmp(env, "none")))
+	xmlXPathStreamPaths = 0;
+#endif
 
     xmlXPathInitialized = 1;
 }
@@ -939,6 +959,9 @@ struct _xmlXPathStepOp {
     void *cacheURI;
 };
 
+typedef struct _xmlXPathCompCacheEntry xmlXPathCompCacheEntry;
+typedef xmlXPathCompCacheEntry *xmlXPathCompCacheEntryPtr;
+
 struct _xmlXPathCompExpr {
     int nbStep;			/* Number of steps in this expression */
     int maxStep;		/* Maximum number of steps allocated */
@@ -953,6 +976,10 @@ struct _xmlXPathCompExpr {
 #ifdef XPATH_STREAMING
     xmlPatternPtr stream;
 #endif
+    int pathOp;			/* the last step of a path xmlXPathStreamPath()
+				   can evaluate, or -1 */
+    int pathCount;		/* the expression is count() of that path */
+    xmlXPathCompCacheEntryPtr entry; /* the cache entry sharing it, or NULL */
 };
 
 /************************************************************************
@@ -1006,6 +1033,7 @@ xmlXPathNewCompExpr(void) {
     }
     memset(cur->steps, 0, cur->maxStep * sizeof(xmlXPathStepOp));
     cur->last = -1;
+    cur->pathOp = -1;
 #ifdef DEBUG_EVAL_COUNTS
     cur->nb = 0;
 #endif
@@ -12767,8 +12795,8 @@ xmlXPathCompOpEvalFirst(xmlXPathParserContextPtr ctxt,
                                                     arg2->nodesetval);
             valuePush(ctxt, arg1);
 	    xmlXPathReleaseObject(ctxt->context, arg2);
-            /* optimizer */
-	    if (total > cur)
+            /* optimizer, expressions shared by a cache are read-only */
+	    if ((total > cur) && (comp->entry == NULL))
 		xmlXPathCompSwap(op);
             return (total + cur);
         case XPATH_OP_ROOT:
@@ -12902,8 +12930,8 @@ xmlXPathCompOpEvalLast(xmlXPathParserContextPtr ctxt, xmlXPathStepOpPtr op,
                                                     arg2->nodesetval);
             valuePush(ctxt, arg1);
 	    xmlXPathReleaseObject(ctxt->context, arg2);
-            /* optimizer */
-	    if (total > cur)
+            /* optimizer, expressions shared by a cache are read-only */
+	    if ((total > cur) && (comp->entry == NULL))
 		xmlXPathCompSwap(op);
             return (total + cur);
         case XPATH_OP_ROOT:
@@ -13521,6 +13549,7 @@ xmlXPathCompOpEval(xmlXPathParserContextPtr ctxt, xmlXPathStepOpPtr op)
         case XPATH_OP_FUNCTION:{
                 xmlXPathFunction func;
                 const xmlChar *oldFunc, *oldFuncURI;
+                const xmlChar *URI = NULL;
 		int i;
                 int frame;
 
@@ -13549,11 +13578,10 @@ xmlXPathCompOpEval(xmlXPathParserContextPtr ctxt, xmlXPathStepOpPtr op)
 			return (total);
 		    }
                 }
-                if (op->cache != NULL)
+                if (op->cache != NULL) {
                     XML_CAST_FPTR(func) = op->cache;
-                else {
-                    const xmlChar *URI = NULL;
-
+                    URI = op->cacheURI;
+                } else {
                     if (op->value5 == NULL)
                         func =
                             xmlXPathFunctionLookup(ctxt->context,
@@ -13577,13 +13605,19 @@ xmlXPathCompOpEval(xmlXPathParserContextPtr ctxt, xmlXPathStepOpPtr op)
                                         (char *)op->value4);
                         XP_ERROR0(XPATH_UNKNOWN_FUNC_ERROR);
                     }
-                    op->cache = XML_CAST_FPTR(func);
-                    op->cacheURI = (void *) URI;
+                    /*
+                     * Expressions shared by a cache are evaluated by
+                     * several threads and are read-only.
+                     */
+                    if (comp->entry == NULL) {
+                        op->cache = XML_CAST_FPTR(func);
+                        op->cacheURI = (void *) URI;
+                    }
                 }
                 oldFunc = ctxt->context->function;
                 oldFuncURI = ctxt->context->functionURI;
                 ctxt->context->function = op->value4;
-                ctxt->context->functionURI = op->cacheURI;
+                ctxt->context->functionURI = URI;
                 func(ctxt, op->value);
                 ctxt->context->function = oldFunc;
                 ctxt->context->functionURI = oldFuncURI;
@@ -14478,6 +14512,752 @@ return_1:
 }
 #endif /* XPATH_STREAMING */
 
+/************************************************************************
+ *									*
+ *		Streaming evaluation of location paths			*
+ *									*
+ ************************************************************************/
+
+/*
+ * A location path whose steps all use the child, descendant,
+ * descendant-or-self and self axes, possibly followed by an attribute
+ * step, selects its nodes in document order in one walk of the tree:
+ * xmlXPathStreamPath() keeps for each node the set of steps it matches,
+ * bit j for step j and bit 0 for the context node, instead of building
+ * and sorting the node-set of every step.
+ */
+#define XPATH_STREAM_MAX_STEPS 31
+
+typedef struct _xmlXPathStreamStep xmlXPathStreamStep;
+typedef xmlXPathStreamStep *xmlXPathStreamStepPtr;
+struct _xmlXPathStreamStep {
+    xmlXPathStepOpPtr op;	/* the COLLECT operation */
+    xmlXPathAxisVal axis;	/* copied from op for the node tests */
+    xmlXPathTestVal test;
+    xmlXPathTypeVal type;
+    const xmlChar *name;
+    xmlXPathStepOpPtr pred;	/* the predicates but a last [n], or NULL */
+    int ranged;			/* the step ends with a [n] predicate */
+    int pos;			/* the n of that predicate */
+    int slot;			/* its counter for the child axis */
+    const xmlChar *URI;		/* the namespace of the node test */
+};
+
+typedef struct _xmlXPathStreamWalk xmlXPathStreamWalk;
+typedef xmlXPathStreamWalk *xmlXPathStreamWalkPtr;
+struct _xmlXPathStreamWalk {
+    xmlXPathParserContextPtr ctxt;
+    xmlXPathStreamStep steps[XPATH_STREAM_MAX_STEPS + 1]; /* from 1 */
+    int nbStep;
+    int nbSlot;			/* the number of [n] on the child axis */
+    unsigned int childMask;	/* bit j - 1 for the child steps j */
+    unsigned int descMask;	/* bit j - 1 for the descendant steps j */
+    unsigned int selfMask;	/* bit j - 1 for the self steps j */
+    int elements;		/* only elements can match the steps */
+    xmlXPathObjectPtr contextObj; /* the context node of the predicates */
+    xmlNodeSetPtr set;		/* the selected nodes, or NULL */
+    xmlXPathStreamFunc func;	/* called on the selected nodes, or NULL */
+    void *data;
+    int max;			/* stop after that many nodes, if not 0 */
+    int nb;			/* the number of nodes selected */
+};
+
+/*
+ * A node whose children are being walked.
+ */
+typedef struct _xmlXPathStreamFrame xmlXPathStreamFrame;
+typedef xmlXPathStreamFrame *xmlXPathStreamFramePtr;
+struct _xmlXPathStreamFrame {
+    xmlNodePtr node;
+    unsigned int matched;	/* the steps the node matches */
+    unsigned int inherited;	/* the steps matched by it or an ancestor,
+				   for the descendant axes */
+    unsigned int exhausted;	/* the [n] steps of the child axis which
+				   have found their child */
+};
+
+/*
+ * The core functions which can appear in the predicates of a streamed
+ * path, that is all but position() and last(); the ones before
+ * XPATH_STREAM_NUMBER_FUNC do not return a number and can be the whole
+ * predicate.
+ */
+static const char *const xmlXPathStreamFunctions[] = {
+    "boolean", "not", "true", "false", "lang", "contains", "starts-with",
+    "string", "concat", "substring", "substring-before", "substring-after",
+    "normalize-space", "translate", "local-name", "name", "namespace-uri",
+    "id",
+    "count", "sum", "string-length", "number", "floor", "ceiling", "round",
+    NULL
+};
+#define XPATH_STREAM_NUMBER_FUNC 18
+
+static int
+xmlXPathStreamFunction(const xmlChar *name) {
+    int i;
+
+    for (i = 0; xmlXPathStreamFunctions[i] != NULL; i++) {
+	if (xmlStrEqual(name, BAD_CAST xmlXPathStreamFunctions[i]))
+	    return(i);
+    }
+    return(-1);
+}
+
+/**
+ * xmlXPathStreamPositionFree:
+ * @comp:  the compiled expression
+ * @op:  an operation of a predicate
+ *
+ * Returns 1 if @op does not depend on the context position and size,
+ *         0 otherwise
+ */
+static int
+xmlXPathStreamPositionFree(xmlXPathCompExprPtr comp, xmlXPathStepOpPtr op) {
+    if ((op->op == XPATH_OP_FUNCTION) &&
+        ((op->value5 != NULL) || (xmlXPathStreamFunction(op->value4) < 0)))
+	return(0);
+#ifdef LIBXML_XPTR_ENABLED
+    if (op->op == XPATH_OP_RANGETO)
+	return(0);
+#endif
+    if ((op->ch1 != -1) &&
+        (!xmlXPathStreamPositionFree(comp, &comp->steps[op->ch1])))
+	return(0);
+    if ((op->ch2 != -1) &&
+        (!xmlXPathStreamPositionFree(comp, &comp->steps[op->ch2])))
+	return(0);
+    return(1);
+}
+
+/**
+ * xmlXPathStreamPredicate:
+ * @comp:  the compiled expression
+ * @op:  the expression of a predicate
+ *
+ * A predicate evaluating to a number compares it with the context
+ * position, which xmlXPathStreamPath() does not know.
+ *
+ * Returns 1 if @op never evaluates to a number nor uses the context
+ *         position, 0 otherwise
+ */
+static int
+xmlXPathStreamPredicate(xmlXPathCompExprPtr comp, xmlXPathStepOpPtr op) {
+    xmlXPathStepOpPtr top = op;
+
+    while ((top->op == XPATH_OP_SORT) && (top->ch1 != -1))
+	top = &comp->steps[top->ch1];
+    switch (top->op) {
+	case XPATH_OP_AND:
+	case XPATH_OP_OR:
+	case XPATH_OP_EQUAL:
+	case XPATH_OP_CMP:
+	case XPATH_OP_UNION:
+	case XPATH_OP_COLLECT:
+	    break;
+	case XPATH_OP_VALUE:
+	    if (((xmlXPathObjectPtr) top->value4)->type == XPATH_NUMBER)
+		return(0);
+	    break;
+	case XPATH_OP_FUNCTION:
+	    if ((top->value5 != NULL) ||
+	        (xmlXPathStreamFunction(top->value4) < 0) ||
+	        (xmlXPathStreamFunction(top->value4) >=
+		 XPATH_STREAM_NUMBER_FUNC))
+		return(0);
+	    break;
+	default:
+	    return(0);
+    }
+    return(xmlXPathStreamPositionFree(comp, op));
+}
+
+/**
+ * xmlXPathStreamPathCompile:
+ * @comp:  the compiled expression
+ *
+ * Check whether @comp, or the argument of a count() making up @comp,
+ * is a location path xmlXPathStreamPath() can evaluate and record it
+ * in @comp.
+ */
+static void
+xmlXPathStreamPathCompile(xmlXPathCompExprPtr comp) {
+    xmlXPathParserContext pctxt;
+    xmlXPathStepOpPtr op, pred;
+    int i, last, nbStep = 0, count = 0, pos;
+
+    if ((comp == NULL) || (comp->last < 0))
+	return;
+    /* xmlXPathIsPositionalPredicate() only looks at the steps */
+    memset(&pctxt, 0, sizeof(pctxt));
+    pctxt.comp = comp;
+
+    op = &comp->steps[comp->last];
+    if ((op->op == XPATH_OP_SORT) && (op->ch1 != -1))
+	op = &comp->steps[op->ch1];
+    if ((op->op == XPATH_OP_FUNCTION) && (op->value == 1) &&
+        (op->value5 == NULL) && (xmlStrEqual(op->value4, BAD_CAST "count")) &&
+	(op->ch1 != -1)) {
+	op = &comp->steps[op->ch1];
+	if ((op->op != XPATH_OP_ARG) || (op->ch1 != -1) || (op->ch2 == -1))
+	    return;
+	op = &comp->steps[op->ch2];
+	if ((op->op == XPATH_OP_SORT) && (op->ch1 != -1))
+	    op = &comp->steps[op->ch1];
+	count = 1;
+    }
+    last = op - comp->steps;
+
+    for (i = last; op->op == XPATH_OP_COLLECT; op = &comp->steps[i]) {
+	if (++nbStep > XPATH_STREAM_MAX_STEPS)
+	    return;
+	switch ((xmlXPathAxisVal) op->value) {
+	    case AXIS_ATTRIBUTE:
+		if (i != last)
+		    return;
+		break;
+	    case AXIS_CHILD:
+	    case AXIS_DESCENDANT:
+	    case AXIS_DESCENDANT_OR_SELF:
+	    case AXIS_SELF:
+		break;
+	    default:
+		return;
+	}
+	switch ((xmlXPathTestVal) op->value2) {
+	    case NODE_TEST_TYPE:
+	    case NODE_TEST_PI:
+	    case NODE_TEST_ALL:
+	    case NODE_TEST_NAME:
+		break;
+	    default:
+		return;
+	}
+	if (op->ch2 != -1) {
+	    pred = &comp->steps[op->ch2];
+	    if (xmlXPathIsPositionalPredicate(&pctxt, pred, &pos)) {
+		/* the position among the descendants of several nodes */
+		if ((op->value == AXIS_DESCENDANT) ||
+		    (op->value == AXIS_DESCENDANT_OR_SELF))
+		    return;
+		pred = (pred->ch1 != -1) ? &comp->steps[pred->ch1] : NULL;
+	    }
+	    for (; pred != NULL;
+	         pred = (pred->ch1 != -1) ? &comp->steps[pred->ch1] : NULL) {
+		if ((pred->op != XPATH_OP_PREDICATE) || (pred->ch2 == -1) ||
+		    (!xmlXPathStreamPredicate(comp, &comp->steps[pred->ch2])))
+		    return;
+	    }
+	}
+	if (op->ch1 == -1)
+	    return;
+	i = op->ch1;
+    }
+    if ((nbStep == 0) ||
+        ((op->op != XPATH_OP_ROOT) && (op->op != XPATH_OP_NODE)) ||
+	(op->ch1 != -1) || (op->ch2 != -1))
+	return;
+    comp->pathOp = last;
+    comp->pathCount = count;
+}
+
+/**
+ * xmlXPathStreamNodeTest:
+ * @step:  a step of the path
+ * @cur:  a node
+ *
+ * Apply the node test of @step to @cur the way
+ * xmlXPathNodeCollectAndTest() does.
+ *
+ * Returns 1 if @cur passes the test, 0 otherwise
+ */
+static int
+xmlXPathStreamNodeTest(xmlXPathStreamStepPtr step, xmlNodePtr cur) {
+    switch (step->test) {
+	case NODE_TEST_NAME:
+	case NODE_TEST_ALL:
+	    if (step->axis == AXIS_ATTRIBUTE) {
+		if (cur->type != XML_ATTRIBUTE_NODE)
+		    return(0);
+	    } else if (cur->type != XML_ELEMENT_NODE) {
+		return(0);
+	    }
+	    if ((step->test == NODE_TEST_NAME) &&
+	        (!xmlStrEqual(step->name, cur->name)))
+		return(0);
+	    if (step->URI != NULL)
+		return((cur->ns != NULL) &&
+		       (xmlStrEqual(step->URI, cur->ns->href)));
+	    if (step->test == NODE_TEST_ALL)
+		return(1);
+	    if (cur->type == XML_ELEMENT_NODE)
+		return(cur->ns == NULL);
+	    return((cur->ns == NULL) || (cur->ns->prefix == NULL));
+	case NODE_TEST_TYPE:
+	    if (step->type == NODE_TYPE_NODE) {
+		switch (cur->type) {
+		    case XML_DOCUMENT_NODE:
+		    case XML_HTML_DOCUMENT_NODE:
+#ifdef LIBXML_DOCB_ENABLED
+		    case XML_DOCB_DOCUMENT_NODE:
+#endif
+		    case XML_ELEMENT_NODE:
+		    case XML_ATTRIBUTE_NODE:
+		    case XML_PI_NODE:
+		    case XML_COMMENT_NODE:
+		    case XML_CDATA_SECTION_NODE:
+		    case XML_TEXT_NODE:
+			return(1);
+		    default:
+			return(0);
+		}
+	    }
+	    return((cur->type == (xmlElementType) step->type) ||
+	           ((step->type == NODE_TYPE_TEXT) &&
+		    (cur->type == XML_CDATA_SECTION_NODE)));
+	case NODE_TEST_PI:
+	    return((cur->type == XML_PI_NODE) &&
+	           ((step->name == NULL) || (xmlStrEqual(step->name, cur->name))));
+	default:
+	    return(0);
+    }
+}
+
+/**
+ * xmlXPathStreamPredicates:
+ * @walk:  the walk
+ * @op:  the outermost predicate to apply
+ * @cur:  a node
+ *
+ * Evaluate the predicates with @cur as the context node, the way
+ * xmlXPathCompOpEvalPredicate() does, but without a context position
+ * and size which xmlXPathStreamPathCompile() made sure are not used.
+ *
+ * Returns 1 if @cur passes the predicates, 0 if not and -1 on error
+ */
+static int
+xmlXPathStreamPredicates(xmlXPathStreamWalkPtr walk, xmlXPathStepOpPtr op,
+                         xmlNodePtr cur) {
+    xmlXPathParserContextPtr ctxt = walk->ctxt;
+    xmlXPathContextPtr xpctxt = ctxt->context;
+    xmlNodePtr oldContextNode;
+    xmlDocPtr oldContextDoc;
+    int res;
+
+    if (op->ch1 != -1) {
+	res = xmlXPathStreamPredicates(walk, &ctxt->comp->steps[op->ch1], cur);
+	if (res != 1)
+	    return(res);
+    }
+
+    if (walk->contextObj == NULL) {
+	walk->contextObj = xmlXPathCacheNewNodeSet(xpctxt, cur);
+	if (walk->contextObj == NULL) {
+	    ctxt->error = XPATH_MEMORY_ERROR;
+	    return(-1);
+	}
+    } else if (xmlXPathNodeSetAddUnique(walk->contextObj->nodesetval,
+                                        cur) < 0) {
+	ctxt->error = XPATH_MEMORY_ERROR;
+	return(-1);
+    }
+
+    oldContextNode = xpctxt->node;
+    oldContextDoc = xpctxt->doc;
+    xpctxt->node = cur;
+    if (cur->doc != NULL)
+	xpctxt->doc = cur->doc;
+
+    valuePush(ctxt, walk->contextObj);
+    res = xmlXPathCompOpEvalToBoolean(ctxt, &ctxt->comp->steps[op->ch2], 1);
+    if (ctxt->error != XPATH_EXPRESSION_OK)
+	res = -1;
+    if (ctxt->value == walk->contextObj) {
+	valuePop(ctxt);
+	xmlXPathNodeSetClear(walk->contextObj->nodesetval, 0);
+    } else {
+	/* lost in the evaluation, see xmlXPathCompOpEvalPredicate() */
+	walk->contextObj = NULL;
+    }
+
+    xpctxt->node = oldContextNode;
+    xpctxt->doc = oldContextDoc;
+    xpctxt->contextSize = -1;
+    xpctxt->proximityPosition = -1;
+    return(res);
+}
+
+/**
+ * xmlXPathStreamMatch:
+ * @walk:  the walk
+ * @cur:  a node
+ * @matched:  the steps @cur is known to match
+ * @parent:  the steps the parent of @cur matches, but the exhausted ones
+ * @inherited:  the steps the ancestors of @cur match, for the
+ *              descendant axes
+ * @frame:  the frame of the parent of @cur, or NULL
+ * @counters:  the [n] counters of the parent of @cur
+ *
+ * Returns the steps @cur matches, check ctxt->error
+ */
+static unsigned int
+xmlXPathStreamMatch(xmlXPathStreamWalkPtr walk, xmlNodePtr cur,
+                    unsigned int matched, unsigned int parent,
+		    unsigned int inherited, xmlXPathStreamFramePtr frame,
+		    int *counters) {
+    xmlXPathStreamStepPtr step;
+    unsigned int todo, bit;
+    int j, res;
+
+    /*
+     * Only try the steps whose previous step the parent or an ancestor
+     * matched, or the node itself for the self axes; the bits of the
+     * latter are added as the node matches the previous steps.
+     */
+    todo = (parent & walk->childMask) | inherited | (matched & walk->selfMask);
+    for (j = 1, bit = 1; todo >= bit; j++, bit <<= 1) {
+	if ((todo & bit) == 0)
+	    continue;
+	step = &walk->steps[j];
+	if (!xmlXPathStreamNodeTest(step, cur))
+	    continue;
+	if (step->pred != NULL) {
+	    res = xmlXPathStreamPredicates(walk, step->pred, cur);
+	    if (res < 0)
+		return(0);
+	    if (res == 0)
+		continue;
+	}
+	if (step->ranged) {
+	    if (step->axis == AXIS_CHILD) {
+		if (++counters[step->slot] != step->pos)
+		    continue;
+		frame->exhausted |= bit;
+	    } else if (step->pos != 1) {
+		continue;
+	    }
+	}
+	matched |= bit << 1;
+	todo |= (bit << 1) & walk->selfMask;
+    }
+    return(matched);
+}
+
+/**
+ * xmlXPathStreamAdd:
+ * @walk:  the walk
+ * @cur:  a node selected by the path
+ *
+ * Returns 1 to stop the walk, 0 to go on and -1 on error
+ */
+static int
+xmlXPathStreamAdd(xmlXPathStreamWalkPtr walk, xmlNodePtr cur) {
+    walk->nb++;
+    if ((walk->set != NULL) &&
+        (xmlXPathNodeSetAddUnique(walk->set, cur) < 0)) {
+	walk->ctxt->error = XPATH_MEMORY_ERROR;
+	return(-1);
+    }
+    if ((walk->func != NULL) && (walk->func(walk->data, cur) != 0))
+	return(1);
+    if ((walk->max > 0) && (walk->nb >= walk->max))
+	return(1);
+    return(0);
+}
+
+/**
+ * xmlXPathStreamSelect:
+ * @walk:  the walk
+ * @cur:  a node
+ * @matched:  the steps @cur matches
+ *
+ * Add @cur, or its attributes selected by a last attribute step.
+ *
+ * Returns 1 to stop the walk, 0 to go on and -1 on error
+ */
+static int
+xmlXPathStreamSelect(xmlXPathStreamWalkPtr walk, xmlNodePtr cur,
+                     unsigned int matched) {
+    xmlXPathStreamStepPtr step = &walk->steps[walk->nbStep];
+    xmlAttrPtr attr;
+    int pos = 0, res;
+
+    if (matched & (1U << walk->nbStep))
+	return(xmlXPathStreamAdd(walk, cur));
+    if ((step->axis != AXIS_ATTRIBUTE) ||
+        ((matched & (1U << (walk->nbStep - 1))) == 0) ||
+	(cur->type != XML_ELEMENT_NODE))
+	return(0);
+    for (attr = cur->properties; attr != NULL; attr = attr->next) {
+	if (!xmlXPathStreamNodeTest(step, (xmlNodePtr) attr))
+	    continue;
+	if (step->pred != NULL) {
+	    res = xmlXPathStreamPredicates(walk, step->pred, (xmlNodePtr) attr);
+	    if (res < 0)
+		return(-1);
+	    if (res == 0)
+		continue;
+	}
+	if ((step->ranged) && (++pos != step->pos))
+	    continue;
+	res = xmlXPathStreamAdd(walk, (xmlNodePtr) attr);
+	if (res != 0)
+	    return(res);
+    }
+    return(0);
+}
+
+/**
+ * xmlXPathStreamPath:
+ * @ctxt:  the XPath parser context with the compiled expression
+ * @set:  a node-set to add the selected nodes to, or NULL
+ * @func:  a function to call on the selected nodes, or NULL
+ * @data:  the first argument of @func
+ * @max:  the number of nodes to stop after, or 0
+ *
+ * Select the nodes of the path recorded by xmlXPathStreamPathCompile()
+ * in document order, in a single walk of the tree below the context
+ * node, or the document for an absolute path.
+ *
+ * Returns the number of nodes selected, -1 on error and -2 if the
+ *         context node is an attribute or other node the walk does not
+ *         start from.
+ */
+static int
+xmlXPathStreamPath(xmlXPathParserContextPtr ctxt, xmlNodeSetPtr set,
+                   xmlXPathStreamFunc func, void *data, int max) {
+    xmlXPathContextPtr xpctxt = ctxt->context;
+    xmlXPathCompExprPtr comp = ctxt->comp;
+    xmlXPathStreamWalk walk;
+    xmlXPathStreamStepPtr step;
+    xmlXPathStreamFramePtr frames = NULL, top;
+    xmlXPathStepOpPtr op, pred;
+    xmlNodePtr start, cur;
+    unsigned int matched, inherited, parent, bit;
+    int *counters = NULL;
+    int depth = 0, maxDepth = 0, j, res;
+
+    memset(&walk, 0, sizeof(walk));
+    walk.ctxt = ctxt;
+    walk.set = set;
+    walk.func = func;
+    walk.data = data;
+    walk.max = max;
+
+    for (op = &comp->steps[comp->pathOp]; op->op == XPATH_OP_COLLECT;
+         op = &comp->steps[op->ch1])
+	walk.nbStep++;
+    walk.elements = 1;
+    for (j = walk.nbStep, op = &comp->steps[comp->pathOp]; j > 0;
+         j--, op = &comp->steps[op->ch1]) {
+	step = &walk.steps[j];
+	step->op = op;
+	step->axis = (xmlXPathAxisVal) op->value;
+	step->test = (xmlXPathTestVal) op->value2;
+	step->type = (xmlXPathTypeVal) op->value3;
+	step->name = op->value5;
+	if ((step->axis != AXIS_ATTRIBUTE) && (step->test != NODE_TEST_NAME) &&
+	    (step->test != NODE_TEST_ALL))
+	    walk.elements = 0;
+	if (op->value4 != NULL) {
+	    step->URI = xmlXPathNsLookup(xpctxt, op->value4);
+	    if (step->URI == NULL) {
+		xmlXPathErr(ctxt, XPATH_UNDEF_PREFIX_ERROR);
+		return(-1);
+	    }
+	}
+	pred = NULL;
+	if (op->ch2 != -1) {
+	    pred = &comp->steps[op->ch2];
+	    if (xmlXPathIsPositionalPredicate(ctxt, pred, &step->pos)) {
+		step->ranged = 1;
+		if (op->value == AXIS_CHILD)
+		    step->slot = walk.nbSlot++;
+		pred = (pred->ch1 != -1) ? &comp->steps[pred->ch1] : NULL;
+	    }
+	}
+	step->pred = pred;
+	bit = 1U << (j - 1);
+	if (op->value == AXIS_CHILD)
+	    walk.childMask |= bit;
+	if ((op->value == AXIS_DESCENDANT) ||
+	    (op->value == AXIS_DESCENDANT_OR_SELF))
+	    walk.descMask |= bit;
+	if ((op->value == AXIS_SELF) ||
+	    (op->value == AXIS_DESCENDANT_OR_SELF))
+	    walk.selfMask |= bit;
+    }
+
+    if (op->op == XPATH_OP_ROOT)
+	xpctxt->node = (xmlNodePtr) xpctxt->doc;
+    start = xpctxt->node;
+    if (start == NULL)
+	return(0);
+    switch (start->type) {
+	case XML_ELEMENT_NODE:
+	case XML_DOCUMENT_NODE:
+	case XML_HTML_DOCUMENT_NODE:
+#ifdef LIBXML_DOCB_ENABLED
+	case XML_DOCB_DOCUMENT_NODE:
+#endif
+	    break;
+	default:
+	    return(-2);
+    }
+
+    matched = xmlXPathStreamMatch(&walk, start, 1, 0, 0, NULL, NULL);
+    if (ctxt->error != XPATH_EXPRESSION_OK)
+	goto done;
+    res = xmlXPathStreamSelect(&walk, start, matched);
+    if (res != 0)
+	goto done;
+    inherited = matched & walk.descMask;
+    if (((matched & walk.childMask) | inherited) == 0)
+	goto done;
+
+    /*
+     * Walk the tree in document order, skipping the DTD and the entity
+     * declarations like xmlXPathNextDescendant(), and the subtrees the
+     * remaining steps cannot match in.
+     */
+    cur = start;
+    while (1) {
+	if (depth >= maxDepth) {
+	    xmlXPathStreamFramePtr tmp;
+	    int *tmpc;
+
+	    maxDepth = maxDepth ? 2 * maxDepth : 16;
+	    tmp = (xmlXPathStreamFramePtr) xmlRealloc(frames,
+		    maxDepth * sizeof(xmlXPathStreamFrame));
+	    if (tmp == NULL) {
+		xmlXPathPErrMemory(ctxt, "growing the path walk\n");
+		goto done;
+	    }
+	    frames = tmp;
+	    if (walk.nbSlot > 0) {
+		tmpc = (int *) xmlRealloc(counters,
+			maxDepth * walk.nbSlot * sizeof(int));
+		if (tmpc == NULL) {
+		    xmlXPathPErrMemory(ctxt, "growing the path walk\n");
+		    goto done;
+		}
+		counters = tmpc;
+	    }
+	}
+	top = &frames[depth];
+	top->node = cur;
+	top->matched = matched;
+	top->inherited = inherited;
+	top->exhausted = 0;
+	if (walk.nbSlot > 0)
+	    memset(&counters[depth * walk.nbSlot], 0, walk.nbSlot * sizeof(int));
+	depth++;
+	cur = cur->children;
+
+	while (1) {
+	    top = &frames[depth - 1];
+	    parent = top->matched & ~top->exhausted;
+	    if ((cur == NULL) ||
+	        (((parent & walk.childMask) | top->inherited) == 0)) {
+		/* no step left to match among the siblings */
+		if (--depth == 0)
+		    goto done;
+		cur = frames[depth].node->next;
+		continue;
+	    }
+	    if ((cur->type != XML_ELEMENT_NODE) &&
+	        ((walk.elements) || (cur->type == XML_DTD_NODE) ||
+		 (cur->type == XML_ENTITY_DECL))) {
+		cur = cur->next;
+		continue;
+	    }
+	    matched = xmlXPathStreamMatch(&walk, cur, 0, parent,
+		    top->inherited, top,
+		    (walk.nbSlot > 0) ? &counters[(depth - 1) * walk.nbSlot] :
+		                        NULL);
+	    if (ctxt->error != XPATH_EXPRESSION_OK)
+		goto done;
+	    if (matched != 0) {
+		res = xmlXPathStreamSelect(&walk, cur, matched);
+		if (res != 0)
+		    goto done;
+	    }
+	    inherited = top->inherited | (matched & walk.descMask);
+	    if ((((matched & walk.childMask) | inherited) != 0) &&
+	        (cur->children != NULL) &&
+		(cur->children->type != XML_ENTITY_DECL))
+		break;
+	    cur = cur->next;
+	}
+    }
+
+done:
+    if (frames != NULL)
+	xmlFree(frames);
+    if (counters != NULL)
+	xmlFree(counters);
+    if (walk.contextObj != NULL)
+	xmlXPathReleaseObject(xpctxt, walk.contextObj);
+    if (ctxt->error != XPATH_EXPRESSION_OK)
+	return(-1);
+    return(walk.nb);
+}
+
+/**
+ * xmlXPathRunStreamPath:
+ * @ctxt:  the XPath parser context with the compiled expression
+ * @toBool:  evaluate to a boolean result
+ *
+ * Evaluate the expression recorded by xmlXPathStreamPathCompile() with
+ * xmlXPathStreamPath(), leaving the result on the stack.
+ *
+ * Returns what xmlXPathRunEval() returns, or -2 if the expression
+ *         must be evaluated by xmlXPathCompOpEval().
+ */
+static int
+xmlXPathRunStreamPath(xmlXPathParserContextPtr ctxt, int toBool)
+{
+    xmlXPathContextPtr xpctxt = ctxt->context;
+    xmlNodeSetPtr set;
+    int res;
+
+    if (ctxt->comp->pathCount) {
+	xmlNodePtr oldContextNode = xpctxt->node;
+
+	if (xmlXPathFunctionLookup(xpctxt, BAD_CAST "count") !=
+	    xmlXPathCountFunction)
+	    return(-2);
+	/* count() evaluates its argument in an XPATH_OP_ARG */
+	res = xmlXPathStreamPath(ctxt, NULL, NULL, NULL, toBool);
+	xpctxt->node = oldContextNode;
+	if (res < 0)
+	    return(((res == -2) || (toBool)) ? res : 0);
+	if (toBool)
+	    return(res != 0);
+	valuePush(ctxt, xmlXPathCacheNewFloat(xpctxt, (double) res));
+	return(0);
+    }
+
+    if (toBool) {
+	res = xmlXPathStreamPath(ctxt, NULL, NULL, NULL, 1);
+	if (res < 0)
+	    return(res);
+	return(res != 0);
+    }
+    set = xmlXPathNodeSetCreate(NULL);
+    if (set == NULL) {
+	ctxt->error = XPATH_MEMORY_ERROR;
+	return(0);
+    }
+    res = xmlXPathStreamPath(ctxt, set, NULL, NULL, 0);
+    if (res == -2) {
+	xmlXPathFreeNodeSet(set);
+	return(-2);
+    }
+    /* pushed on errors too, like xmlXPathNodeCollectAndTest() does */
+    valuePush(ctxt, xmlXPathCacheWrapNodeSet(xpctxt, set));
+    return(0);
+}
+
 /**
  * xmlXPathRunEval:
  * @ctxt:  the XPath parser context with the compiled expression
@@ -14546,6 +15326,13 @@ xmlXPathRunEval(xmlXPathParserContextPtr ctxt, int toBool)
 	    "xmlXPathRunEval: last is less than zero\n");
 	return(-1);
     }
+    if ((comp->pathOp >= 0) && (xmlXPathStreamPaths)) {
+	int res;
+
+	res = xmlXPathRunStreamPath(ctxt, toBool);
+	if (res != -2)
+	    return(res);
+    }
     if (toBool)
 	return(xmlXPathCompOpEvalToBoolean(ctxt,
 	    &comp->steps[comp->last], 0));
@@ -14871,6 +15658,7 @@ xmlXPathCtxtCompile(xmlXPathContextPtr ctxt, const xmlChar *str) {
 	if ((comp->nbStep > 1) && (comp->last >= 0)) {
 	    xmlXPathOptimizeExpression(comp, comp->last);
 	}
+	xmlXPathStreamPathCompile(comp);
     }
     return(comp);
 }
@@ -15019,6 +15807,445 @@ xmlXPathCompiledEvalToBoolean(xmlXPathCompExprPtr comp,
     return(xmlXPathCompiledEvalInternal(comp, ctxt, NULL, 1));
 }
 
+/**
+ * xmlXPathCompiledEvalStream:
+ * @comp:  the compiled XPath expression
+ * @ctxt:  the XPath context
+ * @func:  the function to call on the selected nodes
+ * @data:  the first argument of @func
+ *
+ * Evaluate the Precompiled XPath expression and call @func on each node
+ * of the resulting node-set, in document order, until it returns
+ * nonzero.  A location path on the forward axes from the document or an
+ * element, like "//item[@id]" or "a/b[1]/@c", is evaluated in a single
+ * walk of the tree without building its node-set, and stops walking
+ * when @func asks to.
+ *
+ * Returns the number of nodes @func was called on, or -1 in case of
+ *         error or if the expression does not evaluate to a node-set.
+ */
+int
+xmlXPathCompiledEvalStream(xmlXPathCompExprPtr comp, xmlXPathContextPtr ctxt,
+                           xmlXPathStreamFunc func, void *data)
+{
+    xmlXPathParserContextPtr pctxt;
+    xmlXPathObjectPtr res = NULL;
+    int ret, i;
+
+    CHECK_CTXT_NEG(ctxt)
+
+    if ((comp == NULL) || (func == NULL))
+	return(-1);
+    xmlXPathInit();
+
+    if ((comp->pathOp >= 0) && (!comp->pathCount) && (xmlXPathStreamPaths)) {
+	pctxt = xmlXPathCompParserContext(comp, ctxt);
+	if (pctxt == NULL)
+	    return(-1);
+	ret = xmlXPathStreamPath(pctxt, NULL, func, data, 0);
+	pctxt->comp = NULL;
+	xmlXPathFreeParserContext(pctxt);
+	if (ret != -2)
+	    return(ret);
+    }
+
+    xmlXPathCompiledEvalInternal(comp, ctxt, &res, 0);
+    if (res == NULL)
+	return(-1);
+    if (res->type != XPATH_NODESET) {
+	xmlXPathFreeObject(res);
+	return(-1);
+    }
+    ret = 0;
+    if (res->nodesetval != NULL) {
+	xmlXPathNodeSetSort(res->nodesetval);
+	for (i = 0; i < res->nodesetval->nodeNr; i++) {
+	    ret++;
+	    if (func(data, res->nodesetval->nodeTab[i]) != 0)
+		break;
+	}
+    }
+    xmlXPathFreeObject(res);
+    return(ret);
+}
+
+/************************************************************************
+ *									*
+ *			Compiled expression cache			*
+ *									*
+ ************************************************************************/
+
+/*
+ * The entries are keyed by the expression, the compilation flags and the
+ * namespace bindings of the context, which xmlXPathTryStreamCompile()
+ * resolves prefixes with; the prefixes registered with xmlXPathRegisterNs()
+ * are only looked up during the evaluation.  The expressions are shared
+ * by all the threads and are not modified by the evaluation once cached,
+ * see comp->entry.  An expression handed out and not released yet is
+ * never evicted.
+ */
+struct _xmlXPathCompCacheEntry {
+    xmlXPathCompCacheEntryPtr next;	/* in the hash bucket */
+    xmlXPathCompCacheEntryPtr lruPrev;	/* used more recently */
+    xmlXPathCompCacheEntryPtr lruNext;	/* used less recently */
+    unsigned int hash;
+    int flags;
+    int keyLen;
+    xmlChar *key;		/* prefix and href pairs, then the
+				   expression, all 0 terminated */
+    xmlXPathCompExprPtr comp;
+    int refs;			/* the lookups not released yet */
+};
+
+struct _xmlXPathCompCache {
+    xmlMutexPtr lock;
+    xmlXPathCompCacheEntryPtr *table;
+    int size;			/* the number of buckets, a power of 2 */
+    int nbEntries;
+    int maxEntries;		/* or 0 for no limit */
+    xmlXPathCompCacheEntryPtr lruFirst;
+    xmlXPathCompCacheEntryPtr lruLast;
+};
+
+#define XPATH_COMP_CACHE_SIZE 64
+
+/**
+ * xmlXPathNewCompCache:
+ * @max:  the number of expressions to keep, or 0 for no limit
+ *
+ * Create a cache of compiled expressions which several threads can
+ * look expressions up in, compiling each of them once.
+ *
+ * Returns the cache or NULL in case of error.
+ */
+xmlXPathCompCachePtr
+xmlXPathNewCompCache(int max) {
+    xmlXPathCompCachePtr ret;
+
+    ret = (xmlXPathCompCachePtr) xmlMalloc(sizeof(xmlXPathCompCache));
+    if (ret == NULL) {
+        xmlXPathErrMemory(NULL, "creating the expression cache\n");
+	return(NULL);
+    }
+    memset(ret, 0, sizeof(xmlXPathCompCache));
+    ret->size = XPATH_COMP_CACHE_SIZE;
+    ret->table = (xmlXPathCompCacheEntryPtr *)
+	xmlMalloc(ret->size * sizeof(xmlXPathCompCacheEntryPtr));
+    ret->lock = xmlNewMutex();
+    if ((ret->table == NULL) || (ret->lock == NULL)) {
+        xmlXPathErrMemory(NULL, "creating the expression cache\n");
+	xmlXPathFreeCompCache(ret);
+	return(NULL);
+    }
+    memset(ret->table, 0, ret->size * sizeof(xmlXPathCompCacheEntryPtr));
+    ret->maxEntries = (max > 0) ? max : 0;
+    return(ret);
+}
+
+static void
+xmlXPathFreeCompCacheEntry(xmlXPathCompCacheEntryPtr entry) {
+    entry->comp->entry = NULL;
+    xmlXPathFreeCompExpr(entry->comp);
+    xmlFree(entry->key);
+    xmlFree(entry);
+}
+
+/**
+ * xmlXPathFreeCompCache:
+ * @cache:  the expression cache
+ *
+ * Free the cache and its expressions, none of which may still be in use.
+ */
+void
+xmlXPathFreeCompCache(xmlXPathCompCachePtr cache) {
+    xmlXPathCompCacheEntryPtr entry, next;
+
+    if (cache == NULL)
+	return;
+    for (entry = cache->lruFirst; entry != NULL; entry = next) {
+	next = entry->lruNext;
+	xmlXPathFreeCompCacheEntry(entry);
+    }
+    if (cache->table != NULL)
+	xmlFree(cache->table);
+    if (cache->lock != NULL)
+	xmlFreeMutex(cache->lock);
+    xmlFree(cache);
+}
+
+/**
+ * xmlXPathCompCacheKey:
+ * @ctxt:  the XPath context or NULL
+ * @str:  the XPath expression
+ * @buf:  a buffer for the key
+ * @size:  the size of @buf
+ * @len:  the length of the key
+ *
+ * Returns the key, in @buf if it fits and allocated otherwise, or NULL
+ *         in case of error.
+ */
+static xmlChar *
+xmlXPathCompCacheKey(xmlXPathContextPtr ctxt, const xmlChar *str,
+                     xmlChar *buf, int size, int *len) {
+    const xmlChar *strs[2];
+    xmlChar *key, *cur;
+    int i, j, l, nsNr;
+
+    nsNr = ((ctxt != NULL) && (ctxt->namespaces != NULL)) ? ctxt->nsNr : 0;
+    l = xmlStrlen(str) + 1;
+    for (i = 0; i < nsNr; i++)
+	l += xmlStrlen(ctxt->namespaces[i]->prefix) +
+	     xmlStrlen(ctxt->namespaces[i]->href) + 2;
+    if (l > size) {
+	key = (xmlChar *) xmlMallocAtomic(l);
+	if (key == NULL)
+	    return(NULL);
+    } else
+	key = buf;
+
+    cur = key;
+    for (i = 0; i <= nsNr; i++) {
+	if (i < nsNr) {
+	    strs[0] = ctxt->namespaces[i]->prefix;
+	    strs[1] = ctxt->namespaces[i]->href;
+	} else {
+	    strs[0] = str;
+	    strs[1] = NULL;
+	}
+	for (j = 0; j < 2; j++) {
+	    if ((i == nsNr) && (j == 1))
+		break;
+	    l = xmlStrlen(strs[j]);
+	    if (l > 0)
+		memcpy(cur, strs[j], l);
+	    cur += l;
+	    *cur++ = 0;
+	}
+    }
+    *len = cur - key;
+    return(key);
+}
+
+static xmlXPathCompCacheEntryPtr
+xmlXPathCompCacheFind(xmlXPathCompCachePtr cache, const xmlChar *key,
+                      int len, unsigned int hash, int flags) {
+    xmlXPathCompCacheEntryPtr entry;
+
+    for (entry = cache->table[hash & (cache->size - 1)]; entry != NULL;
+         entry = entry->next) {
+	if ((entry->hash == hash) && (entry->flags == flags) &&
+	    (entry->keyLen == len) && (!memcmp(entry->key, key, len)))
+	    return(entry);
+    }
+    return(NULL);
+}
+
+static void
+xmlXPathCompCacheUnlinkLRU(xmlXPathCompCachePtr cache,
+                           xmlXPathCompCacheEntryPtr entry) {
+    if (entry->lruPrev != NULL)
+	entry->lruPrev->lruNext = entry->lruNext;
+    else
+	cache->lruFirst = entry->lruNext;
+    if (entry->lruNext != NULL)
+	entry->lruNext->lruPrev = entry->lruPrev;
+    else
+	cache->lruLast = entry->lruPrev;
+}
+
+/*
+ * Hand out the expression of @entry, the cache being locked.
+ */
+static xmlXPathCompExprPtr
+xmlXPathCompCacheUse(xmlXPathCompCachePtr cache,
+                     xmlXPathCompCacheEntryPtr entry) {
+    entry->refs++;
+    if (cache->lruFirst != entry) {
+	xmlXPathCompCacheUnlinkLRU(cache, entry);
+	entry->lruPrev = NULL;
+	entry->lruNext = cache->lruFirst;
+	cache->lruFirst->lruPrev = entry;
+	cache->lruFirst = entry;
+    }
+    return(entry->comp);
+}
+
+/*
+ * Add @entry, the cache being locked, growing the table and evicting
+ * the least recently used expressions not in use beyond the limit.
+ */
+static void
+xmlXPathCompCacheAdd(xmlXPathCompCachePtr cache,
+                     xmlXPathCompCacheEntryPtr entry) {
+    xmlXPathCompCacheEntryPtr *bucket, cur, prev;
+
+    if (cache->nbEntries >= cache->size) {
+	xmlXPathCompCacheEntryPtr *table;
+
+	table = (xmlXPathCompCacheEntryPtr *)
+	    xmlMalloc(2 * cache->size * sizeof(xmlXPathCompCacheEntryPtr));
+	if (table != NULL) {
+	    memset(table, 0,
+	           2 * cache->size * sizeof(xmlXPathCompCacheEntryPtr));
+	    for (cur = cache->lruFirst; cur != NULL; cur = cur->lruNext) {
+		bucket = &table[cur->hash & (2 * cache->size - 1)];
+		cur->next = *bucket;
+		*bucket = cur;
+	    }
+	    xmlFree(cache->table);
+	    cache->table = table;
+	    cache->size *= 2;
+	}
+    }
+    bucket = &cache->table[entry->hash & (cache->size - 1)];
+    entry->next = *bucket;
+    *bucket = entry;
+    entry->lruPrev = NULL;
+    entry->lruNext = cache->lruFirst;
+    if (cache->lruFirst != NULL)
+	cache->lruFirst->lruPrev = entry;
+    else
+	cache->lruLast = entry;
+    cache->lruFirst = entry;
+    cache->nbEntries++;
+
+    if (cache->maxEntries == 0)
+	return;
+    for (cur = cache->lruLast;
+         (cur != NULL) && (cache->nbEntries > cache->maxEntries);
+	 cur = prev) {
+	prev = cur->lruPrev;
+	if (cur->refs > 0)
+	    continue;
+	bucket = &cache->table[cur->hash & (cache->size - 1)];
+	while (*bucket != cur)
+	    bucket = &(*bucket)->next;
+	*bucket = cur->next;
+	xmlXPathCompCacheUnlinkLRU(cache, cur);
+	cache->nbEntries--;
+	xmlXPathFreeCompCacheEntry(cur);
+    }
+}
+
+/**
+ * xmlXPathCompCacheLookup:
+ * @cache:  the expression cache
+ * @ctxt:  the XPath context
+ * @str:  the XPath expression
+ *
+ * Look up the compiled form of @str for the namespaces and flags of
+ * @ctxt in @cache, compiling it with xmlXPathCtxtCompile() the first
+ * time.  The expression can be evaluated by several threads at once,
+ * each with its own context, and is handed back with
+ * xmlXPathCompCacheRelease() instead of being freed.
+ *
+ * Returns the compiled expression or NULL in case of error.
+ */
+xmlXPathCompExprPtr
+xmlXPathCompCacheLookup(xmlXPathCompCachePtr cache, xmlXPathContextPtr ctxt,
+                        const xmlChar *str) {
+    xmlXPathCompCacheEntryPtr entry;
+    xmlXPathCompExprPtr comp = NULL;
+    xmlChar buf[200], *key;
+    unsigned int hash;
+    int len, flags, i;
+
+    if (str == NULL)
+	return(NULL);
+    if (cache == NULL)
+	return(xmlXPathCtxtCompile(ctxt, str));
+
+    flags = (ctxt != NULL) ? ctxt->flags : 0;
+    key = xmlXPathCompCacheKey(ctxt, str, buf, sizeof(buf), &len);
+    if (key == NULL) {
+        xmlXPathErrMemory(ctxt, "looking up an expression\n");
+	return(NULL);
+    }
+    hash = 2166136261U ^ (unsigned int) flags;
+    for (i = 0; i < len; i++)
+	hash = (hash ^ key[i]) * 16777619U;
+
+    xmlMutexLock(cache->lock);
+    entry = xmlXPathCompCacheFind(cache, key, len, hash, flags);
+    if (entry != NULL)
+	comp = xmlXPathCompCacheUse(cache, entry);
+    xmlMutexUnlock(cache->lock);
+    if (comp != NULL)
+	goto done;
+
+    /*
+     * Compile unlocked, another thread may be adding the same
+     * expression meanwhile.
+     */
+    comp = xmlXPathCtxtCompile(ctxt, str);
+    if (comp == NULL)
+	goto done;
+
+    xmlMutexLock(cache->lock);
+    entry = xmlXPathCompCacheFind(cache, key, len, hash, flags);
+    if (entry != NULL) {
+	xmlXPathFreeCompExpr(comp);
+	comp = xmlXPathCompCacheUse(cache, entry);
+    } else {
+	entry = (xmlXPathCompCacheEntryPtr)
+	    xmlMalloc(sizeof(xmlXPathCompCacheEntry));
+	if (entry != NULL) {
+	    memset(entry, 0, sizeof(xmlXPathCompCacheEntry));
+	    if (key == buf) {
+		entry->key = (xmlChar *) xmlMallocAtomic(len);
+		if (entry->key != NULL)
+		    memcpy(entry->key, key, len);
+	    } else {
+		entry->key = key;
+		key = buf;
+	    }
+	    if (entry->key == NULL) {
+		xmlFree(entry);
+		entry = NULL;
+	    }
+	}
+	/* Without an entry, the expression is simply not shared */
+	if (entry != NULL) {
+	    entry->hash = hash;
+	    entry->flags = flags;
+	    entry->keyLen = len;
+	    entry->comp = comp;
+	    entry->refs = 1;
+	    comp->entry = entry;
+	    xmlXPathCompCacheAdd(cache, entry);
+	}
+    }
+    xmlMutexUnlock(cache->lock);
+
+done:
+    if (key != buf)
+	xmlFree(key);
+    return(comp);
+}
+
+/**
+ * xmlXPathCompCacheRelease:
+ * @cache:  the expression cache
+ * @comp:  an expression returned by xmlXPathCompCacheLookup()
+ *
+ * Hand @comp back to @cache once the evaluation is over.
+ */
+void
+xmlXPathCompCacheRelease(xmlXPathCompCachePtr cache,
+                         xmlXPathCompExprPtr comp) {
+    if (comp == NULL)
+	return;
+    if (comp->entry == NULL) {
+	xmlXPathFreeCompExpr(comp);
+	return;
+    }
+    if (cache == NULL)
+	return;
+    xmlMutexLock(cache->lock);
+    comp->entry->refs--;
+    xmlMutexUnlock(cache->lock);
+}
+
 /**
  * xmlXPathEvalExpr:
  * @ctxt:  the XPath Parser context
@@ -15053,6 +16280,8 @@ xmlXPathEvalExpr(xmlXPathParserContextPtr ctxt) {
 	{
 	    xmlXPathOptimizeExpression(ctxt->comp, ctxt->comp->last);
 	}
+	if ((ctxt->error == XPATH_EXPRESSION_OK) && (!ctxt->xptr))
+	    xmlXPathStreamPathCompile(ctxt->comp);
     }
     CHECK_ERROR;
     xmlXPathRunEval(ctxt, 0);
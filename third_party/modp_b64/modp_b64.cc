@@ -77,6 +77,267 @@
 #define CHARPAD '\0'
 #endif
 
+/*
+ * SSSE3 and AVX2 kernels, after Wojciech Mula's "Base64 encoding and
+ * decoding with SIMD instructions" (http://0x80.pl/articles/), picked at
+ * run time with __builtin_cpu_supports(). They only take the bulk of the
+ * input: the last quanta, the padding and short inputs go through the
+ * table-driven loops, and a vector of characters with any one outside of
+ * the alphabet fails the decode as the tables would.  The lookup tables
+ * below are for the standard alphabet.
+ */
+#if defined(__GNUC__) && ((__GNUC__ >= 5) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__)) && \
+    !defined(__native_client__) && !defined(WORDS_BIGENDIAN) && \
+    CHAR62 == '+' && CHAR63 == '/'
+#define MODP_B64_SIMD
+#include <immintrin.h>
+
+#define TARGET_SSSE3 __attribute__((target("ssse3")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+
+/* the 12 bytes in the low lanes of in to their 16 six-bit values */
+static inline TARGET_SSSE3 __m128i enc_split_ssse3(__m128i in)
+{
+    in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7,
+                                           4, 5, 3, 4, 1, 2, 0, 1));
+    __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+    __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+    __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+    __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+    return _mm_or_si128(t1, t3);
+}
+
+/* six-bit values to characters, adding the offset of their range */
+static inline TARGET_SSSE3 __m128i enc_translate_ssse3(__m128i in)
+{
+    const __m128i offsets = _mm_setr_epi8(
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+        '/' - 63, 'A', 0, 0);
+    __m128i range = _mm_subs_epu8(in, _mm_set1_epi8(51));
+    __m128i upper = _mm_cmpgt_epi8(_mm_set1_epi8(26), in);
+    range = _mm_or_si128(range, _mm_and_si128(upper, _mm_set1_epi8(13)));
+    return _mm_add_epi8(in, _mm_shuffle_epi8(offsets, range));
+}
+
+/*
+ * characters to six-bit values, setting the lanes of *bad whose
+ * character is outside of the alphabet
+ */
+static inline TARGET_SSSE3 __m128i dec_translate_ssse3(__m128i in,
+                                                       __m128i* bad)
+{
+    const __m128i lut_lo = _mm_setr_epi8(
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+        0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+    const __m128i lut_hi = _mm_setr_epi8(
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i lut_roll = _mm_setr_epi8(
+        0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i mask_2f = _mm_set1_epi8(0x2f);
+
+    __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(in, 4), mask_2f);
+    __m128i lo_nibbles = _mm_and_si128(in, mask_2f);
+    __m128i hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+    __m128i lo = _mm_shuffle_epi8(lut_lo, lo_nibbles);
+    *bad = _mm_cmpgt_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128());
+
+    __m128i slash = _mm_cmpeq_epi8(in, mask_2f);
+    __m128i roll = _mm_shuffle_epi8(lut_roll,
+                                    _mm_add_epi8(slash, hi_nibbles));
+    return _mm_add_epi8(in, roll);
+}
+
+/* 16 six-bit values to their 12 bytes, in the low lanes */
+static inline TARGET_SSSE3 __m128i dec_merge_ssse3(__m128i in)
+{
+    __m128i pairs = _mm_maddubs_epi16(in, _mm_set1_epi32(0x01400140));
+    __m128i quads = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+    return _mm_shuffle_epi8(quads, _mm_setr_epi8(2, 1, 0, 6, 5, 4,
+                                                 10, 9, 8, 14, 13, 12,
+                                                 -1, -1, -1, -1));
+}
+
+/* the AVX2 versions, each 128-bit lane as above */
+static inline TARGET_AVX2 __m256i enc_split_avx2(__m256i in)
+{
+    in = _mm256_shuffle_epi8(in, _mm256_broadcastsi128_si256(
+        _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1)));
+    __m256i t0 = _mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00));
+    __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+    __m256i t2 = _mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0));
+    __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+    return _mm256_or_si256(t1, t3);
+}
+
+static inline TARGET_AVX2 __m256i enc_translate_avx2(__m256i in)
+{
+    const __m256i offsets = _mm256_broadcastsi128_si256(_mm_setr_epi8(
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+        '/' - 63, 'A', 0, 0));
+    __m256i range = _mm256_subs_epu8(in, _mm256_set1_epi8(51));
+    __m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), in);
+    range = _mm256_or_si256(range,
+                            _mm256_and_si256(upper, _mm256_set1_epi8(13)));
+    return _mm256_add_epi8(in, _mm256_shuffle_epi8(offsets, range));
+}
+
+static inline TARGET_AVX2 __m256i dec_translate_avx2(__m256i in, __m256i* bad)
+{
+    const __m256i lut_lo = _mm256_broadcastsi128_si256(_mm_setr_epi8(
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+        0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a));
+    const __m256i lut_hi = _mm256_broadcastsi128_si256(_mm_setr_epi8(
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10));
+    const __m256i lut_roll = _mm256_broadcastsi128_si256(_mm_setr_epi8(
+        0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0));
+    const __m256i mask_2f = _mm256_set1_epi8(0x2f);
+
+    __m256i hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(in, 4), mask_2f);
+    __m256i lo_nibbles = _mm256_and_si256(in, mask_2f);
+    __m256i hi = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+    __m256i lo = _mm256_shuffle_epi8(lut_lo, lo_nibbles);
+    *bad = _mm256_cmpgt_epi8(_mm256_and_si256(lo, hi),
+                             _mm256_setzero_si256());
+
+    __m256i slash = _mm256_cmpeq_epi8(in, mask_2f);
+    __m256i roll = _mm256_shuffle_epi8(lut_roll,
+                                       _mm256_add_epi8(slash, hi_nibbles));
+    return _mm256_add_epi8(in, roll);
+}
+
+/* 32 six-bit values to their 24 bytes, in the low lanes */
+static inline TARGET_AVX2 __m256i dec_merge_avx2(__m256i in)
+{
+    __m256i pairs = _mm256_maddubs_epi16(in, _mm256_set1_epi32(0x01400140));
+    __m256i quads = _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000));
+    quads = _mm256_shuffle_epi8(quads, _mm256_broadcastsi128_si256(
+        _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12,
+                      -1, -1, -1, -1)));
+    return _mm256_permutevar8x32_epi32(quads,
+                                       _mm256_setr_epi32(0, 1, 2, 4, 5, 6,
+                                                         3, 7));
+}
+
+/*
+ * Encodes 12 bytes at a time while 16 can be loaded, returns the number
+ * of bytes encoded
+ */
+static TARGET_SSSE3 size_t encode_ssse3(uint8_t* dest, const uint8_t* str,
+                                        size_t len)
+{
+    size_t i = 0;
+
+    for (; i + 16 <= len; i += 12, dest += 16) {
+        __m128i in = _mm_loadu_si128((const __m128i*)(str + i));
+        in = enc_translate_ssse3(enc_split_ssse3(in));
+        _mm_storeu_si128((__m128i*)dest, in);
+    }
+    return i;
+}
+
+static TARGET_AVX2 size_t encode_avx2(uint8_t* dest, const uint8_t* str,
+                                      size_t len)
+{
+    size_t i = 0;
+
+    for (; i + 28 <= len; i += 24, dest += 32) {
+        __m256i in = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(str + i))),
+            _mm_loadu_si128((const __m128i*)(str + i + 12)), 1);
+        in = enc_translate_avx2(enc_split_avx2(in));
+        _mm256_storeu_si256((__m256i*)dest, in);
+    }
+    return i + encode_ssse3(dest, str + i, len - i);
+}
+
+/*
+ * Decodes 4 quanta at a time into 16 byte stores, 4 of them past the
+ * block, so it stops while the remaining quanta, and the final one of the
+ * input which the caller keeps back, still cover those 4 bytes.  Returns
+ * the number of quanta decoded, or MODP_B64_ERROR.
+ */
+static TARGET_SSSE3 size_t decode_ssse3(uint8_t* dest, const uint8_t* src,
+                                        size_t chunks)
+{
+    size_t i = 0;
+    __m128i bad;
+
+    for (; i + 5 <= chunks; i += 4, src += 16, dest += 12) {
+        __m128i in = _mm_loadu_si128((const __m128i*)src);
+        in = dec_translate_ssse3(in, &bad);
+        if (_mm_movemask_epi8(bad))
+            return MODP_B64_ERROR;
+        _mm_storeu_si128((__m128i*)dest, dec_merge_ssse3(in));
+    }
+    return i;
+}
+
+/* the same 8 quanta at a time, 8 bytes past the block */
+static TARGET_AVX2 size_t decode_avx2(uint8_t* dest, const uint8_t* src,
+                                      size_t chunks)
+{
+    size_t i = 0, j;
+    __m256i bad;
+
+    for (; i + 11 <= chunks; i += 8, src += 32, dest += 24) {
+        __m256i in = _mm256_loadu_si256((const __m256i*)src);
+        in = dec_translate_avx2(in, &bad);
+        if (_mm256_movemask_epi8(bad))
+            return MODP_B64_ERROR;
+        _mm256_storeu_si256((__m256i*)dest, dec_merge_avx2(in));
+    }
+    j = decode_ssse3(dest, src, chunks - i);
+    return (j == MODP_B64_ERROR) ? j : i + j;
+}
+
+/* the kernel set by modp_b64_set_kernel() */
+static modp_b64_kernel forced_kernel = MODP_B64_KERNEL_AUTO;
+
+static modp_b64_kernel simd_kernel(void)
+{
+    if (forced_kernel != MODP_B64_KERNEL_AUTO)
+        return forced_kernel;
+    if (__builtin_cpu_supports("avx2"))
+        return MODP_B64_KERNEL_AVX2;
+    if (__builtin_cpu_supports("ssse3"))
+        return MODP_B64_KERNEL_SSSE3;
+    return MODP_B64_KERNEL_SCALAR;
+}
+
+static size_t encode_simd(uint8_t* dest, const char* str, size_t len)
+{
+    if (len < 16)
+        return 0;
+    switch (simd_kernel()) {
+    case MODP_B64_KERNEL_AVX2:
+        return encode_avx2(dest, (const uint8_t*)str, len);
+    case MODP_B64_KERNEL_SSSE3:
+        return encode_ssse3(dest, (const uint8_t*)str, len);
+    default:
+        return 0;
+    }
+}
+
+static size_t decode_simd(uint8_t* dest, const uint8_t* src, size_t chunks)
+{
+    if (chunks < 5)
+        return 0;
+    switch (simd_kernel()) {
+    case MODP_B64_KERNEL_AVX2:
+        return decode_avx2(dest, src, chunks);
+    case MODP_B64_KERNEL_SSSE3:
+        return decode_ssse3(dest, src, chunks);
+    default:
+        return 0;
+    }
+}
+#endif  /* MODP_B64_SIMD */
+
 size_t modp_b64_encode(char* dest, const char* str, size_t len)
 {
     size_t i = 0;
@@ -85,6 +346,11 @@ size_t modp_b64_encode(char* dest, const char* str, size_t len)
     /* unsigned here is important! */
     uint8_t t1, t2, t3;
 
+#ifdef MODP_B64_SIMD
+    i = encode_simd(p, str, len);
+    p += i / 3 * 4;
+#endif
+
     if (len > 2) {
         for (; i < len - 2; i += 3) {
             t1 = str[i]; t2 = str[i+1]; t3 = str[i+2];
@@ -212,7 +478,14 @@ size_t modp_b64_decode(char* dest, const char* src, size_t len)
     uint8_t* p = (uint8_t*)dest;
     uint32_t x = 0;
     const uint8_t* y = (uint8_t*)src;
-    for (i = 0; i < chunks; ++i, y += 4) {
+    i = 0;
+#ifdef MODP_B64_SIMD
+    i = decode_simd(p, y, chunks);
+    if (i == MODP_B64_ERROR) return MODP_B64_ERROR;
+    p += i * 3;
+    y += i * 4;
+#endif
+    for (; i < chunks; ++i, y += 4) {
         x = d0[y[0]] | d1[y[1]] | d2[y[2]] | d3[y[3]];
         if (x >= BADCHAR) return MODP_B64_ERROR;
         *p++ =  ((uint8_t*)(&x))[0];
@@ -251,3 +524,126 @@ size_t modp_b64_decode(char* dest, const char* src, size_t len)
 }
 
 #endif  /* if bigendian / else / endif */
+
+modp_b64_kernel modp_b64_set_kernel(modp_b64_kernel kernel)
+{
+#ifdef MODP_B64_SIMD
+    if (kernel == MODP_B64_KERNEL_AVX2 && !__builtin_cpu_supports("avx2"))
+        kernel = MODP_B64_KERNEL_SSSE3;
+    if (kernel == MODP_B64_KERNEL_SSSE3 && !__builtin_cpu_supports("ssse3"))
+        kernel = MODP_B64_KERNEL_SCALAR;
+    forced_kernel = kernel;
+    return simd_kernel();
+#else
+    (void)kernel;
+    return MODP_B64_KERNEL_SCALAR;
+#endif
+}
+
+void modp_b64_stream_init(modp_b64_stream* s)
+{
+    s->len = 0;
+    s->done = 0;
+    s->error = 0;
+}
+
+size_t modp_b64_encode_update(modp_b64_stream* s, char* dest,
+                              const char* str, size_t len)
+{
+    size_t n = 0, bulk;
+
+    dest[0] = '\0';
+    if (s->len + len < 3) {
+        for (; len > 0; --len)
+            s->carry[s->len++] = *str++;
+        return 0;
+    }
+
+    /* complete the quantum carried from the last call */
+    if (s->len > 0) {
+        for (; s->len < 3; --len)
+            s->carry[s->len++] = *str++;
+        n = modp_b64_encode(dest, s->carry, 3);
+        s->len = 0;
+    }
+
+    bulk = len - len % 3;
+    if (bulk > 0)
+        n += modp_b64_encode(dest + n, str, bulk);
+    for (str += bulk; s->len < len - bulk; )
+        s->carry[s->len++] = *str++;
+    return n;
+}
+
+size_t modp_b64_encode_final(modp_b64_stream* s, char* dest)
+{
+    size_t n = modp_b64_encode(dest, s->carry, s->len);
+
+    s->len = 0;
+    return n;
+}
+
+size_t modp_b64_decode_update(modp_b64_stream* s, char* dest,
+                              const char* src, size_t len)
+{
+    size_t n = 0, m, bulk;
+
+    if (s->error)
+        return MODP_B64_ERROR;
+    if (len == 0)
+        return 0;
+    /* nothing can follow the padding */
+    if (s->done)
+        goto error;
+
+    if (s->len + len < 4) {
+        for (; len > 0; --len)
+            s->carry[s->len++] = *src++;
+        return 0;
+    }
+
+    /* complete the quantum carried from the last call */
+    if (s->len > 0) {
+        for (; s->len < 4; --len)
+            s->carry[s->len++] = *src++;
+        n = modp_b64_decode(dest, s->carry, 4);
+        if (n == MODP_B64_ERROR)
+            goto error;
+        s->len = 0;
+        if (s->carry[3] == CHARPAD) {
+            s->done = 1;
+            if (len > 0)
+                goto error;
+            return n;
+        }
+    }
+
+    bulk = len - len % 4;
+    if (bulk > 0) {
+        m = modp_b64_decode(dest + n, src, bulk);
+        if (m == MODP_B64_ERROR)
+            goto error;
+        n += m;
+        if (src[bulk - 1] == CHARPAD) {
+            s->done = 1;
+            if (len > bulk)
+                goto error;
+        }
+    }
+    for (src += bulk; s->len < len - bulk; )
+        s->carry[s->len++] = *src++;
+    return n;
+
+error:
+    s->error = 1;
+    return MODP_B64_ERROR;
+}
+
+size_t modp_b64_decode_final(modp_b64_stream* s)
+{
+    if (s->error || s->len != 0) {
+        s->error = 1;
+        return MODP_B64_ERROR;
+    }
+    return 0;
+}
@@ -130,6 +130,89 @@ size_t modp_b64_decode(char* dest, const char* src, size_t len);
 
 #define MODP_B64_ERROR ((size_t)-1)
 
+/**
+ * The kernels that modp_b64_encode() and modp_b64_decode() can run on
+ * the bulk of the input.  By default, MODP_B64_KERNEL_AUTO, they use the
+ * widest one the CPU supports.
+ */
+typedef enum modp_b64_kernel {
+    MODP_B64_KERNEL_AUTO,
+    MODP_B64_KERNEL_SCALAR,  /* the table-driven loops alone */
+    MODP_B64_KERNEL_SSSE3,
+    MODP_B64_KERNEL_AVX2
+} modp_b64_kernel;
+
+/**
+ * Force the kernel, for tests and benchmarks.  A kernel that the build
+ * or the CPU lacks falls back to a narrower one.  Not to be called while
+ * another thread encodes or decodes.  Returns the kernel now in use.
+ */
+modp_b64_kernel modp_b64_set_kernel(modp_b64_kernel kernel);
+
+/**
+ * Chunked encoding and decoding, for input that does not fit in memory
+ * at once or arrives in pieces.
+ *
+ * The stream carries the bytes (or characters) of an incomplete quantum
+ * from one update to the next, so the chunks can be of any size and the
+ * output of all the updates plus the final call is exactly what one
+ * modp_b64_encode() or modp_b64_decode() of the whole input would give,
+ * including the decode errors.  A stream is either an encoder or a
+ * decoder, and is reset by modp_b64_stream_init().
+ *
+ * \code
+ * modp_b64_stream s;
+ * modp_b64_stream_init(&s);
+ * while ((n = read(fd, in, sizeof(in))) > 0) {
+ *     // out holds at least modp_b64_encode_len(n) bytes
+ *     len = modp_b64_encode_update(&s, out, in, n);
+ *     fwrite(out, 1, len, stdout);
+ * }
+ * len = modp_b64_encode_final(&s, out);
+ * fwrite(out, 1, len, stdout);
+ * \endcode
+ */
+typedef struct modp_b64_stream {
+    char carry[4];  /* the incomplete quantum */
+    size_t len;     /* the number of bytes in carry */
+    int done;       /* a padded quantum was decoded */
+    int error;      /* a decode error, reported until the next init */
+} modp_b64_stream;
+
+void modp_b64_stream_init(modp_b64_stream* s);
+
+/**
+ * Encode the next len bytes of the stream into dest, which should hold
+ * modp_b64_encode_len(len) bytes.  Up to 2 bytes are kept for the next
+ * call.  Returns the number of characters written; dest is
+ * null-terminated like the output of modp_b64_encode().
+ */
+size_t modp_b64_encode_update(modp_b64_stream* s, char* dest,
+                              const char* str, size_t len);
+
+/**
+ * Encode the bytes kept by the last update, with padding, into dest,
+ * which should hold modp_b64_encode_len(2) bytes.  Returns the number
+ * of characters written, 0 or 4.
+ */
+size_t modp_b64_encode_final(modp_b64_stream* s, char* dest);
+
+/**
+ * Decode the next len characters of the stream into dest, which should
+ * hold modp_b64_decode_len(len + 3) bytes.  Up to 3 characters are kept
+ * for the next call.  Returns the number of bytes written, or -1 if the
+ * input so far cannot be the start of a valid base 64 string, in which
+ * case every later call returns -1 too.
+ */
+size_t modp_b64_decode_update(modp_b64_stream* s, char* dest,
+                              const char* src, size_t len);
+
+/**
+ * Finish decoding the stream.  Returns 0, or -1 if the input did not
+ * end on a complete quantum or an update failed.
+ */
+size_t modp_b64_decode_final(modp_b64_stream* s);
+
 #ifdef __cplusplus
 }
 
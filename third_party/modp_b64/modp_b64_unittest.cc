@@ -0,0 +1,205 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "third_party/modp_b64/modp_b64.h"
+
+#include <stddef.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+// The inputs of each test, per kernel.
+const int kIterations = 3000;
+
+const modp_b64_kernel kKernels[] = {
+    MODP_B64_KERNEL_SSSE3, MODP_B64_KERNEL_AVX2,
+};
+
+// A decode result: the bytes, or an error.
+struct Decoded {
+  bool error;
+  std::string bytes;
+
+  bool operator==(const Decoded& other) const {
+    return error == other.error && (error || bytes == other.bytes);
+  }
+};
+
+class ModpB64Test : public testing::Test {
+ protected:
+  ModpB64Test() : random_(1) {}
+
+  void TearDown() override { modp_b64_set_kernel(MODP_B64_KERNEL_AUTO); }
+
+  // Returns a random integer in [0, n).
+  size_t Random(size_t n) {
+    return std::uniform_int_distribution<size_t>(0, n - 1)(random_);
+  }
+
+  // Lengths below the SIMD thresholds most of the time, up to several
+  // AVX2 blocks otherwise.
+  size_t RandomLength() { return Random(3) ? Random(100) : Random(5000); }
+
+  std::string RandomBytes(size_t len) {
+    std::string bytes(len, '\0');
+    for (size_t i = 0; i < len; ++i)
+      bytes[i] = static_cast<char>(Random(256));
+    return bytes;
+  }
+
+  // The size of the next chunk of a stream, sometimes smaller than a
+  // quantum.
+  size_t RandomChunk(size_t left) {
+    size_t n = Random(4) ? Random(300) : Random(5);
+    return n < left ? n : left;
+  }
+
+  // Encodes |bytes| in one call, checking the returned length.
+  std::string Encode(const std::string& bytes) {
+    std::vector<char> out(modp_b64_encode_len(bytes.size()));
+    size_t len = modp_b64_encode(&out[0], bytes.data(), bytes.size());
+    EXPECT_EQ(modp_b64_encode_strlen(bytes.size()), len);
+    EXPECT_EQ('\0', out[len]);
+    return std::string(&out[0], len);
+  }
+
+  // Encodes |bytes| in random chunks.
+  std::string EncodeStream(const std::string& bytes) {
+    modp_b64_stream s;
+    std::string encoded;
+    modp_b64_stream_init(&s);
+    for (size_t pos = 0, n; pos < bytes.size(); pos += n) {
+      n = RandomChunk(bytes.size() - pos);
+      std::vector<char> out(modp_b64_encode_len(n));
+      size_t len = modp_b64_encode_update(&s, &out[0], bytes.data() + pos, n);
+      EXPECT_EQ('\0', out[len]);
+      encoded.append(&out[0], len);
+    }
+    std::vector<char> out(modp_b64_encode_len(2));
+    encoded.append(&out[0], modp_b64_encode_final(&s, &out[0]));
+    return encoded;
+  }
+
+  // Decodes |chars| in one call into a buffer of the documented size.
+  Decoded Decode(const std::string& chars) {
+    std::vector<char> out(modp_b64_decode_len(chars.size()));
+    size_t len = modp_b64_decode(&out[0], chars.data(), chars.size());
+    Decoded decoded = {len == MODP_B64_ERROR, std::string()};
+    if (!decoded.error)
+      decoded.bytes.assign(&out[0], len);
+    return decoded;
+  }
+
+  // Decodes |chars| in random chunks.
+  Decoded DecodeStream(const std::string& chars) {
+    modp_b64_stream s;
+    Decoded decoded = {false, std::string()};
+    modp_b64_stream_init(&s);
+    for (size_t pos = 0, n; pos < chars.size(); pos += n) {
+      n = RandomChunk(chars.size() - pos);
+      std::vector<char> out(modp_b64_decode_len(n + 3));
+      size_t len = modp_b64_decode_update(&s, &out[0], chars.data() + pos, n);
+      if (len == MODP_B64_ERROR) {
+        decoded.error = true;
+        return decoded;
+      }
+      decoded.bytes.append(&out[0], len);
+    }
+    decoded.error = modp_b64_decode_final(&s) == MODP_B64_ERROR;
+    return decoded;
+  }
+
+  // Checks the one-shot and chunked decodes of |chars| with |kernel|
+  // against the one-shot decode with the scalar loops, returning it.
+  Decoded CheckDecode(modp_b64_kernel kernel, const std::string& chars) {
+    modp_b64_set_kernel(MODP_B64_KERNEL_SCALAR);
+    Decoded expected = Decode(chars);
+    modp_b64_set_kernel(kernel);
+    EXPECT_EQ(expected, Decode(chars)) << chars;
+    EXPECT_EQ(expected, DecodeStream(chars)) << chars;
+    return expected;
+  }
+
+  std::mt19937 random_;
+};
+
+TEST_F(ModpB64Test, SetKernel) {
+  EXPECT_EQ(MODP_B64_KERNEL_SCALAR,
+            modp_b64_set_kernel(MODP_B64_KERNEL_SCALAR));
+  for (modp_b64_kernel kernel : kKernels) {
+    modp_b64_kernel used = modp_b64_set_kernel(kernel);
+    EXPECT_LE(used, kernel);
+    EXPECT_NE(MODP_B64_KERNEL_AUTO, used);
+  }
+}
+
+TEST_F(ModpB64Test, EncodeMatchesScalar) {
+  for (modp_b64_kernel kernel : kKernels) {
+    for (int i = 0; i < kIterations; ++i) {
+      std::string bytes = RandomBytes(RandomLength());
+      modp_b64_set_kernel(MODP_B64_KERNEL_SCALAR);
+      std::string expected = Encode(bytes);
+      EXPECT_EQ(expected, EncodeStream(bytes));
+      modp_b64_set_kernel(kernel);
+      EXPECT_EQ(expected, Encode(bytes)) << kernel;
+      EXPECT_EQ(expected, EncodeStream(bytes)) << kernel;
+    }
+  }
+}
+
+TEST_F(ModpB64Test, DecodeValidMatchesScalar) {
+  for (modp_b64_kernel kernel : kKernels) {
+    for (int i = 0; i < kIterations; ++i) {
+      std::string bytes = RandomBytes(RandomLength());
+      modp_b64_set_kernel(MODP_B64_KERNEL_SCALAR);
+      Decoded decoded = CheckDecode(kernel, Encode(bytes));
+      EXPECT_FALSE(decoded.error);
+      EXPECT_EQ(bytes, decoded.bytes);
+    }
+  }
+}
+
+TEST_F(ModpB64Test, DecodeMutatedMatchesScalar) {
+  for (modp_b64_kernel kernel : kKernels) {
+    for (int i = 0; i < kIterations; ++i) {
+      modp_b64_set_kernel(MODP_B64_KERNEL_SCALAR);
+      std::string chars = Encode(RandomBytes(RandomLength() + 1));
+      // Any byte in one to three places, often one of the alphabet or the
+      // padding, so that some mutations still decode.
+      for (size_t n = 1 + Random(3); n > 0; --n) {
+        size_t pos = Random(chars.size());
+        switch (Random(3)) {
+          case 0:
+            chars[pos] = static_cast<char>(Random(256));
+            break;
+          case 1:
+            chars[pos] = '=';
+            break;
+          default:
+            chars[pos] = Encode(RandomBytes(3))[Random(4)];
+            break;
+        }
+      }
+      CheckDecode(kernel, chars);
+    }
+  }
+}
+
+TEST_F(ModpB64Test, DecodeTruncatedMatchesScalar) {
+  for (modp_b64_kernel kernel : kKernels) {
+    for (int i = 0; i < kIterations; ++i) {
+      modp_b64_set_kernel(MODP_B64_KERNEL_SCALAR);
+      std::string chars = Encode(RandomBytes(RandomLength() + 1));
+      chars.resize(Random(chars.size()));
+      CheckDecode(kernel, chars);
+    }
+  }
+}
+
+}  // namespace
@@ -6,6 +6,8 @@
 /* @(#) $Id$ */
 
 #include "zutil.h"
+#include "adler32_simd.h"
+#include "x86.h"
 
 #define local static
 
@@ -81,8 +83,20 @@ uLong ZEXPORT adler32(adler, buf, len)
     }
 
     /* initial Adler-32 value (deferred check for len == 1 speed) */
-    if (buf == Z_NULL)
+    if (buf == Z_NULL) {
+        /* adler32(0L, Z_NULL, 0) starts a new check value, which is a good
+           time to learn which SIMD kernels may be used */
+        x86_check_features();
         return 1L;
+    }
+
+    /* long inputs go to the widest SIMD kernel this CPU supports */
+    if (len >= Z_ADLER32_SIMD_MINIMUM_LENGTH) {
+        if (x86_cpu_enable_avx2)
+            return adler32_avx2_(adler | (sum2 << 16), buf, len);
+        if (x86_cpu_enable_ssse3)
+            return adler32_simd_(adler | (sum2 << 16), buf, len);
+    }
 
     /* in case short lengths are provided, keep it somewhat fast */
     if (len < 16) {
@@ -0,0 +1,239 @@
+/* adler32_simd.c -- compute the Adler-32 checksum with SSSE3 and AVX2
+ * Copyright 2016 The Chromium Authors. All rights reserved.
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ *
+ * The Adler-32 A value (aka s1) is the sum of the N input bytes D1 ... DN
+ * plus its initial value A0. The B value (aka s2) sums the A value after
+ * each step:
+ *
+ *   B = B0 + N.A0 + N.D1 + (N-1).D2 + (N-2).D3 + ... + 1.DN
+ *
+ * For a block of 32 bytes that is
+ *
+ *   B = B0 + 32.A0 + [D1 D2 D3 ... D32] x [32 31 30 ... 1]
+ *
+ * so _mm_sad_epu8() gives the byte sums for s1 and _mm_maddubs_epi16() the
+ * weighted sums for s2, one block per loop iteration. The 32.A0 terms are
+ * accumulated separately (v_ps) and hoisted out of the loop.
+ *
+ * As in adler32.c, at most NMAX bytes are summed before s1 and s2 are
+ * reduced modulo BASE, which keeps both within 32 bits.
+ */
+
+#include "adler32_simd.h"
+
+#include <tmmintrin.h>
+#include <immintrin.h>
+
+/* Definitions from adler32.c: largest prime smaller than 65536 */
+#define BASE 65521U
+/* NMAX is the largest n such that 255n(n+1)/2 + (n+1)(BASE-1) <= 2^32-1 */
+#define NMAX 5552
+
+/* Horizontal shuffles used to sum the four epi32 lanes of a register. */
+#define S23O1 _MM_SHUFFLE(2,3,0,1)  /* A B C D -> B A D C */
+#define S1O32 _MM_SHUFFLE(1,0,3,2)  /* A B C D -> C D A B */
+
+/* Folds the sub-NMAX tail of the input into s1 s2 with the scalar loop. */
+local uLong adler32_simd_tail(unsigned s1, unsigned s2,
+                              const unsigned char *buf, uInt len)
+{
+    if (len) {
+        while (len >= 16) {
+            len -= 16;
+            s2 += (s1 += *buf++);
+            s2 += (s1 += *buf++);
+            s2 += (s1 += *buf++);
+            s2 += (s1 += *buf++);
+            s2 += (s1 += *buf++);
+            s2 += (s1 += *buf++);
+            s2 += (s1 += *buf++);
+            s2 += (s1 += *buf++);
+            s2 += (s1 += *buf++);
+            s2 += (s1 += *buf++);
+            s2 += (s1 += *buf++);
+            s2 += (s1 += *buf++);
+            s2 += (s1 += *buf++);
+            s2 += (s1 += *buf++);
+            s2 += (s1 += *buf++);
+            s2 += (s1 += *buf++);
+        }
+        while (len--) {
+            s2 += (s1 += *buf++);
+        }
+
+        if (s1 >= BASE)
+            s1 -= BASE;
+        s2 %= BASE;
+    }
+
+    /* Return the recombined sums. */
+    return s1 | (s2 << 16);
+}
+
+uLong ZLIB_INTERNAL adler32_simd_(uLong adler,
+                                  const unsigned char *buf,
+                                  uInt len)
+{
+    /* Split Adler-32 into component sums. */
+    unsigned s1 = adler & 0xffff;
+    unsigned s2 = adler >> 16;
+
+    /* Process the data in blocks. */
+    const unsigned BLOCK_SIZE = 1 << 5;
+    uInt blocks = len / BLOCK_SIZE;
+    len -= blocks * BLOCK_SIZE;
+
+    while (blocks) {
+        unsigned n = NMAX / BLOCK_SIZE;  /* The NMAX constraint. */
+        const __m128i tap1 =
+            _mm_setr_epi8(32,31,30,29,28,27,26,25,24,23,22,21,20,19,18,17);
+        const __m128i tap2 =
+            _mm_setr_epi8(16,15,14,13,12,11,10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i ones = _mm_set1_epi16(1);
+        __m128i v_ps, v_s1, v_s2;
+
+        if (n > blocks)
+            n = (unsigned) blocks;
+        blocks -= n;
+
+        /* Process n blocks of data. At most NMAX data bytes can be
+         * processed before s2 must be reduced modulo BASE.
+         */
+        v_ps = _mm_set_epi32(0, 0, 0, s1 * n);
+        v_s2 = _mm_set_epi32(0, 0, 0, s2);
+        v_s1 = _mm_setzero_si128();
+
+        do {
+            /* Load 32 input bytes. */
+            const __m128i bytes1 = _mm_loadu_si128((const __m128i *)(buf));
+            const __m128i bytes2 = _mm_loadu_si128((const __m128i *)(buf + 16));
+            __m128i mad1, mad2;
+
+            /* Add previous block byte sum to v_ps. */
+            v_ps = _mm_add_epi32(v_ps, v_s1);
+
+            /* Horizontally add the bytes for s1, multiply-adds the
+             * bytes by [ 32, 31, 30, ... ] for s2.
+             */
+            v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(bytes1, zero));
+            mad1 = _mm_maddubs_epi16(bytes1, tap1);
+            v_s2 = _mm_add_epi32(v_s2, _mm_madd_epi16(mad1, ones));
+
+            v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(bytes2, zero));
+            mad2 = _mm_maddubs_epi16(bytes2, tap2);
+            v_s2 = _mm_add_epi32(v_s2, _mm_madd_epi16(mad2, ones));
+
+            buf += BLOCK_SIZE;
+        } while (--n);
+
+        v_s2 = _mm_add_epi32(v_s2, _mm_slli_epi32(v_ps, 5));
+
+        /* Sum epi32 ints v_s1(s2) and accumulate in s1(s2). */
+        v_s1 = _mm_add_epi32(v_s1, _mm_shuffle_epi32(v_s1, S23O1));
+        v_s1 = _mm_add_epi32(v_s1, _mm_shuffle_epi32(v_s1, S1O32));
+        s1 += _mm_cvtsi128_si32(v_s1);
+
+        v_s2 = _mm_add_epi32(v_s2, _mm_shuffle_epi32(v_s2, S23O1));
+        v_s2 = _mm_add_epi32(v_s2, _mm_shuffle_epi32(v_s2, S1O32));
+        s2 = _mm_cvtsi128_si32(v_s2);
+
+        /* Reduce. */
+        s1 %= BASE;
+        s2 %= BASE;
+    }
+
+    /* Handle leftover data. */
+    return adler32_simd_tail(s1, s2, buf, len);
+}
+
+/* This file is only built with -mssse3 (zlib_adler32_simd), so the AVX2 kernel
+ * asks for its instruction set per function. It is only ever called once
+ * x86_check_features() has seen AVX2 support.
+ */
+#if defined(__GNUC__) || defined(__clang__)
+__attribute__((target("avx2")))
+#endif
+uLong ZLIB_INTERNAL adler32_avx2_(uLong adler,
+                                  const unsigned char *buf,
+                                  uInt len)
+{
+    /* Split Adler-32 into component sums. */
+    unsigned s1 = adler & 0xffff;
+    unsigned s2 = adler >> 16;
+
+    /* Process the data in blocks. */
+    const unsigned BLOCK_SIZE = 1 << 6;
+    uInt blocks = len / BLOCK_SIZE;
+    len -= blocks * BLOCK_SIZE;
+
+    while (blocks) {
+        unsigned n = NMAX / BLOCK_SIZE;  /* The NMAX constraint. */
+        const __m256i tap1 = _mm256_setr_epi8(
+            64,63,62,61,60,59,58,57,56,55,54,53,52,51,50,49,
+            48,47,46,45,44,43,42,41,40,39,38,37,36,35,34,33);
+        const __m256i tap2 = _mm256_setr_epi8(
+            32,31,30,29,28,27,26,25,24,23,22,21,20,19,18,17,
+            16,15,14,13,12,11,10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i ones = _mm256_set1_epi16(1);
+        __m256i v_ps, v_s1, v_s2;
+        __m128i h_s1, h_s2;
+
+        if (n > blocks)
+            n = (unsigned) blocks;
+        blocks -= n;
+
+        v_ps = _mm256_set_epi32(0, 0, 0, 0, 0, 0, 0, s1 * n);
+        v_s2 = _mm256_set_epi32(0, 0, 0, 0, 0, 0, 0, s2);
+        v_s1 = _mm256_setzero_si256();
+
+        do {
+            /* Load 64 input bytes. */
+            const __m256i bytes1 =
+                _mm256_loadu_si256((const __m256i *)(buf));
+            const __m256i bytes2 =
+                _mm256_loadu_si256((const __m256i *)(buf + 32));
+            __m256i mad1, mad2;
+
+            /* Add previous block byte sum to v_ps. */
+            v_ps = _mm256_add_epi32(v_ps, v_s1);
+
+            /* Horizontally add the bytes for s1, multiply-adds the
+             * bytes by [ 64, 63, 62, ... ] for s2.
+             */
+            v_s1 = _mm256_add_epi32(v_s1, _mm256_sad_epu8(bytes1, zero));
+            mad1 = _mm256_maddubs_epi16(bytes1, tap1);
+            v_s2 = _mm256_add_epi32(v_s2, _mm256_madd_epi16(mad1, ones));
+
+            v_s1 = _mm256_add_epi32(v_s1, _mm256_sad_epu8(bytes2, zero));
+            mad2 = _mm256_maddubs_epi16(bytes2, tap2);
+            v_s2 = _mm256_add_epi32(v_s2, _mm256_madd_epi16(mad2, ones));
+
+            buf += BLOCK_SIZE;
+        } while (--n);
+
+        v_s2 = _mm256_add_epi32(v_s2, _mm256_slli_epi32(v_ps, 6));
+
+        /* Fold the two 128-bit lanes, then sum the epi32 ints as above. */
+        h_s1 = _mm_add_epi32(_mm256_castsi256_si128(v_s1),
+                             _mm256_extracti128_si256(v_s1, 1));
+        h_s1 = _mm_add_epi32(h_s1, _mm_shuffle_epi32(h_s1, S23O1));
+        h_s1 = _mm_add_epi32(h_s1, _mm_shuffle_epi32(h_s1, S1O32));
+        s1 += _mm_cvtsi128_si32(h_s1);
+
+        h_s2 = _mm_add_epi32(_mm256_castsi256_si128(v_s2),
+                             _mm256_extracti128_si256(v_s2, 1));
+        h_s2 = _mm_add_epi32(h_s2, _mm_shuffle_epi32(h_s2, S23O1));
+        h_s2 = _mm_add_epi32(h_s2, _mm_shuffle_epi32(h_s2, S1O32));
+        s2 = _mm_cvtsi128_si32(h_s2);
+
+        /* Reduce. */
+        s1 %= BASE;
+        s2 %= BASE;
+    }
+
+    /* Handle leftover data. */
+    return adler32_simd_tail(s1, s2, buf, len);
+}
@@ -0,0 +1,24 @@
+/* adler32_simd.h -- SIMD Adler-32 checksum
+ * Copyright 2016 The Chromium Authors. All rights reserved.
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+#ifndef ADLER32_SIMD_H
+#define ADLER32_SIMD_H
+
+#include "zutil.h"
+
+/* Inputs shorter than this are faster through the scalar loop. */
+#define Z_ADLER32_SIMD_MINIMUM_LENGTH 64
+
+/* SSSE3 variant: 32 bytes per iteration. Needs x86_cpu_enable_ssse3. */
+uLong ZLIB_INTERNAL adler32_simd_(uLong adler,
+                                  const unsigned char *buf,
+                                  uInt len);
+
+/* AVX2 variant: 64 bytes per iteration. Needs x86_cpu_enable_avx2. */
+uLong ZLIB_INTERNAL adler32_avx2_(uLong adler,
+                                  const unsigned char *buf,
+                                  uInt len);
+
+#endif  /* ADLER32_SIMD_H */
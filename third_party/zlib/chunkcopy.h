@@ -0,0 +1,128 @@
+/* chunkcopy.h -- fast chunk copy and set operations
+ * Copyright 2016 The Chromium Authors. All rights reserved.
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+#ifndef CHUNKCOPY_H
+#define CHUNKCOPY_H
+
+#include <emmintrin.h>
+#include "zutil.h"
+
+/*
+   The copies below move CHUNKCOPY_CHUNK_SIZE bytes at a time with unaligned
+   SSE2 loads and stores. To keep the inner loops free of length checks they
+   are "relaxed": they may write up to CHUNKCOPY_CHUNK_SIZE - 1 bytes of
+   garbage past the end of the requested copy, and read as far past the end
+   of the source. Callers guarantee that much slack in both buffers (see
+   inffast_chunk.h), and later output overwrites the garbage.
+ */
+#define CHUNKCOPY_CHUNK_SIZE 16
+
+typedef __m128i z_vec128i_t;
+
+local z_vec128i_t loadchunk(const unsigned char FAR *s)
+{
+    return _mm_loadu_si128((const __m128i *)s);
+}
+
+local void storechunk(unsigned char FAR *d, const z_vec128i_t c)
+{
+    _mm_storeu_si128((__m128i *)d, c);
+}
+
+/*
+   Copies |len| bytes from |from| to |out|, where |from| is at least
+   CHUNKCOPY_CHUNK_SIZE bytes behind |out| (or in another buffer), and returns
+   the new |out|. The first store rounds the length to a whole number of
+   chunks so the loop only moves full chunks. |len| must be non-zero.
+ */
+local unsigned char FAR *chunkcopy_relaxed(unsigned char FAR *out,
+                                           const unsigned char FAR *from,
+                                           unsigned len)
+{
+    unsigned bump = ((len - 1) % CHUNKCOPY_CHUNK_SIZE) + 1;
+    storechunk(out, loadchunk(from));
+    out += bump;
+    from += bump;
+    len -= bump;
+    while (len > 0) {
+        storechunk(out, loadchunk(from));
+        out += CHUNKCOPY_CHUNK_SIZE;
+        from += CHUNKCOPY_CHUNK_SIZE;
+        len -= CHUNKCOPY_CHUNK_SIZE;
+    }
+    return out;
+}
+
+/*
+   Replicates the |dist|-periodic pattern ending at |out| until either the
+   period reaches CHUNKCOPY_CHUNK_SIZE or |len| runs out, doubling the period
+   at every step. Updates |dist| and |len| for the copy that finishes the
+   match.
+ */
+local unsigned char FAR *chunkunroll_relaxed(unsigned char FAR *out,
+                                             unsigned FAR *dist,
+                                             unsigned FAR *len)
+{
+    const unsigned char FAR *from = out - *dist;
+    while (*dist < *len && *dist < CHUNKCOPY_CHUNK_SIZE) {
+        storechunk(out, loadchunk(from));
+        out += *dist;
+        *len -= *dist;
+        *dist += *dist;
+    }
+    return out;
+}
+
+/*
+   Builds a chunk holding the |dist|-periodic pattern that starts at |from|
+   for the periods that divide CHUNKCOPY_CHUNK_SIZE, which make up nearly all
+   short-distance matches (runs of one byte, UTF-16 text, 32-bit pixels...).
+ */
+local z_vec128i_t chunkset_pattern(const unsigned char FAR *from,
+                                   unsigned dist)
+{
+    int v32;
+    short v16;
+    switch (dist) {
+    case 1:
+        return _mm_set1_epi8((char)*from);
+    case 2:
+        zmemcpy(&v16, from, 2);
+        return _mm_set1_epi16(v16);
+    case 4:
+        zmemcpy(&v32, from, 4);
+        return _mm_set1_epi32(v32);
+    default:  /* 8 */
+        return _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)from),
+                                  _mm_loadl_epi64((const __m128i *)from));
+    }
+}
+
+/*
+   Copies |len| bytes of a match |dist| bytes back in the output, where the
+   source and destination may overlap. Returns the new |out|. |len| must be
+   non-zero.
+ */
+local unsigned char FAR *chunkcopy_lapped_relaxed(unsigned char FAR *out,
+                                                  unsigned dist,
+                                                  unsigned len)
+{
+    if (dist < len && dist < CHUNKCOPY_CHUNK_SIZE) {
+        if ((CHUNKCOPY_CHUNK_SIZE % dist) == 0) {
+            /* memset-like: one pattern chunk covers every store */
+            const z_vec128i_t pattern = chunkset_pattern(out - dist, dist);
+            unsigned char FAR *limit = out + len;
+            do {
+                storechunk(out, pattern);
+                out += CHUNKCOPY_CHUNK_SIZE;
+            } while (out < limit);
+            return limit;
+        }
+        out = chunkunroll_relaxed(out, &dist, &len);
+    }
+    return chunkcopy_relaxed(out, out - dist, len);
+}
+
+#endif  /* CHUNKCOPY_H */
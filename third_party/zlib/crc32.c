@@ -27,6 +27,7 @@
 #endif /* MAKECRCH */
 
 #include "deflate.h"
+#include "crc32_simd.h"
 #include "x86.h"
 #include "zutil.h"      /* for STDC and FAR definitions */
 
@@ -225,13 +226,28 @@ unsigned long ZEXPORT crc32(crc, buf, len)
     const unsigned char FAR *buf;
     uInt len;
 {
-    if (buf == Z_NULL) return 0UL;
+    if (buf == Z_NULL) {
+        /* crc32(0L, Z_NULL, 0) is how callers start a new check value, so
+           it is a good time to learn which SIMD kernels may be used. */
+        x86_check_features();
+        return 0UL;
+    }
 
 #ifdef DYNAMIC_CRC_TABLE
     if (crc_table_empty)
         make_crc_table();
 #endif /* DYNAMIC_CRC_TABLE */
 
+    if (x86_cpu_enable_simd && len >= Z_CRC32_SSE42_MINIMUM_LENGTH) {
+        /* fold whole 16-byte chunks, the table code handles the rest */
+        uInt chunk_size = len & ~Z_CRC32_SSE42_CHUNKSIZE_MASK;
+        crc = ~crc32_sse42_simd_(buf, chunk_size, ~(unsigned)crc);
+        len -= chunk_size;
+        if (!len)
+            return crc;
+        buf += chunk_size;
+    }
+
 #ifdef BYFOUR
     if (sizeof(void *) == sizeof(ptrdiff_t)) {
         u4 endian;
@@ -0,0 +1,25 @@
+/* crc32_simd.h -- PCLMULQDQ folded CRC-32
+ * Copyright 2016 The Chromium Authors. All rights reserved.
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+#ifndef CRC32_SIMD_H
+#define CRC32_SIMD_H
+
+#include "zutil.h"
+
+/* The folding kernel consumes 16-byte chunks and needs at least four of
+ * them to prime its accumulators.
+ */
+#define Z_CRC32_SSE42_MINIMUM_LENGTH 64
+#define Z_CRC32_SSE42_CHUNKSIZE_MASK 15
+
+/* Computes the (non-inverted) CRC-32 of |len| bytes at |buf|, where |len| is
+ * a multiple of 16 and at least Z_CRC32_SSE42_MINIMUM_LENGTH. Needs
+ * x86_cpu_enable_simd.
+ */
+unsigned ZLIB_INTERNAL crc32_sse42_simd_(const unsigned char *buf,
+                                         uInt len,
+                                         unsigned crc);
+
+#endif  /* CRC32_SIMD_H */
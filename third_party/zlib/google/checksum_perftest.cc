@@ -0,0 +1,116 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+#include "base/macros.h"
+#include "base/rand_util.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+#include "third_party/zlib/zlib.h"
+
+extern "C" {
+#include "third_party/zlib/x86.h"
+}
+
+namespace {
+
+const size_t kBufferSize = 16 * 1024 * 1024;
+const int kIterations = 16;
+
+// Forces adler32() and crc32() onto one kernel by overriding the flags set by
+// x86_check_features(), restoring the detected values when it goes out of
+// scope. Only ever narrows the detected set, so it is safe on any CPU.
+class ScopedChecksumKernel {
+ public:
+  ScopedChecksumKernel(bool pclmul, bool ssse3, bool avx2)
+      : simd_(x86_cpu_enable_simd),
+        ssse3_(x86_cpu_enable_ssse3),
+        avx2_(x86_cpu_enable_avx2) {
+    x86_cpu_enable_simd = pclmul && simd_;
+    x86_cpu_enable_ssse3 = ssse3 && ssse3_;
+    x86_cpu_enable_avx2 = avx2 && avx2_;
+  }
+
+  ~ScopedChecksumKernel() {
+    x86_cpu_enable_simd = simd_;
+    x86_cpu_enable_ssse3 = ssse3_;
+    x86_cpu_enable_avx2 = avx2_;
+  }
+
+ private:
+  const int simd_;
+  const int ssse3_;
+  const int avx2_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedChecksumKernel);
+};
+
+typedef uLong (*ChecksumFunction)(uLong, const Bytef*, uInt);
+
+class ChecksumPerfTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    data_.resize(kBufferSize);
+    base::RandBytes(&data_[0], data_.size());
+    // Runs the feature check, as the first call of a stream would.
+    adler32(0L, Z_NULL, 0);
+  }
+
+  // Checksums |data_| kIterations times and reports the throughput of the
+  // currently selected kernel as |trace|. Returns the last checksum so the
+  // kernels can be checked against each other.
+  uLong Measure(const std::string& name,
+                const std::string& trace,
+                ChecksumFunction function,
+                uLong initial) {
+    const Bytef* data = reinterpret_cast<const Bytef*>(data_.data());
+    uLong checksum = initial;
+    base::TimeTicks start = base::TimeTicks::Now();
+    for (int i = 0; i < kIterations; ++i)
+      checksum = function(initial, data, static_cast<uInt>(data_.size()));
+    base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+
+    double bytes = static_cast<double>(data_.size()) * kIterations;
+    perf_test::PrintResult(name, std::string(), trace,
+                           bytes / elapsed.InSecondsF() / 1e9, "GB/s", true);
+    return checksum;
+  }
+
+  std::string data_;
+};
+
+TEST_F(ChecksumPerfTest, Adler32) {
+  uLong scalar;
+  {
+    ScopedChecksumKernel kernel(false, false, false);
+    scalar = Measure("adler32", "scalar", adler32, 1L);
+  }
+  if (x86_cpu_enable_ssse3) {
+    ScopedChecksumKernel kernel(false, true, false);
+    EXPECT_EQ(scalar, Measure("adler32", "ssse3", adler32, 1L));
+  }
+  if (x86_cpu_enable_avx2) {
+    ScopedChecksumKernel kernel(false, true, true);
+    EXPECT_EQ(scalar, Measure("adler32", "avx2", adler32, 1L));
+  }
+}
+
+TEST_F(ChecksumPerfTest, Crc32) {
+  uLong scalar;
+  {
+    ScopedChecksumKernel kernel(false, false, false);
+    scalar = Measure("crc32", "scalar", crc32, 0L);
+  }
+  if (x86_cpu_enable_simd) {
+    ScopedChecksumKernel kernel(true, false, false);
+    EXPECT_EQ(scalar, Measure("crc32", "pclmul", crc32, 0L));
+  }
+}
+
+}  // namespace
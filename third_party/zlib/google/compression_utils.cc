@@ -8,11 +8,16 @@
 #include <stdint.h>
 #include <string.h>
 
+#include <algorithm>
+#include <memory>
 #include <vector>
 
 #include "base/bit_cast.h"
 #include "base/logging.h"
+#include "base/macros.h"
 #include "base/sys_byteorder.h"
+#include "base/sys_info.h"
+#include "base/threading/simple_thread.h"
 #include "third_party/zlib/zlib.h"
 
 namespace {
@@ -114,6 +119,115 @@ int GzipUncompressHelper(Bytef* dest,
   return err;
 }
 
+// The deflate window; each parallel block is primed with this much of the
+// input before it.
+const size_t kDeflateWindowBytes = 32 * 1024;
+
+// The largest ParallelGzipCompress() block. zlib counts input and output in
+// 32-bit uInts, and deflateBound() of a block must fit one as well.
+const size_t kMaxGzipBlockBytes = 1024 * 1024 * 1024;
+
+// The fixed gzip header written by ParallelGzipCompress(): magic, deflate,
+// no flags, no modification time, no extra flags and OS 0, matching the
+// header GzipCompressHelper() gets from a zeroed gz_header.
+const uint8_t kGzipHeader[] = {0x1f, 0x8b, 0x08, 0x00, 0x00,
+                               0x00, 0x00, 0x00, 0x00, 0x00};
+
+// Deflates one block of a ParallelGzipCompress() input into a raw deflate
+// fragment. Every block but the last ends with a sync flush, so the fragments
+// are byte-aligned and can be concatenated into a single deflate stream.
+class GzipBlockCompressor : public base::DelegateSimpleThread::Delegate {
+ public:
+  GzipBlockCompressor(const std::string& input,
+                      size_t offset,
+                      size_t length,
+                      int compression_level)
+      : input_(input),
+        offset_(offset),
+        length_(length),
+        compression_level_(compression_level),
+        crc_(0),
+        result_(Z_OK) {}
+
+  // base::DelegateSimpleThread::Delegate:
+  void Run() override {
+    const Bytef* data = bit_cast<const Bytef*>(input_.data());
+    crc_ = crc32(crc32(0L, Z_NULL, 0), data + offset_,
+                 static_cast<uInt>(length_));
+    result_ = Deflate(data);
+  }
+
+  const std::string& output() const { return output_; }
+  size_t length() const { return length_; }
+  uLong crc() const { return crc_; }
+  int result() const { return result_; }
+
+ private:
+  int Deflate(const Bytef* data) {
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    int err = deflateInit2(&stream, compression_level_, Z_DEFLATED, -MAX_WBITS,
+                           kZlibMemoryLevel, Z_DEFAULT_STRATEGY);
+    if (err != Z_OK)
+      return err;
+
+    if (offset_ > 0) {
+      const size_t dictionary_length = std::min(offset_, kDeflateWindowBytes);
+      err = deflateSetDictionary(&stream, data + offset_ - dictionary_length,
+                                 static_cast<uInt>(dictionary_length));
+      if (err != Z_OK) {
+        deflateEnd(&stream);
+        return err;
+      }
+    }
+
+    const bool last = offset_ + length_ == input_.size();
+    const int flush = last ? Z_FINISH : Z_SYNC_FLUSH;
+    // The sync flush marker adds 5 bytes on top of deflateBound(); grow the
+    // buffer if deflate() still runs out of room.
+    output_.resize(deflateBound(&stream, static_cast<uLong>(length_)) + 5);
+    stream.next_in = bit_cast<Bytef*>(data + offset_);
+    stream.avail_in = static_cast<uInt>(length_);
+    size_t produced = 0;
+    for (;;) {
+      stream.next_out = bit_cast<Bytef*>(&output_[produced]);
+      stream.avail_out = static_cast<uInt>(output_.size() - produced);
+      err = deflate(&stream, flush);
+      produced = output_.size() - stream.avail_out;
+      if (err == Z_STREAM_END || (err == Z_OK && !last && stream.avail_out))
+        break;
+      if (err != Z_OK && err != Z_BUF_ERROR) {
+        deflateEnd(&stream);
+        return err;
+      }
+      output_.resize(output_.size() * 2);
+    }
+    output_.resize(produced);
+
+    // deflateEnd() reports Z_DATA_ERROR for a stream that was never
+    // finished, which is expected for all but the last block.
+    err = deflateEnd(&stream);
+    return last ? err : Z_OK;
+  }
+
+  const std::string& input_;
+  const size_t offset_;
+  const size_t length_;
+  const int compression_level_;
+
+  std::string output_;
+  uLong crc_;
+  int result_;
+
+  DISALLOW_COPY_AND_ASSIGN(GzipBlockCompressor);
+};
+
+// Appends |value| to |output| in little-endian byte order.
+void AppendLE32(uint32_t value, std::string* output) {
+  value = base::ByteSwapToLE32(value);
+  output->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
 // Returns the uncompressed size from GZIP-compressed |compressed_data|.
 uint32_t GetUncompressedSize(const std::string& compressed_data) {
   // The uncompressed size is stored in the last 4 bytes of |input| in LE.
@@ -148,6 +262,73 @@ bool GzipCompress(const std::string& input, std::string* output) {
   return true;
 }
 
+ParallelGzipOptions::ParallelGzipOptions()
+    : num_threads(0),
+      block_size(128 * 1024),
+      compression_level(Z_DEFAULT_COMPRESSION) {}
+
+bool ParallelGzipCompress(const std::string& input,
+                          std::string* output,
+                          const ParallelGzipOptions& options) {
+  // A block size of 0 is taken as 1 byte.
+  const size_t block_size =
+      std::max<size_t>(std::min(options.block_size, kMaxGzipBlockBytes), 1);
+
+  // An empty input still needs one (empty, final) block.
+  std::vector<std::unique_ptr<GzipBlockCompressor>> blocks;
+  size_t offset = 0;
+  do {
+    const size_t length = std::min(block_size, input.size() - offset);
+    blocks.push_back(std::unique_ptr<GzipBlockCompressor>(
+        new GzipBlockCompressor(input, offset, length,
+                                options.compression_level)));
+    offset += length;
+  } while (offset < input.size());
+
+  int num_threads = options.num_threads > 0
+                        ? options.num_threads
+                        : base::SysInfo::NumberOfProcessors();
+  num_threads = std::min(num_threads, static_cast<int>(blocks.size()));
+  if (num_threads <= 1) {
+    for (const auto& block : blocks)
+      block->Run();
+  } else {
+    base::DelegateSimpleThreadPool pool("ParallelGzip", num_threads);
+    for (const auto& block : blocks)
+      pool.AddWork(block.get(), 1);
+    pool.Start();
+    pool.JoinAll();
+  }
+
+  // Stitch the fragments together between the gzip header and a trailer
+  // holding the combined CRC and the input size modulo 2^32.
+  size_t compressed_size = sizeof(kGzipHeader) + 2 * sizeof(uint32_t);
+  for (const auto& block : blocks) {
+    if (block->result() != Z_OK)
+      return false;
+    compressed_size += block->output().size();
+  }
+
+  std::string compressed;
+  compressed.reserve(compressed_size);
+  compressed.assign(reinterpret_cast<const char*>(kGzipHeader),
+                    sizeof(kGzipHeader));
+  uLong crc = crc32(0L, Z_NULL, 0);
+  for (const auto& block : blocks) {
+    compressed.append(block->output());
+    crc = crc32_combine(crc, block->crc(),
+                        static_cast<z_off_t>(block->length()));
+  }
+  const uint32_t input_size = static_cast<uint32_t>(input.size());
+  AppendLE32(static_cast<uint32_t>(crc), &compressed);
+  AppendLE32(input_size, &compressed);
+
+  // |input| may alias |output|, so only replace it now.
+  output->swap(compressed);
+  DCHECK_EQ(input_size, GetUncompressedSize(*output));
+  return true;
+}
+
 bool GzipUncompress(const std::string& input, std::string* output) {
   std::string uncompressed_output;
   uLongf uncompressed_size = static_cast<uLongf>(GetUncompressedSize(input));
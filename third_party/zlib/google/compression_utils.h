@@ -5,14 +5,44 @@
 #ifndef THIRD_PARTY_ZLIB_GOOGLE_COMPRESSION_UTILS_H_
 #define THIRD_PARTY_ZLIB_GOOGLE_COMPRESSION_UTILS_H_
 
+#include <stddef.h>
+
 #include <string>
 
 namespace compression {
 
+// Tuning knobs for ParallelGzipCompress().
+struct ParallelGzipOptions {
+  ParallelGzipOptions();
+
+  // Number of worker threads. Zero means one per processor.
+  int num_threads;
+
+  // The input is split into blocks of this many bytes, each deflated on its
+  // own with the 32 KiB before it as a preset dictionary. Smaller blocks
+  // spread better over the threads, larger ones compress marginally better.
+  // Blocks are at least 1 byte, 0 meaning 1, and at most 1 GiB, the most
+  // zlib can take in one go.
+  size_t block_size;
+
+  // zlib compression level: 1 (fastest) to 9 (smallest), or -1 for the
+  // default.
+  int compression_level;
+};
+
 // Compresses the data in |input| using gzip, storing the result in |output|.
 // |input| and |output| are allowed to be the same string (in-place operation).
 bool GzipCompress(const std::string& input, std::string* output);
 
+// Like GzipCompress(), but deflates |input| in blocks on a pool of worker
+// threads. The output is still one standard gzip member that GzipUncompress()
+// and gunzip can read, and does not depend on the number of threads. It is
+// slightly larger than GzipCompress() output because every block ends on a
+// byte boundary. |input| and |output| are allowed to be the same string.
+bool ParallelGzipCompress(const std::string& input,
+                          std::string* output,
+                          const ParallelGzipOptions& options);
+
 // Uncompresses the data in |input| using gzip, storing the result in |output|.
 // |input| and |output| are allowed to be the same string (in-place operation).
 bool GzipUncompress(const std::string& input, std::string* output);
@@ -7,10 +7,12 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include <limits>
 #include <string>
 
 #include "base/logging.h"
 #include "base/macros.h"
+#include "base/strings/string_number_conversions.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
 namespace compression {
@@ -88,4 +90,96 @@ TEST(CompressionUtilsTest, InPlace) {
   EXPECT_EQ(original_data, data);
 }
 
+TEST(CompressionUtilsTest, ParallelGzipCompression) {
+  // Large enough for several blocks, with matches that cross block
+  // boundaries.
+  std::string data;
+  for (int i = 0; data.size() < 1024 * 1024; ++i)
+    data += "line " + base::IntToString(i % 5000) + " of the test input\n";
+
+  ParallelGzipOptions options;
+  options.num_threads = 4;
+  options.block_size = 64 * 1024;
+  std::string compressed_data;
+  EXPECT_TRUE(ParallelGzipCompress(data, &compressed_data, options));
+
+  std::string uncompressed_data;
+  EXPECT_TRUE(GzipUncompress(compressed_data, &uncompressed_data));
+  EXPECT_EQ(data, uncompressed_data);
+
+  // The preset dictionaries keep the size close to single-stream gzip.
+  std::string serial_data;
+  EXPECT_TRUE(GzipCompress(data, &serial_data));
+  EXPECT_LT(compressed_data.size(), serial_data.size() * 11 / 10);
+}
+
+TEST(CompressionUtilsTest, ParallelGzipIndependentOfThreadCount) {
+  std::string data;
+  data.resize(300 * 1024);
+  for (size_t i = 0; i < data.size(); ++i)
+    data[i] = static_cast<char>((i * i) >> 7);
+
+  ParallelGzipOptions options;
+  options.block_size = 32 * 1024;
+  options.num_threads = 1;
+  std::string single_thread_data;
+  EXPECT_TRUE(ParallelGzipCompress(data, &single_thread_data, options));
+
+  for (int num_threads : {2, 3, 8, 0}) {
+    options.num_threads = num_threads;
+    std::string compressed_data;
+    EXPECT_TRUE(ParallelGzipCompress(data, &compressed_data, options));
+    EXPECT_EQ(single_thread_data, compressed_data) << num_threads;
+  }
+}
+
+TEST(CompressionUtilsTest, ParallelGzipSmallInputs) {
+  ParallelGzipOptions options;
+  options.block_size = 3;
+  for (const char* input : {"", "a", "hello world"}) {
+    std::string data(input);
+    std::string compressed_data;
+    EXPECT_TRUE(ParallelGzipCompress(data, &compressed_data, options));
+    std::string uncompressed_data;
+    EXPECT_TRUE(GzipUncompress(compressed_data, &uncompressed_data));
+    EXPECT_EQ(data, uncompressed_data);
+  }
+}
+
+TEST(CompressionUtilsTest, ParallelGzipHugeBlockSize) {
+  // Block sizes beyond what zlib takes in one go are clamped.
+  std::string data(100 * 1024, 'x');
+  ParallelGzipOptions options;
+  options.block_size = std::numeric_limits<size_t>::max();
+  std::string compressed_data;
+  EXPECT_TRUE(ParallelGzipCompress(data, &compressed_data, options));
+  std::string uncompressed_data;
+  EXPECT_TRUE(GzipUncompress(compressed_data, &uncompressed_data));
+  EXPECT_EQ(data, uncompressed_data);
+}
+
+TEST(CompressionUtilsTest, ParallelGzipZeroBlockSize) {
+  // A block size of 0 is taken as 1 byte, in debug builds too.
+  std::string data("hello world");
+  ParallelGzipOptions options;
+  options.block_size = 0;
+  std::string compressed_data;
+  EXPECT_TRUE(ParallelGzipCompress(data, &compressed_data, options));
+  std::string uncompressed_data;
+  EXPECT_TRUE(GzipUncompress(compressed_data, &uncompressed_data));
+  EXPECT_EQ(data, uncompressed_data);
+}
+
+TEST(CompressionUtilsTest, ParallelGzipInPlace) {
+  const std::string original_data(reinterpret_cast<const char*>(kData),
+                                  arraysize(kData));
+  ParallelGzipOptions options;
+  options.block_size = 4;
+
+  std::string data(original_data);
+  EXPECT_TRUE(ParallelGzipCompress(data, &data, options));
+  EXPECT_TRUE(GzipUncompress(data, &data));
+  EXPECT_EQ(original_data, data);
+}
+
 }  // namespace compression
@@ -0,0 +1,102 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+#include "base/files/file_path.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/macros.h"
+#include "base/rand_util.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+#include "third_party/zlib/zlib.h"
+
+namespace {
+
+const size_t kDataSize = 32 * 1024 * 1024;
+const size_t kReadSize = 4096;
+const int kSeeks = 64;
+const uLong kSpans[] = {256 * 1024, 1024 * 1024, 4 * 1024 * 1024};
+
+class GzIndexPerfTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    // Text-like data that compresses about 4:1, written as one gzip member.
+    static const char kWords[][8] = {"<item>", "</item>", "text", "&amp;",
+                                     "more",   "id=",     "\"42\"", " "};
+    std::string data;
+    data.reserve(kDataSize);
+    while (data.size() < kDataSize)
+      data += kWords[base::RandInt(0, arraysize(kWords) - 1)];
+    data.resize(kDataSize);
+
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    path_ = temp_dir_.path().AppendASCII("data.gz");
+    gzFile file = gzopen(path_.AsUTF8Unsafe().c_str(), "wb");
+    ASSERT_TRUE(file);
+    ASSERT_EQ(static_cast<int>(data.size()),
+              gzwrite(file, data.data(), static_cast<unsigned>(data.size())));
+    ASSERT_EQ(Z_OK, gzclose(file));
+
+    for (int i = 0; i < kSeeks; ++i) {
+      offsets_[i] = static_cast<z_off_t>(
+          base::RandInt(0, static_cast<int>(kDataSize - kReadSize)));
+    }
+  }
+
+  // Seeks |file| to each of |offsets_| in turn, reading kReadSize bytes at
+  // each, and reports the average time per seek as |trace|.
+  void Measure(gzFile file, const std::string& trace) {
+    char buffer[kReadSize];
+    base::TimeTicks start = base::TimeTicks::Now();
+    for (z_off_t offset : offsets_) {
+      ASSERT_EQ(offset, gzseek(file, offset, SEEK_SET));
+      ASSERT_EQ(static_cast<int>(kReadSize), gzread(file, buffer, kReadSize));
+    }
+    base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+    perf_test::PrintResult("gzseek", std::string(), trace,
+                           elapsed.InMillisecondsF() / kSeeks, "ms", true);
+  }
+
+  base::ScopedTempDir temp_dir_;
+  base::FilePath path_;
+  z_off_t offsets_[kSeeks];
+};
+
+TEST_F(GzIndexPerfTest, RandomSeek) {
+  gzFile file = gzopen(path_.AsUTF8Unsafe().c_str(), "rb");
+  ASSERT_TRUE(file);
+  Measure(file, "no_index");
+
+  for (uLong span : kSpans) {
+    gzIndex index = nullptr;
+    base::TimeTicks start = base::TimeTicks::Now();
+    ASSERT_EQ(Z_OK, gzbuildindex(file, span, &index));
+    base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+    const std::string trace =
+        "span_" + base::IntToString(static_cast<int>(span / 1024)) + "k";
+    perf_test::PrintResult("gzbuildindex", std::string(), trace,
+                           elapsed.InMillisecondsF(), "ms", true);
+
+    uLongf saved_length = gzindexbound(index);
+    std::string saved(saved_length, '\0');
+    ASSERT_EQ(Z_OK, gzsaveindex(index, reinterpret_cast<Bytef*>(&saved[0]),
+                                &saved_length));
+    perf_test::PrintResult("gzsaveindex", std::string(), trace,
+                           static_cast<size_t>(saved_length), "bytes", true);
+
+    ASSERT_EQ(Z_OK, gzsetindex(file, index));
+    Measure(file, trace);
+    ASSERT_EQ(Z_OK, gzsetindex(file, nullptr));
+    gzfreeindex(index);
+  }
+  EXPECT_EQ(Z_OK, gzclose(file));
+}
+
+}  // namespace
@@ -0,0 +1,214 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "base/files/file_path.h"
+#include "base/files/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/macros.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "third_party/zlib/zlib.h"
+
+namespace {
+
+const uLong kSpan = 64 * 1024;
+
+// Markup-like text with some variation, so that deflate emits many blocks.
+std::string MakeCorpus(size_t size) {
+  static const char kMarkup[] = "<item id=\"42\">text &amp; more</item>\n";
+  std::string data(size, '\0');
+  uint32_t state = 1;
+  for (size_t i = 0; i < size; ++i) {
+    state = state * 1103515245u + 12345u;
+    data[i] = (state >> 16) % 7 == 0
+                  ? static_cast<char>('a' + (state >> 20) % 26)
+                  : kMarkup[i % (arraysize(kMarkup) - 1)];
+  }
+  return data;
+}
+
+// Writes |data| to |path| as |members| concatenated gzip members.
+bool WriteGzip(const base::FilePath& path,
+               const std::string& data,
+               size_t members) {
+  size_t offset = 0;
+  for (size_t i = 0; i < members; ++i) {
+    size_t end = data.size() * (i + 1) / members;
+    gzFile file = gzopen(path.AsUTF8Unsafe().c_str(), i ? "ab" : "wb");
+    if (!file)
+      return false;
+    int length = static_cast<int>(end - offset);
+    bool written = gzwrite(file, data.data() + offset, length) == length;
+    if (gzclose(file) != Z_OK || !written)
+      return false;
+    offset = end;
+  }
+  return true;
+}
+
+class GzIndexTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    path_ = temp_dir_.path().AppendASCII("data.gz");
+    corpus_ = MakeCorpus(1024 * 1024);
+    ASSERT_TRUE(WriteGzip(path_, corpus_, 3));
+  }
+
+  gzFile Open() const { return gzopen(path_.AsUTF8Unsafe().c_str(), "rb"); }
+
+  // Seeks |file| to |offset| and checks the |length| bytes read from there.
+  void ExpectDataAt(gzFile file, size_t offset, size_t length) {
+    SCOPED_TRACE(testing::Message() << "offset " << offset);
+    ASSERT_EQ(static_cast<z_off_t>(offset),
+              gzseek(file, static_cast<z_off_t>(offset), SEEK_SET));
+    std::string buffer(length, '\0');
+    int read = gzread(file, &buffer[0], static_cast<unsigned>(length));
+    ASSERT_GE(read, 0);
+    buffer.resize(read);
+    EXPECT_EQ(corpus_.substr(offset, length), buffer);
+  }
+
+  // Checks random access to the whole corpus through |file|, forwards and
+  // backwards, then reads to the end so the gzip trailers get checked.
+  void ExpectRandomAccess(gzFile file) {
+    const size_t kOffsets[] = {
+        0, 700000, 300000, kSpan - 1, kSpan, kSpan + 1, 1024 * 1024 - 10,
+        349525, 349526, 699050, 699051, 12345, 1000000,
+    };
+    for (size_t offset : kOffsets)
+      ExpectDataAt(file, offset, 5000);
+
+    ExpectDataAt(file, 500000, 0);
+    std::string rest(corpus_.size(), '\0');
+    int read = gzread(file, &rest[0], static_cast<unsigned>(rest.size()));
+    ASSERT_EQ(static_cast<int>(corpus_.size() - 500000), read);
+    int error;
+    gzerror(file, &error);
+    EXPECT_EQ(Z_OK, error);
+    EXPECT_TRUE(gzeof(file));
+  }
+
+  base::ScopedTempDir temp_dir_;
+  base::FilePath path_;
+  std::string corpus_;
+};
+
+TEST_F(GzIndexTest, SeekWithIndex) {
+  gzFile file = Open();
+  ASSERT_TRUE(file);
+  gzIndex index = nullptr;
+  ASSERT_EQ(Z_OK, gzbuildindex(file, kSpan, &index));
+  ASSERT_TRUE(index);
+  ASSERT_EQ(Z_OK, gzsetindex(file, index));
+  ExpectRandomAccess(file);
+  EXPECT_EQ(Z_OK, gzclose(file));
+
+  // The same index serves several files.
+  gzFile first = Open();
+  gzFile second = Open();
+  ASSERT_TRUE(first);
+  ASSERT_TRUE(second);
+  ASSERT_EQ(Z_OK, gzsetindex(first, index));
+  ASSERT_EQ(Z_OK, gzsetindex(second, index));
+  ExpectDataAt(first, 900000, 100);
+  ExpectDataAt(second, 100000, 100);
+  ExpectDataAt(first, 400000, 100);
+  EXPECT_EQ(Z_OK, gzclose(first));
+  EXPECT_EQ(Z_OK, gzclose(second));
+  gzfreeindex(index);
+}
+
+TEST_F(GzIndexTest, SeekWithoutIndex) {
+  gzFile file = Open();
+  ASSERT_TRUE(file);
+  ExpectRandomAccess(file);
+  EXPECT_EQ(Z_OK, gzclose(file));
+}
+
+TEST_F(GzIndexTest, SaveAndLoad) {
+  gzFile file = Open();
+  ASSERT_TRUE(file);
+  gzIndex index = nullptr;
+  ASSERT_EQ(Z_OK, gzbuildindex(file, kSpan, &index));
+
+  std::vector<Bytef> saved(gzindexbound(index));
+  uLongf saved_length = 10;
+  EXPECT_EQ(Z_BUF_ERROR, gzsaveindex(index, &saved[0], &saved_length));
+  saved_length = saved.size();
+  ASSERT_EQ(Z_OK, gzsaveindex(index, &saved[0], &saved_length));
+  saved.resize(saved_length);
+  gzfreeindex(index);
+  // The saved windows are compressed, so the saved index is a fraction of
+  // the 32K per access point it takes in memory.
+  EXPECT_LT(saved.size(), corpus_.size() / kSpan * 32768 / 4);
+
+  gzIndex loaded = nullptr;
+  ASSERT_EQ(Z_OK, gzloadindex(&saved[0], saved.size(), &loaded));
+  ASSERT_EQ(Z_OK, gzsetindex(file, loaded));
+  ExpectRandomAccess(file);
+  EXPECT_EQ(Z_OK, gzclose(file));
+
+  // Saving again gives the same bytes.
+  std::vector<Bytef> resaved(gzindexbound(loaded));
+  uLongf resaved_length = resaved.size();
+  ASSERT_EQ(Z_OK, gzsaveindex(loaded, &resaved[0], &resaved_length));
+  resaved.resize(resaved_length);
+  EXPECT_EQ(saved, resaved);
+  gzfreeindex(loaded);
+
+  // Any damage is detected.
+  for (size_t i = 0; i < saved.size(); i += saved.size() / 97 + 1) {
+    std::vector<Bytef> corrupt(saved);
+    corrupt[i] ^= 0x10;
+    loaded = nullptr;
+    EXPECT_EQ(Z_DATA_ERROR, gzloadindex(&corrupt[0], corrupt.size(), &loaded));
+    EXPECT_FALSE(loaded);
+  }
+  EXPECT_EQ(Z_DATA_ERROR,
+            gzloadindex(&saved[0], saved.size() - 1, &loaded));
+}
+
+TEST_F(GzIndexTest, RejectsIndexOfOtherData) {
+  gzFile file = Open();
+  ASSERT_TRUE(file);
+  gzIndex index = nullptr;
+  ASSERT_EQ(Z_OK, gzbuildindex(file, kSpan, &index));
+  EXPECT_EQ(Z_OK, gzclose(file));
+
+  base::FilePath other = temp_dir_.path().AppendASCII("other.gz");
+  ASSERT_TRUE(WriteGzip(other, corpus_.substr(1000), 1));
+  file = gzopen(other.AsUTF8Unsafe().c_str(), "rb");
+  ASSERT_TRUE(file);
+  EXPECT_EQ(Z_DATA_ERROR, gzsetindex(file, index));
+  EXPECT_EQ(Z_OK, gzclose(file));
+  gzfreeindex(index);
+}
+
+TEST_F(GzIndexTest, RejectsInvalidData) {
+  gzFile file = Open();
+  ASSERT_TRUE(file);
+  gzIndex index = nullptr;
+  EXPECT_EQ(Z_STREAM_ERROR, gzbuildindex(file, 0, &index));
+  EXPECT_EQ(Z_OK, gzclose(file));
+
+  // A truncated member.
+  std::string compressed;
+  ASSERT_TRUE(base::ReadFileToString(path_, &compressed));
+  compressed.resize(compressed.size() / 2);
+  ASSERT_EQ(static_cast<int>(compressed.size()),
+            base::WriteFile(path_, compressed.data(),
+                            static_cast<int>(compressed.size())));
+  file = Open();
+  ASSERT_TRUE(file);
+  EXPECT_EQ(Z_DATA_ERROR, gzbuildindex(file, kSpan, &index));
+  EXPECT_EQ(Z_OK, gzclose(file));
+}
+
+}  // namespace
@@ -0,0 +1,161 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+#include "base/files/file_path.h"
+#include "base/files/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/macros.h"
+#include "base/rand_util.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_split.h"
+#include "base/time/time.h"
+#include "build/build_config.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+#include "third_party/zlib/zlib.h"
+
+namespace {
+
+const size_t kFileSizes[] = {1024 * 1024, 16 * 1024 * 1024,
+                             128 * 1024 * 1024};
+const size_t kChunkSize = 64 * 1024;
+const unsigned kMaxBuffer = 1024 * 1024;
+
+struct Tuning {
+  const char* name;
+  unsigned max;
+  int flags;
+};
+
+const Tuning kTunings[] = {
+    {"default", 0, 0},
+    {"grow", kMaxBuffer, GZ_TUNE_ADVISE},
+    {"grow_thread", kMaxBuffer, GZ_TUNE_ADVISE | GZ_TUNE_THREAD},
+};
+
+// Counts the read() and write() calls of the process, which /proc/self/io
+// reports on Linux. Elsewhere reports nothing.
+class SyscallCounter {
+ public:
+  SyscallCounter() : reads_(0), writes_(0) { Read(&reads_, &writes_); }
+
+  void Report(const std::string& measurement, const std::string& trace) {
+    uint64_t reads = 0;
+    uint64_t writes = 0;
+    if (!Read(&reads, &writes))
+      return;
+    perf_test::PrintResult(measurement + "_read_calls", std::string(), trace,
+                           static_cast<size_t>(reads - reads_), "calls",
+                           false);
+    perf_test::PrintResult(measurement + "_write_calls", std::string(), trace,
+                           static_cast<size_t>(writes - writes_), "calls",
+                           false);
+  }
+
+ private:
+  static bool Read(uint64_t* reads, uint64_t* writes) {
+#if defined(OS_LINUX)
+    std::string io;
+    if (!base::ReadFileToString(base::FilePath("/proc/self/io"), &io))
+      return false;
+    base::StringPairs pairs;
+    base::SplitStringIntoKeyValuePairs(io, ':', '\n', &pairs);
+    bool found_reads = false;
+    bool found_writes = false;
+    for (const auto& pair : pairs) {
+      std::string value = pair.second;
+      value.erase(0, value.find_first_not_of(' '));
+      if (pair.first == "syscr")
+        found_reads = base::StringToUint64(value, reads);
+      else if (pair.first == "syscw")
+        found_writes = base::StringToUint64(value, writes);
+    }
+    return found_reads && found_writes;
+#else
+    return false;
+#endif
+  }
+
+  uint64_t reads_;
+  uint64_t writes_;
+
+  DISALLOW_COPY_AND_ASSIGN(SyscallCounter);
+};
+
+class GzTunePerfTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    path_ = temp_dir_.path().AppendASCII("data.gz");
+
+    // Text-like data that compresses about 4:1.
+    static const char kWords[][8] = {"<item>", "</item>", "text", "&amp;",
+                                     "more",   "id=",     "\"42\"", " "};
+    while (chunk_.size() < kChunkSize)
+      chunk_ += kWords[base::RandInt(0, arraysize(kWords) - 1)];
+    chunk_.resize(kChunkSize);
+  }
+
+  void Write(size_t size, const Tuning& tuning, const std::string& trace) {
+    SyscallCounter counter;
+    base::TimeTicks start = base::TimeTicks::Now();
+    gzFile file = gzopen(path_.AsUTF8Unsafe().c_str(), "wb1");
+    ASSERT_TRUE(file);
+    ASSERT_EQ(0, gztune(file, tuning.max, tuning.flags));
+    for (size_t written = 0; written < size; written += chunk_.size()) {
+      ASSERT_EQ(static_cast<int>(chunk_.size()),
+                gzwrite(file, chunk_.data(),
+                        static_cast<unsigned>(chunk_.size())));
+    }
+    ASSERT_EQ(Z_OK, gzclose(file));
+    base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+    perf_test::PrintResult("gzwrite", std::string(), trace,
+                           size / elapsed.InSecondsF() / 1e6, "MB/s", true);
+    counter.Report("gzwrite", trace);
+  }
+
+  void Read(size_t size, const Tuning& tuning, const std::string& trace) {
+    std::string buffer(kChunkSize, '\0');
+    SyscallCounter counter;
+    base::TimeTicks start = base::TimeTicks::Now();
+    gzFile file = gzopen(path_.AsUTF8Unsafe().c_str(), "rb");
+    ASSERT_TRUE(file);
+    ASSERT_EQ(0, gztune(file, tuning.max, tuning.flags));
+    size_t total = 0;
+    int read;
+    while ((read = gzread(file, &buffer[0],
+                          static_cast<unsigned>(buffer.size()))) > 0) {
+      total += read;
+    }
+    ASSERT_EQ(0, read);
+    ASSERT_EQ(Z_OK, gzclose(file));
+    base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+    ASSERT_EQ(size, total);
+    perf_test::PrintResult("gzread", std::string(), trace,
+                           size / elapsed.InSecondsF() / 1e6, "MB/s", true);
+    counter.Report("gzread", trace);
+  }
+
+  base::ScopedTempDir temp_dir_;
+  base::FilePath path_;
+  std::string chunk_;
+};
+
+TEST_F(GzTunePerfTest, Streaming) {
+  for (size_t size : kFileSizes) {
+    for (const Tuning& tuning : kTunings) {
+      const std::string trace = std::string(tuning.name) + "_" +
+                                base::SizeTToString(size >> 20) + "MB";
+      Write(size, tuning, trace);
+      Read(size, tuning, trace);
+    }
+  }
+}
+
+}  // namespace
@@ -0,0 +1,171 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <string>
+
+#include "base/files/file_path.h"
+#include "base/files/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/macros.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "third_party/zlib/zlib.h"
+
+namespace {
+
+const unsigned kMaxBuffer = 1024 * 1024;
+const int kTunings[] = {0, GZ_TUNE_ADVISE, GZ_TUNE_THREAD,
+                        GZ_TUNE_ADVISE | GZ_TUNE_THREAD};
+
+// Text with random letters mixed in, or random bytes that do not compress.
+std::string MakeData(size_t size, bool random) {
+  static const char kMarkup[] = "<item id=\"42\">text &amp; more</item>\n";
+  std::string data(size, '\0');
+  uint32_t state = static_cast<uint32_t>(size);
+  for (size_t i = 0; i < size; ++i) {
+    state = state * 1103515245u + 12345u;
+    if (random)
+      data[i] = static_cast<char>(state >> 16);
+    else if ((state >> 16) % 7 == 0)
+      data[i] = static_cast<char>('a' + (state >> 20) % 26);
+    else
+      data[i] = kMarkup[i % (arraysize(kMarkup) - 1)];
+  }
+  return data;
+}
+
+class GzTuneTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    path_ = temp_dir_.path().AppendASCII("data.gz");
+  }
+
+  gzFile Open(const char* mode, unsigned max, int flags) {
+    gzFile file = gzopen(path_.AsUTF8Unsafe().c_str(), mode);
+    EXPECT_TRUE(file);
+    if (file)
+      EXPECT_EQ(0, gztune(file, max, flags));
+    return file;
+  }
+
+  // Writes |data| in |chunk| sized gzwrite() calls.
+  void Write(const std::string& data,
+             size_t chunk,
+             unsigned max,
+             int flags) {
+    gzFile file = Open("wb", max, flags);
+    ASSERT_TRUE(file);
+    for (size_t i = 0; i < data.size(); i += chunk) {
+      size_t n = std::min(chunk, data.size() - i);
+      ASSERT_EQ(static_cast<int>(n),
+                gzwrite(file, data.data() + i, static_cast<unsigned>(n)));
+    }
+    EXPECT_EQ(Z_OK, gzclose(file));
+  }
+
+  // Reads the whole file in |chunk| sized gzread() calls.
+  std::string Read(size_t chunk, unsigned max, int flags) {
+    gzFile file = Open("rb", max, flags);
+    std::string data;
+    if (!file)
+      return data;
+    std::string buffer(chunk, '\0');
+    int read;
+    while ((read = gzread(file, &buffer[0],
+                          static_cast<unsigned>(chunk))) > 0) {
+      data.append(buffer, 0, read);
+    }
+    EXPECT_EQ(0, read);
+    EXPECT_EQ(Z_OK, gzclose(file));
+    return data;
+  }
+
+  base::ScopedTempDir temp_dir_;
+  base::FilePath path_;
+};
+
+TEST_F(GzTuneTest, RoundTrip) {
+  const size_t kSizes[] = {0, 1, 8191, 8192, 100000, 3 * 1024 * 1024};
+  const size_t kChunks[] = {1000, 65536, 1 << 22};
+  for (size_t size : kSizes) {
+    for (int random = 0; random < 2; ++random) {
+      const std::string data = MakeData(size, random != 0);
+      for (int write_flags : kTunings) {
+        SCOPED_TRACE(testing::Message() << "size " << size << " random "
+                                        << random << " write " << write_flags);
+        Write(data, 50000, kMaxBuffer, write_flags);
+        for (int read_flags : kTunings) {
+          for (size_t chunk : kChunks) {
+            SCOPED_TRACE(testing::Message() << "read " << read_flags
+                                            << " chunk " << chunk);
+            EXPECT_EQ(data, Read(chunk, kMaxBuffer, read_flags));
+          }
+        }
+      }
+    }
+  }
+}
+
+TEST_F(GzTuneTest, TooLate) {
+  gzFile file = gzopen(path_.AsUTF8Unsafe().c_str(), "wb");
+  ASSERT_TRUE(file);
+  EXPECT_EQ(-1, gztune(file, kMaxBuffer, 4));
+  ASSERT_EQ(1, gzwrite(file, "x", 1));
+  EXPECT_EQ(-1, gztune(file, kMaxBuffer, GZ_TUNE_THREAD));
+  EXPECT_EQ(Z_OK, gzclose(file));
+}
+
+// Seeking, rewinding and gzungetc() give back or drop the input read ahead.
+TEST_F(GzTuneTest, SeekAndRewind) {
+  const std::string data = MakeData(4 * 1024 * 1024, false);
+  Write(data, 1 << 20, kMaxBuffer, GZ_TUNE_THREAD);
+
+  gzFile file = Open("rb", kMaxBuffer, GZ_TUNE_THREAD);
+  ASSERT_TRUE(file);
+  std::string buffer(10000, '\0');
+  const z_off_t kOffsets[] = {3000000, 100, 2500000, 4 * 1024 * 1024 - 5001};
+  for (z_off_t offset : kOffsets) {
+    SCOPED_TRACE(testing::Message() << "offset " << offset);
+    ASSERT_EQ(offset, gzseek(file, offset, SEEK_SET));
+    ASSERT_EQ(5000, gzread(file, &buffer[0], 5000));
+    EXPECT_EQ(data.substr(offset, 5000), buffer.substr(0, 5000));
+    EXPECT_EQ(static_cast<unsigned char>(data[offset + 5000]), gzgetc(file));
+    EXPECT_EQ('z', gzungetc('z', file));
+    EXPECT_EQ('z', gzgetc(file));
+  }
+  ASSERT_EQ(0, gzrewind(file));
+  EXPECT_EQ(data, Read(1 << 20, 0, 0));
+  std::string all(data.size() + 1, '\0');
+  EXPECT_EQ(static_cast<int>(data.size()),
+            gzread(file, &all[0], static_cast<unsigned>(all.size())));
+  all.resize(data.size());
+  EXPECT_EQ(data, all);
+  EXPECT_EQ(Z_OK, gzclose(file));
+}
+
+// Data that follows the gzip data is copied as is, even after the input
+// buffer grew past the output buffer.
+TEST_F(GzTuneTest, TrailingData) {
+  const std::string data = MakeData(2 * 1024 * 1024, true);
+  const std::string trailer = MakeData(300000, false);
+  Write(data, 1 << 20, 0, 0);
+  std::string compressed;
+  ASSERT_TRUE(base::ReadFileToString(path_, &compressed));
+  compressed += trailer;
+  ASSERT_EQ(static_cast<int>(compressed.size()),
+            base::WriteFile(path_, compressed.data(),
+                            static_cast<int>(compressed.size())));
+
+  for (int flags : kTunings) {
+    SCOPED_TRACE(testing::Message() << "flags " << flags);
+    EXPECT_EQ(data + trailer, Read(4096, kMaxBuffer, flags));
+    EXPECT_EQ(data + trailer, Read(1 << 22, kMaxBuffer, flags));
+  }
+}
+
+}  // namespace
@@ -0,0 +1,208 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <string>
+
+#include "base/logging.h"
+#include "base/macros.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "third_party/zlib/zlib.h"
+
+extern "C" {
+#include "third_party/zlib/x86.h"
+}
+
+namespace {
+
+// Deterministic generator so failures reproduce across runs and platforms.
+class Lcg {
+ public:
+  explicit Lcg(uint32_t seed) : state_(seed) {}
+  uint32_t Next() {
+    state_ = state_ * 1103515245u + 12345u;
+    return state_ >> 16;
+  }
+
+ private:
+  uint32_t state_;
+};
+
+enum CorpusKind {
+  RANDOM,          // Incompressible: stored blocks and literals.
+  SHORT_PERIODS,   // Runs with periods 1 to 23, the overlapping copies.
+  TEXT,            // Markup-like text with medium distance matches.
+  FAR_MATCHES,     // Matches near the 32K limit, copied from the window.
+  CORPUS_KIND_COUNT,
+};
+
+std::string MakeCorpus(CorpusKind kind, size_t size) {
+  static const char kAlphabet[] = "abcdefghijklmnopqrstuvw";
+  static const char kMarkup[] = "<item id=\"42\">text &amp; more</item>\n";
+  const size_t kMaxPeriod = arraysize(kAlphabet) - 1;
+  Lcg lcg(static_cast<uint32_t>(kind) + 1);
+  std::string data(size, '\0');
+  for (size_t i = 0; i < size; ++i) {
+    switch (kind) {
+      case RANDOM:
+        data[i] = static_cast<char>(lcg.Next());
+        break;
+      case SHORT_PERIODS:
+        data[i] = kAlphabet[i % ((i / 5000) % kMaxPeriod + 1)];
+        break;
+      case TEXT:
+        data[i] = static_cast<char>(kMarkup[i % (arraysize(kMarkup) - 1)] +
+                                    (i / 997) % 3);
+        break;
+      case FAR_MATCHES:
+        data[i] = i > 70000 ? data[i - 32768 + lcg.Next() % 2000]
+                            : static_cast<char>(lcg.Next() % 16);
+        break;
+      default:
+        NOTREACHED();
+    }
+  }
+  return data;
+}
+
+std::string Deflate(const std::string& input, int level, int window_bits) {
+  z_stream stream = {};
+  EXPECT_EQ(Z_OK, deflateInit2(&stream, level, Z_DEFLATED, window_bits, 8,
+                               Z_DEFAULT_STRATEGY));
+  std::string output(deflateBound(&stream, input.size()), '\0');
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+  stream.avail_in = static_cast<uInt>(input.size());
+  stream.next_out = reinterpret_cast<Bytef*>(&output[0]);
+  stream.avail_out = static_cast<uInt>(output.size());
+  EXPECT_EQ(Z_STREAM_END, deflate(&stream, Z_FINISH));
+  output.resize(output.size() - stream.avail_out);
+  deflateEnd(&stream);
+  return output;
+}
+
+// Inflates |input| handing inflate() at most |in_chunk| input and |out_chunk|
+// output bytes per call, which moves the fast path's buffer boundaries
+// around. Returns false on any inflate() error.
+bool Inflate(const std::string& input,
+             int window_bits,
+             size_t in_chunk,
+             size_t out_chunk,
+             std::string* output) {
+  z_stream stream = {};
+  if (inflateInit2(&stream, window_bits) != Z_OK)
+    return false;
+  std::string buffer(out_chunk, '\0');
+  size_t consumed = 0;
+  int result = Z_OK;
+  output->clear();
+  while (result != Z_STREAM_END) {
+    size_t available = std::min(in_chunk, input.size() - consumed);
+    stream.next_in =
+        reinterpret_cast<Bytef*>(const_cast<char*>(input.data())) + consumed;
+    stream.avail_in = static_cast<uInt>(available);
+    stream.next_out = reinterpret_cast<Bytef*>(&buffer[0]);
+    stream.avail_out = static_cast<uInt>(buffer.size());
+    result = inflate(&stream, Z_NO_FLUSH);
+    if (result != Z_OK && result != Z_STREAM_END)
+      break;
+    consumed += available - stream.avail_in;
+    output->append(buffer, 0, buffer.size() - stream.avail_out);
+  }
+  inflateEnd(&stream);
+  return result == Z_STREAM_END;
+}
+
+class InflateChunkTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    // Runs the feature check.
+    crc32(0L, Z_NULL, 0);
+    simd_ = x86_cpu_enable_simd;
+  }
+
+  void TearDown() override { x86_cpu_enable_simd = simd_; }
+
+  int simd_;
+};
+
+// inflate_fast_chunk_() must produce exactly what inflate_fast() does for
+// every kind of stream, whatever the buffer sizes.
+TEST_F(InflateChunkTest, MatchesInflateFast) {
+  const size_t kCorpusSize = 256 * 1024;
+  const int kLevels[] = {1, 6, 9};
+  // Raw deflate, zlib and gzip wrappers; small windows make window copies
+  // wrap around often.
+  const int kWindowBits[] = {-9, 12, 15 + 16};
+  const size_t kInChunks[] = {8, 100, 1 << 20};
+  const size_t kOutChunks[] = {300, 4096, 65536, 1 << 20};
+
+  for (int kind = 0; kind < CORPUS_KIND_COUNT; ++kind) {
+    const std::string corpus =
+        MakeCorpus(static_cast<CorpusKind>(kind), kCorpusSize);
+    for (int level : kLevels) {
+      for (int window_bits : kWindowBits) {
+        const std::string compressed = Deflate(corpus, level, window_bits);
+        for (size_t in_chunk : kInChunks) {
+          for (size_t out_chunk : kOutChunks) {
+            SCOPED_TRACE(testing::Message()
+                         << "corpus " << kind << " level " << level
+                         << " window_bits " << window_bits << " in "
+                         << in_chunk << " out " << out_chunk);
+            std::string reference;
+            x86_cpu_enable_simd = 0;
+            ASSERT_TRUE(Inflate(compressed, window_bits, in_chunk, out_chunk,
+                                &reference));
+            EXPECT_EQ(corpus, reference);
+
+            if (!simd_)
+              continue;
+            std::string chunked;
+            x86_cpu_enable_simd = simd_;
+            ASSERT_TRUE(Inflate(compressed, window_bits, in_chunk, out_chunk,
+                                &chunked));
+            EXPECT_EQ(reference, chunked);
+          }
+        }
+      }
+    }
+  }
+}
+
+// Corrupt streams must fail the same way on both paths.
+TEST_F(InflateChunkTest, RejectsDistanceTooFarBack) {
+  const std::string dictionary = MakeCorpus(TEXT, 16 * 1024);
+  const std::string corpus = MakeCorpus(TEXT, 64 * 1024);
+
+  // A raw stream written against a preset dictionary starts with matches
+  // reaching back into it, so inflating it without the dictionary must
+  // fail rather than copy from the (empty) window.
+  z_stream stream = {};
+  ASSERT_EQ(Z_OK, deflateInit2(&stream, 9, Z_DEFLATED, -15, 8,
+                               Z_DEFAULT_STRATEGY));
+  ASSERT_EQ(Z_OK,
+            deflateSetDictionary(
+                &stream, reinterpret_cast<const Bytef*>(dictionary.data()),
+                static_cast<uInt>(dictionary.size())));
+  std::string compressed(deflateBound(&stream, corpus.size()), '\0');
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(corpus.data()));
+  stream.avail_in = static_cast<uInt>(corpus.size());
+  stream.next_out = reinterpret_cast<Bytef*>(&compressed[0]);
+  stream.avail_out = static_cast<uInt>(compressed.size());
+  ASSERT_EQ(Z_STREAM_END, deflate(&stream, Z_FINISH));
+  compressed.resize(compressed.size() - stream.avail_out);
+  deflateEnd(&stream);
+
+  std::string output;
+  x86_cpu_enable_simd = 0;
+  EXPECT_FALSE(Inflate(compressed, -15, 1 << 20, 1 << 20, &output));
+  if (!simd_)
+    return;
+  x86_cpu_enable_simd = simd_;
+  EXPECT_FALSE(Inflate(compressed, -15, 1 << 20, 1 << 20, &output));
+}
+
+}  // namespace
@@ -4,15 +4,29 @@
 
 #include "third_party/zlib/google/zip.h"
 
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "base/atomic_sequence_num.h"
+#include "base/atomicops.h"
 #include "base/bind.h"
 #include "base/files/file.h"
 #include "base/files/file_enumerator.h"
+#include "base/files/file_util.h"
 #include "base/logging.h"
+#include "base/macros.h"
 #include "base/strings/string16.h"
 #include "base/strings/string_util.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/sys_info.h"
+#include "base/threading/simple_thread.h"
 #include "build/build_config.h"
 #include "third_party/zlib/google/zip_internal.h"
 #include "third_party/zlib/google/zip_reader.h"
@@ -50,8 +64,10 @@ bool AddFileToZip(zipFile zip_file, const base::FilePath& src_dir) {
   return true;
 }
 
-bool AddEntryToZip(zipFile zip_file, const base::FilePath& path,
-                   const base::FilePath& root_path) {
+// Returns the name of the entry for |path| in a zip of |root_path|.
+std::string GetEntryName(const base::FilePath& path,
+                         const base::FilePath& root_path,
+                         bool is_directory) {
   base::FilePath relative_path;
   bool result = root_path.AppendRelativePath(path, &relative_path);
   DCHECK(result);
@@ -60,13 +76,27 @@ bool AddEntryToZip(zipFile zip_file, const base::FilePath& path,
   base::ReplaceSubstringsAfterOffset(&str_path, 0u, "\\", "/");
 #endif
 
-  bool is_directory = base::DirectoryExists(path);
   if (is_directory)
     str_path += "/";
+  return str_path;
+}
+
+bool AddEntryToZip(zipFile zip_file, const base::FilePath& path,
+                   const base::FilePath& root_path) {
+  bool is_directory = base::DirectoryExists(path);
+  std::string str_path = GetEntryName(path, root_path, is_directory);
+
+  int64_t size = 0;
+  if (!is_directory && !base::GetFileSize(path, &size)) {
+    DLOG(ERROR) << "Could not get the size of " << path.value();
+    return false;
+  }
 
   zip_fileinfo file_info = zip::internal::GetFileInfoForZipping(path);
-  if (!zip::internal::ZipOpenNewFileInZip(zip_file, str_path, &file_info))
+  if (!zip::internal::ZipOpenNewFileInZip(zip_file, str_path, &file_info,
+                                          size)) {
     return false;
+  }
 
   bool success = true;
   if (!is_directory) {
@@ -81,6 +111,278 @@ bool AddEntryToZip(zipFile zip_file, const base::FilePath& path,
   return success;
 }
 
+// How many bytes of source files ParallelZipWithFilterCallback() lets the
+// worker threads compress ahead of the entry being written.
+const int64_t kParallelZipMaxBufferedBytes = 64 * 1024 * 1024;
+
+// Returns the number of worker threads to use for a request of
+// |num_threads|, of which zero means one per processor.
+int GetNumWorkerThreads(int num_threads) {
+  return num_threads > 0 ? num_threads : base::SysInfo::NumberOfProcessors();
+}
+
+// How many deflated bytes of one file FileCompressor keeps in memory before
+// it moves them to a temporary file.
+const size_t kFileCompressorMaxMemoryBytes = 4 * 1024 * 1024;
+
+// Deflates one file for ParallelZipWithFilterCallback(), so that the writer
+// can store it with minizip's raw mode once the entries before it are
+// written. Small files are deflated into memory, larger ones into a temporary
+// file.
+class FileCompressor : public base::DelegateSimpleThread::Delegate {
+ public:
+  FileCompressor(const base::FilePath& path, int64_t size)
+      : path_(path),
+        size_(size),
+        file_info_(),
+        crc_(0),
+        uncompressed_size_(0),
+        compressed_size_(0),
+        success_(false),
+        done_(true /* manual_reset */, false /* initially_signaled */) {}
+
+  ~FileCompressor() override { DiscardCompressed(); }
+
+  // base::DelegateSimpleThread::Delegate:
+  void Run() override {
+    file_info_ = zip::internal::GetFileInfoForZipping(path_);
+    success_ = Compress();
+    done_.Signal();
+  }
+
+  // Blocks until Run() has finished.
+  void Wait() { done_.Wait(); }
+
+  // Writes the compressed data to the current entry of |zip_file|, at most
+  // kZipBufSize bytes at a time.
+  bool WriteCompressed(zipFile zip_file) {
+    const size_t kChunkSize = zip::internal::kZipBufSize;
+    if (!spill_file_.IsValid()) {
+      for (size_t pos = 0; pos < compressed_.size(); pos += kChunkSize) {
+        const size_t len = std::min(kChunkSize, compressed_.size() - pos);
+        if (ZIP_OK != zipWriteInFileInZip(zip_file, &compressed_[pos],
+                                          static_cast<unsigned int>(len))) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    char buf[zip::internal::kZipBufSize];
+    int num_bytes;
+    for (int64_t pos = 0; pos < compressed_size_; pos += num_bytes) {
+      num_bytes = spill_file_.Read(pos, buf, zip::internal::kZipBufSize);
+      if (num_bytes <= 0) {
+        DLOG(ERROR) << "Could not read " << spill_path_.value();
+        return false;
+      }
+      if (ZIP_OK != zipWriteInFileInZip(zip_file, buf, num_bytes))
+        return false;
+    }
+    return true;
+  }
+
+  // Frees the compressed data once it has been written.
+  void DiscardCompressed() {
+    std::string().swap(compressed_);
+    if (!spill_path_.empty()) {
+      spill_file_.Close();
+      base::DeleteFile(spill_path_, false);
+      spill_path_.clear();
+    }
+  }
+
+  const base::FilePath& path() const { return path_; }
+  int64_t size() const { return size_; }
+  const zip_fileinfo& file_info() const { return file_info_; }
+  uLong crc() const { return crc_; }
+  int64_t uncompressed_size() const { return uncompressed_size_; }
+  int64_t compressed_size() const { return compressed_size_; }
+  bool success() const { return success_; }
+
+ private:
+  // Appends |len| deflated bytes to the compressed data, moving it to a
+  // temporary file once it outgrows kFileCompressorMaxMemoryBytes.
+  bool Store(const char* data, int len) {
+    compressed_size_ += len;
+    if (spill_file_.IsValid())
+      return spill_file_.WriteAtCurrentPos(data, len) == len;
+
+    compressed_.append(data, len);
+    if (compressed_.size() <= kFileCompressorMaxMemoryBytes)
+      return true;
+    if (!base::CreateTemporaryFile(&spill_path_)) {
+      DLOG(ERROR) << "Could not create a temporary file for " << path_.value();
+      return false;
+    }
+    spill_file_.Initialize(spill_path_, base::File::FLAG_CREATE_ALWAYS |
+                                            base::File::FLAG_READ |
+                                            base::File::FLAG_WRITE);
+    if (!spill_file_.IsValid()) {
+      DLOG(ERROR) << "Could not open " << spill_path_.value();
+      return false;
+    }
+    const int size = static_cast<int>(compressed_.size());
+    const bool written =
+        spill_file_.WriteAtCurrentPos(compressed_.data(), size) == size;
+    std::string().swap(compressed_);
+    return written;
+  }
+
+  bool Compress() {
+    base::File file(path_, base::File::FLAG_OPEN | base::File::FLAG_READ);
+    if (!file.IsValid()) {
+      DLOG(ERROR) << "Could not open file for path " << path_.value();
+      return false;
+    }
+
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS,
+                     DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK) {
+      return false;
+    }
+    crc_ = crc32(0L, Z_NULL, 0);
+
+    char buf[zip::internal::kZipBufSize];
+    char out[zip::internal::kZipBufSize];
+    int flush = Z_NO_FLUSH;
+    int err = Z_OK;
+    while (flush != Z_FINISH) {
+      int num_bytes = file.ReadAtCurrentPos(buf, zip::internal::kZipBufSize);
+      if (num_bytes < 0) {
+        DLOG(ERROR) << "Could not read file for path " << path_.value();
+        err = Z_ERRNO;
+        break;
+      }
+      if (num_bytes == 0)
+        flush = Z_FINISH;
+      crc_ = crc32(crc_, reinterpret_cast<const Bytef*>(buf), num_bytes);
+      uncompressed_size_ += num_bytes;
+
+      stream.next_in = reinterpret_cast<Bytef*>(buf);
+      stream.avail_in = num_bytes;
+      do {
+        stream.next_out = reinterpret_cast<Bytef*>(out);
+        stream.avail_out = sizeof(out);
+        err = deflate(&stream, flush);
+        if (!Store(out, static_cast<int>(sizeof(out) - stream.avail_out)))
+          err = Z_ERRNO;
+      } while (err == Z_OK && (stream.avail_out == 0 || flush == Z_FINISH));
+      // Z_BUF_ERROR only means the last call had nothing left to do.
+      if (err != Z_OK && err != Z_BUF_ERROR && err != Z_STREAM_END)
+        break;
+    }
+    deflateEnd(&stream);
+    return err == Z_STREAM_END;
+  }
+
+  const base::FilePath path_;
+  const int64_t size_;
+
+  zip_fileinfo file_info_;
+  // The compressed data, unless it is in |spill_file_|.
+  std::string compressed_;
+  base::FilePath spill_path_;
+  base::File spill_file_;
+  uLong crc_;
+  int64_t uncompressed_size_;
+  int64_t compressed_size_;
+  bool success_;
+  base::WaitableEvent done_;
+
+  DISALLOW_COPY_AND_ASSIGN(FileCompressor);
+};
+
+// Stores the file deflated by |file| as the next entry of |zip_file|.
+bool AddCompressedEntryToZip(zipFile zip_file,
+                             FileCompressor* file,
+                             const base::FilePath& root_path) {
+  if (!file->success())
+    return false;
+
+  std::string str_path = GetEntryName(file->path(), root_path, false);
+  if (!zip::internal::ZipOpenNewRawFileInZip(
+          zip_file, str_path, &file->file_info(),
+          std::max(file->uncompressed_size(), file->compressed_size()))) {
+    return false;
+  }
+
+  bool success = true;
+  if (!file->WriteCompressed(zip_file)) {
+    DLOG(ERROR) << "Could not write data to zip for path "
+                << file->path().value();
+    success = false;
+  }
+
+  if (ZIP_OK != zipCloseFileInZipRaw64(zip_file, file->uncompressed_size(),
+                                       file->crc())) {
+    DLOG(ERROR) << "Could not close zip file entry " << str_path;
+    return false;
+  }
+
+  return success;
+}
+
+// Extracts the files of a zip archive for ParallelUnzip(), taking the next
+// entry from |next_entry| until there are none left. Each worker reads the
+// archive through its own ZipReader, and so its own file position.
+class UnzipWorker : public base::DelegateSimpleThread::Delegate {
+ public:
+  UnzipWorker(const base::FilePath& src_file,
+              const base::FilePath& dest_dir,
+              const std::vector<unz_file_pos>& entries,
+              base::AtomicSequenceNumber* next_entry,
+              base::subtle::Atomic32* failed)
+      : src_file_(src_file),
+        dest_dir_(dest_dir),
+        entries_(entries),
+        next_entry_(next_entry),
+        failed_(failed) {}
+
+  // base::DelegateSimpleThread::Delegate:
+  void Run() override {
+    zip::ZipReader reader;
+    if (!reader.Open(src_file_)) {
+      DLOG(WARNING) << "Failed to open " << src_file_.value();
+      base::subtle::NoBarrier_Store(failed_, 1);
+      return;
+    }
+    while (!base::subtle::NoBarrier_Load(failed_)) {
+      const size_t index = static_cast<size_t>(next_entry_->GetNext());
+      if (index >= entries_.size())
+        return;
+      if (!reader.OpenEntryAtPosition(entries_[index])) {
+        DLOG(WARNING) << "Failed to open entry " << index << " in zip";
+        base::subtle::NoBarrier_Store(failed_, 1);
+        return;
+      }
+      if (!reader.ExtractCurrentEntryIntoDirectory(dest_dir_)) {
+        DLOG(WARNING) << "Failed to extract "
+                      << reader.current_entry_info()->file_path().value();
+        base::subtle::NoBarrier_Store(failed_, 1);
+        return;
+      }
+    }
+  }
+
+ private:
+  const base::FilePath& src_file_;
+  const base::FilePath& dest_dir_;
+  const std::vector<unz_file_pos>& entries_;
+  base::AtomicSequenceNumber* next_entry_;
+  base::subtle::Atomic32* failed_;
+
+  DISALLOW_COPY_AND_ASSIGN(UnzipWorker);
+};
+
+// Orders the files for ParallelUnzip() by decreasing size, so that a large
+// entry doesn't start last and hold up the other threads' finish.
+bool IsLargerEntry(const std::pair<int64_t, unz_file_pos>& a,
+                   const std::pair<int64_t, unz_file_pos>& b) {
+  return a.first > b.first;
+}
+
 bool ExcludeNoFilesFilter(const base::FilePath& file_path) {
   return true;
 }
@@ -122,6 +424,87 @@ bool Unzip(const base::FilePath& src_file, const base::FilePath& dest_dir) {
   return true;
 }
 
+bool ParallelUnzip(const base::FilePath& src_file,
+                   const base::FilePath& dest_dir,
+                   int num_threads) {
+  // Check every entry and create the directories before extracting anything,
+  // remembering where the files are for the worker threads. Of the files with
+  // the same path only the last is kept, which is the one Unzip() leaves, so
+  // that no two threads write the same file.
+  std::vector<std::pair<int64_t, unz_file_pos>> files;
+  std::map<base::FilePath, size_t> file_indexes;
+  {
+    ZipReader reader;
+    if (!reader.Open(src_file)) {
+      DLOG(WARNING) << "Failed to open " << src_file.value();
+      return false;
+    }
+    while (reader.HasMore()) {
+      if (!reader.OpenCurrentEntryInZip()) {
+        DLOG(WARNING) << "Failed to open the current file in zip";
+        return false;
+      }
+      const ZipReader::EntryInfo* entry_info = reader.current_entry_info();
+      if (entry_info->is_unsafe()) {
+        DLOG(WARNING) << "Found an unsafe file in zip "
+                      << entry_info->file_path().value();
+        return false;
+      }
+      if (entry_info->is_directory()) {
+        if (!reader.ExtractCurrentEntryIntoDirectory(dest_dir)) {
+          DLOG(WARNING) << "Failed to extract "
+                        << entry_info->file_path().value();
+          return false;
+        }
+      } else {
+        unz_file_pos position = {};
+        if (!reader.GetCurrentEntryPosition(&position)) {
+          DLOG(WARNING) << "Failed to get the position of the current file";
+          return false;
+        }
+        auto file = std::make_pair(entry_info->original_size(), position);
+        auto inserted = file_indexes.insert(
+            std::make_pair(entry_info->file_path(), files.size()));
+        if (inserted.second)
+          files.push_back(file);
+        else
+          files[inserted.first->second] = file;
+      }
+      if (!reader.AdvanceToNextEntry()) {
+        DLOG(WARNING) << "Failed to advance to the next file";
+        return false;
+      }
+    }
+  }
+
+  std::stable_sort(files.begin(), files.end(), IsLargerEntry);
+  std::vector<unz_file_pos> entries;
+  entries.reserve(files.size());
+  for (const auto& file : files)
+    entries.push_back(file.second);
+
+  base::AtomicSequenceNumber next_entry;
+  base::subtle::Atomic32 failed = 0;
+  num_threads = std::min(GetNumWorkerThreads(num_threads),
+                         static_cast<int>(entries.size()));
+  std::vector<std::unique_ptr<UnzipWorker>> workers;
+  for (int i = 0; i < std::max(num_threads, 1); ++i) {
+    workers.push_back(std::unique_ptr<UnzipWorker>(
+        new UnzipWorker(src_file, dest_dir, entries, &next_entry, &failed)));
+  }
+
+  if (num_threads <= 1) {
+    workers[0]->Run();
+  } else {
+    base::DelegateSimpleThreadPool pool("ParallelUnzip", num_threads);
+    for (const auto& worker : workers)
+      pool.AddWork(worker.get(), 1);
+    pool.Start();
+    pool.JoinAll();
+  }
+  return !base::subtle::NoBarrier_Load(&failed);
+}
+
 bool ZipWithFilterCallback(const base::FilePath& src_dir,
                            const base::FilePath& dest_file,
                            const FilterCallback& filter_cb) {
@@ -158,6 +541,81 @@ bool ZipWithFilterCallback(const base::FilePath& src_dir,
   return success;
 }
 
+bool ParallelZipWithFilterCallback(const base::FilePath& src_dir,
+                                   const base::FilePath& dest_file,
+                                   const FilterCallback& filter_cb,
+                                   int num_threads) {
+  DCHECK(base::DirectoryExists(src_dir));
+
+  // Directories are written by the calling thread and have no compressor.
+  std::vector<base::FilePath> paths;
+  std::vector<std::unique_ptr<FileCompressor>> files;
+  base::FileEnumerator file_enumerator(src_dir, true /* recursive */,
+      base::FileEnumerator::FILES | base::FileEnumerator::DIRECTORIES);
+  for (base::FilePath path = file_enumerator.Next(); !path.value().empty();
+       path = file_enumerator.Next()) {
+    if (!filter_cb.Run(path))
+      continue;
+
+    const base::FileEnumerator::FileInfo info = file_enumerator.GetInfo();
+    paths.push_back(path);
+    files.push_back(std::unique_ptr<FileCompressor>(
+        info.IsDirectory() ? nullptr
+                           : new FileCompressor(path, info.GetSize())));
+  }
+
+  zipFile zip_file = internal::OpenForZipping(dest_file.AsUTF8Unsafe(),
+                                              APPEND_STATUS_CREATE);
+
+  if (!zip_file) {
+    DLOG(WARNING) << "couldn't create file " << dest_file.value();
+    return false;
+  }
+
+  base::DelegateSimpleThreadPool pool("ParallelZip",
+                                      GetNumWorkerThreads(num_threads));
+  pool.Start();
+
+  bool success = true;
+  size_t next_to_compress = 0;
+  int64_t buffered_bytes = 0;
+  for (size_t i = 0; i < paths.size(); ++i) {
+    // Keep the pool fed up to the budget, and always with entry |i| itself.
+    for (; next_to_compress < paths.size() &&
+           (next_to_compress <= i ||
+            buffered_bytes < kParallelZipMaxBufferedBytes);
+         ++next_to_compress) {
+      FileCompressor* file = files[next_to_compress].get();
+      if (file) {
+        pool.AddWork(file, 1);
+        buffered_bytes += file->size();
+      }
+    }
+
+    if (!files[i]) {
+      success = AddEntryToZip(zip_file, paths[i], src_dir);
+    } else {
+      files[i]->Wait();
+      success = AddCompressedEntryToZip(zip_file, files[i].get(), src_dir);
+      buffered_bytes -= files[i]->size();
+      files[i]->DiscardCompressed();
+    }
+    if (!success)
+      break;
+  }
+
+  // Lets queued work, if any after a failure, drain before the compressors go
+  // away.
+  pool.JoinAll();
+
+  if (ZIP_OK != zipClose(zip_file, NULL)) {
+    DLOG(ERROR) << "Error closing zip file " << dest_file.value();
+    return false;
+  }
+
+  return success;
+}
+
 bool Zip(const base::FilePath& src_dir, const base::FilePath& dest_file,
          bool include_hidden_files) {
   if (include_hidden_files) {
@@ -28,6 +28,7 @@
       'type': 'static_library',
       'dependencies': [
         '../zlib.gyp:zlib',
+        '../../../base/base.gyp:base',
       ],
       'include_dirs': [
         '../../..',
@@ -23,6 +23,18 @@ bool ZipWithFilterCallback(const base::FilePath& src_dir,
                            const base::FilePath& dest_file,
                            const FilterCallback& filter_cb);
 
+// Like ZipWithFilterCallback(), but reads and deflates the files on
+// |num_threads| worker threads (zero means one per processor) while the
+// calling thread writes the finished entries, in the same order, with their
+// headers and the central directory. The entries waiting to be written are
+// held compressed, up to a fixed budget of source bytes: in memory for small
+// files and in temporary files for larger ones. Entries of 4 GiB or more are
+// written with the zip64 extensions.
+bool ParallelZipWithFilterCallback(const base::FilePath& src_dir,
+                                   const base::FilePath& dest_file,
+                                   const FilterCallback& filter_cb,
+                                   int num_threads);
+
 // Convenience method for callers who don't need to set up the filter callback.
 // If |include_hidden_files| is true, files starting with "." are included.
 // Otherwise they are omitted.
@@ -43,6 +55,15 @@ bool ZipFiles(const base::FilePath& src_dir,
 // Unzip the contents of zip_file into dest_dir.
 bool Unzip(const base::FilePath& zip_file, const base::FilePath& dest_dir);
 
+// Like Unzip(), but extracts the files on |num_threads| worker threads (zero
+// means one per processor). The central directory is read once up front, so
+// unlike Unzip() nothing is written if any entry is unsafe. Each thread then
+// reads the zip file through its own handle, largest entries first. Of
+// several files with the same path, only the last is extracted.
+bool ParallelUnzip(const base::FilePath& zip_file,
+                   const base::FilePath& dest_dir,
+                   int num_threads);
+
 }  // namespace zip
 
 #endif  // THIRD_PARTY_ZLIB_GOOGLE_ZIP_H_
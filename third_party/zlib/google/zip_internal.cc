@@ -241,6 +241,45 @@ int GetErrorOfZipBuffer(void* /*opaque*/, void* /*stream*/) {
   return 0;
 }
 
+// The 64-bit I/O API functions used by PrepareMappedMemoryForUnzipping(). The
+// offsets of zip archives over 4 GiB don't fit in the uLong that the 32-bit
+// functions above use on some platforms.
+void* OpenZipBuffer64(void* opaque, const void* /*filename*/, int mode) {
+  return OpenZipBuffer(opaque, NULL, mode);
+}
+
+ZPOS64_T GetOffsetOfZipBuffer64(void* opaque, void* /*stream*/) {
+  ZipBuffer* buffer = static_cast<ZipBuffer*>(opaque);
+  if (!buffer)
+    return static_cast<ZPOS64_T>(-1);
+  return buffer->offset;
+}
+
+long SeekZipBuffer64(void* opaque,
+                     void* /*stream*/,
+                     ZPOS64_T offset,
+                     int origin) {
+  ZipBuffer* buffer = static_cast<ZipBuffer*>(opaque);
+  if (!buffer)
+    return -1;
+  const ZPOS64_T length = buffer->length;
+  if (origin == ZLIB_FILEFUNC_SEEK_CUR) {
+    buffer->offset = static_cast<size_t>(
+        std::min(buffer->offset + offset, length));
+    return 0;
+  }
+  if (origin == ZLIB_FILEFUNC_SEEK_END) {
+    buffer->offset = static_cast<size_t>(length > offset ? length - offset : 0);
+    return 0;
+  }
+  if (origin == ZLIB_FILEFUNC_SEEK_SET) {
+    buffer->offset = static_cast<size_t>(std::min(length, offset));
+    return 0;
+  }
+  NOTREACHED();
+  return -1;
+}
+
 // Returns a zip_fileinfo struct with the time represented by |file_time|.
 zip_fileinfo TimeToZipFileInfo(const base::Time& file_time) {
   base::Time::Exploded file_time_parts;
@@ -263,6 +302,45 @@ zip_fileinfo TimeToZipFileInfo(const base::Time& file_time) {
 
   return zip_info;
 }
+
+// Wrapper around zipOpenNewFileInZip4_64 shared by ZipOpenNewFileInZip() and
+// ZipOpenNewRawFileInZip(). The zip64 extra field is only added to the local
+// header of entries of |size| bytes or more than minizip can store without it.
+bool OpenNewFileInZip(zipFile zip_file,
+                      const std::string& str_path,
+                      const zip_fileinfo* file_info,
+                      int64_t size,
+                      int raw) {
+  // Section 4.4.4 http://www.pkware.com/documents/casestudies/APPNOTE.TXT
+  // Setting the Language encoding flag so the file is told to be in utf-8.
+  const uLong LANGUAGE_ENCODING_FLAG = 0x1 << 11;
+
+  if (ZIP_OK != zipOpenNewFileInZip4_64(
+                    zip_file,  // file
+                    str_path.c_str(),  // filename
+                    file_info,  // zipfi
+                    NULL,  // extrafield_local,
+                    0u,  // size_extrafield_local
+                    NULL,  // extrafield_global
+                    0u,  // size_extrafield_global
+                    NULL,  // comment
+                    Z_DEFLATED,  // method
+                    Z_DEFAULT_COMPRESSION,  // level
+                    raw,  // raw
+                    -MAX_WBITS,  // windowBits
+                    DEF_MEM_LEVEL,  // memLevel
+                    Z_DEFAULT_STRATEGY,  // strategy
+                    NULL,  // password
+                    0,  // crcForCrypting
+                    0,  // versionMadeBy
+                    LANGUAGE_ENCODING_FLAG,  // flagBase
+                    size >= zip::internal::kZip64MinSize)) {  // zip64
+    DLOG(ERROR) << "Could not open zip file entry " << str_path;
+    return false;
+  }
+  return true;
+}
+
 }  // namespace
 
 namespace zip {
@@ -323,6 +401,29 @@ unzFile PrepareMemoryForUnzipping(const std::string& data) {
   return unzOpen2(NULL, &zip_functions);
 }
 
+unzFile PrepareMappedMemoryForUnzipping(const uint8_t* data, size_t length) {
+  if (!data || !length)
+    return NULL;
+
+  ZipBuffer* buffer = static_cast<ZipBuffer*>(malloc(sizeof(ZipBuffer)));
+  if (!buffer)
+    return NULL;
+  buffer->data = reinterpret_cast<const char*>(data);
+  buffer->length = length;
+  buffer->offset = 0;
+
+  zlib_filefunc64_def zip_functions;
+  zip_functions.zopen64_file = OpenZipBuffer64;
+  zip_functions.zread_file = ReadZipBuffer;
+  zip_functions.zwrite_file = WriteZipBuffer;
+  zip_functions.ztell64_file = GetOffsetOfZipBuffer64;
+  zip_functions.zseek64_file = SeekZipBuffer64;
+  zip_functions.zclose_file = CloseZipBuffer;
+  zip_functions.zerror_file = GetErrorOfZipBuffer;
+  zip_functions.opaque = static_cast<void*>(buffer);
+  return unzOpen2_64(NULL, &zip_functions);
+}
+
 zipFile OpenForZipping(const std::string& file_name_utf8, int append_flag) {
   zlib_filefunc_def* zip_func_ptrs = NULL;
 #if defined(OS_WIN)
@@ -356,34 +457,16 @@ zip_fileinfo GetFileInfoForZipping(const base::FilePath& path) {
 
 bool ZipOpenNewFileInZip(zipFile zip_file,
                          const std::string& str_path,
-                         const zip_fileinfo* file_info) {
-  // Section 4.4.4 http://www.pkware.com/documents/casestudies/APPNOTE.TXT
-  // Setting the Language encoding flag so the file is told to be in utf-8.
-  const uLong LANGUAGE_ENCODING_FLAG = 0x1 << 11;
+                         const zip_fileinfo* file_info,
+                         int64_t size) {
+  return OpenNewFileInZip(zip_file, str_path, file_info, size, 0);
+}
 
-  if (ZIP_OK != zipOpenNewFileInZip4(
-                    zip_file,  // file
-                    str_path.c_str(),  // filename
-                    file_info,  // zipfi
-                    NULL,  // extrafield_local,
-                    0u,  // size_extrafield_local
-                    NULL,  // extrafield_global
-                    0u,  // size_extrafield_global
-                    NULL,  // comment
-                    Z_DEFLATED,  // method
-                    Z_DEFAULT_COMPRESSION,  // level
-                    0,  // raw
-                    -MAX_WBITS,  // windowBits
-                    DEF_MEM_LEVEL,  // memLevel
-                    Z_DEFAULT_STRATEGY,  // strategy
-                    NULL,  // password
-                    0,  // crcForCrypting
-                    0,  // versionMadeBy
-                    LANGUAGE_ENCODING_FLAG)) {  // flagBase
-    DLOG(ERROR) << "Could not open zip file entry " << str_path;
-    return false;
-  }
-  return true;
+bool ZipOpenNewRawFileInZip(zipFile zip_file,
+                            const std::string& str_path,
+                            const zip_fileinfo* file_info,
+                            int64_t size) {
+  return OpenNewFileInZip(zip_file, str_path, file_info, size, 1);
 }
 
 }  // namespace internal
@@ -5,6 +5,9 @@
 #ifndef THIRD_PARTY_ZLIB_GOOGLE_ZIP_INTERNAL_H_
 #define THIRD_PARTY_ZLIB_GOOGLE_ZIP_INTERNAL_H_
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include <string>
 
 #include "build/build_config.h"
@@ -49,6 +52,11 @@ unzFile OpenHandleForUnzipping(HANDLE zip_handle);
 // read data from the specified string.
 unzFile PrepareMemoryForUnzipping(const std::string& data);
 
+// Like PrepareMemoryForUnzipping(), but reads the |length| bytes at |data|,
+// typically a memory-mapped zip file, through minizip's 64-bit I/O API so
+// that archives over 4 GiB work too. |data| must outlive the unzFile.
+unzFile PrepareMappedMemoryForUnzipping(const uint8_t* data, size_t length);
+
 // Opens the given file name in UTF-8 for zipping, with some setup for
 // Windows. |append_flag| will be passed to zipOpen2().
 zipFile OpenForZipping(const std::string& file_name_utf8, int append_flag);
@@ -62,14 +70,28 @@ zipFile OpenFdForZipping(int zip_fd, int append_flag);
 // Returns a zip_fileinfo with the last modification date of |path| set.
 zip_fileinfo GetFileInfoForZipping(const base::FilePath& path);
 
-// Wrapper around zipOpenNewFileInZip4 which passes most common options.
+// Wrapper around zipOpenNewFileInZip4_64 which passes most common options.
+// |size| is the larger of the expected uncompressed and compressed sizes of
+// the entry; from kZip64MinSize bytes on, the entry is opened for zip64.
 bool ZipOpenNewFileInZip(zipFile zip_file,
                          const std::string& str_path,
-                         const zip_fileinfo* file_info);
+                         const zip_fileinfo* file_info,
+                         int64_t size);
+
+// Like ZipOpenNewFileInZip(), but opens the entry in raw mode: the caller
+// writes data it has already deflated with -MAX_WBITS and must close the entry
+// with zipCloseFileInZipRaw64(), passing the uncompressed size and CRC.
+bool ZipOpenNewRawFileInZip(zipFile zip_file,
+                            const std::string& str_path,
+                            const zip_fileinfo* file_info,
+                            int64_t size);
 
 const int kZipMaxPath = 256;
 const int kZipBufSize = 8192;
 
+// The smallest entry size that needs the zip64 extensions.
+const int64_t kZip64MinSize = 0xffffffff;
+
 }  // namespace internal
 }  // namespace zip
 
@@ -4,10 +4,15 @@
 
 #include "third_party/zlib/google/zip_reader.h"
 
+#include <string.h>
+
+#include <algorithm>
+#include <limits>
 #include <utility>
 
 #include "base/bind.h"
 #include "base/files/file.h"
+#include "base/files/memory_mapped_file.h"
 #include "base/logging.h"
 #include "base/macros.h"
 #include "base/message_loop/message_loop.h"
@@ -123,6 +128,57 @@ bool StringWriterDelegate::WriteBytes(const char* data, int num_bytes) {
   return true;
 }
 
+// Largest amount of data handed to zlib or minizip in one call.
+const size_t kMaxChunkSize = 1 << 30;
+
+// Returns the CRC-32 of the |size| bytes at |data|.
+uLong Crc32(const char* data, size_t size) {
+  uLong crc = crc32(0L, Z_NULL, 0);
+  while (size > 0) {
+    const size_t chunk_size = std::min(size, kMaxChunkSize);
+    crc = crc32(crc, reinterpret_cast<const Bytef*>(data),
+                static_cast<uInt>(chunk_size));
+    data += chunk_size;
+    size -= chunk_size;
+  }
+  return crc;
+}
+
+// Inflates the raw deflate data in |input| into the |output_size| bytes at
+// |output|, and sets |size| to the number of bytes written. Returns false if
+// the data is corrupt or doesn't fit.
+bool InflateToBuffer(const base::StringPiece& input,
+                     char* output,
+                     size_t output_size,
+                     size_t* size) {
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  if (inflateInit2(&stream, -MAX_WBITS) != Z_OK)
+    return false;
+
+  stream.next_in =
+      reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+  stream.next_out = reinterpret_cast<Bytef*>(output);
+  size_t input_left = input.size();
+  size_t output_left = output_size;
+  int result = Z_OK;
+  do {
+    const uInt avail_in =
+        static_cast<uInt>(std::min(input_left, kMaxChunkSize));
+    const uInt avail_out =
+        static_cast<uInt>(std::min(output_left, kMaxChunkSize));
+    stream.avail_in = avail_in;
+    stream.avail_out = avail_out;
+    result = inflate(&stream, Z_NO_FLUSH);
+    input_left -= avail_in - stream.avail_in;
+    output_left -= avail_out - stream.avail_out;
+  } while (result == Z_OK);
+  inflateEnd(&stream);
+
+  *size = output_size - output_left;
+  return result == Z_STREAM_END;
+}
+
 }  // namespace
 
 // TODO(satorux): The implementation assumes that file names in zip files
@@ -211,10 +267,29 @@ bool ZipReader::OpenFromPlatformFile(base::PlatformFile zip_fd) {
   return OpenInternal();
 }
 
+bool ZipReader::OpenMapped(const base::FilePath& zip_file_path) {
+  DCHECK(!zip_file_);
+
+  scoped_ptr<base::MemoryMappedFile> mapped_file(new base::MemoryMappedFile);
+  if (!mapped_file->Initialize(zip_file_path))
+    return false;
+
+  zip_file_ = internal::PrepareMappedMemoryForUnzipping(mapped_file->data(),
+                                                        mapped_file->length());
+  if (!zip_file_)
+    return false;
+
+  mapped_file_ = std::move(mapped_file);
+  memory_.set(reinterpret_cast<const char*>(mapped_file_->data()),
+              mapped_file_->length());
+  return OpenInternal();
+}
+
 bool ZipReader::OpenFromString(const std::string& data) {
   zip_file_ = internal::PrepareMemoryForUnzipping(data);
   if (!zip_file_)
     return false;
+  memory_ = data;
   return OpenInternal();
 }
 
@@ -292,6 +367,24 @@ bool ZipReader::LocateAndOpenEntry(const base::FilePath& path_in_zip) {
   return OpenCurrentEntryInZip();
 }
 
+bool ZipReader::GetCurrentEntryPosition(unz_file_pos* position) const {
+  DCHECK(zip_file_);
+
+  return unzGetFilePos(zip_file_, position) == UNZ_OK;
+}
+
+bool ZipReader::OpenEntryAtPosition(const unz_file_pos& position) {
+  DCHECK(zip_file_);
+
+  current_entry_info_.reset();
+  reached_end_ = false;
+  unz_file_pos mutable_position = position;
+  if (unzGoToFilePos(zip_file_, &mutable_position) != UNZ_OK)
+    return false;
+
+  return OpenCurrentEntryInZip();
+}
+
 bool ZipReader::ExtractCurrentEntry(WriterDelegate* delegate) const {
   DCHECK(zip_file_);
 
@@ -449,6 +542,114 @@ bool ZipReader::ExtractCurrentEntryToString(size_t max_read_bytes,
   return true;
 }
 
+bool ZipReader::ExtractCurrentEntryToBuffer(char* buffer,
+                                            size_t buffer_size,
+                                            size_t* output_size) const {
+  DCHECK(zip_file_);
+  DCHECK(current_entry_info_.get());
+
+  if (current_entry_info()->is_directory())
+    return false;
+
+  base::StringPiece data;
+  int method = 0;
+  uLong expected_crc = 0;
+  if (GetCurrentEntryRawData(&data, &method, &expected_crc) &&
+      (method == 0 || method == Z_DEFLATED)) {
+    size_t size = 0;
+    if (method == Z_DEFLATED) {
+      if (!InflateToBuffer(data, buffer, buffer_size, &size))
+        return false;
+    } else {
+      if (data.size() > buffer_size)
+        return false;
+      memcpy(buffer, data.data(), data.size());
+      size = data.size();
+    }
+    if (Crc32(buffer, size) != expected_crc) {
+      DLOG(WARNING) << "CRC mismatch in "
+                    << current_entry_info()->file_path().value();
+      return false;
+    }
+    *output_size = size;
+    return true;
+  }
+
+  // Otherwise read the entry through minizip, asking for a byte more than
+  // fits so that an entry larger than |buffer| is noticed.
+  if (unzOpenCurrentFile(zip_file_) != UNZ_OK)
+    return false;
+
+  bool success = true;
+  size_t size = 0;
+  while (true) {
+    char overflow;
+    const bool full = size == buffer_size;
+    const int num_bytes_read = unzReadCurrentFile(
+        zip_file_, full ? &overflow : buffer + size,
+        full ? 1u : static_cast<unsigned>(
+                        std::min(buffer_size - size, kMaxChunkSize)));
+    if (num_bytes_read == 0)
+      break;
+    if (num_bytes_read < 0 || full) {
+      success = false;
+      break;
+    }
+    size += num_bytes_read;
+  }
+
+  // Checks the CRC, once the whole entry has been read.
+  if (unzCloseCurrentFile(zip_file_) != UNZ_OK)
+    success = false;
+  if (success)
+    *output_size = size;
+  return success;
+}
+
+bool ZipReader::GetCurrentEntryStoredData(base::StringPiece* data) const {
+  DCHECK(zip_file_);
+  DCHECK(current_entry_info_.get());
+
+  int method = 0;
+  uLong crc = 0;
+  return !current_entry_info()->is_directory() &&
+         GetCurrentEntryRawData(data, &method, &crc) && method == 0;
+}
+
+bool ZipReader::GetCurrentEntryRawData(base::StringPiece* data,
+                                       int* method,
+                                       uLong* crc) const {
+  if (memory_.empty())
+    return false;
+
+  unz_file_info64 raw_file_info = {};
+  if (unzGetCurrentFileInfo64(zip_file_, &raw_file_info, NULL, 0, NULL, 0,
+                              NULL, 0) != UNZ_OK) {
+    return false;
+  }
+  // Bit 0 of the general purpose flags marks encrypted entries, which only
+  // minizip can read.
+  if (raw_file_info.flag & 1)
+    return false;
+
+  // Opening the entry in raw mode parses its local header, which gives the
+  // offset of its data; nothing is read or inflated.
+  int level = 0;
+  if (unzOpenCurrentFile2(zip_file_, method, &level, 1 /* raw */) != UNZ_OK)
+    return false;
+  const ZPOS64_T offset = unzGetCurrentFileZStreamPos64(zip_file_);
+  unzCloseCurrentFile(zip_file_);
+
+  if (offset == 0 || offset > memory_.size() ||
+      raw_file_info.compressed_size > memory_.size() - offset) {
+    return false;
+  }
+  *data = memory_.substr(static_cast<size_t>(offset),
+                         static_cast<size_t>(raw_file_info.compressed_size));
+  *crc = raw_file_info.crc;
+  return true;
+}
+
 bool ZipReader::OpenInternal() {
   DCHECK(zip_file_);
 
@@ -470,6 +671,8 @@ void ZipReader::Reset() {
   num_entries_ = 0;
   reached_end_ = false;
   current_entry_info_.reset();
+  memory_.clear();
+  mapped_file_.reset();
 }
 
 void ZipReader::ExtractChunk(base::File output_file,
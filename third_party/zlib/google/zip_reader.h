@@ -16,6 +16,7 @@
 #include "base/macros.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/memory/weak_ptr.h"
+#include "base/strings/string_piece.h"
 #include "base/time/time.h"
 
 #if defined(USE_SYSTEM_MINIZIP)
@@ -24,6 +25,10 @@
 #include "third_party/zlib/contrib/minizip/unzip.h"
 #endif
 
+namespace base {
+class MemoryMappedFile;
+}
+
 namespace zip {
 
 // A delegate interface used to stream out an entry; see
@@ -124,6 +129,13 @@ class ZipReader {
   // taking ownership of |zip_fd|. Returns true on success.
   bool OpenFromPlatformFile(base::PlatformFile zip_fd);
 
+  // Opens the zip file specified by |zip_file_path| by mapping it into
+  // memory. Returns true on success. minizip then reads the zip file from the
+  // mapping rather than through stdio, and ExtractCurrentEntryToBuffer() and
+  // GetCurrentEntryStoredData() can read entries without copying them through
+  // intermediate buffers.
+  bool OpenMapped(const base::FilePath& zip_file_path);
+
   // Opens the zip data stored in |data|. This class uses a weak reference to
   // the given sring while extracting files, i.e. the caller should keep the
   // string until it finishes extracting files.
@@ -159,6 +171,18 @@ class ZipReader {
   // success. On failure, current_entry_info() becomes NULL.
   bool LocateAndOpenEntry(const base::FilePath& path_in_zip);
 
+  // Gets the position of the current entry in the central directory. Returns
+  // true on success. The position stays valid for any ZipReader opened on the
+  // same zip file, so the entries found by one scan of the archive can be
+  // shared out between several readers.
+  bool GetCurrentEntryPosition(unz_file_pos* position) const;
+
+  // Moves to the entry at |position|, as returned by GetCurrentEntryPosition(),
+  // and opens it. Returns true on success. Unlike LocateAndOpenEntry(), this
+  // does not scan the central directory. On failure, current_entry_info()
+  // becomes NULL.
+  bool OpenEntryAtPosition(const unz_file_pos& position);
+
   // Extracts the current entry in chunks to |delegate|.
   bool ExtractCurrentEntry(WriterDelegate* delegate) const;
 
@@ -217,6 +241,25 @@ class ZipReader {
       size_t max_read_bytes,
       std::string* output) const;
 
+  // Extracts the current entry into |buffer|, which holds |buffer_size| bytes,
+  // and sets |output_size| to the number of bytes written. Returns false if
+  // the entry is a directory, doesn't fit in |buffer| or fails its CRC check.
+  // If the zip file is in memory (see OpenMapped() and OpenFromString()), the
+  // entry is inflated straight from there into |buffer|. As with
+  // ExtractCurrentEntryToString(), original_size() is only a hint for the
+  // size of |buffer|. OpenCurrentEntryInZip() must be called beforehand.
+  bool ExtractCurrentEntryToBuffer(char* buffer,
+                                   size_t buffer_size,
+                                   size_t* output_size) const;
+
+  // If the zip file is in memory (see OpenMapped() and OpenFromString()) and
+  // the current entry is stored without compression, points |data| at the
+  // contents of the entry inside the zip file and returns true. Nothing is
+  // copied, nor checked against the CRC of the entry. |data| stays valid until
+  // the zip file is closed. Returns false for other entries.
+  // OpenCurrentEntryInZip() must be called beforehand.
+  bool GetCurrentEntryStoredData(base::StringPiece* data) const;
+
   // Returns the current entry info. Returns NULL if the current entry is
   // not yet opened. OpenCurrentEntryInZip() must be called beforehand.
   EntryInfo* current_entry_info() const {
@@ -234,6 +277,13 @@ class ZipReader {
   // Resets the internal state.
   void Reset();
 
+  // Finds the compressed data of the current entry in |memory_|, and sets
+  // |method| to its compression method and |crc| to its CRC. Returns false if
+  // the zip file is not in memory or the entry is encrypted.
+  bool GetCurrentEntryRawData(base::StringPiece* data,
+                              int* method,
+                              uLong* crc) const;
+
   // Extracts a chunk of the file to the target.  Will post a task for the next
   // chunk and success/failure/progress callbacks as necessary.
   void ExtractChunk(base::File target_file,
@@ -246,6 +296,10 @@ class ZipReader {
   int num_entries_;
   bool reached_end_;
   scoped_ptr<EntryInfo> current_entry_info_;
+  // The mapping made by OpenMapped(), if any.
+  scoped_ptr<base::MemoryMappedFile> mapped_file_;
+  // The whole zip file when it is in memory, or empty.
+  base::StringPiece memory_;
 
   base::WeakPtrFactory<ZipReader> weak_ptr_factory_;
 
@@ -20,6 +20,7 @@
 #include "base/md5.h"
 #include "base/path_service.h"
 #include "base/run_loop.h"
+#include "base/strings/string_piece.h"
 #include "base/strings/stringprintf.h"
 #include "base/strings/utf_string_conversions.h"
 #include "base/time/time.h"
@@ -587,6 +588,131 @@ TEST_F(ZipReaderTest, ExtractCurrentEntryToString) {
   reader.Close();
 }
 
+// Verifies that entries are inflated straight from a mapped zip file into the
+// caller's buffer, and only if they fit.
+TEST_F(ZipReaderTest, OpenMapped_ExtractCurrentEntryToBuffer) {
+  ZipReader reader;
+  ASSERT_TRUE(reader.OpenMapped(test_zip_file_));
+  base::FilePath target_path(FILE_PATH_LITERAL("foo/bar/quux.txt"));
+  ASSERT_TRUE(reader.LocateAndOpenEntry(target_path));
+
+  std::string contents(
+      static_cast<size_t>(reader.current_entry_info()->original_size()), '\0');
+  size_t size = 0;
+  ASSERT_TRUE(reader.ExtractCurrentEntryToBuffer(&contents[0], contents.size(),
+                                                 &size));
+  EXPECT_EQ(contents.size(), size);
+  EXPECT_EQ(kQuuxExpectedMD5, base::MD5String(contents));
+
+  EXPECT_FALSE(reader.ExtractCurrentEntryToBuffer(
+      &contents[0], contents.size() - 1, &size));
+
+  // The entry is deflated, so there is no stored data to point at.
+  base::StringPiece data;
+  EXPECT_FALSE(reader.GetCurrentEntryStoredData(&data));
+}
+
+// Verifies that ExtractCurrentEntryToBuffer() also works through minizip's
+// I/O when the zip file isn't in memory.
+TEST_F(ZipReaderTest, ExtractCurrentEntryToBuffer) {
+  ZipReader reader;
+  ASSERT_TRUE(reader.Open(test_zip_file_));
+  base::FilePath target_path(FILE_PATH_LITERAL("foo/bar/quux.txt"));
+  ASSERT_TRUE(reader.LocateAndOpenEntry(target_path));
+
+  std::string contents(
+      static_cast<size_t>(reader.current_entry_info()->original_size()), '\0');
+  size_t size = 0;
+  ASSERT_TRUE(reader.ExtractCurrentEntryToBuffer(&contents[0], contents.size(),
+                                                 &size));
+  EXPECT_EQ(contents.size(), size);
+  EXPECT_EQ(kQuuxExpectedMD5, base::MD5String(contents));
+
+  ASSERT_TRUE(reader.LocateAndOpenEntry(target_path));
+  EXPECT_FALSE(reader.ExtractCurrentEntryToBuffer(
+      &contents[0], contents.size() - 1, &size));
+
+  base::StringPiece data;
+  EXPECT_FALSE(reader.GetCurrentEntryStoredData(&data));
+}
+
+// Verifies that a mapped zip file does not rely on the uncompressed sizes
+// recorded in it. See ExtractCurrentEntryToString.
+TEST_F(ZipReaderTest, OpenMapped_ExtractCurrentEntryToBufferIncorrectSize) {
+  base::FilePath test_zip_file =
+      test_data_dir_.AppendASCII("test_mismatch_size.zip");
+
+  ZipReader reader;
+  ASSERT_TRUE(reader.OpenMapped(test_zip_file));
+
+  for (size_t i = 0; i < 8; i++) {
+    SCOPED_TRACE(base::StringPrintf("Processing %d.txt", static_cast<int>(i)));
+
+    base::FilePath file_name = base::FilePath::FromUTF8Unsafe(
+        base::StringPrintf("%d.txt", static_cast<int>(i)));
+    ASSERT_TRUE(reader.LocateAndOpenEntry(file_name));
+
+    char buffer[16];
+    size_t size = 0;
+    if (i > 0) {
+      // Off by one byte: must fail.
+      EXPECT_FALSE(reader.ExtractCurrentEntryToBuffer(buffer, i - 1, &size));
+    }
+    EXPECT_TRUE(reader.ExtractCurrentEntryToBuffer(buffer, i, &size));
+    EXPECT_EQ(i, size);
+    EXPECT_EQ(0, memcmp(buffer, "0123456", i));
+  }
+}
+
+// Verifies that stored entries of a mapped zip file are exposed in place.
+TEST_F(ZipReaderTest, OpenMapped_GetCurrentEntryStoredData) {
+  ZipReader reader;
+  ASSERT_TRUE(reader.OpenMapped(test_data_dir_.AppendASCII(
+      "test_nocompress.zip")));
+  base::FilePath target_path(FILE_PATH_LITERAL("foo/bar/quux.txt"));
+  ASSERT_TRUE(reader.LocateAndOpenEntry(target_path));
+
+  base::StringPiece data;
+  ASSERT_TRUE(reader.GetCurrentEntryStoredData(&data));
+  EXPECT_EQ(kQuuxExpectedMD5, base::MD5String(data));
+
+  std::string contents(data.size(), '\0');
+  size_t size = 0;
+  ASSERT_TRUE(reader.ExtractCurrentEntryToBuffer(&contents[0], contents.size(),
+                                                 &size));
+  EXPECT_EQ(data, contents);
+
+  // Directories have no data.
+  ASSERT_TRUE(reader.LocateAndOpenEntry(
+      base::FilePath(FILE_PATH_LITERAL("foo/bar/"))));
+  EXPECT_FALSE(reader.GetCurrentEntryStoredData(&data));
+}
+
+// Verifies that ExtractCurrentEntryToBuffer() checks the CRC of entries read
+// from memory, whereas GetCurrentEntryStoredData() hands them out as they are.
+TEST_F(ZipReaderTest, OpenFromString_CorruptStoredEntry) {
+  std::string zip_data;
+  ASSERT_TRUE(base::ReadFileToString(
+      test_data_dir_.AppendASCII("test_nocompress.zip"), &zip_data));
+
+  ZipReader reader;
+  ASSERT_TRUE(reader.OpenFromString(zip_data));
+  ASSERT_TRUE(reader.LocateAndOpenEntry(
+      base::FilePath(FILE_PATH_LITERAL("foo.txt"))));
+  base::StringPiece data;
+  ASSERT_TRUE(reader.GetCurrentEntryStoredData(&data));
+  ASSERT_EQ(4u, data.size());
+
+  // Flip a bit of the entry in place; the reader only holds a reference.
+  zip_data[data.data() - zip_data.data()] ^= 1;
+  char buffer[4];
+  size_t size = 0;
+  EXPECT_FALSE(reader.ExtractCurrentEntryToBuffer(buffer, sizeof(buffer),
+                                                  &size));
+  ASSERT_TRUE(reader.GetCurrentEntryStoredData(&data));
+  EXPECT_EQ(4u, data.size());
+}
+
 // This test exposes http://crbug.com/430959, at least on OS X
 TEST_F(ZipReaderTest, DISABLED_LeakDetectionTest) {
   for (int i = 0; i < 100000; ++i) {
@@ -9,22 +9,57 @@
 #include <string>
 #include <vector>
 
+#include "base/bind.h"
 #include "base/files/file.h"
 #include "base/files/file_enumerator.h"
 #include "base/files/file_path.h"
 #include "base/files/file_util.h"
 #include "base/files/scoped_temp_dir.h"
 #include "base/path_service.h"
+#include "base/rand_util.h"
 #include "base/strings/string_util.h"
 #include "base/strings/stringprintf.h"
 #include "build/build_config.h"
 #include "testing/gtest/include/gtest/gtest.h"
 #include "testing/platform_test.h"
 #include "third_party/zlib/google/zip.h"
+#include "third_party/zlib/google/zip_internal.h"
 #include "third_party/zlib/google/zip_reader.h"
 
 namespace {
 
+bool IncludeAllFiles(const base::FilePath& path) {
+  return true;
+}
+
+// Checks that |actual_dir| holds the same files, with the same contents, as
+// |expected_dir|.
+void ExpectSameFiles(const base::FilePath& expected_dir,
+                     const base::FilePath& actual_dir) {
+  base::FileEnumerator expected_files(expected_dir, true,
+                                      base::FileEnumerator::FILES);
+  size_t expected_count = 0;
+  for (base::FilePath path = expected_files.Next(); !path.value().empty();
+       path = expected_files.Next()) {
+    base::FilePath actual_path = actual_dir;
+    ASSERT_TRUE(expected_dir.AppendRelativePath(path, &actual_path));
+    std::string expected;
+    std::string actual;
+    ASSERT_TRUE(base::ReadFileToString(path, &expected));
+    EXPECT_TRUE(base::ReadFileToString(actual_path, &actual))
+        << "no file " << actual_path.value();
+    EXPECT_EQ(expected, actual) << actual_path.value();
+    ++expected_count;
+  }
+
+  base::FileEnumerator actual_files(actual_dir, true,
+                                    base::FileEnumerator::FILES);
+  size_t actual_count = 0;
+  while (!actual_files.Next().value().empty())
+    ++actual_count;
+  EXPECT_EQ(expected_count, actual_count);
+}
+
 // Make the test a PlatformTest to setup autorelease pools properly on Mac.
 class ZipTest : public PlatformTest {
  protected:
@@ -85,7 +120,11 @@ class ZipTest : public PlatformTest {
   void TestUnzipFile(const base::FilePath& path, bool expect_hidden_files) {
     ASSERT_TRUE(base::PathExists(path)) << "no file " << path.value();
     ASSERT_TRUE(zip::Unzip(path, test_dir_));
+    TestUnzippedContents(expect_hidden_files);
+  }
 
+  // Checks that |test_dir_| holds the contents of test.zip.
+  void TestUnzippedContents(bool expect_hidden_files) {
     base::FileEnumerator files(test_dir_, true,
         base::FileEnumerator::FILES | base::FileEnumerator::DIRECTORIES);
     base::FilePath next_path = files.Next();
@@ -335,4 +374,132 @@ TEST_F(ZipTest, UnzipFilesWithIncorrectSize) {
   }
 }
 
+TEST_F(ZipTest, ParallelUnzip) {
+  base::FilePath path;
+  ASSERT_TRUE(GetTestDataDirectory(&path));
+  ASSERT_TRUE(zip::ParallelUnzip(path.AppendASCII("test.zip"), test_dir_, 4));
+  TestUnzippedContents(true);
+}
+
+TEST_F(ZipTest, ParallelUnzipEvil) {
+  base::FilePath path;
+  ASSERT_TRUE(GetTestDataDirectory(&path));
+  path = path.AppendASCII("evil.zip");
+  // See the comment at UnzipEvil() for why we do this.
+  base::FilePath output_dir = test_dir_.AppendASCII("out");
+  ASSERT_FALSE(zip::ParallelUnzip(path, output_dir, 4));
+  // The entries are all checked before any is extracted.
+  EXPECT_FALSE(base::PathExists(output_dir));
+}
+
+TEST_F(ZipTest, ParallelZip) {
+  base::FilePath src_dir;
+  ASSERT_TRUE(GetTestDataDirectory(&src_dir));
+  src_dir = src_dir.AppendASCII("test");
+
+  base::ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  base::FilePath zip_file = temp_dir.path().AppendASCII("out.zip");
+
+  EXPECT_TRUE(zip::ParallelZipWithFilterCallback(
+      src_dir, zip_file, base::Bind(&IncludeAllFiles), 4));
+  TestUnzipFile(zip_file, true);
+}
+
+// Round-trips a tree of files of assorted sizes through the parallel and
+// serial code in every combination.
+TEST_F(ZipTest, ParallelZipManyFiles) {
+  base::FilePath src_dir = test_dir_.AppendASCII("input");
+  for (int i = 0; i < 200; ++i) {
+    base::FilePath dir =
+        src_dir.AppendASCII(base::StringPrintf("dir%d", i % 7));
+    ASSERT_TRUE(base::CreateDirectory(dir));
+    // Every third file is incompressible; the others repeat a short line.
+    std::string contents;
+    if (i % 3 == 0) {
+      contents = base::RandBytesAsString(i * 997);
+    } else {
+      for (int j = 0; j < i * 10; ++j)
+        contents += base::StringPrintf("line %d of file %d\n", j, i);
+    }
+    base::FilePath file = dir.AppendASCII(base::StringPrintf("%d.txt", i));
+    ASSERT_EQ(static_cast<int>(contents.size()),
+              base::WriteFile(file, contents.data(), contents.size()));
+  }
+  ASSERT_TRUE(base::CreateDirectory(src_dir.AppendASCII("empty")));
+
+  base::FilePath serial_zip = test_dir_.AppendASCII("serial.zip");
+  base::FilePath parallel_zip = test_dir_.AppendASCII("parallel.zip");
+  ASSERT_TRUE(zip::Zip(src_dir, serial_zip, true));
+  ASSERT_TRUE(zip::ParallelZipWithFilterCallback(
+      src_dir, parallel_zip, base::Bind(&IncludeAllFiles), 4));
+
+  base::FilePath out_dir = test_dir_.AppendASCII("out1");
+  ASSERT_TRUE(zip::Unzip(parallel_zip, out_dir));
+  ExpectSameFiles(src_dir, out_dir);
+  EXPECT_TRUE(base::DirectoryExists(out_dir.AppendASCII("empty")));
+
+  out_dir = test_dir_.AppendASCII("out2");
+  ASSERT_TRUE(zip::ParallelUnzip(serial_zip, out_dir, 4));
+  ExpectSameFiles(src_dir, out_dir);
+  EXPECT_TRUE(base::DirectoryExists(out_dir.AppendASCII("empty")));
+
+  out_dir = test_dir_.AppendASCII("out3");
+  ASSERT_TRUE(zip::ParallelUnzip(parallel_zip, out_dir, 0));
+  ExpectSameFiles(src_dir, out_dir);
+}
+
+// Files whose deflated data outgrows what is kept in memory go through
+// temporary files.
+TEST_F(ZipTest, ParallelZipLargeFiles) {
+  base::FilePath src_dir = test_dir_.AppendASCII("input");
+  ASSERT_TRUE(base::CreateDirectory(src_dir));
+  for (int i = 0; i < 3; ++i) {
+    std::string contents = base::RandBytesAsString((i + 1) * 3 * 1024 * 1024);
+    base::FilePath file = src_dir.AppendASCII(base::StringPrintf("%d.bin", i));
+    ASSERT_EQ(static_cast<int>(contents.size()),
+              base::WriteFile(file, contents.data(), contents.size()));
+  }
+
+  base::FilePath zip_file = test_dir_.AppendASCII("out.zip");
+  ASSERT_TRUE(zip::ParallelZipWithFilterCallback(
+      src_dir, zip_file, base::Bind(&IncludeAllFiles), 4));
+
+  base::FilePath out_dir = test_dir_.AppendASCII("out");
+  ASSERT_TRUE(zip::Unzip(zip_file, out_dir));
+  ExpectSameFiles(src_dir, out_dir);
+}
+
+// Only the last of the files with the same path is extracted, as by Unzip().
+TEST_F(ZipTest, ParallelUnzipDuplicateNames) {
+  base::FilePath zip_path = test_dir_.AppendASCII("dup.zip");
+  zipFile zip_file = zip::internal::OpenForZipping(zip_path.AsUTF8Unsafe(),
+                                                   APPEND_STATUS_CREATE);
+  ASSERT_TRUE(zip_file);
+  // The last entries are the largest, which ParallelUnzip() starts first.
+  for (int i = 0; i < 20; ++i) {
+    std::string name = base::StringPrintf("%d.txt", i % 2);
+    std::string contents(1000 * (i + 1), static_cast<char>('a' + i));
+    zip_fileinfo file_info = {};
+    ASSERT_TRUE(zip::internal::ZipOpenNewFileInZip(zip_file, name, &file_info,
+                                                   contents.size()));
+    ASSERT_EQ(ZIP_OK,
+              zipWriteInFileInZip(zip_file, contents.data(),
+                                  static_cast<unsigned int>(contents.size())));
+    ASSERT_EQ(ZIP_OK, zipCloseFileInZip(zip_file));
+  }
+  ASSERT_EQ(ZIP_OK, zipClose(zip_file, NULL));
+
+  base::FilePath expected_dir = test_dir_.AppendASCII("serial");
+  ASSERT_TRUE(zip::Unzip(zip_path, expected_dir));
+  std::string contents;
+  ASSERT_TRUE(
+      base::ReadFileToString(expected_dir.AppendASCII("1.txt"), &contents));
+  EXPECT_EQ(std::string(20000, 't'), contents);
+
+  base::FilePath out_dir = test_dir_.AppendASCII("parallel");
+  ASSERT_TRUE(zip::ParallelUnzip(zip_path, out_dir, 4));
+  ExpectSameFiles(expected_dir, out_dir);
+}
+
 }  // namespace
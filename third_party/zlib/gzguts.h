@@ -68,9 +68,27 @@
     ZEXTERN z_off64_t ZEXPORT gzoffset64 OF((gzFile));
 #endif
 
+/* seek on file descriptors with 64-bit offsets where available */
+#if defined(_WIN32) && !defined(__BORLANDC__)
+#  define LSEEK (z_off64_t)_lseeki64
+#elif defined(_LARGEFILE64_SOURCE) && _LFS64_LARGEFILE-0
+#  define LSEEK lseek64
+#else
+#  define LSEEK lseek
+#endif
+
 /* default i/o buffer size -- double this for output when reading */
 #define GZBUFSIZE 8192
 
+/* number of full-size transfers in a row after which gztune() doubles the
+   transfer size */
+#define GZGROW 4
+
+/* overlapped i/o with a helper thread, see gzthread.c */
+#if defined(STDC) && !defined(_WIN32) && !defined(NO_GZTHREAD)
+#  define GZ_THREAD
+#endif
+
 /* gzip modes, also provide a little integrity check on the passed structure */
 #define GZ_NONE 0
 #define GZ_READ 7247
@@ -101,6 +119,19 @@ typedef struct {
     z_off64_t raw;          /* where the raw data started, for seeking */
     int how;                /* 0: get header, 1: copy, 2: decompress */
     int direct;             /* true if last read direct, false if gzip */
+    gzIndex index;          /* access points for seeking, or NULL */
+        /* adaptive buffering and overlapped i/o, see gztune() */
+    unsigned max;           /* largest transfer size to grow to, 0 if fixed */
+    unsigned len;           /* current transfer size to or from the file */
+    unsigned cap;           /* allocated length of in (reading) or out
+                               (writing) once transfers may grow */
+    unsigned full;          /* full-size transfers in a row */
+    int tune;               /* GZ_TUNE_* flags */
+    struct gz_helper_s *helper; /* helper thread, or NULL */
+    unsigned char *spare;   /* buffer exchanged with in or out for the helper
+                               thread to fill or empty */
+    unsigned sparecap;      /* allocated length of spare */
+    unsigned pending;       /* length given to the helper thread, or zero */
         /* just for writing */
     int level;              /* compression level */
     int strategy;           /* compression strategy */
@@ -115,8 +146,41 @@ typedef struct {
 } gz_state;
 typedef gz_state FAR *gz_statep;
 
+/* size of the inflate window saved at each index access point */
+#define GZWINSIZE 32768U
+
+/* access point to restart decompression at, see gzindex.c */
+typedef struct {
+    z_off64_t out;          /* offset in uncompressed data */
+    z_off64_t in;           /* offset of first whole compressed byte, from
+                               the start of the gzip data */
+    unsigned long total;    /* uncompressed bytes of this member before out,
+                               modulo 2^32, for the gzip trailer check */
+    unsigned long crc;      /* crc32 of those bytes */
+    int bits;               /* bits of the byte at in - 1 still to use */
+    unsigned wlen;          /* length of window, at most GZWINSIZE */
+    unsigned char *window;  /* last wlen bytes of output before out */
+} gz_point;
+
+/* random access index, opaque gzIndex in zlib.h */
+struct gz_index_s {
+    z_off64_t length;       /* length of the gzip data it was built from */
+    unsigned have;          /* number of access points */
+    unsigned size;          /* number of access points allocated */
+    gz_point *list;         /* access points, in increasing out order */
+};
+
 /* shared functions */
 void ZLIB_INTERNAL gz_error OF((gz_statep, int, const char *));
+gz_point ZLIB_INTERNAL *gz_index_find OF((gzIndex, z_off64_t));
+void ZLIB_INTERNAL gz_grow OF((gz_statep, unsigned));
+void ZLIB_INTERNAL gz_fit OF((gz_statep, unsigned char **, unsigned *));
+int ZLIB_INTERNAL gz_sync OF((gz_statep));
+struct gz_helper_s ZLIB_INTERNAL *gz_helper_new OF((int));
+void ZLIB_INTERNAL gz_helper_start OF((struct gz_helper_s *, int,
+                                       unsigned char *, unsigned));
+unsigned ZLIB_INTERNAL gz_helper_wait OF((struct gz_helper_s *, int *));
+void ZLIB_INTERNAL gz_helper_free OF((struct gz_helper_s *));
 #if defined UNDER_CE
 char ZLIB_INTERNAL *gz_strwinerror OF((DWORD error));
 #endif
@@ -0,0 +1,509 @@
+/* gzindex.c -- random access index for gzip files
+ * Copyright (C) 2005 Mark Adler
+ * Copyright 2016 The Chromium Authors. All rights reserved.
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+/*
+   Builds, serializes and looks up the access points gzseek() uses to avoid
+   decompressing everything before the offset it seeks to, as in
+   examples/zran.c.  An access point is taken at a deflate block boundary
+   once at least span bytes were decompressed since the last one, and records
+   the inflate bit position and the last 32K of output, which is all inflate
+   needs to resume there (see gz_jump() in gzread.c).
+
+   Serialized format, all integers little-endian:
+
+        4   "gzix" magic
+        1   format version, 1
+        8   length of the gzip data
+        4   number of access points
+        for each access point:
+            8   out
+            8   in
+            4   total
+            4   crc
+            1   bits
+            4   wlen
+            4   length of the compressed window
+            -   window, compressed with compress2()
+        4   crc32 of all of the above
+ */
+
+#include "gzguts.h"
+
+#define CHUNK 16384     /* compressed input buffer size */
+#define HEADLEN 17      /* serialized header */
+#define POINTLEN 33     /* serialized access point, without the window */
+
+/* Local functions */
+local gzIndex gz_newindex OF((void));
+local gz_point *gz_newpoint OF((gzIndex));
+local int gz_addpoint OF((gzIndex, z_off64_t, z_off64_t, z_off64_t,
+                          z_streamp, unsigned char *));
+local int gz_build OF((gz_statep, uLong, gzIndex));
+local unsigned char *gz_put OF((unsigned char *, z_off64_t, int));
+local z_off64_t gz_get OF((const unsigned char *, int));
+
+/* -- see zlib.h -- */
+void ZEXPORT gzfreeindex(index)
+    gzIndex index;
+{
+    unsigned n;
+
+    if (index == NULL)
+        return;
+    for (n = 0; n < index->have; n++)
+        free(index->list[n].window);
+    free(index->list);
+    free(index);
+}
+
+/* Allocate an empty index, or return NULL if out of memory. */
+local gzIndex gz_newindex()
+{
+    gzIndex index;
+
+    index = malloc(sizeof(struct gz_index_s));
+    if (index == NULL)
+        return NULL;
+    index->length = 0;
+    index->have = 0;
+    index->size = 0;
+    index->list = NULL;
+    return index;
+}
+
+/* Make room for one more access point in index and return it, or NULL if out
+   of memory. */
+local gz_point *gz_newpoint(index)
+    gzIndex index;
+{
+    gz_point *list;
+
+    if (index->have == index->size) {
+        list = realloc(index->list, sizeof(gz_point) *
+                                    (index->size ? index->size << 1 : 8));
+        if (list == NULL)
+            return NULL;
+        index->list = list;
+        index->size = index->size ? index->size << 1 : 8;
+    }
+    return index->list + index->have;
+}
+
+/* Add an access point at uncompressed offset out and compressed offset in,
+   member bytes into the current gzip member.  strm is the inflate stream
+   stopped at a block boundary, with its output going to the circular buffer
+   window of GZWINSIZE bytes.  Return -1 if out of memory, 0 otherwise. */
+local int gz_addpoint(index, out, in, member, strm, window)
+    gzIndex index;
+    z_off64_t out;
+    z_off64_t in;
+    z_off64_t member;
+    z_streamp strm;
+    unsigned char *window;
+{
+    unsigned have, len;
+    gz_point *next;
+
+    next = gz_newpoint(index);
+    if (next == NULL)
+        return -1;
+    next->out = out;
+    next->in = in;
+    next->total = (unsigned long)(member & 0xffffffffL);
+    next->crc = strm->adler;
+    next->bits = strm->data_type & 7;
+    next->wlen = member < GZWINSIZE ? (unsigned)member : GZWINSIZE;
+    next->window = malloc(next->wlen ? next->wlen : 1);
+    if (next->window == NULL)
+        return -1;
+
+    /* the newest output is at the start of window, up to next_out, and the
+       older output wraps around from the end */
+    have = GZWINSIZE - strm->avail_out;
+    len = next->wlen;
+    if (len > have) {
+        memcpy(next->window, window + GZWINSIZE - (len - have), len - have);
+        len = have;
+    }
+    memcpy(next->window + next->wlen - len, window + have - len, len);
+    index->have++;
+    return 0;
+}
+
+/* Decompress all of the gzip data of state from its start, adding access
+   points to index every span bytes.  Reads from state->fd directly and
+   leaves the gz_state untouched other than the file position.  Return a
+   zlib error code. */
+local int gz_build(state, span, index)
+    gz_statep state;
+    uLong span;
+    gzIndex index;
+{
+    int ret, got;
+    z_off64_t end, totin, totout, last, member;
+    z_stream strm;
+    unsigned char *in, *window;
+
+    /* the index remembers the length of the data it describes */
+    end = LSEEK(state->fd, 0, SEEK_END);
+    if (end == -1 || LSEEK(state->fd, state->start, SEEK_SET) == -1)
+        return Z_ERRNO;
+    index->length = end - state->start;
+
+    /* allocate buffers and inflate state, looking for a gzip header */
+    in = malloc(CHUNK);
+    window = malloc(GZWINSIZE);
+    strm.zalloc = Z_NULL;
+    strm.zfree = Z_NULL;
+    strm.opaque = Z_NULL;
+    strm.avail_in = 0;
+    strm.next_in = Z_NULL;
+    if (in == NULL || window == NULL || inflateInit2(&strm, 31) != Z_OK) {
+        free(window);
+        free(in);
+        return Z_MEM_ERROR;
+    }
+
+    /* inflate a block at a time, adding an access point at the end of a block
+       once span bytes were decompressed since the last one -- totin and
+       totout are the offsets of next_in and next_out in the data, and member
+       the offset of next_out in the current gzip member */
+    totin = totout = last = member = 0;
+    strm.avail_out = 0;
+    ret = Z_OK;
+    for (;;) {
+        if (strm.avail_in == 0) {
+            got = read(state->fd, in, CHUNK);
+            if (got < 0) {
+                ret = Z_ERRNO;
+                break;
+            }
+            if (got == 0) {
+                ret = Z_DATA_ERROR;     /* truncated member */
+                break;
+            }
+            strm.avail_in = got;
+            strm.next_in = in;
+        }
+        if (strm.avail_out == 0) {
+            strm.avail_out = GZWINSIZE;
+            strm.next_out = window;
+        }
+
+        totin += strm.avail_in;
+        totout += strm.avail_out;
+        member += strm.avail_out;
+        ret = inflate(&strm, Z_BLOCK);
+        totin -= strm.avail_in;
+        totout -= strm.avail_out;
+        member -= strm.avail_out;
+        if (ret == Z_NEED_DICT)
+            ret = Z_DATA_ERROR;
+        if (ret == Z_MEM_ERROR || ret == Z_DATA_ERROR)
+            break;
+
+        if (ret == Z_STREAM_END) {
+            /* look for another gzip member -- anything else ends the data
+               gzread() decompresses, so ends the index */
+            if (strm.avail_in == 0) {
+                got = read(state->fd, in, CHUNK);
+                if (got < 0) {
+                    ret = Z_ERRNO;
+                    break;
+                }
+                strm.avail_in = got;
+                strm.next_in = in;
+            }
+            if (strm.avail_in == 0 || strm.next_in[0] != 31) {
+                ret = Z_OK;
+                break;
+            }
+            inflateReset(&strm);
+            member = 0;
+            continue;
+        }
+
+        /* at the end of a block that is not the last one of the member */
+        if ((strm.data_type & 128) && !(strm.data_type & 64) &&
+                totout - last >= (z_off64_t)span) {
+            if (gz_addpoint(index, totout, totin, member, &strm,
+                            window) == -1) {
+                ret = Z_MEM_ERROR;
+                break;
+            }
+            last = totout;
+        }
+    }
+
+    inflateEnd(&strm);
+    free(window);
+    free(in);
+    return ret;
+}
+
+/* -- see zlib.h -- */
+int ZEXPORT gzbuildindex(file, span, index)
+    gzFile file;
+    uLong span;
+    gzIndex *index;
+{
+    int ret;
+    gz_statep state;
+    gzIndex built;
+
+    /* get internal structure and check integrity */
+    if (file == NULL || index == NULL || span == 0)
+        return Z_STREAM_ERROR;
+    state = (gz_statep)file;
+    if (state->mode != GZ_READ || state->err != Z_OK)
+        return Z_STREAM_ERROR;
+
+    /* build the index, then leave the file as if just opened */
+    if (gz_sync(state) == -1)
+        return Z_ERRNO;
+    built = gz_newindex();
+    if (built == NULL)
+        return Z_MEM_ERROR;
+    ret = gz_build(state, span, built);
+    if (gzrewind(file) == -1 && ret == Z_OK)
+        ret = Z_ERRNO;
+    if (ret != Z_OK) {
+        gzfreeindex(built);
+        return ret;
+    }
+    *index = built;
+    return Z_OK;
+}
+
+/* Return the last access point at or before the uncompressed offset pos, or
+   NULL if there is none. */
+gz_point ZLIB_INTERNAL *gz_index_find(index, pos)
+    gzIndex index;
+    z_off64_t pos;
+{
+    unsigned low, high, mid;
+
+    low = 0;
+    high = index->have;
+    while (low < high) {
+        mid = low + ((high - low) >> 1);
+        if (index->list[mid].out <= pos)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low ? index->list + low - 1 : NULL;
+}
+
+/* -- see zlib.h -- */
+int ZEXPORT gzsetindex(file, index)
+    gzFile file;
+    gzIndex index;
+{
+    z_off64_t here, end;
+    gz_statep state;
+
+    /* get internal structure and check integrity */
+    if (file == NULL)
+        return Z_STREAM_ERROR;
+    state = (gz_statep)file;
+    if (state->mode != GZ_READ)
+        return Z_STREAM_ERROR;
+
+    /* check that the index describes data of the same length */
+    if (index != NULL) {
+        if (gz_sync(state) == -1)
+            return Z_ERRNO;
+        here = LSEEK(state->fd, 0, SEEK_CUR);
+        if (here == -1)
+            return Z_ERRNO;
+        end = LSEEK(state->fd, 0, SEEK_END);
+        if (LSEEK(state->fd, here, SEEK_SET) == -1 || end == -1)
+            return Z_ERRNO;
+        if (end - state->start != index->length)
+            return Z_DATA_ERROR;
+    }
+    state->index = index;
+    return Z_OK;
+}
+
+/* Store the low len bytes of val at buf in little-endian order and return the
+   byte after them. */
+local unsigned char *gz_put(buf, val, len)
+    unsigned char *buf;
+    z_off64_t val;
+    int len;
+{
+    while (len--) {
+        *buf++ = (unsigned char)(val & 0xff);
+        val >>= 8;
+    }
+    return buf;
+}
+
+/* Return the len-byte little-endian integer at buf. */
+local z_off64_t gz_get(buf, len)
+    const unsigned char *buf;
+    int len;
+{
+    z_off64_t val;
+
+    val = 0;
+    while (len--)
+        val = (val << 8) + buf[len];
+    return val;
+}
+
+/* -- see zlib.h -- */
+uLong ZEXPORT gzindexbound(index)
+    gzIndex index;
+{
+    unsigned n;
+    uLong len;
+
+    len = HEADLEN + 4;
+    for (n = 0; n < index->have; n++)
+        len += POINTLEN + compressBound(index->list[n].wlen);
+    return len;
+}
+
+/* -- see zlib.h -- */
+int ZEXPORT gzsaveindex(index, dest, destLen)
+    gzIndex index;
+    Bytef *dest;
+    uLongf *destLen;
+{
+    unsigned n;
+    uLong left, zlen;
+    unsigned char *next, *size;
+    gz_point *point;
+
+    if (*destLen < HEADLEN + 4)
+        return Z_BUF_ERROR;
+    next = dest;
+    memcpy(next, "gzix", 4);
+    next[4] = 1;
+    next = gz_put(next + 5, index->length, 8);
+    next = gz_put(next, index->have, 4);
+    left = *destLen - HEADLEN - 4;
+
+    for (n = 0; n < index->have; n++) {
+        point = index->list + n;
+        if (left < POINTLEN)
+            return Z_BUF_ERROR;
+        next = gz_put(next, point->out, 8);
+        next = gz_put(next, point->in, 8);
+        next = gz_put(next, point->total, 4);
+        next = gz_put(next, point->crc, 4);
+        *next++ = (unsigned char)point->bits;
+        next = gz_put(next, point->wlen, 4);
+        size = next;
+        next += 4;
+        left -= POINTLEN;
+
+        /* compress the window into what is left */
+        zlen = left;
+        switch (compress2(next, &zlen, point->window, point->wlen,
+                          Z_BEST_COMPRESSION)) {
+        case Z_OK:
+            break;
+        case Z_MEM_ERROR:
+            return Z_MEM_ERROR;
+        default:
+            return Z_BUF_ERROR;
+        }
+        gz_put(size, zlen, 4);
+        next += zlen;
+        left -= zlen;
+    }
+
+    next = gz_put(next, crc32(0L, dest, (uInt)(next - dest)), 4);
+    *destLen = (uLong)(next - dest);
+    return Z_OK;
+}
+
+/* -- see zlib.h -- */
+int ZEXPORT gzloadindex(source, sourceLen, index)
+    const Bytef *source;
+    uLong sourceLen;
+    gzIndex *index;
+{
+    int ret;
+    unsigned n, have;
+    uLong left, zlen, wlen;
+    const unsigned char *next;
+    gzIndex loaded;
+    gz_point *point;
+
+    /* check the header and the crc of the whole */
+    if (sourceLen < HEADLEN + 4 || memcmp(source, "gzix", 4) != 0 ||
+            source[4] != 1)
+        return Z_DATA_ERROR;
+    left = sourceLen - 4;
+    if ((unsigned long)gz_get(source + left, 4) !=
+            crc32(0L, source, (uInt)left))
+        return Z_DATA_ERROR;
+    have = (unsigned)gz_get(source + 13, 4);
+    next = source + HEADLEN;
+    left -= HEADLEN;
+
+    loaded = gz_newindex();
+    if (loaded == NULL)
+        return Z_MEM_ERROR;
+    loaded->length = gz_get(source + 5, 8);
+
+    ret = Z_OK;
+    for (n = 0; n < have; n++) {
+        if (left < POINTLEN) {
+            ret = Z_DATA_ERROR;
+            break;
+        }
+        point = gz_newpoint(loaded);
+        if (point == NULL) {
+            ret = Z_MEM_ERROR;
+            break;
+        }
+        point->out = gz_get(next, 8);
+        point->in = gz_get(next + 8, 8);
+        point->total = (unsigned long)gz_get(next + 16, 4);
+        point->crc = (unsigned long)gz_get(next + 20, 4);
+        point->bits = next[24];
+        point->wlen = (unsigned)gz_get(next + 25, 4);
+        zlen = (uLong)gz_get(next + 29, 4);
+        next += POINTLEN;
+        left -= POINTLEN;
+        if (point->bits > 7 || point->wlen > GZWINSIZE || zlen > left ||
+                point->in < 1 || point->in > loaded->length ||
+                (n && point->out <= point[-1].out)) {
+            ret = Z_DATA_ERROR;
+            break;
+        }
+
+        /* decompress the window, which must be exactly wlen long */
+        point->window = malloc(point->wlen ? point->wlen : 1);
+        if (point->window == NULL) {
+            ret = Z_MEM_ERROR;
+            break;
+        }
+        loaded->have++;
+        wlen = point->wlen;
+        ret = uncompress(point->window, &wlen, next, zlen);
+        if (ret != Z_OK || wlen != point->wlen) {
+            ret = ret == Z_MEM_ERROR ? Z_MEM_ERROR : Z_DATA_ERROR;
+            break;
+        }
+        next += zlen;
+        left -= zlen;
+    }
+    if (ret == Z_OK && left != 0)
+        ret = Z_DATA_ERROR;
+    if (ret != Z_OK) {
+        gzfreeindex(loaded);
+        return ret;
+    }
+    *index = loaded;
+    return Z_OK;
+}
@@ -5,14 +5,6 @@
 
 #include "gzguts.h"
 
-#if defined(_WIN32) && !defined(__BORLANDC__)
-#  define LSEEK (z_off64_t)_lseeki64
-#elif defined(_LARGEFILE64_SOURCE) && _LFS64_LARGEFILE-0
-#  define LSEEK lseek64
-#else
-#  define LSEEK lseek
-#endif
-
 /* Local functions */
 local void gz_reset OF((gz_statep));
 local gzFile gz_open OF((const char *, int, const char *));
@@ -100,6 +92,12 @@ local gzFile gz_open(path, fd, mode)
     state->size = 0;            /* no buffers allocated yet */
     state->want = GZBUFSIZE;    /* requested buffer size */
     state->msg = NULL;          /* no error message yet */
+    state->index = NULL;        /* no random access index */
+    state->max = 0;             /* fixed transfer size */
+    state->tune = 0;            /* no hints, no helper thread */
+    state->helper = NULL;
+    state->spare = NULL;
+    state->pending = 0;
 
     /* interpret mode */
     state->mode = GZ_NONE;
@@ -251,6 +249,107 @@ int ZEXPORT gzbuffer(file, size)
     return 0;
 }
 
+/* -- see zlib.h -- */
+int ZEXPORT gztune(file, max, flags)
+    gzFile file;
+    unsigned max;
+    int flags;
+{
+    gz_statep state;
+
+    /* get internal structure and check integrity */
+    if (file == NULL)
+        return -1;
+    state = (gz_statep)file;
+    if (state->mode != GZ_READ && state->mode != GZ_WRITE)
+        return -1;
+
+    /* make sure we haven't already allocated memory */
+    if (state->size != 0)
+        return -1;
+
+    /* check and set the requested tuning */
+    if (flags & ~(GZ_TUNE_ADVISE | GZ_TUNE_THREAD))
+        return -1;
+    state->max = max;
+    state->tune = flags;
+    return 0;
+}
+
+/* Count a transfer of got bytes to or from the file at the current transfer
+   size, and double that size after GZGROW full-size transfers in a row, up to
+   state->max.  Buffers are grown to match by gz_fit() once they are free. */
+void ZLIB_INTERNAL gz_grow(state, got)
+    gz_statep state;
+    unsigned got;
+{
+    if (state->len >= state->max)
+        return;
+    if (got < state->len) {
+        state->full = 0;
+        return;
+    }
+    if (++state->full < GZGROW)
+        return;
+    state->full = 0;
+    state->len = state->len > (state->max >> 1) ? state->max :
+                                                  state->len << 1;
+}
+
+/* Make the unused buffer *buf, *cap bytes long, at least state->len bytes
+   long.  If there is not enough memory, just stop growing. */
+void ZLIB_INTERNAL gz_fit(state, buf, cap)
+    gz_statep state;
+    unsigned char **buf;
+    unsigned *cap;
+{
+    unsigned char *grown;
+
+    if (*cap >= state->len)
+        return;
+    grown = malloc(state->len);
+    if (grown == NULL) {
+        state->len = *cap;
+        state->max = 0;
+        return;
+    }
+    free(*buf);
+    *buf = grown;
+    *cap = state->len;
+}
+
+/* Wait for the transfer the helper thread is doing, if any.  Data read ahead
+   is given back by seeking back over it, so that the file position is where
+   the data used so far ends.  Return -1 on error, 0 otherwise. */
+int ZLIB_INTERNAL gz_sync(state)
+    gz_statep state;
+{
+    int err;
+    unsigned got, want;
+
+    if (state->pending == 0)
+        return 0;
+    want = state->pending;
+    state->pending = 0;
+    got = gz_helper_wait(state->helper, &err);
+    if (state->mode == GZ_READ) {
+        if (got && LSEEK(state->fd, -(z_off64_t)got, SEEK_CUR) == -1) {
+            gz_error(state, Z_ERRNO, zstrerror());
+            return -1;
+        }
+        return 0;
+    }
+    if (got != want) {
+#ifdef GZ_THREAD
+        if (err)
+            errno = err;
+#endif
+        gz_error(state, Z_ERRNO, zstrerror());
+        return -1;
+    }
+    return 0;
+}
+
 /* -- see zlib.h -- */
 int ZEXPORT gzrewind(file)
     gzFile file;
@@ -267,7 +366,8 @@ int ZEXPORT gzrewind(file)
         return -1;
 
     /* back up and start over */
-    if (LSEEK(state->fd, state->start, SEEK_SET) == -1)
+    if (gz_sync(state) == -1 ||
+        LSEEK(state->fd, state->start, SEEK_SET) == -1)
         return -1;
     gz_reset(state);
     return 0;
@@ -308,6 +408,8 @@ z_off64_t ZEXPORT gzseek64(file, offset, whence)
     /* if within raw area while reading, just go there */
     if (state->mode == GZ_READ && state->how == COPY &&
         state->pos + offset >= state->raw) {
+        if (gz_sync(state) == -1)
+            return -1;
         ret = LSEEK(state->fd, offset - state->have, SEEK_CUR);
         if (ret == -1)
             return -1;
@@ -403,6 +505,8 @@ z_off64_t ZEXPORT gzoffset64(file)
         return -1;
 
     /* compute and return effective offset in file */
+    if (gz_sync(state) == -1)
+        return -1;
     offset = LSEEK(state->fd, 0, SEEK_CUR);
     if (offset == -1)
         return -1;
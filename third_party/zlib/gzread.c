@@ -7,11 +7,14 @@
 
 /* Local functions */
 local int gz_load OF((gz_statep, unsigned char *, unsigned, unsigned *));
+local int gz_take OF((gz_statep));
 local int gz_avail OF((gz_statep));
 local int gz_next4 OF((gz_statep, unsigned long *));
+local int gz_init OF((gz_statep));
 local int gz_head OF((gz_statep));
 local int gz_decomp OF((gz_statep));
 local int gz_make OF((gz_statep));
+local int gz_jump OF((gz_statep, z_off64_t));
 local int gz_skip OF((gz_statep, z_off64_t));
 
 /* Use read() to load a buffer -- return -1 on error, otherwise 0.  Read from
@@ -26,7 +29,10 @@ local int gz_load(state, buf, len, have)
 {
     int ret;
 
+    /* the helper thread may be reading ahead -- give that data back */
     *have = 0;
+    if (state->pending && gz_sync(state) == -1)
+        return -1;
     do {
         ret = read(state->fd, buf + *have, len - *have);
         if (ret <= 0)
@@ -42,11 +48,48 @@ local int gz_load(state, buf, len, have)
     return 0;
 }
 
+/* Make the input the helper thread read ahead into state->spare the input
+   buffer, setting the eof flag if it ended the file.  Return -1 on error, 0
+   otherwise. */
+local int gz_take(state)
+    gz_statep state;
+{
+    int err;
+    unsigned got, want, cap;
+    unsigned char *in;
+    z_streamp strm = &(state->strm);
+
+    want = state->pending;
+    state->pending = 0;
+    got = gz_helper_wait(state->helper, &err);
+    if (err) {
+#ifdef GZ_THREAD
+        errno = err;
+#endif
+        gz_error(state, Z_ERRNO, zstrerror());
+        return -1;
+    }
+    if (got < want)
+        state->eof = 1;
+
+    /* swap the buffers */
+    in = state->in;
+    state->in = state->spare;
+    state->spare = in;
+    cap = state->cap;
+    state->cap = state->sparecap;
+    state->sparecap = cap;
+    strm->avail_in = got;
+    return 0;
+}
+
 /* Load up input buffer and set eof flag if last data loaded -- return -1 on
    error, 0 otherwise.  Note that the eof flag is set when the end of the input
    file is reached, even though there may be unused data in the buffer.  Once
    that data has been used, no more attempts will be made to read the file.
-   gz_avail() assumes that strm->avail_in == 0. */
+   gz_avail() assumes that strm->avail_in == 0.  With gztune(), the input
+   buffer grows with sequential reading, and the helper thread, if any, reads
+   the next input while this one is decompressed. */
 local int gz_avail(state)
     gz_statep state;
 {
@@ -55,10 +98,23 @@ local int gz_avail(state)
     if (state->err != Z_OK)
         return -1;
     if (state->eof == 0) {
-        if (gz_load(state, state->in, state->size,
-                (unsigned *)&(strm->avail_in)) == -1)
-            return -1;
+        if (state->pending) {
+            if (gz_take(state) == -1)
+                return -1;
+        }
+        else {
+            gz_fit(state, &(state->in), &(state->cap));
+            if (gz_load(state, state->in, state->len,
+                    (unsigned *)&(strm->avail_in)) == -1)
+                return -1;
+        }
         strm->next_in = state->in;
+        gz_grow(state, strm->avail_in);
+        if (state->helper != NULL && state->eof == 0) {
+            gz_fit(state, &(state->spare), &(state->sparecap));
+            gz_helper_start(state->helper, 0, state->spare, state->len);
+            state->pending = state->len;
+        }
     }
     return 0;
 }
@@ -89,6 +145,64 @@ local int gz_next4(state, ret)
     return 0;
 }
 
+/* Allocate read buffers and inflate memory -- return -1 on error, otherwise
+   0.  Only called while state->size is zero. */
+local int gz_init(state)
+    gz_statep state;
+{
+    /* allocate buffers */
+    state->in = malloc(state->want);
+    state->out = malloc(state->want << 1);
+    if (state->in == NULL || state->out == NULL) {
+        if (state->out != NULL)
+            free(state->out);
+        if (state->in != NULL)
+            free(state->in);
+        gz_error(state, Z_MEM_ERROR, "out of memory");
+        return -1;
+    }
+    state->size = state->want;
+    state->len = state->cap = state->size;
+    state->full = 0;
+
+    /* allocate inflate memory */
+    state->strm.zalloc = Z_NULL;
+    state->strm.zfree = Z_NULL;
+    state->strm.opaque = Z_NULL;
+    state->strm.avail_in = 0;
+    state->strm.next_in = Z_NULL;
+    if (inflateInit2(&(state->strm), -15) != Z_OK) {    /* raw inflate */
+        free(state->out);
+        free(state->in);
+        state->size = 0;
+        gz_error(state, Z_MEM_ERROR, "out of memory");
+        return -1;
+    }
+
+    /* set up gztune() hints and helper thread -- input can only be read ahead
+       or grow past the output buffer if it can be given back by seeking */
+    if (state->tune & GZ_TUNE_ADVISE) {
+#ifdef POSIX_FADV_SEQUENTIAL
+        posix_fadvise(state->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    }
+    if ((state->max > state->size || (state->tune & GZ_TUNE_THREAD)) &&
+            LSEEK(state->fd, 0, SEEK_CUR) == -1)
+        state->max = 0;
+    else if (state->tune & GZ_TUNE_THREAD) {
+        state->spare = malloc(state->size);
+        if (state->spare != NULL) {
+            state->sparecap = state->size;
+            state->helper = gz_helper_new(state->fd);
+            if (state->helper == NULL) {
+                free(state->spare);
+                state->spare = NULL;
+            }
+        }
+    }
+    return 0;
+}
+
 /* Look for gzip header, set up for inflate or copy.  state->have must be zero.
    If this is the first time in, allocate required memory.  state->how will be
    left unchanged if there is no more input data available, will be set to COPY
@@ -109,34 +223,8 @@ local int gz_head(state)
     unsigned len;
 
     /* allocate read buffers and inflate memory */
-    if (state->size == 0) {
-        /* allocate buffers */
-        state->in = malloc(state->want);
-        state->out = malloc(state->want << 1);
-        if (state->in == NULL || state->out == NULL) {
-            if (state->out != NULL)
-                free(state->out);
-            if (state->in != NULL)
-                free(state->in);
-            gz_error(state, Z_MEM_ERROR, "out of memory");
-            return -1;
-        }
-        state->size = state->want;
-
-        /* allocate inflate memory */
-        state->strm.zalloc = Z_NULL;
-        state->strm.zfree = Z_NULL;
-        state->strm.opaque = Z_NULL;
-        state->strm.avail_in = 0;
-        state->strm.next_in = Z_NULL;
-        if (inflateInit2(&(state->strm), -15) != Z_OK) {    /* raw inflate */
-            free(state->out);
-            free(state->in);
-            state->size = 0;
-            gz_error(state, Z_MEM_ERROR, "out of memory");
-            return -1;
-        }
-    }
+    if (state->size == 0 && gz_init(state) == -1)
+        return -1;
 
     /* get some data in the input buffer */
     if (strm->avail_in == 0) {
@@ -209,9 +297,21 @@ local int gz_head(state)
 
     /* doing raw i/o, save start of raw data for seeking, copy any leftover
        input to output -- this assumes that the output buffer is larger than
-       the input buffer, which also assures space for gzungetc() */
+       the input buffer, which also assures space for gzungetc(), so give back
+       what does not fit in it if the input buffer grew with gztune() */
     state->raw = state->pos;
     state->next = state->out;
+    if (strm->avail_in > (state->size << 1) - state->have) {
+        len = strm->avail_in - ((state->size << 1) - state->have);
+        if (gz_sync(state) == -1)
+            return -1;
+        if (LSEEK(state->fd, -(z_off64_t)len, SEEK_CUR) == -1) {
+            gz_error(state, Z_ERRNO, zstrerror());
+            return -1;
+        }
+        strm->avail_in -= len;
+        state->eof = 0;
+    }
     if (strm->avail_in) {
         memcpy(state->next + state->have, strm->next_in, strm->avail_in);
         state->have += strm->avail_in;
@@ -326,13 +426,72 @@ local int gz_make(state)
     return 0;
 }
 
+/* Restart decompression at the last access point of state->index at or before
+   the uncompressed offset pos, if that is past the data already in the output
+   buffer, as in examples/zran.c.  gz_skip() then only has to decompress from
+   there.  Return -1 on error, 0 on success. */
+local int gz_jump(state, pos)
+    gz_statep state;
+    z_off64_t pos;
+{
+    int ch;
+    gz_point *point;
+    z_streamp strm = &(state->strm);
+
+    point = gz_index_find(state->index, pos);
+    if (point == NULL || point->out <= state->pos + state->have)
+        return 0;
+    if (state->size == 0 && gz_init(state) == -1)
+        return -1;
+
+    /* position the input at the first byte with bits to use */
+    if (gz_sync(state) == -1)
+        return -1;
+    if (LSEEK(state->fd, state->start + point->in - (point->bits ? 1 : 0),
+              SEEK_SET) == -1) {
+        gz_error(state, Z_ERRNO, zstrerror());
+        return -1;
+    }
+    state->have = 0;
+    state->eof = 0;
+    strm->avail_in = 0;
+
+    /* resume raw inflate there, with the window and check values the gzip
+       member had up to that point */
+    inflateReset(strm);
+    if (point->bits) {
+        ch = NEXT();
+        if (ch == -1) {
+            if (state->err == Z_OK)
+                gz_error(state, Z_DATA_ERROR, "unexpected end of file");
+            return -1;
+        }
+        inflatePrime(strm, point->bits, ch >> (8 - point->bits));
+    }
+    inflateSetDictionary(strm, point->window, point->wlen);
+    strm->adler = point->crc;
+    strm->total_out = point->total;
+    state->how = GZIP;
+    state->direct = 0;
+    state->pos = point->out;
+    return 0;
+}
+
 /* Skip len uncompressed bytes of output.  Return -1 on error, 0 on success. */
 local int gz_skip(state, len)
     gz_statep state;
     z_off64_t len;
 {
     unsigned n;
+    z_off64_t pos;
 
+    /* go to the closest access point first, if there is an index */
+    if (state->index != NULL) {
+        pos = state->pos + len;
+        if (gz_jump(state, pos) == -1)
+            return -1;
+        len = pos - state->pos;
+    }
     /* skip over len bytes or reach end-of-file, whichever comes first */
     while (len)
         /* skip over whatever is in output buffer */
@@ -627,7 +786,7 @@ int ZEXPORT gzdirect(file)
 int ZEXPORT gzclose_r(file)
     gzFile file;
 {
-    int ret;
+    int ret, err;
     gz_statep state;
 
     /* get internal structure */
@@ -639,7 +798,13 @@ int ZEXPORT gzclose_r(file)
     if (state->mode != GZ_READ)
         return Z_STREAM_ERROR;
 
-    /* free memory and close file */
+    /* stop the helper thread, free memory and close file */
+    if (state->pending) {
+        state->pending = 0;
+        gz_helper_wait(state->helper, &err);
+    }
+    gz_helper_free(state->helper);
+    free(state->spare);
     if (state->size) {
         inflateEnd(&(state->strm));
         free(state->out);
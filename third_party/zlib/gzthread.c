@@ -0,0 +1,204 @@
+/* gzthread.c -- helper thread for overlapped gz* file i/o
+ * Copyright 2016 The Chromium Authors. All rights reserved.
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+/*
+   With GZ_TUNE_THREAD (see gztune() in zlib.h), each gzFile gets a helper
+   thread that does one read() or write() transfer at a time on its behalf:
+   gzread() has it read the next input buffer while inflate() works on the
+   current one, and gzwrite() has it write a full output buffer while
+   deflate() fills the other one.  gz_sync() in gzlib.c waits for the
+   transfer in progress before anything else touches the file descriptor.
+
+   Where threads are not available, gz_helper_new() returns NULL and all i/o
+   is done in the calling thread.
+ */
+
+#include "gzguts.h"
+
+#ifdef GZ_THREAD
+
+#include <pthread.h>
+
+/* helper thread states */
+#define IDLE 0      /* waiting for a transfer */
+#define BUSY 1      /* transferring buf */
+#define DONE 2      /* transfer done, result in got and err */
+#define QUIT 3      /* exit requested */
+
+struct gz_helper_s {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;    /* signaled on every change of state */
+    pthread_t thread;
+    int fd;                 /* file to read or write */
+    int state;              /* see above */
+    int writing;            /* true to write buf, false to read into it */
+    unsigned char *buf;     /* transfer buffer */
+    unsigned len;           /* length to transfer */
+    unsigned got;           /* length transferred */
+    int err;                /* errno of a failed transfer, or zero */
+};
+
+/* Local functions */
+local void gz_transfer OF((struct gz_helper_s *));
+local void *gz_helper_main OF((void *));
+
+/* Read or write helper->len bytes like gz_load() and gz_comp() do, looping
+   since read() and write() are not guaranteed to transfer all of it, and
+   stopping at end of file or on the first error. */
+local void gz_transfer(helper)
+    struct gz_helper_s *helper;
+{
+    int ret;
+
+    helper->got = 0;
+    helper->err = 0;
+    while (helper->got < helper->len) {
+        if (helper->writing)
+            ret = write(helper->fd, helper->buf + helper->got,
+                        helper->len - helper->got);
+        else
+            ret = read(helper->fd, helper->buf + helper->got,
+                       helper->len - helper->got);
+        if (ret < 0)
+            helper->err = errno;
+        if (ret <= 0)
+            break;
+        helper->got += ret;
+    }
+}
+
+/* Do the transfers requested by gz_helper_start() until gz_helper_free(). */
+local void *gz_helper_main(arg)
+    void *arg;
+{
+    struct gz_helper_s *helper = arg;
+
+    pthread_mutex_lock(&helper->lock);
+    for (;;) {
+        while (helper->state != BUSY && helper->state != QUIT)
+            pthread_cond_wait(&helper->cond, &helper->lock);
+        if (helper->state == QUIT)
+            break;
+        pthread_mutex_unlock(&helper->lock);
+        gz_transfer(helper);
+        pthread_mutex_lock(&helper->lock);
+        helper->state = DONE;
+        pthread_cond_broadcast(&helper->cond);
+    }
+    pthread_mutex_unlock(&helper->lock);
+    return NULL;
+}
+
+/* Start a helper thread for fd, or return NULL if that fails. */
+struct gz_helper_s ZLIB_INTERNAL *gz_helper_new(fd)
+    int fd;
+{
+    struct gz_helper_s *helper;
+
+    helper = malloc(sizeof(struct gz_helper_s));
+    if (helper == NULL)
+        return NULL;
+    helper->fd = fd;
+    helper->state = IDLE;
+    if (pthread_mutex_init(&helper->lock, NULL) != 0) {
+        free(helper);
+        return NULL;
+    }
+    if (pthread_cond_init(&helper->cond, NULL) != 0) {
+        pthread_mutex_destroy(&helper->lock);
+        free(helper);
+        return NULL;
+    }
+    if (pthread_create(&helper->thread, NULL, gz_helper_main, helper) != 0) {
+        pthread_cond_destroy(&helper->cond);
+        pthread_mutex_destroy(&helper->lock);
+        free(helper);
+        return NULL;
+    }
+    return helper;
+}
+
+/* Have the helper thread read len bytes into buf, or write len bytes from
+   buf if writing is true.  The previous transfer must have been waited for
+   with gz_helper_wait(). */
+void ZLIB_INTERNAL gz_helper_start(helper, writing, buf, len)
+    struct gz_helper_s *helper;
+    int writing;
+    unsigned char *buf;
+    unsigned len;
+{
+    pthread_mutex_lock(&helper->lock);
+    helper->writing = writing;
+    helper->buf = buf;
+    helper->len = len;
+    helper->state = BUSY;
+    pthread_cond_broadcast(&helper->cond);
+    pthread_mutex_unlock(&helper->lock);
+}
+
+/* Wait for the transfer started by gz_helper_start() and return the length
+   transferred, setting *err to the errno of a failed transfer or zero. */
+unsigned ZLIB_INTERNAL gz_helper_wait(helper, err)
+    struct gz_helper_s *helper;
+    int *err;
+{
+    unsigned got;
+
+    pthread_mutex_lock(&helper->lock);
+    while (helper->state != DONE)
+        pthread_cond_wait(&helper->cond, &helper->lock);
+    helper->state = IDLE;
+    got = helper->got;
+    *err = helper->err;
+    pthread_mutex_unlock(&helper->lock);
+    return got;
+}
+
+/* Stop the helper thread and free it.  No transfer may be in progress. */
+void ZLIB_INTERNAL gz_helper_free(helper)
+    struct gz_helper_s *helper;
+{
+    if (helper == NULL)
+        return;
+    pthread_mutex_lock(&helper->lock);
+    helper->state = QUIT;
+    pthread_cond_broadcast(&helper->cond);
+    pthread_mutex_unlock(&helper->lock);
+    pthread_join(helper->thread, NULL);
+    pthread_cond_destroy(&helper->cond);
+    pthread_mutex_destroy(&helper->lock);
+    free(helper);
+}
+
+#else /* !GZ_THREAD */
+
+struct gz_helper_s ZLIB_INTERNAL *gz_helper_new(fd)
+    int fd;
+{
+    return NULL;
+}
+
+void ZLIB_INTERNAL gz_helper_start(helper, writing, buf, len)
+    struct gz_helper_s *helper;
+    int writing;
+    unsigned char *buf;
+    unsigned len;
+{
+}
+
+unsigned ZLIB_INTERNAL gz_helper_wait(helper, err)
+    struct gz_helper_s *helper;
+    int *err;
+{
+    *err = 0;
+    return 0;
+}
+
+void ZLIB_INTERNAL gz_helper_free(helper)
+    struct gz_helper_s *helper;
+{
+}
+
+#endif /* GZ_THREAD */
@@ -44,6 +44,21 @@ local int gz_init(state)
 
     /* mark state as initialized */
     state->size = state->want;
+    state->len = state->cap = state->size;
+    state->full = 0;
+
+    /* start a helper thread for gztune(), with a second output buffer */
+    if (state->tune & GZ_TUNE_THREAD) {
+        state->spare = malloc(state->size);
+        if (state->spare != NULL) {
+            state->sparecap = state->size;
+            state->helper = gz_helper_new(state->fd);
+            if (state->helper == NULL) {
+                free(state->spare);
+                state->spare = NULL;
+            }
+        }
+    }
 
     /* initialize write buffer */
     strm->avail_out = state->size;
@@ -55,13 +70,17 @@ local int gz_init(state)
 /* Compress whatever is at avail_in and next_in and write to the output file.
    Return -1 if there is an error writing to the output file, otherwise 0.
    flush is assumed to be a valid deflate() flush value.  If flush is Z_FINISH,
-   then the deflate() state is reset to start a new gzip stream. */
+   then the deflate() state is reset to start a new gzip stream.  With
+   gztune(), the output buffer grows with sequential writing, and the helper
+   thread, if any, writes full output buffers while deflate() fills the spare
+   one.  Everything is written once a flush returns. */
 local int gz_comp(state, flush)
     gz_statep state;
     int flush;
 {
     int ret, got;
-    unsigned have;
+    unsigned have, cap;
+    unsigned char *out;
     z_streamp strm = &(state->strm);
 
     /* allocate memory if this is the first time through */
@@ -76,13 +95,29 @@ local int gz_comp(state, flush)
         if (strm->avail_out == 0 || (flush != Z_NO_FLUSH &&
             (flush != Z_FINISH || ret == Z_STREAM_END))) {
             have = (unsigned)(strm->next_out - state->next);
-            if (have && ((got = write(state->fd, state->next, have)) < 0 ||
-                         (unsigned)got != have)) {
+            if (state->pending && gz_sync(state) == -1)
+                return -1;
+            if (strm->avail_out == 0 && state->helper != NULL) {
+                /* write the full buffer in the background, fill the other */
+                gz_helper_start(state->helper, 1, state->next, have);
+                state->pending = have;
+                out = state->out;
+                state->out = state->spare;
+                state->spare = out;
+                cap = state->cap;
+                state->cap = state->sparecap;
+                state->sparecap = cap;
+            }
+            else if (have &&
+                     ((got = write(state->fd, state->next, have)) < 0 ||
+                      (unsigned)got != have)) {
                 gz_error(state, Z_ERRNO, zstrerror());
                 return -1;
             }
             if (strm->avail_out == 0) {
-                strm->avail_out = state->size;
+                gz_grow(state, state->len);
+                gz_fit(state, &(state->out), &(state->cap));
+                strm->avail_out = state->len;
                 strm->next_out = state->out;
             }
             state->next = strm->next_out;
@@ -103,6 +138,10 @@ local int gz_comp(state, flush)
     if (flush == Z_FINISH)
         deflateReset(strm);
 
+    /* a flush leaves nothing for the helper thread to write */
+    if (flush != Z_NO_FLUSH && gz_sync(state) == -1)
+        return -1;
+
     /* all done, no errors */
     return 0;
 }
@@ -501,6 +540,7 @@ int ZEXPORT gzclose_w(file)
     gzFile file;
 {
     int ret = 0;
+    int err;
     gz_statep state;
 
     /* get internal structure */
@@ -518,8 +558,14 @@ int ZEXPORT gzclose_w(file)
         ret += gz_zero(state, state->skip);
     }
 
-    /* flush, free memory, and close file */
+    /* flush, stop the helper thread, free memory, and close file */
     ret += gz_comp(state, Z_FINISH);
+    if (state->pending) {           /* only left after an error */
+        state->pending = 0;
+        gz_helper_wait(state->helper, &err);
+    }
+    gz_helper_free(state->helper);
+    free(state->spare);
     (void)deflateEnd(&(state->strm));
     free(state->out);
     free(state->in);
@@ -0,0 +1,30 @@
+/* inffast_chunk.h -- header to use inffast_chunk.c
+ * Copyright (C) 1995-2003, 2010 Mark Adler
+ * Copyright 2016 The Chromium Authors. All rights reserved.
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+/* WARNING: this file should *not* be used by applications. It is
+   part of the implementation of the compression library and is
+   subject to change. Applications should only use zlib.h.
+ */
+
+#ifndef INFFAST_CHUNK_H
+#define INFFAST_CHUNK_H
+
+/* inflate_fast_chunk_() refills its 64-bit bit buffer with one unaligned
+   8-byte load, so it needs 8 readable input bytes rather than the 6 that
+   inflate_fast() needs for a length/distance pair. */
+#define INFLATE_FAST_CHUNK_MIN_INPUT 8
+
+/* Its copies may run up to 15 bytes past the end of a 258-byte match (see
+   chunkcopy.h), so it needs that much slack in the output buffer ... */
+#define INFLATE_FAST_CHUNK_MIN_OUTPUT (258 + 16)
+
+/* ... and as much padding after the end of the sliding window, which
+   updatewindow() and inflateCopy() allocate for it. */
+#define INFLATE_WINDOW_PADDING 16
+
+void ZLIB_INTERNAL inflate_fast_chunk_ OF((z_streamp strm, unsigned start));
+
+#endif  /* INFFAST_CHUNK_H */
@@ -84,6 +84,8 @@
 #include "inftrees.h"
 #include "inflate.h"
 #include "inffast.h"
+#include "inffast_chunk.h"
+#include "x86.h"
 
 #ifdef MAKEFIXED
 #  ifndef BUILDFIXED
@@ -174,6 +176,8 @@ int stream_size;
     int ret;
     struct inflate_state FAR *state;
 
+    x86_check_features();
+
     if (version == Z_NULL || version[0] != ZLIB_VERSION[0] ||
         stream_size != (int)(sizeof(z_stream)))
         return Z_VERSION_ERROR;
@@ -367,9 +371,13 @@ unsigned out;
     /* if it hasn't been done already, allocate space for the window */
     if (state->window == Z_NULL) {
         state->window = (unsigned char FAR *)
-                        ZALLOC(strm, 1U << state->wbits,
+                        ZALLOC(strm,
+                               (1U << state->wbits) + INFLATE_WINDOW_PADDING,
                                sizeof(unsigned char));
         if (state->window == Z_NULL) return 1;
+        /* inflate_fast_chunk_() may read, but never uses, the padding */
+        zmemzero(state->window + (1U << state->wbits),
+                 INFLATE_WINDOW_PADDING);
     }
 
     /* if window not in use yet, initialize */
@@ -1006,7 +1014,12 @@ int flush;
         case LEN:
             if (have >= 6 && left >= 258) {
                 RESTORE();
-                inflate_fast(strm, out);
+                if (x86_cpu_enable_simd &&
+                    have >= INFLATE_FAST_CHUNK_MIN_INPUT &&
+                    left >= INFLATE_FAST_CHUNK_MIN_OUTPUT)
+                    inflate_fast_chunk_(strm, out);
+                else
+                    inflate_fast(strm, out);
                 LOAD();
                 if (state->mode == TYPE)
                     state->back = -1;
@@ -1425,7 +1438,8 @@ z_streamp source;
     window = Z_NULL;
     if (state->window != Z_NULL) {
         window = (unsigned char FAR *)
-                 ZALLOC(source, 1U << state->wbits, sizeof(unsigned char));
+                 ZALLOC(source, (1U << state->wbits) + INFLATE_WINDOW_PADDING,
+                        sizeof(unsigned char));
         if (window == Z_NULL) {
             ZFREE(source, copy);
             return Z_MEM_ERROR;
@@ -1443,7 +1457,7 @@ z_streamp source;
     copy->next = copy->codes + (state->next - state->codes);
     if (window != Z_NULL) {
         wsize = 1U << state->wbits;
-        zmemcpy(window, state->window, wsize);
+        zmemcpy(window, state->window, wsize + INFLATE_WINDOW_PADDING);
     }
     copy->window = window;
     dest->state = (struct internal_state FAR *)copy;
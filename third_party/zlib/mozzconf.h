@@ -141,11 +141,29 @@
 #define gzbuffer MOZ_Z_gzbuffer
 #define gzclose_r MOZ_Z_gzclose_r
 #define gzclose_w MOZ_Z_gzclose_w
+#define gzbuildindex MOZ_Z_gzbuildindex
+#define gzindexbound MOZ_Z_gzindexbound
+#define gzsaveindex MOZ_Z_gzsaveindex
+#define gzloadindex MOZ_Z_gzloadindex
+#define gzsetindex MOZ_Z_gzsetindex
+#define gzfreeindex MOZ_Z_gzfreeindex
+#define gztune MOZ_Z_gztune
+#define gz_grow MOZ_Z_gz_grow
+#define gz_fit MOZ_Z_gz_fit
+#define gz_sync MOZ_Z_gz_sync
+#define gz_helper_new MOZ_Z_gz_helper_new
+#define gz_helper_start MOZ_Z_gz_helper_start
+#define gz_helper_wait MOZ_Z_gz_helper_wait
+#define gz_helper_free MOZ_Z_gz_helper_free
+#define gz_helper_s MOZ_Z_gz_helper_s
+#define gz_index_find MOZ_Z_gz_index_find
 #define inflateMark MOZ_Z_inflateMark
 #define inflateReset2 MOZ_Z_inflateReset2
 #define inflateUndermine MOZ_Z_inflateUndermine
 #define charf MOZ_Z_charf
 #define gzFile MOZ_Z_gzFile
+#define gzIndex MOZ_Z_gzIndex
+#define gz_index_s MOZ_Z_gz_index_s
 #define gz_header MOZ_Z_gz_header
 #define gz_headerp MOZ_Z_gz_headerp
 #define intf MOZ_Z_intf
@@ -4,10 +4,15 @@
 */
 #include <assert.h>
 
+#include "adler32_simd.h"
+#include "crc32_simd.h"
 #include "deflate.h"
+#include "inffast_chunk.h"
 #include "x86.h"
 
 int x86_cpu_enable_simd = 0;
+int x86_cpu_enable_ssse3 = 0;
+int x86_cpu_enable_avx2 = 0;
 
 void ZLIB_INTERNAL crc_fold_init(deflate_state *const s) {
     assert(0);
@@ -30,6 +35,35 @@ void ZLIB_INTERNAL fill_window_sse(deflate_state *s)
     assert(0);
 }
 
+uLong ZLIB_INTERNAL adler32_simd_(uLong adler,
+                                  const unsigned char *buf,
+                                  uInt len)
+{
+    assert(0);
+    return 0;
+}
+
+uLong ZLIB_INTERNAL adler32_avx2_(uLong adler,
+                                  const unsigned char *buf,
+                                  uInt len)
+{
+    assert(0);
+    return 0;
+}
+
+void ZLIB_INTERNAL inflate_fast_chunk_(z_streamp strm, unsigned start)
+{
+    assert(0);
+}
+
+unsigned ZLIB_INTERNAL crc32_sse42_simd_(const unsigned char *buf,
+                                         uInt len,
+                                         unsigned crc)
+{
+    assert(0);
+    return 0;
+}
+
 void x86_check_features(void)
 {
 }
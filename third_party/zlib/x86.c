@@ -11,6 +11,8 @@
 #include "x86.h"
 
 int x86_cpu_enable_simd = 0;
+int x86_cpu_enable_ssse3 = 0;
+int x86_cpu_enable_avx2 = 0;
 
 #ifndef _MSC_VER
 #include <pthread.h>
@@ -23,35 +25,62 @@ void x86_check_features(void)
   pthread_once(&cpu_check_inited_once, _x86_check_features);
 }
 
-static void _x86_check_features(void)
+static void _x86_cpuid(unsigned leaf, unsigned *ebx, unsigned *ecx,
+                       unsigned *edx)
 {
-    int x86_cpu_has_sse2;
-    int x86_cpu_has_sse42;
-    int x86_cpu_has_pclmulqdq;
-    unsigned eax, ebx, ecx, edx;
+    unsigned eax = leaf;
+    unsigned subleaf = 0;
 
-    eax = 1;
 #ifdef __i386__
     __asm__ __volatile__ (
         "xchg %%ebx, %1\n\t"
         "cpuid\n\t"
         "xchg %1, %%ebx\n\t"
-    : "+a" (eax), "=S" (ebx), "=c" (ecx), "=d" (edx)
+    : "+a" (eax), "=S" (*ebx), "+c" (subleaf), "=d" (*edx)
     );
 #else
     __asm__ __volatile__ (
         "cpuid\n\t"
-    : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx)
+    : "+a" (eax), "=b" (*ebx), "+c" (subleaf), "=d" (*edx)
     );
 #endif  /* (__i386__) */
+    *ecx = subleaf;
+}
+
+static void _x86_check_features(void)
+{
+    int x86_cpu_has_sse2;
+    int x86_cpu_has_ssse3;
+    int x86_cpu_has_sse42;
+    int x86_cpu_has_pclmulqdq;
+    int x86_cpu_has_avx2 = 0;
+    unsigned ebx, ecx, edx;
+
+    _x86_cpuid(1, &ebx, &ecx, &edx);
 
     x86_cpu_has_sse2 = edx & 0x4000000;
+    x86_cpu_has_ssse3 = ecx & 0x200;
     x86_cpu_has_sse42 = ecx & 0x100000;
     x86_cpu_has_pclmulqdq = ecx & 0x2;
 
+    /* AVX2 also needs the OS to save the YMM state (OSXSAVE + XCR0). */
+    if ((ecx & 0x18000000) == 0x18000000) {
+        unsigned xcr0_lo, xcr0_hi;
+        __asm__ __volatile__ (
+            "xgetbv\n\t"
+        : "=a" (xcr0_lo), "=d" (xcr0_hi) : "c" (0)
+        );
+        if ((xcr0_lo & 0x6) == 0x6) {
+            _x86_cpuid(7, &ebx, &ecx, &edx);
+            x86_cpu_has_avx2 = ebx & 0x20;
+        }
+    }
+
     x86_cpu_enable_simd = x86_cpu_has_sse2 &&
                           x86_cpu_has_sse42 &&
                           x86_cpu_has_pclmulqdq;
+    x86_cpu_enable_ssse3 = x86_cpu_has_sse2 && x86_cpu_has_ssse3;
+    x86_cpu_enable_avx2 = x86_cpu_enable_ssse3 && x86_cpu_has_avx2;
 }
 #else
 #include <intrin.h>
@@ -73,19 +102,31 @@ static BOOL CALLBACK _x86_check_features(PINIT_ONCE once,
                                          PVOID *context)
 {
     int x86_cpu_has_sse2;
+    int x86_cpu_has_ssse3;
     int x86_cpu_has_sse42;
     int x86_cpu_has_pclmulqdq;
+    int x86_cpu_has_avx2 = 0;
     int regs[4];
 
     __cpuid(regs, 1);
 
     x86_cpu_has_sse2 = regs[3] & 0x4000000;
+    x86_cpu_has_ssse3 = regs[2] & 0x200;
     x86_cpu_has_sse42= regs[2] & 0x100000;
     x86_cpu_has_pclmulqdq = regs[2] & 0x2;
 
+    /* AVX2 also needs the OS to save the YMM state (OSXSAVE + XCR0). */
+    if ((regs[2] & 0x18000000) == 0x18000000 &&
+        (_xgetbv(0) & 0x6) == 0x6) {
+        __cpuidex(regs, 7, 0);
+        x86_cpu_has_avx2 = regs[1] & 0x20;
+    }
+
     x86_cpu_enable_simd = x86_cpu_has_sse2 &&
                           x86_cpu_has_sse42 &&
                           x86_cpu_has_pclmulqdq;
+    x86_cpu_enable_ssse3 = x86_cpu_has_sse2 && x86_cpu_has_ssse3;
+    x86_cpu_enable_avx2 = x86_cpu_enable_ssse3 && x86_cpu_has_avx2;
     return TRUE;
 }
 #endif  /* _MSC_VER */
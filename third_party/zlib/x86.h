@@ -7,6 +7,8 @@
 #define X86_H
 
 extern int x86_cpu_enable_simd;
+extern int x86_cpu_enable_ssse3;
+extern int x86_cpu_enable_avx2;
 
 void x86_check_features(void);
 
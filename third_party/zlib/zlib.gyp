@@ -4,6 +4,38 @@
 
 {
   'targets': [
+    {
+      # The SSSE3 Adler-32 kernel only needs x86_cpu_enable_ssse3, so it must
+      # not be built with the -msse4.2 of zlib_x86_simd.
+      'target_name' : 'zlib_adler32_simd',
+      'conditions': [
+        ['OS!="ios" and (target_arch=="ia32" or target_arch=="x64")', {
+          'type': 'static_library',
+          'cflags' : ['-mssse3'],
+          'xcode_settings' : {
+             'OTHER_CFLAGS' : ['-mssse3'],
+          },
+          'sources' : [
+            'adler32_simd.c',
+            'adler32_simd.h',
+          ],
+          'conditions': [
+            ['OS=="win" and clang==1', {
+              'msvs_settings': {
+                'VCCLCompilerTool': {
+                  'AdditionalOptions': [ '-mssse3' ],
+                },
+              },
+            }],
+          ],
+        }, {
+          'type': 'none',
+        }],
+        ['OS=="android"', {
+          'toolsets': ['target', 'host'],
+        }],
+      ],
+    },
     {
       'target_name' : 'zlib_x86_simd',
       'type': 'static_library',
@@ -14,8 +46,12 @@
              'OTHER_CFLAGS' : ['-msse4.2', '-mpclmul'],
           },
           'sources' : [
+            'chunkcopy.h',
+            'crc32_simd.c',
+            'crc32_simd.h',
             'crc_folding.c',
             'fill_window_sse.c',
+            'inffast_chunk.c',
           ],
           'conditions': [
             ['OS=="win" and clang==1', {
@@ -46,12 +82,15 @@
         'deflate.h',
         'gzclose.c',
         'gzguts.h',
+        'gzindex.c',
         'gzlib.c',
         'gzread.c',
+        'gzthread.c',
         'gzwrite.c',
         'infback.c',
         'inffast.c',
         'inffast.h',
+        'inffast_chunk.h',
         'inffixed.h',
         'inflate.c',
         'inflate.h',
@@ -68,7 +107,8 @@
         'zutil.h',
       ],
       'dependencies' : [
-        'zlib_x86_simd'
+        'zlib_adler32_simd',
+        'zlib_x86_simd',
       ],
       'include_dirs': [
         '.',
@@ -1228,6 +1228,41 @@ ZEXTERN int ZEXPORT gzbuffer OF((gzFile file, unsigned size));
    too late.
 */
 
+/* Google: adaptive buffering and overlapped i/o.  See gzthread.c. */
+#define GZ_TUNE_ADVISE 1    /* tell the system the file is read sequentially */
+#define GZ_TUNE_THREAD 2    /* overlap file i/o with (de)compression */
+
+ZEXTERN int ZEXPORT gztune OF((gzFile file, unsigned max, int flags));
+/*
+     Lets the reads or writes of file adapt to sequential streaming.  Like
+   gzbuffer(), this function must be called after gzopen() or gzdopen(), and
+   before any other calls that read or write the file.
+
+     If max is larger than the buffer size, then each time four reads or
+   writes in a row transfer a full buffer, the input buffer (reading) or
+   output buffer (writing) doubles, up to max bytes.  Reading or writing a
+   large file then takes a fraction of the read() or write() calls, while
+   small files keep small buffers.  When reading, input buffers only grow on
+   seekable files.
+
+     GZ_TUNE_ADVISE tells the system with posix_fadvise(), where available,
+   that the file will be read sequentially, so that it reads further ahead.
+   It has no effect when writing.
+
+     GZ_TUNE_THREAD starts a helper thread that reads the next input buffer
+   while the current one is decompressed, or writes a full output buffer
+   while deflate fills another one, so that file i/o and (de)compression
+   overlap.  This uses a second buffer of the same size.  When reading, the
+   file must be seekable so that input read ahead can be given back.  Where
+   threads are not available, or if the thread cannot be started, all i/o is
+   done in the calling thread.  When writing, all data is written once
+   gzflush() or gzclose() returns, and a write error may be reported by a
+   later call than the gzwrite() that made it.
+
+     gztune() returns 0 on success, or -1 on failure, such as being called
+   too late or with unknown flags.
+*/
+
 ZEXTERN int ZEXPORT gzsetparams OF((gzFile file, int level, int strategy));
 /*
      Dynamically update the compression level or strategy.  See the description
@@ -1462,6 +1497,72 @@ ZEXTERN void ZEXPORT gzclearerr OF((gzFile file));
    file that is being written concurrently.
 */
 
+/* Google: random access to gzip files.  See gzindex.c. */
+typedef struct gz_index_s FAR *gzIndex;  /* opaque random access index */
+
+ZEXTERN int ZEXPORT gzbuildindex OF((gzFile file, uLong span,
+                                     gzIndex *index));
+/*
+     Reads all of the gzip file opened for reading with gzopen() or gzdopen()
+   and builds an index of access points roughly every span bytes of
+   uncompressed data.  Each access point holds the inflate bit position and
+   the last 32K of output at a deflate block boundary, so the index takes a
+   little over 32K of memory per access point.  Concatenated gzip members are
+   indexed; data following the last member that is not a gzip member is not.
+   The file must be seekable, and is left rewound.
+
+     gzbuildindex returns Z_OK on success and sets *index, Z_STREAM_ERROR if
+   file is not open for reading or span is zero, Z_MEM_ERROR if there was not
+   enough memory, Z_DATA_ERROR if the gzip data is invalid or truncated, or
+   Z_ERRNO on a file error.
+*/
+
+ZEXTERN uLong ZEXPORT gzindexbound OF((gzIndex index));
+/*
+     Returns an upper bound on the length of index once serialized by
+   gzsaveindex().
+*/
+
+ZEXTERN int ZEXPORT gzsaveindex OF((gzIndex index, Bytef *dest,
+                                    uLongf *destLen));
+/*
+     Serializes index into dest, whose length in bytes is *destLen on entry,
+   and sets *destLen to the length used.  The saved windows are compressed,
+   and the whole is covered by a crc32, so a saved index is typically a
+   fraction of its size in memory.  gzsaveindex returns Z_OK on success,
+   Z_BUF_ERROR if dest is too small, or Z_MEM_ERROR if there was not enough
+   memory.
+*/
+
+ZEXTERN int ZEXPORT gzloadindex OF((const Bytef *source, uLong sourceLen,
+                                    gzIndex *index));
+/*
+     Rebuilds in *index an index serialized with gzsaveindex().  Returns Z_OK
+   on success, Z_DATA_ERROR if source is not a valid serialized index, or
+   Z_MEM_ERROR if there was not enough memory.
+*/
+
+ZEXTERN int ZEXPORT gzsetindex OF((gzFile file, gzIndex index));
+/*
+     Makes gzseek() and the skipping it requests use index, which must have
+   been built from the same gzip data.  A seek then costs at most the
+   decompression of span bytes from the closest access point before the new
+   offset, instead of the decompression of everything up to it, and seeking
+   backwards no longer restarts from the beginning of the file.  The index is
+   only read, so one index can be shared by several files open at the same
+   time.  It is not owned by file: it must outlive it, or be detached first
+   with gzsetindex(file, NULL).
+
+     gzsetindex returns Z_OK on success, Z_STREAM_ERROR if file is not open
+   for reading, Z_DATA_ERROR if index was built from data of another length,
+   or Z_ERRNO on a file error.
+*/
+
+ZEXTERN void ZEXPORT gzfreeindex OF((gzIndex index));
+/*
+     Frees index.  index may be NULL.
+*/
+
 
                         /* checksum functions */
 